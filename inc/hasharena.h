@@ -0,0 +1,84 @@
+/// @file hasharena.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief The per-table arena behind the HT_ARENA flag: size-classed slabs with
+///        freelists for entries, keys and values, released all at once.
+///        An arena is not thread safe, it belongs to a single table.
+
+#ifndef HASH_ARENA_H
+#define HASH_ARENA_H
+
+#include <stddef.h>
+
+/// The size class granularity in bytes (also the alignment of every allocation).
+#define HA_CLASS_SIZE 16
+
+/// Allocations larger than this go to malloc (and are still released with the arena).
+#ifndef HA_MAX_SMALL
+#define HA_MAX_SMALL 256
+#endif //HA_MAX_SMALL
+
+/// The number of size classes.
+#define HA_CLASS_COUNT (HA_MAX_SMALL / HA_CLASS_SIZE)
+
+/// The size of a slab, each slab serving a single size class.
+#ifndef HA_SLAB_SIZE
+#define HA_SLAB_SIZE (64 * 1024)
+#endif //HA_SLAB_SIZE
+
+/// The header of a slab, or of a large allocation.
+typedef struct hash_arena_block {
+    /// The next block of the list.
+    struct hash_arena_block *pnext;
+    /// The previous block of the list (large allocations only).
+    struct hash_arena_block *pprev;
+} hash_arena_block_t;
+
+/// A per-table arena.
+typedef struct hash_arena {
+    /// The freed allocations of each size class, linked through their first bytes.
+    void *pfree[HA_CLASS_COUNT];
+    /// The next never used byte of the current slab of each size class.
+    char *pcursor[HA_CLASS_COUNT];
+    /// The end of the current slab of each size class.
+    char *pend[HA_CLASS_COUNT];
+    /// Every slab of the arena.
+    hash_arena_block_t *pslabs;
+    /// Every live large allocation.
+    hash_arena_block_t *plarge;
+    /// The number of bytes obtained from malloc.
+    size_t reserved;
+} hash_arena_t;
+
+/// @brief Initializes an empty arena.
+/// @param parena A pointer to the arena.
+void ha_init(hash_arena_t *parena);
+
+/// @brief Allocates memory from the arena.
+/// @param parena A pointer to the arena.
+/// @param size The number of bytes to allocate.
+/// @returns A pointer to the memory, NULL if it could not be allocated.
+void *ha_alloc_p(hash_arena_t *parena, size_t size);
+
+/// @brief Makes sure the next count allocations of size bytes are carved
+///        from a single block, allocating one slab large enough for all of
+///        them if the current slab of their size class is too short (what is
+///        left of that slab is abandoned). Large sizes are not reserved.
+/// @param parena A pointer to the arena.
+/// @param size The size of each allocation.
+/// @param count The number of allocations.
+/// @returns 1 on success, 0 if the slab could not be allocated (later
+///          allocations then fall back to regular slabs).
+int ha_reserve_i(hash_arena_t *parena, size_t size, size_t count);
+
+/// @brief Gives an allocation back to its size class for reuse.
+/// @param parena A pointer to the arena.
+/// @param p A pointer returned by ha_alloc_p (NULL is ignored).
+/// @param size The size that was passed to ha_alloc_p.
+void ha_free(hash_arena_t *parena, void *p, size_t size);
+
+/// @brief Frees every allocation of the arena at once (one free per slab),
+///        leaving the arena empty and ready for reuse.
+/// @param parena A pointer to the arena.
+void ha_release(hash_arena_t *parena);
+
+#endif //HASH_ARENA_H
@@ -10,12 +10,56 @@
 #include <stddef.h>
 
 #include "hashfunc.h"
+#include "hasharena.h"
 
 /// The initial size of the hash table.
 #ifndef HT_INITIAL_SIZE
 #define HT_INITIAL_SIZE 64
 #endif //HT_INITIAL_SIZE
 
+/// The largest key or value (in bytes) stored inside the entry itself
+/// by an HT_INLINE table, at most 65528 (the capacity is kept in 16 bits).
+#ifndef HT_INLINE_MAX
+#define HT_INLINE_MAX 32
+#endif //HT_INLINE_MAX
+
+/// The default number of old buckets an HT_INCREMENTAL table migrates on
+/// each operation while a resize is in progress (see ht_set_migrate_budget).
+#ifndef HT_MIGRATE_BUDGET
+#define HT_MIGRATE_BUDGET 64
+#endif //HT_MIGRATE_BUDGET
+
+/// The default number of threads ht_resize rehashes a chained table with
+/// (see ht_set_resize_threads).
+#ifndef HT_RESIZE_THREADS
+#define HT_RESIZE_THREADS 1
+#endif //HT_RESIZE_THREADS
+
+/// The fewest old buckets a resize hands to each of its threads: below
+/// that, starting a thread costs more than it saves.
+#ifndef HT_RESIZE_SPLIT
+#define HT_RESIZE_SPLIT 65536
+#endif //HT_RESIZE_SPLIT
+
+/// The most buckets (or slots) ht_scan_sz visits per item it may return,
+/// which bounds a call on a sparse table.
+#ifndef HT_SCAN_VISITS
+#define HT_SCAN_VISITS 10
+#endif //HT_SCAN_VISITS
+
+/// The fewest buckets (or slots) ht_foreach_parallel hands to each of its
+/// threads.
+#ifndef HT_FOREACH_SPLIT
+#define HT_FOREACH_SPLIT 16384
+#endif //HT_FOREACH_SPLIT
+
+/// The number of keys the batched lookups (ht_get_batch) keep in flight:
+/// each stage issues the prefetches of the whole group before the next
+/// stage reads what the previous one fetched.
+#ifndef HT_BATCH_GROUP
+#define HT_BATCH_GROUP 16
+#endif //HT_BATCH_GROUP
+
 /// The hash entry struct. Acts as a node in a linked list.
 struct hash_entry {
     /// A pointer to the key.
@@ -25,17 +69,131 @@ struct hash_entry {
 
     /// A pointer to the value.
     void *pvalue;
-    /// The size of the key in bytes.
-    size_t key_size;
+    /// The size of the key in bytes (the hash functions take an int length,
+    /// so 32 bits are enough).
+    uint32_t key_size;
+
+    /// The number of bytes reserved for the value inside the entry
+    /// allocation (after the inline key, if any), 0 if there are none.
+    uint16_t value_capacity;
+    /// 1 if the key is stored inside the entry allocation, right after the
+    /// entry. A key allocated apart may land there too (from an arena slab).
+    uint16_t key_inline;
 
     /// A pointer to the next hash entry in the chain (or NULL if none).
     /// This is used for collision resolution.
     struct hash_entry *pnext;
+
+    /// The hash of the key, computed once when the entry is inserted. Resizes
+    /// redistribute by it and lookups compare it before comparing keys.
+    /// Only the low 32 bits are set unless the table uses HT_HASH64.
+    uint64_t hash;
 };
 
 /// The hash_entry struct. This is considered to be private
 typedef struct hash_entry hash_entry_t;
 
+/// A slot of the open-addressing (HT_ROBIN_HOOD, HT_SWISS) engines. The entry
+/// is stored by value so that a probe walks contiguous memory.
+struct hash_slot {
+    /// The entry held by this slot (key and value are owned as in a chain node,
+    /// the hash is kept in it so that probing and resizing never rehash).
+    hash_entry_t entry;
+    /// The probe distance from the home slot plus one, 0 if the slot is empty.
+    uint32_t dist;
+};
+
+/// The hash_slot struct. This is considered to be private
+typedef struct hash_slot hash_slot_t;
+
+/// The hash of a key as the engine of a table uses it (see ht_hash_code), for
+/// callers that hash a key once and hand it to several calls.
+typedef struct hash_code {
+    /// The hash of the key (ht_hash_ul, or the entry hash of ck_hash with HT_CUCKOO).
+    uint64_t hash;
+    /// The tag of the key with HT_CUCKOO (ck_hash), 0 otherwise.
+    uint32_t tag;
+} hash_code_t;
+
+/// Number of buckets in the probe length histogram (see ht_probe_stats).
+#ifndef HT_PROBE_HISTOGRAM_SIZE
+#define HT_PROBE_HISTOGRAM_SIZE 16
+#endif //HT_PROBE_HISTOGRAM_SIZE
+
+/// Probe length statistics, the probe length of an entry being the number
+/// of chain nodes (or slots, or HT_CUCKOO buckets) examined by a successful
+/// lookup of its key.
+typedef struct hash_probe_stats {
+    /// The longest probe length found in the table.
+    unsigned int max_probe;
+    /// The mean probe length over all entries (0 for an empty table).
+    double mean_probe;
+    /// histogram[i] is the number of entries with a probe length of i + 1,
+    /// the last bucket also counts every longer probe.
+    size_t histogram[HT_PROBE_HISTOGRAM_SIZE];
+    /// The number of inserts that found no bucket and went to the stash (HT_CUCKOO only).
+    unsigned int insert_failures;
+    /// The number of times the buckets were rebuilt (HT_CUCKOO only).
+    unsigned int rehashes;
+} hash_probe_stats_t;
+
+/// Number of buckets in the chain length histogram (see ht_stats).
+#ifndef HT_CHAIN_HISTOGRAM_SIZE
+#define HT_CHAIN_HISTOGRAM_SIZE 16
+#endif //HT_CHAIN_HISTOGRAM_SIZE
+
+/// The statistics of a table (see ht_stats). The chain of a bucket is the
+/// keys that hash to it: the nodes linked from it, the keys whose home slot
+/// it is for HT_ROBIN_HOOD and HT_SWISS, the keys in it for HT_CUCKOO.
+typedef struct hash_stats {
+    /// chain_histogram[i] is the number of buckets with a chain of i keys,
+    /// the last bucket also counts every longer chain.
+    size_t chain_histogram[HT_CHAIN_HISTOGRAM_SIZE];
+    /// The longest chain.
+    size_t max_chain;
+    /// The probe lengths of successful lookups (see ht_probe_stats), the mean in hits.mean_probe.
+    hash_probe_stats_t hits;
+    /// The mean probe length of a lookup of a missing key, over every bucket
+    /// its hash can land on: the nodes of the chain, the slots up to the
+    /// first one that ends the probe (HT_ROBIN_HOOD, HT_SWISS) or the
+    /// buckets and stash (HT_CUCKOO) examined.
+    double miss_probes;
+    /// The bytes of the bucket array (slots and control bytes for
+    /// HT_ROBIN_HOOD and HT_SWISS, buckets and stash for HT_CUCKOO).
+    size_t array_bytes;
+    /// The bytes of the entry nodes, 0 when entries are stored in the slots.
+    size_t node_bytes;
+    /// The bytes of the keys the table owns (none with HT_KEY_CONST), inline ones included.
+    size_t key_bytes;
+    /// The bytes of the values the table owns (none with HT_VALUE_CONST), inline space included.
+    size_t value_bytes;
+    /// The number of resizes since ht_init, rehashes at the same size included.
+    size_t resize_count;
+    /// The time spent in them, the migrations of an HT_INCREMENTAL resize included.
+    double resize_seconds;
+} hash_stats_t;
+
+/// The state of the HT_CUCKOO engine (see hashcuckoo.h).
+struct hash_cuckoo;
+
+/// The reclamation domain of an HT_EPOCH table (see hashepoch.h).
+struct hash_epoch;
+
+/// A snapshot file mapped by ht_load_i (see hashsnap.h).
+struct hash_snapshot;
+
+/// A write-ahead log the writes of a table are appended to (see hashwal.h).
+struct hash_wal;
+
+/// The bucket array and its size, published together to the lock-free
+/// readers of an HT_EPOCH table and replaced (not changed) by a resize.
+typedef struct hash_view {
+    /// The bucket array.
+    hash_entry_t **pparray;
+    /// The number of buckets.
+    size_t array_size;
+} hash_view_t;
+
 /// The primary hashtable struct
 typedef struct hash_table {
     // hash function for x86_32
@@ -46,19 +204,63 @@ typedef struct hash_table {
     HashFunc *phashfunc_x64_128;
 
     /// The number of keys in the hash table.
-    unsigned int key_count;
+    size_t key_count;
     /// The internal hash table array.
     hash_entry_t **pparray;
+    /// The internal slot array (HT_ROBIN_HOOD and HT_SWISS engines, NULL otherwise).
+    hash_slot_t *pslots;
+    /// One control byte per slot, followed by a copy of the first bytes
+    /// so that a group load never wraps (HT_SWISS engine only, NULL otherwise).
+    uint8_t *pctrl;
+
+    /// The size of the internal array (number of slots for HT_ROBIN_HOOD and HT_SWISS).
+    size_t array_size;
 
-    /// The size of the internal array.
-    unsigned int array_size;
+    /// The number of deleted slots not yet reclaimed by a rehash (HT_SWISS only).
+    size_t tombstones;
 
-    /// A count of the number of hash collisions.
-    unsigned int collisions;
+    /// A count of the number of hash collisions (entries stored away from
+    /// their home slot for HT_ROBIN_HOOD).
+    size_t collisions;
 
     /// Any flags that have been set. (See the ht_flags enum).
     int flags;
 
+    /// The arena entries, keys and values are allocated from (HT_ARENA only, NULL otherwise).
+    hash_arena_t *parena;
+
+    /// The buckets and stash of the HT_CUCKOO engine (NULL otherwise).
+    struct hash_cuckoo *pcuckoo;
+
+    /// The epoch domain of the lock-free readers (HT_EPOCH only, NULL otherwise).
+    struct hash_epoch *pepoch;
+    /// The bucket array the lock-free readers use (HT_EPOCH only, NULL otherwise).
+    hash_view_t *pview;
+
+    /// The snapshot the table was loaded from (NULL otherwise), which serves
+    /// its lookups until the first write.
+    struct hash_snapshot *psnapshot;
+
+    /// The log every insert and remove is appended to before it is applied
+    /// (attached by hw_open_i, NULL otherwise).
+    struct hash_wal *pwal;
+
+    /// The bucket array an incremental resize is moving away from
+    /// (HT_INCREMENTAL only, NULL when no resize is in progress).
+    hash_entry_t **ppold;
+    /// The size of ppold.
+    size_t old_size;
+    /// The next bucket of ppold to migrate, every bucket before it is empty.
+    size_t migrate_index;
+    /// The number of ppold buckets migrated by each operation.
+    size_t migrate_budget;
+    /// The number of threads ht_resize rehashes the chains with.
+    size_t resize_threads;
+    /// The number of resizes since ht_init (see ht_stats).
+    size_t resize_count;
+    /// The time spent in them in nanoseconds.
+    uint64_t resize_ns;
+
     /// The max load factor that is acceptable before an autoresize is triggered
     /// (where load_factor is the ratio of collisions to table size).
     double max_load_factor;
@@ -81,7 +283,90 @@ typedef enum {
 
     /// Don't automatically resize hashtable when the load factor
     /// goes above the trigger value
-    HT_NO_AUTORESIZE = 4
+    HT_NO_AUTORESIZE = 4,
+
+    /// Store the entries in a flat slot array using Robin Hood linear
+    /// probing with backward-shift deletion instead of chained buckets.
+    /// max_load_factor is ignored, the table grows once HT_ROBIN_MAX_LOAD
+    /// of the slots are in use (or when it is full with HT_NO_AUTORESIZE).
+    HT_ROBIN_HOOD = 8,
+
+    /// Store the entries in a flat slot array probed a group of slots at a
+    /// time through a separate array of 1-byte hash fingerprints (SSE2 or
+    /// AVX2, picked at runtime, with a scalar fallback). Keys are only
+    /// compared on a fingerprint match. The size is rounded up to a power
+    /// of two and, as for HT_ROBIN_HOOD, max_load_factor is ignored.
+    HT_SWISS = 16,
+
+    /// Keys and values of up to HT_INLINE_MAX bytes are copied right after
+    /// the entry, in the same allocation, rather than allocated on their own.
+    /// A new value that fits the inline space reuses it. Has no effect on
+    /// HT_KEY_CONST keys, HT_VALUE_CONST values, or the open-addressing
+    /// engines (whose entries live in the slot array).
+    HT_INLINE = 32,
+
+    /// Allocate entries, keys and values from a per-table arena of
+    /// size-classed slabs. Removed entries are recycled through freelists
+    /// and ht_clear/ht_destroy free whole slabs instead of every entry.
+    HT_ARENA = 64,
+
+    /// Grow the chained table incrementally: an autoresize only allocates
+    /// the new bucket array, then every insert, lookup and remove moves up
+    /// to migrate_budget buckets of the old one, which lookups keep
+    /// checking until it is empty. Explicit ht_resize calls still move
+    /// everything at once. Has no effect on the open-addressing engines.
+    HT_INCREMENTAL = 128,
+
+    /// Round the bucket count (slot count for HT_ROBIN_HOOD) up to a power
+    /// of two and take the index from the high bits of the hash, a shift
+    /// instead of the default modulo. HT_SWISS tables always do so (masking
+    /// the low bits, the high ones being its fingerprints).
+    HT_POW2 = 256,
+
+    /// Keep any bucket count and map the hash onto it with a multiply and
+    /// a shift (Lemire's fastrange) instead of the default modulo. Ignored
+    /// if HT_POW2 is set.
+    HT_FASTRANGE = 512,
+
+    /// Store pointers to the entries in buckets of 4 slots (one cache line)
+    /// and give every key two candidate buckets, both derived from the
+    /// 128 bit hash, moving entries between them (cuckoo hashing) to make
+    /// room. A lookup reads at most two buckets, plus a small stash that is
+    /// only used when an insert runs out of moves. The number of slots is
+    /// a power of two and max_load_factor is ignored, the table grows once
+    /// HT_CUCKOO_MAX_LOAD of the slots are in use or the stash is full.
+    HT_CUCKOO = 1024,
+
+    /// Hash every key with a single call to the x64_128 function and keep
+    /// 64 bits of it: the bucket index is taken from one end of them and the
+    /// rest still tells keys apart (HT_SWISS fingerprints, hash compares), so
+    /// tables of more than 2^32 buckets stay evenly used. The default 32 bit
+    /// hash is cheaper for short keys and small tables.
+    HT_HASH64 = 2048,
+
+    /// Hash with the bundled multiply-mix functions (hf_mix_32, hf_mix_128)
+    /// instead of the ones given to (or built into) ht_init. The cheapest
+    /// choice for keys of up to 16 bytes.
+    HT_HASH_MIX = 4096,
+
+    /// Hash with the bundled CRC32C functions (hf_crc32c_32, hf_crc32c_128),
+    /// in hardware on cpus with SSE4.2. Ignored if HT_HASH_MIX is set.
+    HT_HASH_CRC32C = 8192,
+
+    /// Hash with MurmurHash3, even when built without __WITH_MURMUR.
+    /// Ignored if HT_HASH_MIX or HT_HASH_CRC32C is set.
+    HT_HASH_MURMUR = 16384,
+
+    /// Let ht_get_p and ht_contains_i run concurrently with one writer,
+    /// without locks or atomic read-modify-writes (chained engine only,
+    /// HT_INCREMENTAL is cleared). Each reader thread registers with
+    /// ep_register_p(ptable->pepoch) and wraps its lookups, and its use
+    /// of the values they return, in ep_enter/ep_exit. Writers must be
+    /// serialized among themselves: they publish chain changes with
+    /// release stores, replace a value by a new entry, copy the entries
+    /// on a resize, and free what they unlink only once no reader can
+    /// still reach it (see hashepoch.h).
+    HT_EPOCH = 32768
 
 } hash_flags_t;
 
@@ -89,19 +374,64 @@ typedef enum {
 // HashEntry functions
 //----------------------------------
 
+/// @brief Fills an existing hash entry, copying key and value as he_create_p does.
+/// @param flags Hash table flags.
+/// @param parena The arena to allocate from, NULL to use malloc.
+/// @param pentry A pointer to the entry to fill.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+/// @returns 1 on success, 0 if memory could not be allocated.
+int he_fill_i(int flags, hash_arena_t *parena, hash_entry_t *pentry, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Frees the key and value owned by the entry, but not the entry itself.
+/// @param flags The hash table flags.
+/// @param parena The arena to allocate from, NULL to use malloc.
+/// @param pentry A pointer to the hash entry.
+void he_release(int flags, hash_arena_t *parena, hash_entry_t *pentry);
+
+/// @brief Moves a hash entry into an entry stored by value (a slot) and frees
+///        the source node. Inline key or value bytes are copied out of the node.
+/// @param flags The hash table flags.
+/// @param parena The arena to allocate from, NULL to use malloc.
+/// @param pdst A pointer to the destination entry.
+/// @param psrc A pointer to the hash entry (created by he_create_p).
+/// @returns 1 on success, 0 if memory could not be allocated (psrc is then left untouched).
+int he_move_i(int flags, hash_arena_t *parena, hash_entry_t *pdst, hash_entry_t *psrc);
+
 /// @brief Creates a new hash entry.
 /// @param flags Hash table flags.
+/// @param parena The arena to allocate from, NULL to use malloc.
 /// @param pkey A pointer to the key.
 /// @param key_size The size of the key in bytes.
 /// @param pvalue A pointer to the value.
 /// @param value_size The size of the value in bytes.
 /// @returns A pointer to the hash entry.
-hash_entry_t *he_create_p(int flags, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+hash_entry_t *he_create_p(int flags, hash_arena_t *parena, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Reserves arena space for count entries made by he_create_p with
+///        these sizes: the nodes, and the keys and values not stored inline,
+///        each come from one block (see ha_reserve_i).
+/// @param flags Hash table flags.
+/// @param parena The arena to reserve from (nothing is done if NULL).
+/// @param key_size The size of each key in bytes.
+/// @param value_size The size of each value in bytes.
+/// @param count The number of entries.
+void he_reserve(int flags, hash_arena_t *parena, size_t key_size, size_t value_size, size_t count);
+
+/// @brief Adds the bytes the entry owns to the counts of ht_stats.
+/// @param flags The hash table flags.
+/// @param pentry A pointer to the hash entry.
+/// @param pkey_bytes The key bytes to add to: the key, aligned if it is inline.
+/// @param pvalue_bytes The value bytes to add to: the inline space and the value stored apart.
+void he_bytes(int flags, hash_entry_t *pentry, size_t *pkey_bytes, size_t *pvalue_bytes);
 
 /// @brief Destroys the hash entry and frees all associated memory.
 /// @param flags The hash table flags.
+/// @param parena The arena to allocate from, NULL to use malloc.
 /// @param hash_entry A pointer to the hash entry.
-void he_destroy(int flags, hash_entry_t *pentry);
+void he_destroy(int flags, hash_arena_t *parena, hash_entry_t *pentry);
 
 /// @brief Compare two hash entries.
 /// @param pe1 A pointer to the first entry.
@@ -112,10 +442,11 @@ int he_key_compare_i(hash_entry_t *pe1, hash_entry_t *pe2);
 
 /// @brief Sets the value on an existing hash entry.
 /// @param flags The hashtable flags.
+/// @param parena The arena to allocate from, NULL to use malloc.
 /// @param pentry A pointer to the hash entry.
 /// @param pvalue A pointer to the new value.
 /// @param value_size The size of the new value in bytes.
-void he_set_value(int flags, hash_entry_t *pentry, void *pvalue, size_t value_size);
+void he_set_value(int flags, hash_arena_t *parena, hash_entry_t *pentry, void *pvalue, size_t value_size);
 
 //----------------------------------
 // HashTable functions
@@ -127,6 +458,8 @@ void he_set_value(int flags, hash_entry_t *pentry, void *pvalue, size_t value_si
 /// @param max_load_factor The ratio of collisions:table_size before an autoresize is triggered
 ///        for example: if max_load_factor = 0.1, the table will resize if the number
 ///        of collisions increases beyond 1/10th of the size of the table
+///        The HT_HASH_MIX, HT_HASH_CRC32C and HT_HASH_MURMUR flags replace the
+///        hash functions below (or MurmurHash3 when built with __WITH_MURMUR).
 void ht_init(hash_table_t *ptable, hash_flags_t flags, double max_load_factor
 #ifndef __WITH_MURMUR
         , HashFunc *for_x86_32, HashFunc *for_x86_128, HashFunc *for_x64_128
@@ -144,12 +477,49 @@ void ht_destroy(hash_table_t *ptable);
 /// @brief Resizes the hash table's internal array. This operation is
 ///        _expensive_, however it can make an overfull table run faster
 ///        if the table is expanded. The table can also be shrunk to reduce
-///        memory usage.
+///        memory usage. Entries are moved by their stored hash, keys are
+///        neither hashed nor compared again. An incremental resize in
+///        progress is completed first. With HT_POW2 the size is rounded
+///        up to a power of two.
 /// @param ptable A pointer to the table.
 /// @param new_size The desired size of the table.
-void ht_resize(hash_table_t *ptable, unsigned int new_size);
+void ht_resize(hash_table_t *ptable, size_t new_size);
 
-/// @brief Inserts an existing hash entry into the hash table.
+/// @brief Resizes the array for key_count keys without an autoresize, as
+///        ht_insert_batch does for a batch. Never shrinks the table, and has
+///        no effect with HT_NO_AUTORESIZE.
+/// @param ptable A pointer to the table.
+/// @param key_count The number of keys the table will hold.
+void ht_reserve(hash_table_t *ptable, size_t key_count);
+
+/// @brief Sets the number of old buckets an HT_INCREMENTAL table migrates on
+///        each operation while a resize is in progress (HT_MIGRATE_BUDGET by
+///        default). Larger budgets finish sooner, smaller ones stall less.
+/// @param ptable A pointer to the hash table.
+/// @param budget The number of buckets, at least 1.
+void ht_set_migrate_budget(hash_table_t *ptable, size_t budget);
+
+/// @brief Sets the number of threads ht_resize (explicit or automatic, but
+///        not an HT_INCREMENTAL migration) moves the chains of the table
+///        with, HT_RESIZE_THREADS by default. Each thread gets at least
+///        HT_RESIZE_SPLIT old buckets. The resulting table is the same
+///        whatever the number of threads. Has no effect on HT_EPOCH tables
+///        or the open-addressing engines.
+/// @param ptable A pointer to the hash table.
+/// @param thread_count The number of threads, at least 1.
+void ht_set_resize_threads(hash_table_t *ptable, size_t thread_count);
+
+/// @brief Reads a monotonic clock, to time a resize for ht_resize_done.
+/// @returns The time in nanoseconds.
+uint64_t ht_clock_ul(void);
+
+/// @brief Counts a resize of the table in the statistics of ht_stats
+///        (called by the engines once their resize succeeded).
+/// @param ptable A pointer to the hash table.
+/// @param start The time the resize started at (ht_clock_ul).
+void ht_resize_done(hash_table_t *ptable, uint64_t start);
+
+/// @brief Inserts an existing hash entry into the hash table, setting its hash.
 /// @param ptable A pointer to the hash table.
 /// @param pentry A pointer to the hash entry.
 void ht_he_insert(hash_table_t *ptable, hash_entry_t *pentry);
@@ -172,6 +542,46 @@ void* ht_get_p(hash_table_t *ptable, void *pkey, size_t key_size, size_t *pvalue
 /// @returns 1 if the key is in the table, 0 otherwise
 int ht_contains_i(hash_table_t *ptable, void *pkey, size_t key_size);
 
+/// @brief Same as ht_get_p, for a key whose hash is already known.
+/// @param ptable A pointer to the hash table.
+/// @param pcode The hash of the key (ht_hash_code on this table, or on one
+///        created with the same flags and hash functions).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue_size Set to the size in bytes of the value, can be NULL.
+/// @returns A pointer to the requested value, NULL if the key is not in the table.
+void* ht_get_hashed_p(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size, size_t *pvalue_size);
+
+/// @brief Same as ht_contains_i, for a key whose hash is already known.
+/// @param ptable A pointer to the hash table.
+/// @param pcode The hash of the key (see ht_get_hashed_p).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns 1 if the key is in the table, 0 otherwise
+int ht_contains_hashed_i(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size);
+
+/// @brief Looks up count keys at once. The keys are handled HT_BATCH_GROUP
+///        at a time: all of them are hashed and their buckets prefetched,
+///        then their first nodes are prefetched, then the chains are
+///        walked, so that the cache misses of independent keys overlap.
+///        The results are the same as count calls to ht_get_p.
+/// @param ptable A pointer to the hash table.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param count The number of keys.
+/// @param ppvalues Set to a pointer to the value of each key, NULL if it is not in the table.
+/// @param pvalue_sizes Set to the size of each value (0 if not found), can be NULL.
+void ht_get_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count,
+                  void **ppvalues, size_t *pvalue_sizes);
+
+/// @brief Checks count keys at once, see ht_get_batch.
+/// @param ptable A pointer to the hash table.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param count The number of keys.
+/// @param pfound Set to 1 for each key in the table, 0 otherwise.
+void ht_contains_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count, int *pfound);
+
 /// @brief Inserts the {key: value} pair into the hash table, makes copies of both key and value.
 /// @param ptable A pointer to the hash table.
 /// @param pkey A pointer to the key.
@@ -180,35 +590,285 @@ int ht_contains_i(hash_table_t *ptable, void *pkey, size_t key_size);
 /// @param value_size The size of the value in bytes.
 void ht_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size);
 
+/// @brief Same as ht_insert, for a key whose hash is already known.
+/// @param ptable A pointer to the hash table.
+/// @param pcode The hash of the key (see ht_get_hashed_p).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void ht_insert_hashed(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size,
+                      void *pvalue, size_t value_size);
+
+/// @brief Inserts count {key: value} pairs, with the same result as count
+///        calls to ht_insert. Unless HT_NO_AUTORESIZE is set, the array is
+///        first resized once for the final number of keys, to at least twice
+///        its size as an autoresize would; with HT_ARENA the
+///        entries are carved from one block, sized after the first pair.
+///        The chained engine then hashes, prefetches and links the pairs
+///        HT_BATCH_GROUP at a time.
+/// @param ptable A pointer to the hash table.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param ppvalues The values.
+/// @param pvalue_sizes The size of each value in bytes.
+/// @param count The number of pairs.
+void ht_insert_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes,
+                     void **ppvalues, size_t *pvalue_sizes, size_t count);
+
 /// @brief Removes the entry corresponding to the specified key from the hash table.
 /// @param ptable A pointer to the hash table.
 /// @param pkey A pointer to the key.
 /// @param key_size The size of the key in bytes.
 void ht_remove(hash_table_t *ptable, void *pkey, size_t key_size);
 
+/// @brief Same as ht_remove, for a key whose hash is already known.
+/// @param ptable A pointer to the hash table.
+/// @param pcode The hash of the key (see ht_get_hashed_p).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void ht_remove_hashed(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size);
+
 /// @brief Sets the global security seed to be used in hash function.
 /// @param seed The seed to use.
 void ht_set_seed(uint32_t seed);
 
+/// @brief Returns the global seed (see ht_set_seed), for the tables that
+///        hash keys outside ht_hash_ul.
+/// @returns The seed.
+uint32_t ht_get_seed_ui(void);
+
 /// @brief Returns the number of entries in the hash table.
 /// @param ptable A pointer to the table.
 /// @returns The number of entries in the hash table.
+size_t ht_size_sz(hash_table_t *ptable);
+
+/// @brief Same as ht_size_sz, kept for API compatibility.
+/// @param ptable A pointer to the table.
+/// @returns The number of entries in the hash table, truncated to unsigned int.
 unsigned int ht_size_ui(hash_table_t *ptable);
 
+/// A pair returned by ht_scan_sz, pointing into the table: valid until the
+/// key is removed or its value replaced.
+typedef struct hash_scan_item {
+    void *pkey;
+    size_t key_size;
+    void *pvalue;
+    size_t value_size;
+} hash_scan_item_t;
+
+/// Where a scan (ht_scan_sz) stands, kept by the caller between calls.
+typedef struct hash_cursor {
+    /// The smallest hash position (the hash, 32 bit ones in the high half)
+    /// not returned yet: in the whole table for the chained HT_POW2 and
+    /// HT_FASTRANGE tables, in the bucket at index for the other chained
+    /// ones. The smallest hash not returned yet of the home slot at index
+    /// for HT_ROBIN_HOOD and HT_SWISS.
+    uint64_t position;
+    /// The bucket the scan is at (the home slot with HT_ROBIN_HOOD and
+    /// HT_SWISS, the slot with HT_CUCKOO), unless the table orders its
+    /// buckets by hash.
+    size_t index;
+    /// The number of keys at position already returned, when there were
+    /// more keys of that hash than a call could take.
+    size_t offset;
+    /// The array size index refers to, a different one restarts the scan.
+    size_t array_size;
+    /// The rehashes of the HT_CUCKOO table index refers to, a different
+    /// count restarts the scan.
+    size_t generation;
+    /// The HT_CUCKOO moves back already looked at (see hash_cuckoo_t).
+    size_t moves;
+    /// 1 while the old array of an incremental resize is scanned.
+    int old_phase;
+    /// 1 once the scan is complete.
+    int done;
+} hash_cursor_t;
+
+/// @brief Starts a scan of a table.
+/// @param pcursor A pointer to the cursor to reset.
+void ht_scan_start(hash_cursor_t *pcursor);
+
+/// @brief Returns the next pairs of a scan, without allocating anything.
+///        Every key present from ht_scan_start until the scan is done is
+///        returned at least once, whatever is inserted, removed or resized
+///        (ht_resize or HT_INCREMENTAL) between the calls.
+///
+///        The chained HT_POW2 and HT_FASTRANGE tables index by the high
+///        bits of the hash, so the buckets are in hash order: the cursor is
+///        a hash position, valid for any array size, and each such key is
+///        returned exactly once. Other chained tables restart from the
+///        first bucket after a resize, so keys may come back again.
+///
+///        HT_ROBIN_HOOD and HT_SWISS are scanned by home slot, and by hash
+///        within a home: their shifts, and their rehashes at the same size
+///        (HT_SWISS clearing its tombstones), never change the home of a
+///        key, another size restarts the scan. HT_CUCKOO is scanned slot
+///        after slot, a rehash restarts it. The keys its writes move behind
+///        the cursor are returned before it goes on, unless more than
+///        HT_CUCKOO_MOVE_LOG moved since the previous call, which restarts it.
+///
+///        Keys of equal hash are returned by the same call, unless there
+///        are more of them than capacity: they are then split across calls
+///        in chain (or slot) order, which a write in between can change.
+/// @param ptable A pointer to the hash table.
+/// @param pcursor The cursor, from ht_scan_start or the previous call.
+/// @param pitems The array to fill.
+/// @param capacity The number of items pitems holds, at least 1.
+/// @returns The number of items filled. It can be 0 on a sparse table
+///          (see HT_SCAN_VISITS): the scan is over once pcursor->done is set.
+size_t ht_scan_sz(hash_table_t *ptable, hash_cursor_t *pcursor, hash_scan_item_t *pitems, size_t capacity);
+
+/// Called by ht_foreach on each pair, with the state it accumulates into.
+typedef void (ht_visit_t)(void *pstate, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// Called by ht_foreach_hash on each pair, with the hash of its key.
+typedef void (ht_visit_hash_t)(void *pstate, uint64_t hash, void *pkey, size_t key_size, void *pvalue,
+                               size_t value_size);
+
+/// Folds the state of one thread of ht_foreach_parallel (pother) into pstate.
+typedef void (ht_combine_t)(void *pstate, void *pother);
+
+/// @brief Calls pvisit on every pair of the table, straight from the
+///        buckets: nothing is hashed, looked up or allocated. The table must
+///        not be written to until it returns.
+/// @param ptable A pointer to the hash table.
+/// @param pvisit The function to call.
+/// @param pstate Passed to pvisit.
+void ht_foreach(hash_table_t *ptable, ht_visit_t *pvisit, void *pstate);
+
+/// @brief Same as ht_foreach, also passing the ht_hash_ul of each key as the
+///        table stored it, so that a walk that needs the hashes (ht_save_i)
+///        doesn't hash every key again. Only HT_CUCKOO without HT_HASH64
+///        stores another hash, its keys are hashed.
+/// @param ptable A pointer to the hash table.
+/// @param pvisit The function to call.
+/// @param pstate Passed to pvisit.
+void ht_foreach_hash(hash_table_t *ptable, ht_visit_hash_t *pvisit, void *pstate);
+
+/// @brief Calls pvisit on every pair of the table from thread_count threads,
+///        each over its own range of buckets with its own state, then folds
+///        every state into the first one: pvisit need not be thread-safe,
+///        as long as it only writes to its state. Each thread gets at least
+///        HT_FOREACH_SPLIT buckets, so small tables use fewer threads (the
+///        states they leave alone are still combined). The table must not be
+///        written to until it returns.
+/// @param ptable A pointer to the hash table.
+/// @param thread_count The number of threads, the calling one included.
+/// @param pvisit The function to call.
+/// @param pstates thread_count states of state_size bytes, initialized by the caller.
+/// @param state_size The size of a state in bytes.
+/// @param pcombine Called on the first state and each other one in turn (can be NULL).
+void ht_foreach_parallel(hash_table_t *ptable, size_t thread_count, ht_visit_t *pvisit,
+                         void *pstates, size_t state_size, ht_combine_t *pcombine);
+
 /// @brief Returns an array of all the keys in the hash table.
 /// @param ptable A pointer to the hash table.
-/// @param pkey_count A pointer to an unsigned int that
+/// @param pkey_count A pointer to a size_t that
 ///        will be set to the number of keys in the returned array.
 /// @returns A pointer to an array of keys.
 /// TODO: Add a key_lengths return value as well?
+void** ht_keys_pp_sz(hash_table_t *ptable, size_t *pkey_count);
+
+/// @brief Same as ht_keys_pp_sz, kept for API compatibility.
+/// @param ptable A pointer to the hash table.
+/// @param pkey_count A pointer to an unsigned int that
+///        will be set to the number of keys in the returned array.
+/// @returns A pointer to an array of keys.
 void** ht_keys_pp(hash_table_t *ptable, unsigned int *pkey_count);
 
+/// @brief Fills pstats with the probe length statistics of the table.
+///        Walks the whole table, so this is meant for tuning, not hot paths.
+/// @param ptable A pointer to the hash table.
+/// @param pstats A pointer to the statistics to fill.
+void ht_probe_stats(hash_table_t *ptable, hash_probe_stats_t *pstats);
+
+/// @brief Fills pstats with the chain lengths, probe lengths, memory and
+///        resizes of the table, to tune its max_load_factor and initial
+///        size. Walks the whole table, completing a resize in progress.
+/// @param ptable A pointer to the hash table.
+/// @param pstats A pointer to the statistics to fill.
+void ht_stats(hash_table_t *ptable, hash_stats_t *pstats);
+
+/// @brief Calculates the hash of the given key with the table's hash function.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns The hash of the key: 64 bits (one x64_128 call) with HT_HASH64,
+///          otherwise the 32 bits of the x86_32 function.
+uint64_t ht_hash_ul(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Calculates the 128 bit hash of the given key with the table's
+///        x64_128 hash function (used by HT_CUCKOO for its two buckets).
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pout The two 64 bit halves of the hash.
+void ht_hash128(hash_table_t *ptable, void *pkey, size_t key_size, uint64_t pout[2]);
+
+/// @brief Calculates the hash of a key the way the engine of the table uses
+///        it, for the ht_*_hashed calls: ht_hash_ul, or ck_hash with HT_CUCKOO.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pcode Set to the hash of the key.
+void ht_hash_code(hash_table_t *ptable, void *pkey, size_t key_size, hash_code_t *pcode);
+
+/// @brief Calculates the hashes of count keys, the same as ht_hash_ul on
+///        each. Keys of a single size are hashed several at a time by the
+///        multi-key murmur kernels (see mu_set_isa_i), when the table uses murmur.
+/// @param ptable A pointer to the hash table.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param count The number of keys.
+/// @param phash Set to the hash of each key.
+void ht_hash_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count, uint64_t *phash);
+
+/// @brief Calculates the 128 bit hashes of count keys, the same as
+///        ht_hash128 on each (see ht_hash_batch).
+/// @param ptable A pointer to the hash table.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param count The number of keys.
+/// @param pout Set to the two 64 bit halves of the hash of each key.
+void ht_hash128_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count, uint64_t *pout);
+
+/// @brief Maps a hash to an index in the hash table's internal array,
+///        per the capacity policy of the table (modulo, HT_POW2 or HT_FASTRANGE).
+/// @param ptable A pointer to the hash table.
+/// @param hash A hash returned by ht_hash_ul.
+/// @returns The index into the hash table's internal array.
+size_t ht_bucket_sz(hash_table_t *ptable, uint64_t hash);
+
+/// @brief Maps a hash to an index in an array of the given size,
+///        per the capacity policy of the given flags.
+/// @param flags The hash table flags.
+/// @param hash A hash returned by ht_hash_ul.
+/// @param size The size of the array (a power of two with HT_POW2).
+/// @returns The index into the array. Without HT_HASH64, arrays of up to
+///          2^32 entries are indexed with 32 bit arithmetic.
+size_t ht_reduce_sz(int flags, uint64_t hash, size_t size);
+
+/// @brief Rounds a requested array size per the capacity policy of the table
+///        (up to a power of two with HT_POW2, unchanged otherwise).
+/// @param ptable A pointer to the hash table.
+/// @param size The requested size.
+/// @returns The size to allocate.
+size_t ht_capacity_sz(hash_table_t *ptable, size_t size);
+
 /// @brief Calulates the index in the hash table's internal array
 ///        from the given key (used for debugging currently).
 /// @param ptable A pointer to the hash table.
 /// @param pkey A pointer to the key.
 /// @param key_size The size of the key in bytes.
 /// @returns The index into the hash table's internal array.
+size_t ht_index_sz(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Same as ht_index_sz, kept for API compatibility.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns The index into the hash table's internal array, truncated to unsigned int.
 unsigned int ht_index_ui(hash_table_t *ptable, void *pkey, size_t key_size);
 
 #endif
@@ -0,0 +1,173 @@
+/// @file hashcuckoo.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief The bucketized cuckoo engine behind the HT_CUCKOO flag. A key can
+///        only be in one of two buckets of one cache line each (or in the
+///        stash, which is empty unless an insert failed), so a lookup is
+///        bounded whatever the load. These functions are private, they are
+///        reached through the ht_ functions.
+
+#ifndef HASH_CUCKOO_H
+#define HASH_CUCKOO_H
+
+#include "hashcore.h"
+
+/// The ratio of used slots above which an HT_CUCKOO table doubles its size.
+#ifndef HT_CUCKOO_MAX_LOAD
+#define HT_CUCKOO_MAX_LOAD 0.9
+#endif //HT_CUCKOO_MAX_LOAD
+
+/// The number of displacements tried by an insert before its entry goes to the stash.
+#ifndef HT_CUCKOO_MAX_KICKS
+#define HT_CUCKOO_MAX_KICKS 256
+#endif //HT_CUCKOO_MAX_KICKS
+
+/// The number of slots of a bucket.
+#define CK_BUCKET_SLOTS 4
+
+/// The number of entries the stash can hold before the table has to grow.
+#define CK_STASH_SIZE 8
+
+/// The number of keys moved back a table remembers for the scans
+/// (ht_scan_sz): a scan left behind by more moves between two calls starts over.
+#ifndef HT_CUCKOO_MOVE_LOG
+#define HT_CUCKOO_MOVE_LOG 256
+#endif //HT_CUCKOO_MOVE_LOG
+
+/// A key moved to a slot before the one it left (by a displacement, or a
+/// remove from the stash), which a scan could have passed already.
+typedef struct hash_cuckoo_move {
+    /// The entry moved, only compared: it may have been removed since.
+    hash_entry_t *pentry;
+    /// Its entry hash, which gives its first bucket.
+    uint64_t hash;
+    /// Its tag, which gives its second bucket.
+    uint32_t tag;
+} hash_cuckoo_move_t;
+
+/// A bucket, exactly one cache line.
+typedef struct hash_cuckoo_bucket {
+    /// The tag of each slot (a second, independent hash of the key),
+    /// which also gives the alternate bucket of the entry.
+    uint32_t tag[CK_BUCKET_SLOTS];
+    /// The entry of each slot, NULL if the slot is free.
+    hash_entry_t *pentry[CK_BUCKET_SLOTS];
+} __attribute__((aligned(64))) hash_cuckoo_bucket_t;
+
+/// The state of the HT_CUCKOO engine.
+typedef struct hash_cuckoo {
+    /// The buckets, a power of two of them (ptable->array_size / CK_BUCKET_SLOTS).
+    hash_cuckoo_bucket_t *pbuckets;
+    /// The number of buckets minus one.
+    size_t bucket_mask;
+    /// The entries no bucket had room for.
+    hash_entry_t *pstash[CK_STASH_SIZE];
+    /// The tags of the stashed entries.
+    uint32_t stash_tag[CK_STASH_SIZE];
+    /// The number of stashed entries.
+    unsigned int stash_count;
+    /// The number of inserts that ran out of displacements (and used the stash).
+    unsigned int insert_failures;
+    /// The number of times the table was rebuilt, growing or not.
+    unsigned int rehashes;
+    /// Rotates the slot evicted by each displacement.
+    unsigned int kick;
+    /// The last HT_CUCKOO_MOVE_LOG moves back, the next one goes at
+    /// moves_back % HT_CUCKOO_MOVE_LOG.
+    hash_cuckoo_move_t moves[HT_CUCKOO_MOVE_LOG];
+    /// The number of moves back since the table was created.
+    size_t moves_back;
+} hash_cuckoo_t;
+
+/// @brief Allocates the engine state and the (empty) buckets, rounding
+///        ptable->array_size up to a power of two of buckets.
+/// @param ptable A pointer to the hash table.
+void ck_init(hash_table_t *ptable);
+
+/// @brief Frees every entry, the buckets and the engine state.
+/// @param ptable A pointer to the hash table.
+void ck_destroy(hash_table_t *ptable);
+
+/// @brief Moves every entry into new buckets, at least new_size slots in all.
+///        The size is doubled again until every entry finds a place.
+/// @param ptable A pointer to the hash table.
+/// @param new_size The desired number of slots.
+void ck_resize(hash_table_t *ptable, size_t new_size);
+
+/// @brief Inserts an existing hash entry, or replaces the value of its key
+///        (the entry is then destroyed).
+/// @param ptable A pointer to the hash table.
+/// @param pentry A pointer to the hash entry (created by he_create_p).
+void ck_he_insert(hash_table_t *ptable, hash_entry_t *pentry);
+
+/// @brief Inserts an existing hash entry whose key hash and tag are already
+///        known, the same as ck_he_insert.
+/// @param ptable A pointer to the hash table.
+/// @param pentry A pointer to the hash entry (created by he_create_p).
+/// @param hash The entry hash of the key (ck_hash).
+/// @param tag The tag of the key (ck_hash).
+void ck_he_insert_hash(hash_table_t *ptable, hash_entry_t *pentry, uint64_t hash, uint32_t tag);
+
+/// @brief Looks up a key, touching at most two buckets (and the stash if not empty).
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns A pointer to the entry holding the key, NULL if it is not in the table.
+hash_entry_t *ck_find_p(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Calculates the entry hash and the tag of a key (both halves of
+///        one ht_hash128 call).
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param phash Set to the entry hash, which gives the first bucket.
+/// @param ptag Set to the tag, which gives the alternate bucket.
+void ck_hash(hash_table_t *ptable, void *pkey, size_t key_size, uint64_t *phash, uint32_t *ptag);
+
+/// @brief Calculates the entry hashes and tags of count keys, the same as
+///        ck_hash on each (with the multi-key kernels of ht_hash128_batch).
+/// @param ptable A pointer to the hash table.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param count The number of keys, at most HT_BATCH_GROUP.
+/// @param phash Set to the entry hash of each key.
+/// @param ptag Set to the tag of each key.
+void ck_hash_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count,
+                   uint64_t *phash, uint32_t *ptag);
+
+/// @brief Looks up a key whose hash and tag are already known (batched lookups).
+/// @param ptable A pointer to the hash table.
+/// @param hash The entry hash of the key (ck_hash).
+/// @param tag The tag of the key (ck_hash).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns A pointer to the entry holding the key, NULL if it is not in the table.
+hash_entry_t *ck_find_hash_p(hash_table_t *ptable, uint64_t hash, uint32_t tag, void *pkey, size_t key_size);
+
+/// @brief Prefetches both buckets of a key, ahead of ck_find_hash_p.
+/// @param ptable A pointer to the hash table.
+/// @param hash The entry hash of the key (ck_hash).
+/// @param tag The tag of the key (ck_hash).
+void ck_prefetch(hash_table_t *ptable, uint64_t hash, uint32_t tag);
+
+/// @brief Removes a key.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void ck_remove(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Removes a key whose hash and tag are already known, the same as ck_remove.
+/// @param ptable A pointer to the hash table.
+/// @param hash The entry hash of the key (ck_hash).
+/// @param tag The tag of the key (ck_hash).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void ck_remove_hash(hash_table_t *ptable, uint64_t hash, uint32_t tag, void *pkey, size_t key_size);
+
+/// @brief Finds where a moved key is now, in the order ht_scan_sz visits the
+///        slots: bucket * CK_BUCKET_SLOTS + slot, then the stash.
+/// @param ptable A pointer to the hash table.
+/// @param pmove A pointer to the move (from pcuckoo->moves).
+/// @returns The slot, or SIZE_MAX if the entry is not in the table anymore.
+size_t ck_slot_sz(hash_table_t *ptable, const hash_cuckoo_move_t *pmove);
+
+#endif //HASH_CUCKOO_H
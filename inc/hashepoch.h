@@ -0,0 +1,140 @@
+/// @file hashepoch.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief Epoch-based reclamation, behind the lock-free lookups of HT_EPOCH
+///        tables. A reader announces the epoch it entered in its record;
+///        memory a writer unlinks is retired rather than freed, and only
+///        freed once the global epoch has moved two steps past the one it was
+///        retired in, which requires every reader to have left the epochs
+///        that could still see it. Readers never lock nor use atomic
+///        read-modify-writes. Writers using the domain's limbo lists
+///        (ep_retire, ep_advance_i) must be serialized among themselves;
+///        ep_retire_local lets any number of threads retire at once, each
+///        into the lists of its own record.
+
+#ifndef HASH_EPOCH_H
+#define HASH_EPOCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/// The number of retirements after which a writer tries to advance the epoch.
+#ifndef EP_RETIRE_BATCH
+#define EP_RETIRE_BATCH 64
+#endif //EP_RETIRE_BATCH
+
+/// The number of limbo lists: retired in epoch e, freed once the epoch is e + 2.
+#define EP_LIMBO_COUNT 3
+
+/// Frees a retired pointer.
+typedef void (ep_free_t)(void *pctx, void *p);
+
+struct hash_epoch;
+
+/// A retired pointer and how to free it.
+typedef struct hash_epoch_retired {
+    void *p;
+    ep_free_t *pfree;
+    void *pctx;
+} hash_epoch_retired_t;
+
+/// The pointers retired during one epoch.
+typedef struct hash_epoch_limbo {
+    hash_epoch_retired_t *pitems;
+    size_t count;
+    size_t capacity;
+} hash_epoch_limbo_t;
+
+/// The record of a thread, on cache lines of its own. Only the epoch is
+/// read by other threads.
+typedef struct hash_epoch_record {
+    /// The epoch the reader entered, 0 while it is outside.
+    uint64_t epoch;
+    /// The domain the record is registered with.
+    struct hash_epoch *pepoch;
+    /// 0 once unregistered, the record is then reused by ep_register_p.
+    int in_use;
+    /// The next record of the domain.
+    struct hash_epoch_record *pnext;
+    /// What the thread retired with ep_retire_local, by epoch modulo
+    /// EP_LIMBO_COUNT. Kept across ep_unregister for the next user.
+    hash_epoch_limbo_t limbo[EP_LIMBO_COUNT];
+    /// The epoch each limbo list was filled in.
+    uint64_t limbo_epoch[EP_LIMBO_COUNT];
+    /// The ep_retire_local calls since the last try to advance.
+    size_t pending;
+} __attribute__((aligned(64))) hash_epoch_record_t;
+
+/// A reclamation domain (one per HT_EPOCH table).
+typedef struct hash_epoch {
+    /// The current epoch, starting at 1.
+    uint64_t global;
+    /// The registered records, never freed before ep_destroy.
+    hash_epoch_record_t *precords;
+    /// Serializes registrations (readers never take it otherwise).
+    pthread_mutex_t lock;
+    /// The retired pointers, by epoch modulo EP_LIMBO_COUNT.
+    hash_epoch_limbo_t limbo[EP_LIMBO_COUNT];
+    /// The retirements since the last try to advance.
+    size_t pending;
+} hash_epoch_t;
+
+/// @brief Initializes a domain.
+/// @param pepoch A pointer to the domain.
+void ep_init(hash_epoch_t *pepoch);
+
+/// @brief Frees every retired pointer and every record. No reader may be
+///        inside an epoch anymore.
+/// @param pepoch A pointer to the domain.
+void ep_destroy(hash_epoch_t *pepoch);
+
+/// @brief Registers a reader thread (once, before its first ep_enter).
+/// @param pepoch A pointer to the domain.
+/// @returns The record of the thread.
+hash_epoch_record_t *ep_register_p(hash_epoch_t *pepoch);
+
+/// @brief Gives a record back, its thread must be outside any epoch.
+/// @param precord The record (ep_register_p).
+void ep_unregister(hash_epoch_record_t *precord);
+
+/// @brief Enters the current epoch: until ep_exit, nothing the thread can
+///        reach is freed. Epochs do not nest.
+/// @param precord The record of the thread.
+void ep_enter(hash_epoch_record_t *precord);
+
+/// @brief Leaves the epoch, every pointer read inside it may be freed.
+/// @param precord The record of the thread.
+void ep_exit(hash_epoch_record_t *precord);
+
+/// @brief Frees p (with pfree) once no reader can reach it anymore. p must
+///        already be unreachable for readers entering from now on. Writer only.
+/// @param pepoch A pointer to the domain.
+/// @param p The pointer.
+/// @param pfree The function that frees it.
+/// @param pctx Passed to pfree.
+void ep_retire(hash_epoch_t *pepoch, void *p, ep_free_t *pfree, void *pctx);
+
+/// @brief Frees p (with pfree) once no reader can reach it anymore, as
+///        ep_retire does, but from any thread: the pointer goes to the
+///        record's own limbo lists, which the thread empties itself as the
+///        epoch moves on, and every EP_RETIRE_BATCH calls it tries to
+///        advance the epoch. p must already be unreachable for readers
+///        entering from now on.
+/// @param precord The record of the thread.
+/// @param p The pointer.
+/// @param pfree The function that frees it.
+/// @param pctx Passed to pfree.
+void ep_retire_local(hash_epoch_record_t *precord, void *p, ep_free_t *pfree, void *pctx);
+
+/// @brief Advances the epoch if every reader inside one entered the current
+///        epoch, then frees what was retired two epochs ago. Writer only.
+/// @param pepoch A pointer to the domain.
+/// @returns 1 if the epoch advanced, 0 if a reader held it back.
+int ep_advance_i(hash_epoch_t *pepoch);
+
+/// @brief Waits until everything retired so far is freed. Writer only, and
+///        never from inside an epoch.
+/// @param pepoch A pointer to the domain.
+void ep_synchronize(hash_epoch_t *pepoch);
+
+#endif //HASH_EPOCH_H
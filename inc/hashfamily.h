@@ -0,0 +1,50 @@
+/// @file hashfamily.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief The hash functions bundled besides MurmurHash3, always built and
+///        picked per table with the HT_HASH_ flags of ht_init. Each comes as
+///        a 32 bit function (the x86_32 slot of the table) and a 128 bit one
+///        (the x86_128 and x64_128 slots), all with the HashFunc signature.
+
+#ifndef HASH_FAMILY_H
+#define HASH_FAMILY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "hashfunc.h"
+
+/// @brief A 64 bit multiply-mix hash in the style of wyhash: a key of up to
+///        16 bytes is read as two overlapping 64 bit words and folded by a
+///        single 64x64->128 bit multiply. Writes a uint32_t.
+HashFunc hf_mix_32;
+
+/// @brief The 128 bit variant of hf_mix_32: out[0] is the same 64 bit hash
+///        hf_mix_32 truncates, out[1] a second mix of the same state.
+///        Writes two uint64_t.
+HashFunc hf_mix_128;
+
+/// @brief A CRC32C (Castagnoli) of the key seeded with the seed and the
+///        length, spread by a multiply so that the high bits are as good as
+///        the low ones. Uses the SSE4.2 crc32 instruction when the cpu has
+///        it, one instruction per 8 bytes. Writes a uint32_t.
+HashFunc hf_crc32c_32;
+
+/// @brief The 128 bit variant of hf_crc32c_32: two CRC32C of the key with
+///        different seeds, mixed into two uint64_t. Writes two uint64_t.
+HashFunc hf_crc32c_128;
+
+/// @brief Updates a raw CRC32C (no initial or final inversion), in hardware
+///        if it is enabled (see hf_set_crc_hw_i). Both paths give the same result.
+/// @param crc The CRC of the bytes so far.
+/// @param pdata A pointer to the bytes.
+/// @param size The number of bytes.
+/// @returns The CRC including the bytes.
+uint32_t hf_crc32c_ui(uint32_t crc, const void *pdata, size_t size);
+
+/// @brief Enables or disables the SSE4.2 path of the CRC32C functions. It
+///        is enabled on first use if the cpu supports it.
+/// @param enable 1 to use the crc32 instruction, 0 for the portable code.
+/// @returns 1 if the request was applied, 0 if the cpu lacks SSE4.2.
+int hf_set_crc_hw_i(int enable);
+
+#endif //HASH_FAMILY_H
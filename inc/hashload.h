@@ -0,0 +1,88 @@
+/// @file hashload.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief Bulk loading of a table from a file of records. The file is
+///        mapped and cut into chunks of about HL_CHUNK_BYTES, each ending
+///        on a record boundary. Parse threads turn chunks into arrays of
+///        keys and values, at most HL_WINDOW chunks ahead, while the calling
+///        thread inserts them with ht_insert_batch in file order, so a key
+///        seen twice keeps its last value. The table is first presized for
+///        the number of records the size of the file suggests, from the
+///        records of its first HL_SAMPLE_BYTES.
+///
+///        A binary record is only found from the one before it, so a binary
+///        chunk ends where the parse of it stops and the next one can only
+///        start then: binary chunks are parsed one after the other, which
+///        still overlaps with the inserts but gets nothing from more than
+///        one parse thread.
+///
+///        Keys and values are read where they are in the mapping: with
+///        HT_KEY_CONST or HT_VALUE_CONST the entries point into it and
+///        nothing is copied, the mapping staying until hl_unmap.
+
+#ifndef HASH_LOAD_H
+#define HASH_LOAD_H
+
+#include "hashcore.h"
+
+/// The bytes of file a parse thread turns into records at a time.
+#ifndef HL_CHUNK_BYTES
+#define HL_CHUNK_BYTES (1 << 20)
+#endif //HL_CHUNK_BYTES
+
+/// The largest number of parsed chunks waiting for the inserting thread.
+#ifndef HL_WINDOW
+#define HL_WINDOW 8
+#endif //HL_WINDOW
+
+/// The bytes at the start of the file the number of records is estimated from.
+#ifndef HL_SAMPLE_BYTES
+#define HL_SAMPLE_BYTES 65536
+#endif //HL_SAMPLE_BYTES
+
+/// The number of parse threads when none is given.
+#ifndef HL_PARSE_THREADS
+#define HL_PARSE_THREADS 2
+#endif //HL_PARSE_THREADS
+
+/// The layout of the records of a file.
+typedef enum hash_load_format {
+    /// One record per line, the key, a delimiter then the value (neither
+    /// includes the end of line, "\n" or "\r\n"). Empty lines are skipped,
+    /// lines without the delimiter too but counted.
+    HL_DELIMITED = 0,
+    /// A 32 bit key size, a 32 bit value size (in native byte order), then
+    /// the key and the value bytes, record after record.
+    HL_BINARY = 1
+} hash_load_format_t;
+
+/// What hl_load_i read.
+typedef struct hash_load {
+    /// The mapping of the file, kept for HT_KEY_CONST or HT_VALUE_CONST tables (NULL otherwise).
+    uint8_t *pbase;
+    /// The size of the mapping in bytes.
+    size_t size;
+    /// The number of records inserted.
+    size_t record_count;
+    /// The number of records skipped: lines without the delimiter, or a binary record cut short.
+    size_t skipped;
+} hash_load_t;
+
+/// @brief Inserts every record of a file into the table, as ht_insert would
+///        one after the other.
+/// @param pload A pointer to fill with what was read.
+/// @param ptable A pointer to the table.
+/// @param ppath The path of the file.
+/// @param format The layout of the records.
+/// @param delimiter The byte between key and value (HL_DELIMITED only).
+/// @param thread_count The number of parse threads, 0 for HL_PARSE_THREADS.
+/// @returns 1 on success, 0 if the file can't be read (the table is unchanged).
+int hl_load_i(hash_load_t *pload, hash_table_t *ptable, const char *ppath, hash_load_format_t format,
+              char delimiter, size_t thread_count);
+
+/// @brief Unmaps the file of an HT_KEY_CONST or HT_VALUE_CONST load, once
+///        the table is destroyed or holds none of its entries. Does nothing
+///        for other tables, whose file is already unmapped.
+/// @param pload A pointer to what hl_load_i filled.
+void hl_unmap(hash_load_t *pload);
+
+#endif //HASH_LOAD_H
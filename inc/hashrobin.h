@@ -0,0 +1,92 @@
+/// @file hashrobin.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief The open-addressing (Robin Hood) engine behind the HT_ROBIN_HOOD flag.
+///        These functions are private, they are reached through the ht_ functions.
+
+#ifndef HASH_ROBIN_H
+#define HASH_ROBIN_H
+
+#include "hashcore.h"
+
+/// The ratio of used slots above which an HT_ROBIN_HOOD table doubles its size.
+#ifndef HT_ROBIN_MAX_LOAD
+#define HT_ROBIN_MAX_LOAD 0.9
+#endif //HT_ROBIN_MAX_LOAD
+
+/// @brief Allocates the (empty) slot array of ptable->array_size slots.
+/// @param ptable A pointer to the hash table.
+void rh_init(hash_table_t *ptable);
+
+/// @brief Frees every entry and the slot array.
+/// @param ptable A pointer to the hash table.
+void rh_destroy(hash_table_t *ptable);
+
+/// @brief Moves every entry into a new slot array of new_size slots.
+///        new_size is raised to key_count + 1 if it is too small, then rounded
+///        per the capacity policy of the table (see ht_capacity_sz).
+/// @param ptable A pointer to the hash table.
+/// @param new_size The desired number of slots.
+void rh_resize(hash_table_t *ptable, size_t new_size);
+
+/// @brief Inserts (or replaces) the {key: value} pair, copying them per the table flags.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void rh_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Inserts (or replaces) a key whose hash is already known, the same as rh_insert.
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void rh_insert_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Moves an existing hash entry into the table and frees the entry node.
+/// @param ptable A pointer to the hash table.
+/// @param pentry A pointer to the hash entry (created by he_create_p).
+void rh_he_insert(hash_table_t *ptable, hash_entry_t *pentry);
+
+/// @brief Looks up a key.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns A pointer to the slot holding the key, NULL if it is not in the table.
+hash_slot_t *rh_find_p(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Looks up a key whose hash is already known (batched lookups).
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns A pointer to the slot holding the key, NULL if it is not in the table.
+hash_slot_t *rh_find_hash_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size);
+
+/// @brief Prefetches the home slot of a hash, ahead of rh_find_hash_p.
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+void rh_prefetch(hash_table_t *ptable, uint64_t hash);
+
+/// @brief Removes a key, shifting the following slots back into place.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void rh_remove(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Removes a key whose hash is already known, the same as rh_remove.
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void rh_remove_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size);
+
+/// @brief Adds up the slots a lookup of a missing key examines, from each
+///        home slot in turn (see ht_stats).
+/// @param ptable A pointer to the hash table.
+/// @returns The total over all the slots, array_size times the mean.
+size_t rh_miss_probes_sz(hash_table_t *ptable);
+
+#endif //HASH_ROBIN_H
@@ -0,0 +1,109 @@
+/// @file hashshard.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief A table split into independent hash_table_t shards, each with its
+///        own reader-writer lock, load factor and resize. A key always goes
+///        to the same shard, picked by the high bits of its hash, so a resize
+///        only moves one shard (1/shard_count of the keys) and writers on
+///        different shards run in parallel.
+///
+///        The shard bits are taken after a remix of the hash: the engines
+///        index with the high bits too (HT_POW2, HT_FASTRANGE, the HT_SWISS
+///        fingerprints), which would otherwise be the same within a shard.
+///        HT_INCREMENTAL is cleared, as its lookups move buckets.
+
+#ifndef HASH_SHARD_H
+#define HASH_SHARD_H
+
+#include "hashcore.h"
+
+#include <pthread.h>
+
+/// The number of shards used when hs_init is given 0.
+#ifndef HS_SHARD_COUNT
+#define HS_SHARD_COUNT 16
+#endif //HS_SHARD_COUNT
+
+/// A shard: a table and its lock, on cache lines of their own.
+typedef struct hash_shard {
+    /// Guards the table.
+    pthread_rwlock_t lock;
+    /// The keys of the shard.
+    hash_table_t table;
+} __attribute__((aligned(64))) hash_shard_t;
+
+/// A sharded hash table.
+typedef struct hash_table_sharded {
+    /// The shards.
+    hash_shard_t *pshards;
+    /// The number of shards, a power of two.
+    size_t shard_count;
+    /// log2(shard_count).
+    unsigned int shard_bits;
+} hash_table_sharded_t;
+
+/// @brief Initializes every shard (see ht_init) and its lock.
+/// @param phs A pointer to the sharded table.
+/// @param flags Options for the way each shard behaves.
+/// @param max_load_factor See ht_init, applied to each shard.
+/// @param shard_count The number of shards, rounded up to a power of two, 0 for HS_SHARD_COUNT.
+void hs_init(hash_table_sharded_t *phs, hash_flags_t flags, double max_load_factor, size_t shard_count
+#ifndef __WITH_MURMUR
+        , HashFunc *for_x86_32, HashFunc *for_x86_128, HashFunc *for_x64_128
+#endif //__WITH_MURMUR
+);
+
+/// @brief Destroys every shard. No other thread may use the table anymore.
+/// @param phs A pointer to the sharded table.
+void hs_destroy(hash_table_sharded_t *phs);
+
+/// @brief Returns the shard a key belongs to.
+/// @param phs A pointer to the sharded table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns The shard.
+hash_shard_t *hs_shard_p(hash_table_sharded_t *phs, void *pkey, size_t key_size);
+
+/// @brief Inserts the {key: value} pair into its shard, or replaces the value of the key.
+/// @param phs A pointer to the sharded table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void hs_insert(hash_table_sharded_t *phs, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Copies the value of a key while its shard is locked (see hts_get_i).
+/// @param phs A pointer to the sharded table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue The buffer to copy the value into (can be NULL).
+/// @param pvalue_size In: the size of the buffer. Out: the size of the value.
+/// @returns 1 if the key was found, 0 otherwise.
+int hs_get_i(hash_table_sharded_t *phs, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size);
+
+/// @brief Checks whether a key is in the table.
+/// @param phs A pointer to the sharded table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns 1 if the key was found, 0 otherwise.
+int hs_contains_i(hash_table_sharded_t *phs, void *pkey, size_t key_size);
+
+/// @brief Removes a key.
+/// @param phs A pointer to the sharded table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void hs_remove(hash_table_sharded_t *phs, void *pkey, size_t key_size);
+
+/// @brief Returns the number of keys, summed over the shards (each one
+///        locked in turn, so concurrent writes may or may not be counted).
+/// @param phs A pointer to the sharded table.
+/// @returns The number of keys in the table.
+size_t hs_size_sz(hash_table_sharded_t *phs);
+
+/// @brief Returns the keys of every shard (see ht_keys_pp_sz). The pointers are
+///        only valid until their keys are removed or replaced.
+/// @param phs A pointer to the sharded table.
+/// @param pkey_count Set to the number of keys returned.
+/// @returns An array of pointers to the keys, to be freed by the caller.
+void **hs_keys_pp(hash_table_sharded_t *phs, size_t *pkey_count);
+
+#endif //HASH_SHARD_H
@@ -0,0 +1,165 @@
+/// @file hashshm.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief A table living in a POSIX shared memory segment, one copy for
+///        every process that maps it. Nothing in the segment is a pointer:
+///        the bucket array and the records are found by their offset from
+///        the start of the segment, wherever each process maps it, and are
+///        allocated from the segment itself (power-of-two size classes, each
+///        with a free list). The segment keeps the size it was created with:
+///        an insert that finds no room in it fails.
+///
+///        Writers, from any process, are serialized by a process-shared
+///        mutex in the segment. Readers take no lock: a sequence counter,
+///        odd while a writer changes anything, makes them retry a lookup
+///        that overlapped a write (a seqlock). As a write can reuse any
+///        record, lookups copy the value out (as hs_get_i does) and check
+///        every offset they follow against the segment. A writer killed in
+///        the middle of a write leaves the table locked.
+
+#ifndef HASH_SHM_H
+#define HASH_SHM_H
+
+#include "hashcore.h"
+#include "hashfunc.h"
+
+#include <pthread.h>
+
+/// "HASHSHM", the first bytes of a segment.
+#define HM_MAGIC UINT64_C(0x004d485348534148)
+
+/// The version of the segment layout.
+#define HM_VERSION 1
+
+/// log2 of the number of buckets of a new segment.
+#ifndef HM_INITIAL_BITS
+#define HM_INITIAL_BITS 10
+#endif //HM_INITIAL_BITS
+
+/// The number of keys per bucket above which the buckets double.
+#ifndef HM_MAX_LOAD
+#define HM_MAX_LOAD 1.0
+#endif //HM_MAX_LOAD
+
+/// The smallest block the segment allocator hands out, size class 0.
+#define HM_MIN_BLOCK 64
+
+/// The number of size classes, class c holding blocks of HM_MIN_BLOCK << c bytes.
+#define HM_CLASS_COUNT 48
+
+/// The start of a segment.
+typedef struct hash_shm_header {
+    uint64_t magic;
+    uint32_t version;
+    /// HT_HASH_MIX or HT_HASH_CRC32C as given to hm_create_i, MurmurHash3 otherwise.
+    uint32_t flags;
+    /// The seed every process hashes with.
+    uint32_t seed;
+    /// log2 of the number of buckets.
+    uint32_t bucket_bits;
+    /// The size of the segment in bytes.
+    uint64_t size;
+    /// Odd while a writer is changing the table.
+    uint64_t sequence;
+    /// The number of keys.
+    uint64_t key_count;
+    /// The offset of the bucket array, each bucket the offset of its first record (0 for none).
+    uint64_t buckets;
+    /// The offset of the part of the segment never allocated yet.
+    uint64_t top;
+    /// The offset of the first free block of each size class, 0 for none.
+    uint64_t free_lists[HM_CLASS_COUNT];
+    /// Serializes the writers of every process.
+    pthread_mutex_t lock;
+} hash_shm_header_t;
+
+/// A record, followed by its key then its value, each on 8 bytes.
+typedef struct hash_shm_record {
+    /// The 64 bit hash of the key.
+    uint64_t hash;
+    /// The offset of the next record of the bucket, 0 if there is none.
+    uint64_t next;
+    uint64_t value_size;
+    uint32_t key_size;
+    /// The size class of the record's block.
+    uint32_t size_class;
+} hash_shm_record_t;
+
+/// A process's handle on a shared table.
+typedef struct hash_table_shm {
+    /// The segment, mapped at any address.
+    uint8_t *pbase;
+    /// The same address, as the header.
+    hash_shm_header_t *pheader;
+    /// The size of the mapping in bytes.
+    size_t size;
+    /// The 128 bit hash function, of which the first 64 bits are used.
+    HashFunc *phashfunc;
+} hash_table_shm_t;
+
+/// @brief Creates a shared memory segment holding an empty table, and maps it.
+/// @param phm A pointer to the handle to fill.
+/// @param pname The name of the segment (see shm_open), which must not exist yet.
+/// @param size The size of the segment in bytes, which bounds the keys and values it holds.
+/// @param flags HT_HASH_MIX or HT_HASH_CRC32C to pick the hash function
+///        (MurmurHash3 otherwise), other flags are ignored.
+/// @returns 1 on success, 0 if the segment can't be created or size is too small.
+int hm_create_i(hash_table_shm_t *phm, const char *pname, size_t size, hash_flags_t flags);
+
+/// @brief Maps an existing segment, created by hm_create_i in any process.
+/// @param phm A pointer to the handle to fill.
+/// @param pname The name of the segment.
+/// @returns 1 on success, 0 if there is no such segment or it holds no table.
+int hm_open_i(hash_table_shm_t *phm, const char *pname);
+
+/// @brief Unmaps the segment from this process, which keeps existing.
+/// @param phm A pointer to the handle.
+void hm_close(hash_table_shm_t *phm);
+
+/// @brief Removes the name of a segment, which goes once every process has unmapped it.
+/// @param pname The name of the segment.
+/// @returns 1 on success, 0 if there is no such segment.
+int hm_unlink_i(const char *pname);
+
+/// @brief Inserts the {key: value} pair, or replaces the value of the key.
+/// @param phm A pointer to the handle.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+/// @returns 1 on success, 0 if the segment has no room left (the table is unchanged).
+int hm_insert_i(hash_table_shm_t *phm, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Copies the value of a key, as hs_get_i does, without locking.
+/// @param phm A pointer to the handle.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue The buffer to copy the value into (can be NULL).
+/// @param pvalue_size In: the size of the buffer. Out: the size of the value.
+/// @returns 1 if the key was found, 0 otherwise.
+int hm_get_i(hash_table_shm_t *phm, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size);
+
+/// @brief Checks whether a key is in the table, without locking.
+/// @param phm A pointer to the handle.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns 1 if the key was found, 0 otherwise.
+int hm_contains_i(hash_table_shm_t *phm, void *pkey, size_t key_size);
+
+/// @brief Removes a key, its block going back to the free list of its class.
+/// @param phm A pointer to the handle.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void hm_remove(hash_table_shm_t *phm, void *pkey, size_t key_size);
+
+/// @brief Returns the number of keys.
+/// @param phm A pointer to the handle.
+/// @returns The number of keys, as of the last completed write.
+size_t hm_size_sz(hash_table_shm_t *phm);
+
+/// @brief Returns the bytes of the segment allocated so far, freed blocks
+///        included: the memory the table takes for all the processes.
+/// @param phm A pointer to the handle.
+/// @returns The number of bytes.
+size_t hm_used_sz(hash_table_shm_t *phm);
+
+#endif //HASH_SHM_H
@@ -0,0 +1,134 @@
+/// @file hashsnap.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief Snapshots: a table written to a file by ht_save_i, in a layout
+///        that a later process maps (ht_load_i) and looks keys up in right
+///        from the mapped pages. Nothing is allocated, rehashed or even read
+///        per entry at load: the pages a lookup touches are faulted in as
+///        it goes.
+///
+///        The file holds a header, an array of bucket offsets and the
+///        records, each bucket's records one after the other. The layout
+///        is the same whatever the engine of the saved table, the buckets
+///        being indexed by fastrange over the stored hash (64 or 32 bit as
+///        the table hashes). Keys and values are aligned on 8 bytes.
+///
+///        A loaded table answers ht_get_p, ht_contains_i, the batched
+///        lookups, ht_size_sz and ht_foreach(_parallel) from the file. The
+///        first write, or a walk the file has no layout for (ht_keys_pp_sz,
+///        ht_scan_sz, ht_probe_stats), turns it into a regular table first,
+///        inserting every record into the table's own engine. With
+///        HT_KEY_CONST or HT_VALUE_CONST the entries then point into the
+///        mapping, which stays until ht_destroy.
+
+#ifndef HASH_SNAP_H
+#define HASH_SNAP_H
+
+#include "hashcore.h"
+
+/// "HASHSNAP", the first bytes of a snapshot file.
+#define SN_MAGIC UINT64_C(0x50414e5348534148)
+
+/// The version of the layout, bumped on any change to it.
+#define SN_VERSION 1
+
+/// The key hashed into the header: a table that hashes it differently
+/// (other function, width or seed) can't use the file.
+#define SN_PROBE_KEY "hashsnap"
+
+/// The header of a snapshot file, at offset 0.
+typedef struct hash_snapshot_header {
+    uint64_t magic;
+    uint32_t version;
+    /// The flags of the saved table.
+    uint32_t flags;
+    /// The seed the keys were hashed with (see ht_set_seed).
+    uint32_t seed;
+    /// The CRC32C of the header, computed with this field at 0.
+    uint32_t header_crc;
+    /// ht_hash_ul of SN_PROBE_KEY by the saved table.
+    uint64_t probe_hash;
+    /// The number of records.
+    uint64_t key_count;
+    /// The number of buckets, whose offsets follow the header.
+    uint64_t bucket_count;
+    /// The size of the file in bytes.
+    uint64_t file_size;
+    /// The CRC32C of everything after the header.
+    uint32_t body_crc;
+    uint32_t reserved;
+} hash_snapshot_header_t;
+
+/// A record, followed by its key then, at value_offset, its value.
+typedef struct hash_snapshot_record {
+    /// The hash of the key, as hash_entry_t keeps it.
+    uint64_t hash;
+    /// The offset of the next record of the bucket, 0 if there is none.
+    uint64_t next;
+    uint64_t value_size;
+    uint32_t key_size;
+    /// The offset of the value from the record.
+    uint32_t value_offset;
+} hash_snapshot_record_t;
+
+/// A mapped snapshot.
+typedef struct hash_snapshot {
+    /// The mapping, the header first.
+    uint8_t *pbase;
+    /// The size of the mapping in bytes.
+    size_t size;
+    /// The offset of the first record of each bucket, 0 for none.
+    uint64_t *pbuckets;
+    /// The number of buckets.
+    uint64_t bucket_count;
+    /// The number of records.
+    uint64_t key_count;
+    /// 1 while its records are inserted into the table.
+    int thawing;
+    /// 1 once they are, the mapping being kept for HT_KEY_CONST or HT_VALUE_CONST entries.
+    int thawed;
+} hash_snapshot_t;
+
+/// @brief Writes the table to a snapshot file, through a temporary file
+///        renamed over ppath once complete and synced.
+/// @param ptable A pointer to the hash table.
+/// @param ppath The path of the file.
+/// @returns 1 on success, 0 if the file could not be written.
+int ht_save_i(hash_table_t *ptable, const char *ppath);
+
+/// @brief Maps a snapshot file into the table in place of its contents.
+///        The table must hash as the saved one did (same hash flags and
+///        functions, and seed), its engine and other flags may differ.
+/// @param ptable A pointer to a table initialized by ht_init.
+/// @param ppath The path of the file.
+/// @param verify 1 to check the CRC of the whole file, reading every page
+///        of it, 0 to check the header only and trust the rest.
+/// @returns 1 on success, 0 (the table being left untouched) if the file
+///          can't be mapped, is not a valid snapshot or was hashed differently,
+///          or if a write-ahead log is attached to the table (see hashwal.h).
+int ht_load_i(hash_table_t *ptable, const char *ppath, int verify);
+
+/// @brief Looks a key up in a snapshot.
+/// @param psnap A pointer to the snapshot.
+/// @param flags The table flags (HT_HASH64 picks the bucket from the hash).
+/// @param hash The hash of the key.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue_size Set to the size of the value if found (can be NULL).
+/// @returns A pointer to the value in the mapping, NULL if the key is not in it.
+void *sn_get_p(hash_snapshot_t *psnap, int flags, uint64_t hash, void *pkey, size_t key_size, size_t *pvalue_size);
+
+/// @brief Calls pvisit on the records of the buckets [begin, end).
+/// @param psnap A pointer to the snapshot.
+/// @param begin The first bucket.
+/// @param end The bucket past the last one.
+/// @param pvisit The function to call, NULL to call pvisit_hash instead.
+/// @param pvisit_hash The function to call with the hash of each record (see ht_foreach_hash).
+/// @param pstate Passed to the function.
+void sn_foreach_range(hash_snapshot_t *psnap, size_t begin, size_t end, ht_visit_t *pvisit,
+                      ht_visit_hash_t *pvisit_hash, void *pstate);
+
+/// @brief Unmaps a snapshot and frees it.
+/// @param psnap A pointer to the snapshot.
+void sn_unmap(hash_snapshot_t *psnap);
+
+#endif //HASH_SNAP_H
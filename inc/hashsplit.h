@@ -0,0 +1,116 @@
+/// @file hashsplit.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief A lock-free hash table for any number of concurrent writers and
+///        readers: Shalev and Shavit's split-ordered list. Every entry sits
+///        in a single sorted list, ordered by its bit-reversed hash, and the
+///        buckets are only shortcuts into it: bucket b points at a sentinel
+///        entry placed right before the keys whose hash ends with the bits
+///        of b. Doubling the number of buckets splits each of them without
+///        moving any entry, the new sentinels being linked in lazily, on
+///        first use. The list itself is Michael's: an entry is deleted by
+///        marking the low bit of its next pointer, then unlinked by whoever
+///        meets it first.
+///
+///        Every call but so_init and so_destroy takes the epoch record of
+///        the calling thread, from ep_register_p(&pso->epoch): unlinked
+///        entries are freed through it once no thread can reach them
+///        anymore (see hashepoch.h).
+
+#ifndef HASH_SPLIT_H
+#define HASH_SPLIT_H
+
+#include "hashcore.h"
+#include "hashepoch.h"
+#include "hashfunc.h"
+
+/// log2 of the number of buckets of a new table, which the first segment
+/// of the bucket array holds.
+#ifndef SO_INITIAL_BITS
+#define SO_INITIAL_BITS 6
+#endif //SO_INITIAL_BITS
+
+/// The number of keys per bucket above which the buckets double, when
+/// so_init is given 0.
+#ifndef SO_MAX_LOAD
+#define SO_MAX_LOAD 2.0
+#endif //SO_MAX_LOAD
+
+/// The number of segments of the bucket array: the first one holds
+/// 2^SO_INITIAL_BITS buckets, segment k the 2^(SO_INITIAL_BITS + k - 1) next.
+#define SO_SEGMENT_COUNT (64 - SO_INITIAL_BITS + 1)
+
+/// A split-ordered table.
+typedef struct hash_table_split {
+    /// The segments of the bucket array, each allocated on first use and
+    /// never moved. A bucket holds its sentinel, NULL until initialized.
+    hash_entry_t **ppsegments[SO_SEGMENT_COUNT];
+    /// The number of buckets, a power of two that only grows.
+    uint64_t bucket_count;
+    /// The number of keys.
+    uint64_t key_count;
+    /// The number of keys per bucket above which the buckets double.
+    double max_load_factor;
+    /// HT_KEY_CONST, HT_VALUE_CONST and HT_INLINE, as given to so_init.
+    int flags;
+    /// The 128 bit hash function, of which the first 64 bits are used.
+    HashFunc *phashfunc;
+    /// Reclaims the unlinked entries.
+    hash_epoch_t epoch;
+} hash_table_split_t;
+
+/// @brief Initializes a split-ordered table.
+/// @param pso A pointer to the table.
+/// @param flags HT_KEY_CONST, HT_VALUE_CONST and HT_INLINE as for ht_init,
+///        and the hash function: HT_HASH_MIX, HT_HASH_CRC32C or MurmurHash3.
+///        Other flags are ignored.
+/// @param max_load_factor The number of keys per bucket above which the
+///        buckets double, 0 for SO_MAX_LOAD.
+void so_init(hash_table_split_t *pso, hash_flags_t flags, double max_load_factor);
+
+/// @brief Frees every entry. No other thread may use the table anymore.
+/// @param pso A pointer to the table.
+void so_destroy(hash_table_split_t *pso);
+
+/// @brief Inserts the {key: value} pair, or replaces the value of the key
+///        (by a new entry taking the place of the old one).
+/// @param pso A pointer to the table.
+/// @param precord The epoch record of the calling thread.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void so_insert(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size,
+               void *pvalue, size_t value_size);
+
+/// @brief Copies the value of a key, as hts_get_i does.
+/// @param pso A pointer to the table.
+/// @param precord The epoch record of the calling thread.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue The buffer to copy the value into (can be NULL).
+/// @param pvalue_size In: the size of the buffer. Out: the size of the value.
+/// @returns 1 if the key was found, 0 otherwise.
+int so_get_i(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size,
+             void *pvalue, size_t *pvalue_size);
+
+/// @brief Checks whether a key is in the table.
+/// @param pso A pointer to the table.
+/// @param precord The epoch record of the calling thread.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns 1 if the key was found, 0 otherwise.
+int so_contains_i(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size);
+
+/// @brief Removes a key.
+/// @param pso A pointer to the table.
+/// @param precord The epoch record of the calling thread.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void so_remove(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size);
+
+/// @brief Returns the number of keys.
+/// @param pso A pointer to the table.
+/// @returns The number of keys, exact once the writers are done.
+size_t so_size_sz(hash_table_split_t *pso);
+
+#endif //HASH_SPLIT_H
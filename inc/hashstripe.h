@@ -0,0 +1,109 @@
+/// @file hashstripe.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief A thread-safe wrapper around hash_table_t. The bucket array is cut
+///        into stripe_count ranges of buckets, each guarded by a reader-writer
+///        lock, so lookups never block each other and writers only block the
+///        operations on their own range. A resize takes every stripe.
+///
+///        Stripes only cover chained tables: with HT_ROBIN_HOOD, HT_SWISS,
+///        HT_CUCKOO or HT_ARENA a write can touch state shared by all keys,
+///        so readers still take a single stripe but writers take them all.
+///        HT_INCREMENTAL is cleared, as its lookups move buckets.
+
+#ifndef HASH_STRIPE_H
+#define HASH_STRIPE_H
+
+#include "hashcore.h"
+
+#include <pthread.h>
+
+/// The number of stripes used when hts_init is given 0.
+#ifndef HTS_STRIPE_COUNT
+#define HTS_STRIPE_COUNT 64
+#endif //HTS_STRIPE_COUNT
+
+/// A stripe: its lock and the counters of its bucket range, one cache line
+/// each so that writers on different stripes do not share lines.
+typedef struct hash_stripe {
+    /// Guards the buckets of the range (and the counters below).
+    pthread_rwlock_t lock;
+    /// The number of keys in the range.
+    size_t key_count;
+    /// The number of collisions in the range, counted as ptable->collisions.
+    size_t collisions;
+} __attribute__((aligned(64))) hash_stripe_t;
+
+/// A thread-safe hash table.
+typedef struct hash_table_striped {
+    /// The table itself. Its key_count and collisions are only up to date
+    /// after a resize in striped mode (see hts_size_sz).
+    hash_table_t table;
+    /// The stripes.
+    hash_stripe_t *pstripes;
+    /// The number of stripes.
+    size_t stripe_count;
+    /// A copy of table.array_size, read without a lock to pick a stripe.
+    size_t array_size;
+    /// 1 if writers lock a single stripe (chained tables), 0 if they lock all.
+    int striped;
+} hash_table_striped_t;
+
+/// @brief Initializes the table (see ht_init) and its stripes.
+/// @param pts A pointer to the striped table.
+/// @param flags Options for the way the table behaves.
+/// @param max_load_factor See ht_init.
+/// @param stripe_count The number of stripes, 0 for HTS_STRIPE_COUNT.
+void hts_init(hash_table_striped_t *pts, hash_flags_t flags, double max_load_factor, size_t stripe_count
+#ifndef __WITH_MURMUR
+        , HashFunc *for_x86_32, HashFunc *for_x86_128, HashFunc *for_x64_128
+#endif //__WITH_MURMUR
+);
+
+/// @brief Destroys the table and its stripes. No other thread may use it anymore.
+/// @param pts A pointer to the striped table.
+void hts_destroy(hash_table_striped_t *pts);
+
+/// @brief Inserts the {key: value} pair, or replaces the value of the key.
+/// @param pts A pointer to the striped table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void hts_insert(hash_table_striped_t *pts, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Copies the value of a key while its stripe is locked, as another
+///        thread may replace or remove the value as soon as it is unlocked.
+/// @param pts A pointer to the striped table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue The buffer to copy the value into (can be NULL).
+/// @param pvalue_size In: the size of the buffer, of which at most that many
+///        bytes are copied. Out: the size of the value (can be NULL if pvalue is).
+/// @returns 1 if the key was found, 0 otherwise.
+int hts_get_i(hash_table_striped_t *pts, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size);
+
+/// @brief Checks whether a key is in the table.
+/// @param pts A pointer to the striped table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns 1 if the key was found, 0 otherwise.
+int hts_contains_i(hash_table_striped_t *pts, void *pkey, size_t key_size);
+
+/// @brief Removes a key.
+/// @param pts A pointer to the striped table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void hts_remove(hash_table_striped_t *pts, void *pkey, size_t key_size);
+
+/// @brief Resizes the table (see ht_resize), with every stripe locked.
+/// @param pts A pointer to the striped table.
+/// @param new_size The desired size of the table.
+void hts_resize(hash_table_striped_t *pts, size_t new_size);
+
+/// @brief Returns the number of keys, summed over the stripes (each one
+///        locked in turn, so concurrent writes may or may not be counted).
+/// @param pts A pointer to the striped table.
+/// @returns The number of keys in the table.
+size_t hts_size_sz(hash_table_striped_t *pts);
+
+#endif //HASH_STRIPE_H
@@ -0,0 +1,125 @@
+/// @file hashswiss.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief The fingerprint group probing engine behind the HT_SWISS flag.
+///        These functions are private, they are reached through the ht_ functions.
+
+#ifndef HASH_SWISS_H
+#define HASH_SWISS_H
+
+#include "hashcore.h"
+
+/// The ratio of used (or deleted) slots above which an HT_SWISS table rehashes.
+#ifndef HT_SWISS_MAX_LOAD
+#define HT_SWISS_MAX_LOAD 0.875
+#endif //HT_SWISS_MAX_LOAD
+
+/// The widest group probed at once, in slots. Also the smallest table size
+/// and the number of control bytes mirrored after the last slot.
+#define SW_GROUP_MAX 32
+
+/// The control byte of a slot that never held an entry: ends a probe.
+#define SW_EMPTY   ((uint8_t)0x80)
+/// The control byte of a slot whose entry was removed: a probe goes on past it.
+#define SW_DELETED ((uint8_t)0xFE)
+
+/// Instruction sets the group probe can run on (see sw_set_isa_i).
+typedef enum {
+    /// The best set supported by the running cpu.
+    SW_ISA_AUTO = 0,
+    /// Plain C, 16 slots per group.
+    SW_ISA_SCALAR,
+    /// SSE2, 16 slots per group.
+    SW_ISA_SSE2,
+    /// AVX2, 32 slots per group.
+    SW_ISA_AVX2
+} sw_isa_t;
+
+/// @brief Selects the instruction set used by every HT_SWISS table. The probe
+///        sequence does not depend on the group width, so this can be changed
+///        while tables exist (it is meant for benchmarks and tests).
+/// @param isa The instruction set.
+/// @returns 1 if the running cpu supports it, 0 otherwise (nothing changes).
+int sw_set_isa_i(sw_isa_t isa);
+
+/// @brief Returns the instruction set currently used.
+/// @returns The instruction set (never SW_ISA_AUTO).
+sw_isa_t sw_get_isa(void);
+
+/// @brief Allocates the (empty) slot and control arrays, rounding
+///        ptable->array_size up to a power of two.
+/// @param ptable A pointer to the hash table.
+void sw_init(hash_table_t *ptable);
+
+/// @brief Frees every entry and both arrays.
+/// @param ptable A pointer to the hash table.
+void sw_destroy(hash_table_t *ptable);
+
+/// @brief Moves every entry into new arrays of at least new_size slots.
+/// @param ptable A pointer to the hash table.
+/// @param new_size The desired number of slots.
+void sw_resize(hash_table_t *ptable, size_t new_size);
+
+/// @brief Inserts (or replaces) the {key: value} pair, copying them per the table flags.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void sw_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Inserts (or replaces) a key whose hash is already known, the same as sw_insert.
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void sw_insert_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Moves an existing hash entry into the table and frees the entry node.
+/// @param ptable A pointer to the hash table.
+/// @param pentry A pointer to the hash entry (created by he_create_p).
+void sw_he_insert(hash_table_t *ptable, hash_entry_t *pentry);
+
+/// @brief Looks up a key.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns A pointer to the slot holding the key, NULL if it is not in the table.
+hash_slot_t *sw_find_p(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Looks up a key whose hash is already known (batched lookups).
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @returns A pointer to the slot holding the key, NULL if it is not in the table.
+hash_slot_t *sw_find_hash_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size);
+
+/// @brief Prefetches the first control group and home slot of a hash,
+///        ahead of sw_find_hash_p.
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+void sw_prefetch(hash_table_t *ptable, uint64_t hash);
+
+/// @brief Removes a key.
+/// @param ptable A pointer to the hash table.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void sw_remove(hash_table_t *ptable, void *pkey, size_t key_size);
+
+/// @brief Removes a key whose hash is already known, the same as sw_remove.
+/// @param ptable A pointer to the hash table.
+/// @param hash The hash of the key (ht_hash_ul).
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void sw_remove_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size);
+
+/// @brief Adds up the slots a lookup of a missing key covers, from each home
+///        slot in turn up to the first empty one (see ht_stats). The groups
+///        of the probe cover sw_width of them at once.
+/// @param ptable A pointer to the hash table.
+/// @returns The total over all the slots, array_size times the mean.
+size_t sw_miss_probes_sz(hash_table_t *ptable);
+
+#endif //HASH_SWISS_H
@@ -0,0 +1,168 @@
+/// @file hashwal.h
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+/// @brief Write-ahead log: once attached to a table by hw_open_i, every
+///        ht_insert, ht_insert_batch, ht_he_insert and ht_remove of the
+///        table is appended to a file before it is applied. After a crash,
+///        hw_recover_i loads the last snapshot (see hashsnap.h) and replays
+///        the log on top of it, the inserts in batches (ht_insert_batch).
+///        An ht_clear of the table is logged too, a table can't ht_load_i
+///        while a log is attached. hw_checkpoint_i writes a new snapshot
+///        and empties the log.
+///
+///        The file holds a header then the records, each an operation, the
+///        sizes, the key and the value, checked by a CRC32C. Replay stops at
+///        the first record that is cut short or fails its check: the tail a
+///        crash in the middle of a write leaves, which hw_open_i truncates.
+///
+///        Records are gathered in memory and written to the file together
+///        (group commit) when HW_BATCH_BYTES of them are waiting or on
+///        hw_commit_i, then synced as the hash_wal_sync_t policy says.
+
+#ifndef HASH_WAL_H
+#define HASH_WAL_H
+
+#include "hashcore.h"
+
+/// "HASHWAL", the first bytes of a log.
+#define HW_MAGIC UINT64_C(0x004c415748534148)
+
+/// The version of the record layout.
+#define HW_VERSION 1
+
+/// The bytes of records gathered before they are written together.
+#ifndef HW_BATCH_BYTES
+#define HW_BATCH_BYTES 65536
+#endif //HW_BATCH_BYTES
+
+/// The largest number of consecutive inserts replayed by one ht_insert_batch.
+#ifndef HW_REPLAY_BATCH
+#define HW_REPLAY_BATCH 4096
+#endif //HW_REPLAY_BATCH
+
+/// When the records written to the log are synced to the disk.
+typedef enum hash_wal_sync {
+    /// Never: they are in the file once committed, which a crash of the
+    /// process doesn't lose, but a crash of the system may.
+    HW_SYNC_NONE = 0,
+    /// With each commit, one fdatasync for all the records it writes.
+    HW_SYNC_BATCH = 1,
+    /// Every record is written and synced before its operation returns.
+    HW_SYNC_EACH = 2
+} hash_wal_sync_t;
+
+/// The operation of a record.
+typedef enum hash_wal_op {
+    HW_INSERT = 1,
+    HW_REMOVE = 2,
+    /// An ht_clear, with no key and no value.
+    HW_CLEAR = 3
+} hash_wal_op_t;
+
+/// The header of a log file, at offset 0.
+typedef struct hash_wal_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t reserved;
+} hash_wal_header_t;
+
+/// A record, followed by its key then its value.
+typedef struct hash_wal_record {
+    /// The CRC32C of the rest of the record, key and value included.
+    uint32_t crc;
+    /// A hash_wal_op_t.
+    uint32_t op;
+    uint32_t key_size;
+    uint32_t reserved;
+    /// The size of the value, 0 for HW_REMOVE.
+    uint64_t value_size;
+} hash_wal_record_t;
+
+/// A log attached to a table.
+typedef struct hash_wal {
+    /// The table whose writes are logged, NULL once it was destroyed.
+    hash_table_t *ptable;
+    /// The log file, opened for appending.
+    int fd;
+    hash_wal_sync_t sync;
+    /// The records not written yet.
+    uint8_t *pbuffer;
+    /// The bytes of pbuffer in use.
+    size_t used;
+    /// The size of pbuffer.
+    size_t capacity;
+    /// The number of records appended since the log was opened or checkpointed.
+    uint64_t record_count;
+    /// 0 once a write to the file failed: the table went on without the log.
+    int healthy;
+} hash_wal_t;
+
+/// @brief Opens or creates a log and attaches it to a table. An existing
+///        log is kept, but for a torn last record: call hw_recover_i first
+///        to bring the table up to date with it.
+/// @param pwal A pointer to the log to fill.
+/// @param ptable A pointer to the table, which has no log attached.
+/// @param ppath The path of the log file.
+/// @param sync When the records are synced.
+/// @returns 1 on success, 0 if the file can't be opened or is not a log.
+int hw_open_i(hash_wal_t *pwal, hash_table_t *ptable, const char *ppath, hash_wal_sync_t sync);
+
+/// @brief Commits the waiting records, detaches the log from its table (if
+///        ht_destroy did not already) and closes it.
+/// @param pwal A pointer to the log.
+void hw_close(hash_wal_t *pwal);
+
+/// @brief Writes the records waiting in memory to the log, and syncs them
+///        unless the policy is HW_SYNC_NONE.
+/// @param pwal A pointer to the log.
+/// @returns 1 if every record logged so far is in the file, 0 otherwise.
+int hw_commit_i(hash_wal_t *pwal);
+
+/// @brief Saves the table to a snapshot (ht_save_i) then empties the log,
+///        whose records the snapshot holds. A crash in between only makes
+///        the next recovery replay them again, to the same result.
+/// @param pwal A pointer to the log.
+/// @param psnapshot The path of the snapshot.
+/// @returns 1 on success, 0 if the snapshot could not be written (the log
+///          is kept) or the log emptied.
+int hw_checkpoint_i(hash_wal_t *pwal, const char *psnapshot);
+
+/// @brief Rebuilds a table after a crash: loads the snapshot, if there is
+///        one, then replays the log on top of it, up to its first torn or
+///        corrupt record. The table must copy its keys and values (no
+///        HT_KEY_CONST or HT_VALUE_CONST), the log being unmapped after.
+/// @param ptable A pointer to the table, initialized by ht_init.
+/// @param psnapshot The path of the snapshot, NULL or missing to replay onto the table as it is.
+/// @param plog The path of the log, which may not exist.
+/// @param preplayed Set to the number of records replayed (can be NULL).
+/// @returns 1 on success, 0 if the snapshot or the log exist but can't be used.
+int hw_recover_i(hash_table_t *ptable, const char *psnapshot, const char *plog, size_t *preplayed);
+
+/// @brief Appends an insert to the log (called by the table's writes).
+/// @param pwal A pointer to the log.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+/// @param pvalue A pointer to the value.
+/// @param value_size The size of the value in bytes.
+void hw_log_insert(hash_wal_t *pwal, void *pkey, size_t key_size, void *pvalue, size_t value_size);
+
+/// @brief Appends the inserts of a batch to the log, committed as one under HW_SYNC_EACH.
+/// @param pwal A pointer to the log.
+/// @param ppkeys The keys.
+/// @param pkey_sizes The size of each key in bytes.
+/// @param ppvalues The values.
+/// @param pvalue_sizes The size of each value in bytes.
+/// @param count The number of pairs.
+void hw_log_batch(hash_wal_t *pwal, void **ppkeys, size_t *pkey_sizes, void **ppvalues, size_t *pvalue_sizes,
+                  size_t count);
+
+/// @brief Appends a remove to the log (called by the table's writes).
+/// @param pwal A pointer to the log.
+/// @param pkey A pointer to the key.
+/// @param key_size The size of the key in bytes.
+void hw_log_remove(hash_wal_t *pwal, void *pkey, size_t key_size);
+
+/// @brief Appends a clear to the log (called by ht_clear).
+/// @param pwal A pointer to the log.
+void hw_log_clear(hash_wal_t *pwal);
+
+#endif //HASH_WAL_H
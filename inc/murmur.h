@@ -1,4 +1,3 @@
-#ifdef __WITH_MURMUR
 //-----------------------------------------------------------------------------
 // MurmurHash3 was written by Austin Appleby, and is placed in the public
 // domain. The author hereby disclaims copyright to this source code.
@@ -7,6 +6,7 @@
 #define _MURMURHASH3_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include "hashfunc.h"
 
@@ -28,5 +28,47 @@ HashFunc MurmurHash3_x86_128;
  */
 HashFunc MurmurHash3_x64_128;
 
+/// Instruction sets the multi-key kernels can run on (see mu_set_isa_i).
+typedef enum {
+    /// The best set supported by the running cpu.
+    MU_ISA_AUTO = 0,
+    /// One key after the other with the functions above.
+    MU_ISA_SCALAR,
+    /// AVX2: 8 keys per x86_32 round, 4 per x64_128 round.
+    MU_ISA_AVX2,
+    /// AVX-512 (F and DQ): 16 keys per x86_32 round, 8 per x64_128 round.
+    MU_ISA_AVX512
+} mu_isa_t;
+
+/*! \brief Selects the instruction set of the multi-key kernels.
+ *  \param isa The instruction set.
+ *  \return 1 if the running cpu supports it, 0 otherwise (nothing changes).
+ */
+int mu_set_isa_i(mu_isa_t isa);
+
+/*! \brief Returns the instruction set of the multi-key kernels.
+ *  \return The instruction set (never MU_ISA_AUTO).
+ */
+mu_isa_t mu_get_isa(void);
+
+/*! \brief Hashes count keys of len bytes each, one lane per key. The
+ *         results are bit-identical to MurmurHash3_x86_32 on every key.
+ *  \param ppkeys The keys.
+ *  \param len The size of every key in bytes.
+ *  \param seed The seed.
+ *  \param pout Set to the count hashes.
+ *  \param count The number of keys.
+ */
+void MurmurHash3_x86_32_multi(void **ppkeys, int len, uint32_t seed, uint32_t *pout, size_t count);
+
+/*! \brief Hashes count keys of len bytes each, one lane per key. The
+ *         results are bit-identical to MurmurHash3_x64_128 on every key.
+ *  \param ppkeys The keys.
+ *  \param len The size of every key in bytes.
+ *  \param seed The seed.
+ *  \param pout Set to the count hashes, two 64 bit halves each.
+ *  \param count The number of keys.
+ */
+void MurmurHash3_x64_128_multi(void **ppkeys, int len, uint32_t seed, uint64_t *pout, size_t count);
+
 #endif // _MURMURHASH3_H_
-#endif //__WITH_MURMUR
@@ -0,0 +1,171 @@
+/// @cond PRIVATE
+/// @file hasharena.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hasharena.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/// The block header, rounded up so that allocations stay 16 byte aligned.
+#define HA_HEADER_SIZE ((sizeof(hash_arena_block_t) + HA_CLASS_SIZE - 1) & ~(size_t)(HA_CLASS_SIZE - 1))
+
+// class c serves the sizes from c * HA_CLASS_SIZE + 1 to (c + 1) * HA_CLASS_SIZE
+static unsigned int ha_class_ui(size_t size)
+{
+    return (0 == size) ? 0 : (unsigned int)((size - 1) / HA_CLASS_SIZE);
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void ha_init(hash_arena_t *parena)
+{
+    memset(parena, 0, sizeof(*parena));
+}
+
+void ha_release(hash_arena_t *parena)
+{
+    hash_arena_block_t *pblock;
+    hash_arena_block_t *pnext;
+
+    for(pblock = parena->pslabs; NULL != pblock; pblock = pnext)
+    {
+        pnext = pblock->pnext;
+        free(pblock);
+    }
+
+    for(pblock = parena->plarge; NULL != pblock; pblock = pnext)
+    {
+        pnext = pblock->pnext;
+        free(pblock);
+    }
+
+    ha_init(parena);
+}
+
+/************************************************************************************************>
+ * ALLOCATION
+ ************************************************************************************************/
+void *ha_alloc_p(hash_arena_t *parena, size_t size)
+{
+    unsigned int class_index;
+    size_t class_size;
+    hash_arena_block_t *pblock;
+    void *p;
+
+    //-----------------------------------------------------------------------------
+    // large allocations are kept in a list so that ha_release can find them
+    if(size > HA_MAX_SMALL) {
+        pblock = malloc(HA_HEADER_SIZE + size);
+        if(NULL == pblock) {
+            debug("ha_alloc_p failed to allocate memory\n");
+            return NULL;
+        }
+
+        pblock->pprev = NULL;
+        pblock->pnext = parena->plarge;
+        if(NULL != parena->plarge)
+            parena->plarge->pprev = pblock;
+        parena->plarge = pblock;
+        parena->reserved += HA_HEADER_SIZE + size;
+
+        return (char *)pblock + HA_HEADER_SIZE;
+    }
+
+    //-----------------------------------------------------------------------------
+    class_index = ha_class_ui(size);
+    class_size = (class_index + 1) * HA_CLASS_SIZE;
+
+    p = parena->pfree[class_index];
+    if(NULL != p) {
+        parena->pfree[class_index] = *(void **)p;
+        return p;
+    }
+
+    if((size_t)(parena->pend[class_index] - parena->pcursor[class_index]) < class_size) {
+        pblock = malloc(HA_SLAB_SIZE);
+        if(NULL == pblock) {
+            debug("ha_alloc_p failed to allocate memory\n");
+            return NULL;
+        }
+
+        pblock->pnext = parena->pslabs;
+        parena->pslabs = pblock;
+        parena->reserved += HA_SLAB_SIZE;
+
+        parena->pcursor[class_index] = (char *)pblock + HA_HEADER_SIZE;
+        parena->pend[class_index] = (char *)pblock + HA_SLAB_SIZE;
+    }
+
+    p = parena->pcursor[class_index];
+    parena->pcursor[class_index] += class_size;
+    return p;
+}
+
+int ha_reserve_i(hash_arena_t *parena, size_t size, size_t count)
+{
+    unsigned int class_index;
+    size_t bytes;
+    hash_arena_block_t *pblock;
+
+    if(size > HA_MAX_SMALL || 0 == count)
+        return 1;
+
+    class_index = ha_class_ui(size);
+    bytes = (class_index + 1) * HA_CLASS_SIZE * count;
+    if((size_t)(parena->pend[class_index] - parena->pcursor[class_index]) >= bytes)
+        return 1;
+
+    pblock = malloc(HA_HEADER_SIZE + bytes);
+    if(NULL == pblock) {
+        debug("ha_reserve_i failed to allocate memory\n");
+        return 0;
+    }
+
+    pblock->pnext = parena->pslabs;
+    parena->pslabs = pblock;
+    parena->reserved += HA_HEADER_SIZE + bytes;
+
+    parena->pcursor[class_index] = (char *)pblock + HA_HEADER_SIZE;
+    parena->pend[class_index] = (char *)pblock + HA_HEADER_SIZE + bytes;
+    return 1;
+}
+
+void ha_free(hash_arena_t *parena, void *p, size_t size)
+{
+    hash_arena_block_t *pblock;
+    unsigned int class_index;
+
+    if(NULL == p)
+        return;
+
+    if(size > HA_MAX_SMALL) {
+        pblock = (hash_arena_block_t *)((char *)p - HA_HEADER_SIZE);
+        if(NULL != pblock->pprev)
+            pblock->pprev->pnext = pblock->pnext;
+        else
+            parena->plarge = pblock->pnext;
+        if(NULL != pblock->pnext)
+            pblock->pnext->pprev = pblock->pprev;
+
+        parena->reserved -= HA_HEADER_SIZE + size;
+        free(pblock);
+        return;
+    }
+
+    class_index = ha_class_ui(size);
+    *(void **)p = parena->pfree[class_index];
+    parena->pfree[class_index] = p;
+}
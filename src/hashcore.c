@@ -5,13 +5,22 @@
 
 #include "../inc/hashcore.h"
 #include "../inc/hashfunc.h"
+#include "../inc/hashrobin.h"
+#include "../inc/hashswiss.h"
+#include "../inc/hashcuckoo.h"
+#include "../inc/hashfamily.h"
+#include "../inc/hashepoch.h"
+#include "../inc/hashsnap.h"
+#include "../inc/hashwal.h"
 
-#ifdef __WITH_MURMUR
 #include "../inc/murmur.h"
-#endif //__WITH_MURMUR
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <time.h>
 //#include <tkDecls.h>
 
 static uint32_t global_seed = 2976579765;
@@ -48,32 +57,114 @@ void ht_init(hash_table_t *ptable, hash_flags_t flags, double max_load_factor
     ptable->phashfunc_x64_128 = for_x64_128;
 
 #   endif //__WITH_MURMUR
-    //----------------------------------------------------------------
-    ptable->array_size = HT_INITIAL_SIZE;
-    ptable->pparray = malloc(ptable->array_size * sizeof(*(ptable->pparray)));
-    if(NULL == ptable->pparray) {
-        debug("ht_init failed to allocate memory\n");
-        exit(-1);
+
+    if(flags & HT_HASH_MIX) {
+        ptable->phashfunc_x86_32  = hf_mix_32;
+        ptable->phashfunc_x86_128 = hf_mix_128;
+        ptable->phashfunc_x64_128 = hf_mix_128;
+    }
+    else if(flags & HT_HASH_CRC32C) {
+        ptable->phashfunc_x86_32  = hf_crc32c_32;
+        ptable->phashfunc_x86_128 = hf_crc32c_128;
+        ptable->phashfunc_x64_128 = hf_crc32c_128;
     }
+    else if(flags & HT_HASH_MURMUR) {
+        ptable->phashfunc_x86_32  = MurmurHash3_x86_32;
+        ptable->phashfunc_x86_128 = MurmurHash3_x86_128;
+        ptable->phashfunc_x64_128 = MurmurHash3_x64_128;
+    }
+    // lookups of an incremental resize move buckets, lock-free readers can't allow it
+    if(flags & HT_EPOCH)
+        flags &= ~HT_INCREMENTAL;
 
+    //----------------------------------------------------------------
+    ptable->flags                = flags;
+    ptable->array_size           = ht_capacity_sz(ptable, HT_INITIAL_SIZE);
     ptable->key_count            = 0;
     ptable->collisions           = 0;
-    ptable->flags                = flags;
     ptable->max_load_factor      = max_load_factor;
     ptable->current_load_factor  = 0.0;
 
     //----------------------------------------------------------------
-    unsigned int index;
+    ptable->pslots               = NULL;
+    ptable->pctrl                = NULL;
+    ptable->tombstones           = 0;
+    ptable->parena               = NULL;
+    ptable->pcuckoo              = NULL;
+    ptable->pepoch               = NULL;
+    ptable->pview                = NULL;
+    ptable->psnapshot            = NULL;
+    ptable->pwal                 = NULL;
+    ptable->ppold                = NULL;
+    ptable->old_size             = 0;
+    ptable->migrate_index        = 0;
+    ptable->migrate_budget       = HT_MIGRATE_BUDGET;
+    ptable->resize_threads       = HT_RESIZE_THREADS;
+    ptable->resize_count         = 0;
+    ptable->resize_ns            = 0;
+
+    if(flags & HT_ARENA) {
+        ptable->parena = malloc(sizeof(*(ptable->parena)));
+        if(NULL == ptable->parena) {
+            debug("ht_init failed to allocate memory\n");
+            exit(-1);
+        }
+        ha_init(ptable->parena);
+    }
+
+    if(flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        ptable->pparray = NULL;
+        if(flags & HT_ROBIN_HOOD)
+            rh_init(ptable);
+        else
+            sw_init(ptable);
+        return;
+    }
+
+    if(flags & HT_CUCKOO) {
+        ptable->pparray = NULL;
+        ck_init(ptable);
+        return;
+    }
+
+    ptable->pparray = malloc(ptable->array_size * sizeof(*(ptable->pparray)));
+    if(NULL == ptable->pparray) {
+        debug("ht_init failed to allocate memory\n");
+        exit(-1);
+    }
+
+    //----------------------------------------------------------------
+    size_t index;
     for(index = 0; index < ptable->array_size; index++)
     {
         ptable->pparray[index] = NULL;
     }
 
+    if(flags & HT_EPOCH) {
+        ptable->pepoch = malloc(sizeof(*(ptable->pepoch)));
+        ptable->pview = malloc(sizeof(*(ptable->pview)));
+        if(NULL == ptable->pepoch || NULL == ptable->pview) {
+            debug("ht_init failed to allocate memory\n");
+            exit(-1);
+        }
+        ep_init(ptable->pepoch);
+        ptable->pview->pparray = ptable->pparray;
+        ptable->pview->array_size = ptable->array_size;
+    }
+
     return;
 }
 
 void ht_clear(hash_table_t *ptable)
 {
+    size_t budget = ptable->migrate_budget;
+    size_t threads = ptable->resize_threads;
+    struct hash_wal *pwal = ptable->pwal;
+
+    /// the log stays attached, ht_destroy would detach it
+    if(NULL != pwal)
+        hw_log_clear(pwal);
+    ptable->pwal = NULL;
     ht_destroy(ptable);
 
     ht_init(ptable, ptable->flags, ptable->max_load_factor
@@ -81,29 +172,79 @@ void ht_clear(hash_table_t *ptable)
             , ptable->phashfunc_x86_32, ptable->phashfunc_x86_128, ptable->phashfunc_x64_128
 #   endif //__WITH_MURMUR
             );
+    ptable->migrate_budget = budget;
+    ptable->resize_threads = threads;
+    ptable->pwal = pwal;
 }
 
-void ht_destroy(hash_table_t *ptable)
+// frees every node of every chain, leaving the bucket array itself allocated
+static void ht_free_chains(hash_entry_t **pparray, size_t array_size, hash_table_t *ptable)
 {
-    unsigned int i;
+    size_t i;
 
     hash_entry_t *pentry;
     hash_entry_t *ptmp;
 
-    if(NULL == ptable->pparray) {
-        debug("ht_destroy got a bad ptable\n");
-    }
-
     // crawl the entries and delete them
-    for(i = 0; i < ptable->array_size; i++) {
-        pentry = ptable->pparray[i];
+    for(i = 0; i < array_size; i++) {
+        pentry = pparray[i];
 
         while(NULL != pentry) {
             ptmp = pentry->pnext;
-            he_destroy(ptable->flags, pentry);
+            he_destroy(ptable->flags, ptable->parena, pentry);
             pentry = ptmp;
         }
     }
+}
+
+void ht_destroy(hash_table_t *ptable)
+{
+    if(ptable->flags & HT_ROBIN_HOOD) {
+        rh_destroy(ptable);
+    }
+    else if(ptable->flags & HT_SWISS) {
+        sw_destroy(ptable);
+    }
+    else if(ptable->flags & HT_CUCKOO) {
+        ck_destroy(ptable);
+    }
+    else if(NULL == ptable->pparray) {
+        debug("ht_destroy got a bad ptable\n");
+    }
+    else if(NULL == ptable->parena) {
+        ht_free_chains(ptable->pparray, ptable->array_size, ptable);
+        if(NULL != ptable->ppold)
+            ht_free_chains(ptable->ppold, ptable->old_size, ptable);
+    }
+
+    // what writers retired goes before the arena its entries may come from
+    if(NULL != ptable->pepoch) {
+        ep_destroy(ptable->pepoch);
+        free(ptable->pepoch);
+        ptable->pepoch = NULL;
+        free(ptable->pview);
+        ptable->pview = NULL;
+    }
+
+    // with an arena, every entry goes away with its slabs
+    if(NULL != ptable->parena) {
+        ha_release(ptable->parena);
+        free(ptable->parena);
+        ptable->parena = NULL;
+    }
+
+    // HT_KEY_CONST and HT_VALUE_CONST entries of a thawed snapshot pointed into it
+    if(NULL != ptable->psnapshot) {
+        sn_unmap(ptable->psnapshot);
+        ptable->psnapshot = NULL;
+    }
+
+    // what was logged is committed, the log outlives the table but logs no more
+    if(NULL != ptable->pwal) {
+        hw_commit_i(ptable->pwal);
+        ptable->pwal->ptable = NULL;
+        ptable->pwal = NULL;
+    }
 
     ptable->phashfunc_x86_32 = NULL;
     ptable->phashfunc_x86_128 = NULL;
@@ -115,273 +256,2186 @@ void ht_destroy(hash_table_t *ptable)
 
     free(ptable->pparray);
     ptable->pparray = NULL;
+    free(ptable->ppold);
+    ptable->ppold = NULL;
+    ptable->old_size = 0;
 }
 
-// new_size can be smaller than current size (downsizing allowed)
-void ht_resize(hash_table_t *ptable, unsigned int new_size)
+// the snapshot lookups are served from, NULL once the table was written to
+static hash_snapshot_t *ht_snapshot_p(hash_table_t *ptable)
 {
-    hash_table_t new_table;
+    hash_snapshot_t *psnap = __atomic_load_n(&ptable->psnapshot, __ATOMIC_ACQUIRE);
 
-    debug("ht_resize(old=%d, new=%d)\n",ptable->array_size,new_size);
-    new_table.phashfunc_x86_32 = ptable->phashfunc_x86_32;
-    new_table.phashfunc_x86_128 = ptable->phashfunc_x86_128;
-    new_table.phashfunc_x64_128 = ptable->phashfunc_x64_128;
-    new_table.array_size = new_size;
-    new_table.pparray = malloc(new_size * sizeof(hash_entry_t*));
-    new_table.key_count = 0;
-    new_table.collisions = 0;
-    new_table.flags = ptable->flags;
-    new_table.max_load_factor = ptable->max_load_factor;
+    return (NULL != psnap && !__atomic_load_n(&psnap->thawed, __ATOMIC_ACQUIRE)) ? psnap : NULL;
+}
 
-    unsigned int i;
-    for(i = 0; i < new_table.array_size; i++)
-    {
-        new_table.pparray[i] = NULL;
-    }
+static void ht_thaw_visit(void *pstate, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    ht_insert(pstate, pkey, key_size, pvalue, value_size);
+}
 
-    hash_entry_t *entry;
-    hash_entry_t *next;
-    for(i = 0; i < ptable->array_size; i++)
-    {
-        entry = ptable->pparray[i];
-        while(NULL != entry)
-        {
-            next = entry->pnext;
-            ht_he_insert(&new_table, entry);
-            entry = next;
-        }
-        ptable->pparray[i]=NULL;
+static void ht_snapshot_free(void *pctx, void *p)
+{
+    (void) pctx;
+    sn_unmap(p);
+}
+
+/*! turns a table loaded from a snapshot into a regular one, before its
+    first write: every record is inserted as by ht_insert. HT_EPOCH readers
+    keep using the snapshot until the last one is in, and it is unmapped
+    once they have left it */
+static void ht_thaw(hash_table_t *ptable)
+{
+    hash_snapshot_t *psnap = ptable->psnapshot;
+    struct hash_wal *pwal = ptable->pwal;
+
+    if(NULL == psnap || psnap->thawing || psnap->thawed)
+        return;
+
+    // the records are already in the table, not writes to log
+    debug("ht_thaw: %llu keys\n", (unsigned long long)psnap->key_count);
+    psnap->thawing = 1;
+    ptable->key_count = 0;
+    ptable->pwal = NULL;
+    sn_foreach_range(psnap, 0, psnap->bucket_count, ht_thaw_visit, NULL, ptable);
+    ptable->pwal = pwal;
+    psnap->thawing = 0;
+
+    if(ptable->flags & (HT_KEY_CONST | HT_VALUE_CONST)) {
+        __atomic_store_n(&psnap->thawed, 1, __ATOMIC_RELEASE);
+        return;
     }
 
-    ht_destroy(ptable);
+    __atomic_store_n(&ptable->psnapshot, NULL, __ATOMIC_RELEASE);
+    if(NULL != ptable->pepoch)
+        ep_retire(ptable->pepoch, psnap, ht_snapshot_free, NULL);
+    else
+        sn_unmap(psnap);
+}
+
+// pushes a node at the head of its bucket, by its stored hash
+static void ht_he_link(hash_table_t *ptable, hash_entry_t **pparray, hash_entry_t *pentry)
+{
+    size_t index = ht_bucket_sz(ptable, pentry->hash);
 
-    ptable->phashfunc_x86_32 = new_table.phashfunc_x86_32;
-    ptable->phashfunc_x86_128 = new_table.phashfunc_x86_128;
-    ptable->phashfunc_x64_128 = new_table.phashfunc_x64_128;
-    ptable->array_size = new_table.array_size;
-    ptable->pparray = new_table.pparray;
-    ptable->key_count = new_table.key_count;
-    ptable->collisions = new_table.collisions;
+    if(NULL != pparray[index])
+        ptable->collisions++;
 
+    pentry->pnext = pparray[index];
+    pparray[index] = pentry;
 }
 
-/************************************************************************************************>
- * ACCESS
- ************************************************************************************************/
-// this was separated out of the regular ht_insert for ease of copying hash entries around
-void ht_he_insert(hash_table_t *ptable, hash_entry_t *pentry){
-    unsigned int index;
+// the bucket of a hash in the array an incremental resize is moving away from
+static size_t ht_old_bucket_sz(hash_table_t *ptable, uint64_t hash)
+{
+    return ht_reduce_sz(ptable->flags, hash, ptable->old_size);
+}
 
-    hash_entry_t *ptmp;
+// moves the chain of an old bucket into the new array
+static void ht_migrate_bucket(hash_table_t *ptable, size_t index)
+{
+    hash_entry_t *entry = ptable->ppold[index];
+    hash_entry_t *next;
 
-    pentry->pnext = NULL;
-    index = ht_index_ui(ptable, pentry->pkey, pentry->key_size);
-    ptmp = ptable->pparray[index];
-    //! if true, no collision
-    if(NULL == ptmp)
-    {
-        ptable->pparray[index] = pentry;
-        ptable->key_count++;
+    if(NULL == entry)
         return;
-    }
 
-    /*! walk down the chain until we either hit the end
-        or find an identical pkey (in which case we replace the pvalue)
-    */
-    while(NULL != ptmp->pnext)
+    // the chain's collisions are counted again as its nodes are linked
+    ptable->ppold[index] = NULL;
+    ptable->collisions++;
+    while(NULL != entry)
     {
-        if(he_key_compare_i(ptmp, pentry))
-            break;
-        else
-            ptmp = ptmp->pnext;
+        next = entry->pnext;
+        ptable->collisions--;
+        ht_he_link(ptable, ptable->pparray, entry);
+        entry = next;
     }
+}
 
-    if(he_key_compare_i(ptmp, pentry))
-    {
-        /*! if the keys are identical, throw away the old pentry
-            and stick the new one into the ptable */
-        he_set_value(ptable->flags, ptmp, pentry->pvalue, pentry->value_size);
-        he_destroy(ptable->flags, pentry);
-    }
-    else
-    {
-        //! else tack the new pentry onto the end of the chain
-        ptmp->pnext = pentry;
-        ptable->collisions += 1;
-        ptable->key_count ++;
-        ptable->current_load_factor = (double)ptable->collisions / ptable->array_size;
+/*! moves the next budget buckets of an incremental resize, and drops the
+    old array once it is empty */
+static void ht_migrate(hash_table_t *ptable, size_t budget)
+{
+    size_t end;
+    uint64_t start;
 
-        /*! double the size of the ptable if autoresize is on and the
-            load factor has gone too high */
-        if(!(ptable->flags & HT_NO_AUTORESIZE) &&
-                (ptable->current_load_factor > ptable->max_load_factor)) {
-            ht_resize(ptable, ptable->array_size * 2);
-            ptable->current_load_factor =
-                (double)ptable->collisions / ptable->array_size;
-        }
+    if(NULL == ptable->ppold)
+        return;
+
+    // the resize was counted when it started, its migrations only add time
+    start = ht_clock_ul();
+    end = (budget < ptable->old_size - ptable->migrate_index) ?
+          ptable->migrate_index + budget : ptable->old_size;
+    for(; ptable->migrate_index < end; ptable->migrate_index++)
+        ht_migrate_bucket(ptable, ptable->migrate_index);
+
+    if(ptable->migrate_index == ptable->old_size) {
+        debug("ht_migrate: done (old=%zu, new=%zu)\n", ptable->old_size, ptable->array_size);
+        free(ptable->ppold);
+        ptable->ppold = NULL;
+        ptable->old_size = 0;
+        ptable->migrate_index = 0;
     }
+    ptable->resize_ns += ht_clock_ul() - start;
 }
 
-void* ht_get_p(hash_table_t *ptable, void *pkey, size_t key_size, size_t *pvalue_size)
+/*! allocates a NULL filled bucket array, calloc leaves large arrays to
+    zeroed pages that fault in as buckets are first used, so starting an
+    incremental resize does not write the whole array */
+static hash_entry_t **ht_buckets_pp(size_t size)
 {
-    unsigned int index  = ht_index_ui(ptable, pkey, key_size);
-
-    hash_entry_t *pentry   = ptable->pparray[index];
-
-    hash_entry_t tmp;
-    tmp.pkey = pkey;
-    tmp.key_size = key_size;
+    return calloc(size, sizeof(hash_entry_t*));
+}
 
-    // once we have the right index, walk down the chain (if any)
-    // until we find the right pkey or hit the end
-    while(NULL != pentry)
-    {
-        if(he_key_compare_i(pentry, &tmp))
-        {
-            if(NULL != pvalue_size)
-                *pvalue_size = pentry->value_size;
+/*! only swaps the arrays, the entries are moved by the following
+    operations (see ht_migrate) */
+static void ht_resize_start(hash_table_t *ptable, size_t new_size)
+{
+    uint64_t start = ht_clock_ul();
+    hash_entry_t **pparray = ht_buckets_pp(new_size);
 
-            return pentry->pvalue;
-        }
-        else
-        {
-            pentry = pentry->pnext;
-        }
+    if(NULL == pparray) {
+        debug("ht_resize_start failed to allocate memory\n");
+        return;
     }
 
-    return NULL;
+    debug("ht_resize_start(old=%zu, new=%zu)\n", ptable->array_size, new_size);
+    ptable->ppold = ptable->pparray;
+    ptable->old_size = ptable->array_size;
+    ptable->migrate_index = 0;
+    ptable->pparray = pparray;
+    ptable->array_size = new_size;
+    ht_resize_done(ptable, start);
 }
 
-int ht_contains_i(hash_table_t *ptable, void *pkey, size_t key_size)
+void ht_set_migrate_budget(hash_table_t *ptable, size_t budget)
 {
-    unsigned int index  = ht_index_ui(ptable, pkey, key_size);
+    ptable->migrate_budget = (0 == budget) ? 1 : budget;
+}
 
-    hash_entry_t *pentry   = ptable->pparray[index];
+void ht_set_resize_threads(hash_table_t *ptable, size_t thread_count)
+{
+    ptable->resize_threads = (0 == thread_count) ? 1 : thread_count;
+}
 
-    hash_entry_t tmp;
-    tmp.pkey = pkey;
-    tmp.key_size = key_size;
+uint64_t ht_clock_ul(void)
+{
+    struct timespec now;
 
-    /// walk down the chain, compare keys
-    while(NULL != pentry)
-    {
-        if(he_key_compare_i(pentry, &tmp))
-            return 1;
-        else
-            pentry = pentry->pnext;
-    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
 
-    return 0;
+void ht_resize_done(hash_table_t *ptable, uint64_t start)
+{
+    ptable->resize_count++;
+    ptable->resize_ns += ht_clock_ul() - start;
 }
 
-/************************************************************************************************>
- * INSERT / REMOVE
- ************************************************************************************************/
-void ht_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+/// The nodes one thread of a parallel resize hands to another.
+typedef struct ht_resize_list {
+    hash_entry_t **ppitems;
+    size_t count;
+    size_t capacity;
+} ht_resize_list_t;
+
+/// The share of one thread of a parallel resize (see ht_resize_parallel_i).
+typedef struct ht_resize_job {
+    hash_table_t *ptable;
+    hash_entry_t **pold;
+    size_t old_size;
+    size_t thread_count;
+    /// The thread: its range of old buckets, then of new ones.
+    size_t index;
+    /// thread_count * thread_count lists, by source then destination thread.
+    ht_resize_list_t *plists;
+    /// The collisions of the new buckets of the thread.
+    size_t collisions;
+    /// 0 if a list could not grow.
+    int split;
+} ht_resize_job_t;
+
+// the thread that owns a new bucket, the new array being cut into thread_count ranges
+static size_t ht_resize_owner_sz(ht_resize_job_t *pjob, size_t bucket)
 {
-    hash_entry_t *pentry = he_create_p(ptable->flags, pkey, key_size, pvalue, value_size);
-    ht_he_insert(ptable, pentry);
+    return (size_t)(((__uint128_t)bucket * pjob->thread_count) / pjob->ptable->array_size);
 }
 
-void ht_remove(hash_table_t *ptable, void *pkey, size_t key_size)
+/*! first pass: lists the nodes of the thread's old buckets by destination
+    thread, in the order a single-threaded resize would meet them. The
+    chains are only read, so the old array is intact if a list can't grow */
+static void *ht_resize_split(void *parg)
 {
-    unsigned int index  = ht_index_ui(ptable, pkey, key_size);
+    ht_resize_job_t *pjob = parg;
+    ht_resize_list_t *plists = pjob->plists + pjob->index * pjob->thread_count;
+    ht_resize_list_t *plist;
+    hash_entry_t **ppitems;
+    size_t last = pjob->old_size * (pjob->index + 1) / pjob->thread_count;
+    size_t i = pjob->old_size * pjob->index / pjob->thread_count;
+    hash_entry_t *entry;
+    size_t capacity;
 
-    hash_entry_t *pentry = ptable->pparray[index];
+    for(; i < last; i++)
+    {
+        for(entry = pjob->pold[i]; NULL != entry; entry = entry->pnext)
+        {
+            plist = &plists[ht_resize_owner_sz(pjob, ht_bucket_sz(pjob->ptable, entry->hash))];
+
+            if(plist->count == plist->capacity) {
+                capacity = (0 == plist->capacity) ? HT_INITIAL_SIZE : plist->capacity * 2;
+                ppitems = realloc(plist->ppitems, capacity * sizeof(*ppitems));
+                if(NULL == ppitems) {
+                    pjob->split = 0;
+                    return NULL;
+                }
+                plist->ppitems = ppitems;
+                plist->capacity = capacity;
+            }
+            plist->ppitems[plist->count++] = entry;
+        }
+    }
 
-    hash_entry_t tmp;
-    tmp.pkey = pkey;
-    tmp.key_size = key_size;
+    return NULL;
+}
 
-    /// walk down the chain
-    hash_entry_t *pprev = NULL;
-    while(NULL != pentry)
+/*! second pass: links the nodes listed for the thread's new buckets, source
+    thread by source thread, which pushes them in the single-threaded order.
+    No other thread writes these buckets. The lists being arrays, the loads
+    of consecutive nodes don't wait on each other as a chain walk would */
+static void *ht_resize_link(void *parg)
+{
+    ht_resize_job_t *pjob = parg;
+    hash_entry_t **pparray = pjob->ptable->pparray;
+    ht_resize_list_t *plist;
+    hash_entry_t *entry;
+    size_t source;
+    size_t bucket;
+    size_t k;
+
+    for(source = 0; source < pjob->thread_count; source++)
     {
-        /// if the pkey matches, take it out and connect its
-        /// parent and child in its place
-        if(he_key_compare_i(pentry, &tmp))
+        plist = &pjob->plists[source * pjob->thread_count + pjob->index];
+        for(k = 0; k < plist->count; k++)
         {
-            if(NULL == pprev)
-                ptable->pparray[index] = pentry->pnext;
-            else
-                pprev->pnext = pentry->pnext;
+            entry = plist->ppitems[k];
+            bucket = ht_bucket_sz(pjob->ptable, entry->hash);
 
-            ptable->key_count--;
+            if(NULL != pparray[bucket])
+                pjob->collisions++;
+            entry->pnext = pparray[bucket];
+            pparray[bucket] = entry;
+        }
+    }
 
-            if(NULL != pprev)
-              ptable->collisions--;
+    return NULL;
+}
 
-            he_destroy(ptable->flags, pentry);
-            return;
-        }
+/*! runs one pass on every job, the calling thread taking the first one and
+    any a thread could not be started for */
+static void ht_resize_pass(ht_resize_job_t *pjobs, pthread_t *pids, int *pstarted, void *(*ppass)(void *))
+{
+    size_t count = pjobs[0].thread_count;
+    size_t index;
+
+    for(index = 1; index < count; index++)
+        pstarted[index] = (0 == pthread_create(&pids[index], NULL, ppass, &pjobs[index]));
+
+    ppass(&pjobs[0]);
+    for(index = 1; index < count; index++)
+    {
+        if(pstarted[index])
+            pthread_join(pids[index], NULL);
         else
+            ppass(&pjobs[index]);
+    }
+}
+
+/*! moves every chain of pold into the new array (already set in the table)
+    with thread_count threads. Returns 0, having moved nothing, if the lists
+    can't be allocated */
+static int ht_resize_parallel_i(hash_table_t *ptable, hash_entry_t **pold, size_t old_size, size_t thread_count)
+{
+    ht_resize_job_t *pjobs = malloc(thread_count * sizeof(*pjobs));
+    ht_resize_list_t *plists = calloc(thread_count * thread_count, sizeof(*plists));
+    pthread_t *pids = malloc(thread_count * sizeof(*pids));
+    int *pstarted = malloc(thread_count * sizeof(*pstarted));
+    size_t index;
+    int done = 0;
+
+    if(NULL != pjobs && NULL != plists && NULL != pids && NULL != pstarted) {
+        for(index = 0; index < thread_count; index++)
         {
-            pprev = pentry;
-            pentry = pentry->pnext;
+            pjobs[index].ptable = ptable;
+            pjobs[index].pold = pold;
+            pjobs[index].old_size = old_size;
+            pjobs[index].thread_count = thread_count;
+            pjobs[index].index = index;
+            pjobs[index].plists = plists;
+            pjobs[index].collisions = 0;
+            pjobs[index].split = 1;
+        }
+
+        // every list is complete before any is linked, the join being the barrier
+        ht_resize_pass(pjobs, pids, pstarted, ht_resize_split);
+
+        done = 1;
+        for(index = 0; index < thread_count; index++)
+            done &= pjobs[index].split;
+
+        if(done) {
+            ht_resize_pass(pjobs, pids, pstarted, ht_resize_link);
+            for(index = 0; index < thread_count; index++)
+                ptable->collisions += pjobs[index].collisions;
         }
     }
-}
 
-/************************************************************************************************>
- * UTILS
- ************************************************************************************************/
-void ht_set_seed(uint32_t seed){
-    global_seed = seed;
+    if(!done) {
+        debug("ht_resize_parallel_i failed to allocate memory\n");
+    }
+
+    if(NULL != plists) {
+        for(index = 0; index < thread_count * thread_count; index++)
+            free(plists[index].ppitems);
+    }
+    free(pjobs);
+    free(plists);
+    free(pids);
+    free(pstarted);
+    return done;
 }
 
-unsigned int ht_size_ui(hash_table_t *ptable)
+// frees an entry an HT_EPOCH writer retired, once no reader can reach it
+static void ht_epoch_free_entry(void *pctx, void *p)
 {
-    return ptable->key_count;
+    hash_table_t *ptable = pctx;
+
+    he_destroy(ptable->flags, ptable->parena, p);
 }
 
-void** ht_keys_pp(hash_table_t *ptable, unsigned int *pkey_count)
+// frees a bucket array or a view an HT_EPOCH writer retired
+static void ht_epoch_free(void *pctx, void *p)
 {
-    void **ppret;
-
-    /// table validity check
-    if(0 == ptable->key_count){
-      *pkey_count = 0;
-      return NULL;
-    }
+    (void) pctx;
+    free(p);
+}
 
-    /// pparray of pointers to keys
-    ppret = malloc(ptable->key_count * sizeof(void *));
-    if(NULL == ppret) {
-        debug("ht_keys_pp failed to allocate memory\n");
+/*! the resize of an HT_EPOCH table: readers may be walking the old chains, so
+    their nodes are copied into the new array rather than relinked, and the
+    new array is published with its size in a new view. The old nodes, array
+    and view are retired */
+static void ht_epoch_resize(hash_table_t *ptable, size_t new_size)
+{
+    uint64_t start = ht_clock_ul();
+    hash_view_t *pview = malloc(sizeof(*pview));
+    hash_view_t *pold_view = ptable->pview;
+    hash_entry_t **pold = ptable->pparray;
+    size_t old_size = ptable->array_size;
+    size_t old_collisions = ptable->collisions;
+    hash_entry_t *pentry;
+    hash_entry_t *pcopy;
+    size_t i;
+
+    new_size = ht_capacity_sz(ptable, new_size);
+    ptable->pparray = ht_buckets_pp(new_size);
+    if(NULL == pview || NULL == ptable->pparray) {
+        debug("ht_epoch_resize failed to allocate memory\n");
+        free(pview);
+        free(ptable->pparray);
+        ptable->pparray = pold;
+        return;
     }
 
-    /// loop over all of the chains,
-    /// walk the chains,
-    /// add each entry to the pparray of keys
-    *pkey_count = 0;
+    ptable->array_size = new_size;
+    ptable->collisions = 0;
 
-    unsigned int index;
-    hash_entry_t *ptmp;
-    for(index = 0; index < ptable->array_size; index++)
+    for(i = 0; i < old_size; i++)
     {
-        ptmp = ptable->pparray[index];
-
-        while(NULL != ptmp)
+        for(pentry = pold[i]; NULL != pentry; pentry = pentry->pnext)
         {
-            ppret[*pkey_count]=ptmp->pkey;
-            *pkey_count += 1;
-            ptmp = ptmp->pnext;
-            // sanity check, should never actually happen
-            if(*pkey_count >= ptable->key_count) {
-                debug("ht_keys_pp: too many keys, expected %d, got %d\n",
-                        ptable->key_count, *pkey_count);
+            pcopy = he_create_p(ptable->flags, ptable->parena, pentry->pkey, pentry->key_size,
+                                pentry->pvalue, pentry->value_size);
+            if(NULL == pcopy) {
+                debug("ht_epoch_resize failed to copy an entry\n");
+                ht_free_chains(ptable->pparray, new_size, ptable);
+                free(ptable->pparray);
+                free(pview);
+                ptable->pparray = pold;
+                ptable->array_size = old_size;
+                ptable->collisions = old_collisions;
+                return;
             }
+
+            pcopy->hash = pentry->hash;
+            ht_he_link(ptable, ptable->pparray, pcopy);
         }
     }
 
-    return ppret;
-}
+    pview->pparray = ptable->pparray;
+    pview->array_size = new_size;
+    __atomic_store_n(&ptable->pview, pview, __ATOMIC_RELEASE);
+
+    /*! only readers that entered before the new view can still be in the old
+        one. A retirement may advance the epoch, the old array and chains are
+        read before what holds them is retired */
+    for(i = 0; i < old_size; i++)
+    {
+        for(pentry = pold[i]; NULL != pentry; pentry = pcopy)
+        {
+            pcopy = pentry->pnext;
+            ep_retire(ptable->pepoch, pentry, ht_epoch_free_entry, ptable);
+        }
+    }
+    ep_retire(ptable->pepoch, pold, ht_epoch_free, NULL);
+    ep_retire(ptable->pepoch, pold_view, ht_epoch_free, NULL);
+    ht_resize_done(ptable, start);
+}
+
+// new_size can be smaller than current size (downsizing allowed)
+void ht_resize(hash_table_t *ptable, size_t new_size)
+{
+    hash_entry_t **pold;
+    size_t old_size;
+    uint64_t start;
+
+    ht_thaw(ptable);
+
+    if(ptable->flags & HT_ROBIN_HOOD) {
+        rh_resize(ptable, new_size);
+        return;
+    }
+    if(ptable->flags & HT_SWISS) {
+        sw_resize(ptable, new_size);
+        return;
+    }
+    if(ptable->flags & HT_CUCKOO) {
+        ck_resize(ptable, new_size);
+        return;
+    }
+    if(NULL != ptable->pepoch) {
+        ht_epoch_resize(ptable, new_size);
+        return;
+    }
+
+    // a resize in progress is completed first
+    if(NULL != ptable->ppold)
+        ht_migrate(ptable, ptable->old_size);
+
+    start = ht_clock_ul();
+    pold = ptable->pparray;
+    old_size = ptable->array_size;
+    new_size = ht_capacity_sz(ptable, new_size);
+
+    debug("ht_resize(old=%zu, new=%zu)\n",ptable->array_size,new_size);
+    ptable->pparray = ht_buckets_pp(new_size);
+    if(NULL == ptable->pparray) {
+        debug("ht_resize failed to allocate memory\n");
+        ptable->pparray = pold;
+        return;
+    }
+
+    ptable->array_size = new_size;
+    ptable->collisions = 0;
+
+    size_t i;
+
+    // large arrays are shared between threads, as long as each gets HT_RESIZE_SPLIT buckets
+    size_t threads = old_size / HT_RESIZE_SPLIT;
+    if(threads > ptable->resize_threads)
+        threads = ptable->resize_threads;
+    if(threads > 1 && ht_resize_parallel_i(ptable, pold, old_size, threads)) {
+        free(pold);
+        ht_resize_done(ptable, start);
+        return;
+    }
+
+    /*! keys are all distinct and their hash is kept in the entry,
+        so nodes are relinked without hashing or comparing anything */
+    hash_entry_t *entry;
+    hash_entry_t *next;
+    for(i = 0; i < old_size; i++)
+    {
+        entry = pold[i];
+        while(NULL != entry)
+        {
+            next = entry->pnext;
+            ht_he_link(ptable, ptable->pparray, entry);
+            entry = next;
+        }
+    }
+
+    // every entry has moved, only the old array is left to free
+    free(pold);
+    ht_resize_done(ptable, start);
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+// lookup shared by the open-addressing engines
+static hash_slot_t *ht_slot_find_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    if(ptable->flags & HT_ROBIN_HOOD)
+        return rh_find_hash_p(ptable, hash, pkey, key_size);
+
+    return sw_find_hash_p(ptable, hash, pkey, key_size);
+}
+
+// walks a chain until the key (compared only when the hashes match) or the end
+static hash_entry_t *ht_chain_walk_p(hash_entry_t *pentry, uint64_t hash, void *pkey, size_t key_size)
+{
+    hash_entry_t tmp;
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    while(NULL != pentry)
+    {
+        if(pentry->hash == hash && he_key_compare_i(pentry, &tmp))
+            return pentry;
+        else
+            pentry = pentry->pnext;
+    }
+
+    return NULL;
+}
+
+/*! lookup of an HT_EPOCH table, concurrent with a writer: the view gives an
+    array and a size that go together, and every link is read with acquire so
+    that the entry it leads to is seen complete. Nothing is written */
+static hash_entry_t *ht_epoch_find_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    hash_view_t *pview = __atomic_load_n(&ptable->pview, __ATOMIC_ACQUIRE);
+    hash_entry_t *pentry;
+    hash_entry_t tmp;
+
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    pentry = __atomic_load_n(&pview->pparray[ht_reduce_sz(ptable->flags, hash, pview->array_size)],
+                             __ATOMIC_ACQUIRE);
+    while(NULL != pentry)
+    {
+        if(pentry->hash == hash && he_key_compare_i(pentry, &tmp))
+            return pentry;
+
+        pentry = __atomic_load_n(&pentry->pnext, __ATOMIC_ACQUIRE);
+    }
+
+    return NULL;
+}
+
+/*! lookup of the chained engine: the key is either in its bucket or,
+    while an incremental resize is in progress, in its old bucket */
+static hash_entry_t *ht_chain_find_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    hash_entry_t *pentry;
+
+    if(NULL != ptable->pepoch)
+        return ht_epoch_find_p(ptable, hash, pkey, key_size);
+
+    ht_migrate(ptable, ptable->migrate_budget);
+
+    pentry = ht_chain_walk_p(ptable->pparray[ht_bucket_sz(ptable, hash)], hash, pkey, key_size);
+    if(NULL == pentry && NULL != ptable->ppold)
+        pentry = ht_chain_walk_p(ptable->ppold[ht_old_bucket_sz(ptable, hash)], hash, pkey, key_size);
+
+    return pentry;
+}
+
+// makes sure the key can only be in the new array, and advances the migration
+static void ht_migrate_key(hash_table_t *ptable, uint64_t hash)
+{
+    if(NULL == ptable->ppold)
+        return;
+
+    ht_migrate_bucket(ptable, ht_old_bucket_sz(ptable, hash));
+    ht_migrate(ptable, ptable->migrate_budget);
+}
+
+/*! the insert of an HT_EPOCH table: the entry is complete before a release
+    store links it, and an existing key gets the new entry in place of its
+    old one (retired) rather than a new value under the readers' feet */
+static void ht_epoch_insert(hash_table_t *ptable, hash_entry_t *pentry)
+{
+    size_t index = ht_bucket_sz(ptable, pentry->hash);
+    hash_entry_t **pplink = &ptable->pparray[index];
+    hash_entry_t *ptmp;
+
+    for(ptmp = *pplink; NULL != ptmp; pplink = &ptmp->pnext, ptmp = *pplink)
+    {
+        if(ptmp->hash == pentry->hash && he_key_compare_i(ptmp, pentry)) {
+            pentry->pnext = ptmp->pnext;
+            __atomic_store_n(pplink, pentry, __ATOMIC_RELEASE);
+            ep_retire(ptable->pepoch, ptmp, ht_epoch_free_entry, ptable);
+            return;
+        }
+    }
+
+    pentry->pnext = NULL;
+    __atomic_store_n(pplink, pentry, __ATOMIC_RELEASE);
+    ptable->key_count++;
+    if(pplink == &ptable->pparray[index])
+        return;
+
+    ptable->collisions++;
+    ptable->current_load_factor = (double)ptable->collisions / ptable->array_size;
+    if(!(ptable->flags & HT_NO_AUTORESIZE) &&
+            (ptable->current_load_factor > ptable->max_load_factor)) {
+        ht_resize(ptable, ptable->array_size * 2);
+        ptable->current_load_factor = (double)ptable->collisions / ptable->array_size;
+    }
+}
+
+// links an entry whose hash is already set into the chained table
+static void ht_chain_insert(hash_table_t *ptable, hash_entry_t *pentry)
+{
+    size_t index;
+
+    hash_entry_t *ptmp;
+
+    if(NULL != ptable->pepoch) {
+        ht_epoch_insert(ptable, pentry);
+        return;
+    }
+
+    pentry->pnext = NULL;
+    ht_migrate_key(ptable, pentry->hash);
+    index = ht_bucket_sz(ptable, pentry->hash);
+    ptmp = ptable->pparray[index];
+    //! if true, no collision
+    if(NULL == ptmp)
+    {
+        ptable->pparray[index] = pentry;
+        ptable->key_count++;
+        return;
+    }
+
+    /*! walk down the chain until we either hit the end
+        or find an identical pkey (in which case we replace the pvalue),
+        keys are only compared when the hashes match
+    */
+    while(NULL != ptmp->pnext)
+    {
+        if(ptmp->hash == pentry->hash && he_key_compare_i(ptmp, pentry))
+            break;
+        else
+            ptmp = ptmp->pnext;
+    }
+
+    if(ptmp->hash == pentry->hash && he_key_compare_i(ptmp, pentry))
+    {
+        /*! if the keys are identical, throw away the old pentry
+            and stick the new one into the ptable */
+        he_set_value(ptable->flags, ptable->parena, ptmp, pentry->pvalue, pentry->value_size);
+        he_destroy(ptable->flags, ptable->parena, pentry);
+    }
+    else
+    {
+        //! else tack the new pentry onto the end of the chain
+        ptmp->pnext = pentry;
+        ptable->collisions += 1;
+        ptable->key_count ++;
+        ptable->current_load_factor = (double)ptable->collisions / ptable->array_size;
+
+        /*! double the size of the ptable if autoresize is on and the
+            load factor has gone too high */
+        if(!(ptable->flags & HT_NO_AUTORESIZE) &&
+                (ptable->current_load_factor > ptable->max_load_factor)) {
+            // an incremental resize in progress has to finish before the next one
+            if(ptable->flags & HT_INCREMENTAL) {
+                if(NULL == ptable->ppold)
+                    ht_resize_start(ptable, ptable->array_size * 2);
+            }
+            else
+                ht_resize(ptable, ptable->array_size * 2);
+            ptable->current_load_factor =
+                (double)ptable->collisions / ptable->array_size;
+        }
+    }
+}
+
+// this was separated out of the regular ht_insert for ease of copying hash entries around
+static void ht_entry_insert(hash_table_t *ptable, hash_entry_t *pentry){
+    ht_thaw(ptable);
+
+    if(ptable->flags & HT_ROBIN_HOOD) {
+        rh_he_insert(ptable, pentry);
+        return;
+    }
+    if(ptable->flags & HT_SWISS) {
+        sw_he_insert(ptable, pentry);
+        return;
+    }
+    if(ptable->flags & HT_CUCKOO) {
+        ck_he_insert(ptable, pentry);
+        return;
+    }
+
+    pentry->hash = ht_hash_ul(ptable, pentry->pkey, pentry->key_size);
+    ht_chain_insert(ptable, pentry);
+}
+
+void ht_he_insert(hash_table_t *ptable, hash_entry_t *pentry)
+{
+    if(NULL != ptable->pwal)
+        hw_log_insert(ptable->pwal, pentry->pkey, pentry->key_size, pentry->pvalue, pentry->value_size);
+    ht_entry_insert(ptable, pentry);
+}
+
+// the snapshot of a frozen table is keyed by ht_hash_ul, which HT_CUCKOO doesn't use
+static uint64_t ht_snapshot_hash_ul(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size)
+{
+    if(ptable->flags & HT_CUCKOO)
+        return ht_hash_ul(ptable, pkey, key_size);
+
+    return pcode->hash;
+}
+
+void* ht_get_p(hash_table_t *ptable, void *pkey, size_t key_size, size_t *pvalue_size)
+{
+    hash_code_t code;
+
+    ht_hash_code(ptable, pkey, key_size, &code);
+    return ht_get_hashed_p(ptable, &code, pkey, key_size, pvalue_size);
+}
+
+void* ht_get_hashed_p(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size, size_t *pvalue_size)
+{
+    hash_snapshot_t *psnap = ht_snapshot_p(ptable);
+
+    if(NULL != psnap)
+        return sn_get_p(psnap, ptable->flags, ht_snapshot_hash_ul(ptable, pcode, pkey, key_size),
+                        pkey, key_size, pvalue_size);
+
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        hash_slot_t *pslot = ht_slot_find_p(ptable, pcode->hash, pkey, key_size);
+        if(NULL == pslot)
+            return NULL;
+
+        if(NULL != pvalue_size)
+            *pvalue_size = pslot->entry.value_size;
+
+        return pslot->entry.pvalue;
+    }
+
+    hash_entry_t *pentry = (ptable->flags & HT_CUCKOO) ?
+                           ck_find_hash_p(ptable, pcode->hash, pcode->tag, pkey, key_size) :
+                           ht_chain_find_p(ptable, pcode->hash, pkey, key_size);
+    if(NULL == pentry)
+        return NULL;
+
+    if(NULL != pvalue_size)
+        *pvalue_size = pentry->value_size;
+
+    return pentry->pvalue;
+}
+
+int ht_contains_i(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    hash_code_t code;
+
+    ht_hash_code(ptable, pkey, key_size, &code);
+    return ht_contains_hashed_i(ptable, &code, pkey, key_size);
+}
+
+int ht_contains_hashed_i(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size)
+{
+    hash_snapshot_t *psnap = ht_snapshot_p(ptable);
+
+    if(NULL != psnap)
+        return NULL != sn_get_p(psnap, ptable->flags, ht_snapshot_hash_ul(ptable, pcode, pkey, key_size),
+                                pkey, key_size, NULL);
+
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS))
+        return NULL != ht_slot_find_p(ptable, pcode->hash, pkey, key_size);
+
+    if(ptable->flags & HT_CUCKOO)
+        return NULL != ck_find_hash_p(ptable, pcode->hash, pcode->tag, pkey, key_size);
+
+    return NULL != ht_chain_find_p(ptable, pcode->hash, pkey, key_size);
+}
+
+/*! finds the entries of up to HT_BATCH_GROUP keys in stages, each stage
+    prefetching for every key what the next stage will read. The migration
+    of an incremental resize advances once per group */
+static void ht_batch_find(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count,
+                          hash_entry_t **ppfound)
+{
+    uint64_t hash[HT_BATCH_GROUP];
+    uint32_t tag[HT_BATCH_GROUP];
+    hash_entry_t **ppbucket[HT_BATCH_GROUP];
+    hash_entry_t *pnode[HT_BATCH_GROUP];
+    hash_slot_t *pslot;
+    size_t index;
+
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        ht_hash_batch(ptable, ppkeys, pkey_sizes, count, hash);
+        for(index = 0; index < count; index++)
+        {
+            if(ptable->flags & HT_ROBIN_HOOD)
+                rh_prefetch(ptable, hash[index]);
+            else
+                sw_prefetch(ptable, hash[index]);
+        }
+        for(index = 0; index < count; index++)
+        {
+            pslot = (ptable->flags & HT_ROBIN_HOOD) ?
+                    rh_find_hash_p(ptable, hash[index], ppkeys[index], pkey_sizes[index]) :
+                    sw_find_hash_p(ptable, hash[index], ppkeys[index], pkey_sizes[index]);
+            ppfound[index] = (NULL == pslot) ? NULL : &pslot->entry;
+        }
+        return;
+    }
+
+    if(ptable->flags & HT_CUCKOO) {
+        ck_hash_batch(ptable, ppkeys, pkey_sizes, count, hash, tag);
+        for(index = 0; index < count; index++)
+            ck_prefetch(ptable, hash[index], tag[index]);
+        for(index = 0; index < count; index++)
+            ppfound[index] = ck_find_hash_p(ptable, hash[index], tag[index], ppkeys[index], pkey_sizes[index]);
+        return;
+    }
+
+    // lock-free readers go through the view, one key at a time
+    if(NULL != ptable->pepoch) {
+        for(index = 0; index < count; index++)
+            ppfound[index] = ht_chain_find_p(ptable, ht_hash_ul(ptable, ppkeys[index], pkey_sizes[index]),
+                                             ppkeys[index], pkey_sizes[index]);
+        return;
+    }
+
+    ht_migrate(ptable, ptable->migrate_budget);
+
+    // the bucket heads
+    ht_hash_batch(ptable, ppkeys, pkey_sizes, count, hash);
+    for(index = 0; index < count; index++)
+    {
+        ppbucket[index] = &ptable->pparray[ht_bucket_sz(ptable, hash[index])];
+        __builtin_prefetch(ppbucket[index]);
+    }
+    // the first node of each chain
+    for(index = 0; index < count; index++)
+    {
+        pnode[index] = *ppbucket[index];
+        if(NULL != pnode[index])
+            __builtin_prefetch(pnode[index]);
+    }
+    // the rest of the chains, and the old buckets while a resize is in progress
+    for(index = 0; index < count; index++)
+    {
+        ppfound[index] = ht_chain_walk_p(pnode[index], hash[index], ppkeys[index], pkey_sizes[index]);
+        if(NULL == ppfound[index] && NULL != ptable->ppold)
+            ppfound[index] = ht_chain_walk_p(ptable->ppold[ht_old_bucket_sz(ptable, hash[index])],
+                                             hash[index], ppkeys[index], pkey_sizes[index]);
+    }
+}
+
+void ht_get_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count,
+                  void **ppvalues, size_t *pvalue_sizes)
+{
+    hash_entry_t *ppfound[HT_BATCH_GROUP];
+    size_t group;
+    size_t index;
+    size_t size;
+
+    // the records of a snapshot are not entries, its keys are looked up one by one
+    if(NULL != ht_snapshot_p(ptable)) {
+        for(index = 0; index < count; index++)
+        {
+            size = 0;
+            ppvalues[index] = ht_get_p(ptable, ppkeys[index], pkey_sizes[index], &size);
+            if(NULL != pvalue_sizes)
+                pvalue_sizes[index] = size;
+        }
+        return;
+    }
+
+    for(group = 0; group < count; group += HT_BATCH_GROUP)
+    {
+        size = (count - group < HT_BATCH_GROUP) ? count - group : HT_BATCH_GROUP;
+        ht_batch_find(ptable, ppkeys + group, pkey_sizes + group, size, ppfound);
+
+        for(index = 0; index < size; index++)
+        {
+            ppvalues[group + index] = (NULL == ppfound[index]) ? NULL : ppfound[index]->pvalue;
+            if(NULL != pvalue_sizes)
+                pvalue_sizes[group + index] = (NULL == ppfound[index]) ? 0 : ppfound[index]->value_size;
+        }
+    }
+}
+
+void ht_contains_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count, int *pfound)
+{
+    hash_entry_t *ppfound[HT_BATCH_GROUP];
+    size_t group;
+    size_t index;
+    size_t size;
+
+    if(NULL != ht_snapshot_p(ptable)) {
+        for(index = 0; index < count; index++)
+            pfound[index] = ht_contains_i(ptable, ppkeys[index], pkey_sizes[index]);
+        return;
+    }
+
+    for(group = 0; group < count; group += HT_BATCH_GROUP)
+    {
+        size = (count - group < HT_BATCH_GROUP) ? count - group : HT_BATCH_GROUP;
+        ht_batch_find(ptable, ppkeys + group, pkey_sizes + group, size, ppfound);
+
+        for(index = 0; index < size; index++)
+            pfound[group + index] = (NULL != ppfound[index]);
+    }
+}
+
+/************************************************************************************************>
+ * INSERT / REMOVE
+ ************************************************************************************************/
+void ht_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hash_code_t code;
+
+    ht_hash_code(ptable, pkey, key_size, &code);
+    ht_insert_hashed(ptable, &code, pkey, key_size, pvalue, value_size);
+}
+
+void ht_insert_hashed(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size,
+                      void *pvalue, size_t value_size)
+{
+    if(NULL != ptable->pwal)
+        hw_log_insert(ptable->pwal, pkey, key_size, pvalue, value_size);
+    ht_thaw(ptable);
+
+    // the slot array copies straight into place, no node is needed
+    if(ptable->flags & HT_ROBIN_HOOD) {
+        rh_insert_hash(ptable, pcode->hash, pkey, key_size, pvalue, value_size);
+        return;
+    }
+    if(ptable->flags & HT_SWISS) {
+        sw_insert_hash(ptable, pcode->hash, pkey, key_size, pvalue, value_size);
+        return;
+    }
+
+    hash_entry_t *pentry = he_create_p(ptable->flags, ptable->parena, pkey, key_size, pvalue, value_size);
+    if(NULL == pentry) {
+        debug("ht_insert failed to allocate memory\n");
+        return;
+    }
+
+    if(ptable->flags & HT_CUCKOO) {
+        ck_he_insert_hash(ptable, pentry, pcode->hash, pcode->tag);
+        return;
+    }
+
+    pentry->hash = pcode->hash;
+    ht_chain_insert(ptable, pentry);
+}
+
+/*! the array size that holds final_count keys without an autoresize. n keys
+    spread over m buckets leave n - m(1 - e^(-n/m)) collisions on average, so
+    the chained load x = n/m has to satisfy x - 1 + e^(-x) <= max_load_factor.
+    The left side grows with x, a bisection finds it (aiming at 90% of the
+    limit, for the variance) */
+static size_t ht_presize_sz(hash_table_t *ptable, size_t final_count)
+{
+    double target = ptable->max_load_factor * 0.9;
+    double low = 0;
+    double high = ptable->max_load_factor + 1;
+    double load;
+    unsigned int step;
+
+    if(ptable->flags & HT_ROBIN_HOOD)
+        return (size_t)(final_count / HT_ROBIN_MAX_LOAD) + 2;
+    if(ptable->flags & HT_SWISS)
+        return (size_t)(final_count / HT_SWISS_MAX_LOAD) + 2;
+    if(ptable->flags & HT_CUCKOO)
+        return (size_t)(final_count / HT_CUCKOO_MAX_LOAD) + 2;
+
+    for(step = 0; step < 40; step++)
+    {
+        load = (low + high) / 2;
+        if(load - 1 + exp(-load) <= target)
+            low = load;
+        else
+            high = load;
+    }
+
+    return (low > 0) ? (size_t)(final_count / low) + 1 : ptable->array_size;
+}
+
+void ht_reserve(hash_table_t *ptable, size_t key_count)
+{
+    size_t new_size;
+
+    if(ptable->flags & HT_NO_AUTORESIZE)
+        return;
+
+    new_size = ht_presize_sz(ptable, key_count);
+    if(new_size > ptable->array_size)
+        ht_resize(ptable, new_size);
+}
+
+static void ht_batch_insert(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes,
+                            void **ppvalues, size_t *pvalue_sizes, size_t count)
+{
+    uint64_t hash[HT_BATCH_GROUP];
+    hash_entry_t *pentries[HT_BATCH_GROUP];
+    hash_entry_t *phead;
+    size_t group;
+    size_t index;
+    size_t size;
+    size_t new_size;
+
+    if(0 == count)
+        return;
+    ht_thaw(ptable);
+
+    /// the array is sized once for the whole batch, and at least doubles
+    /// so that a run of small batches resizes as seldom as single inserts
+    if(!(ptable->flags & HT_NO_AUTORESIZE)) {
+        new_size = ht_presize_sz(ptable, ptable->key_count + count);
+        if(new_size > ptable->array_size)
+            ht_resize(ptable, (new_size > ptable->array_size * 2) ? new_size : ptable->array_size * 2);
+    }
+
+    // the slot engines copy straight into place, there are no nodes to batch
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        for(index = 0; index < count; index++)
+            ht_insert(ptable, ppkeys[index], pkey_sizes[index], ppvalues[index], pvalue_sizes[index]);
+        return;
+    }
+
+    // the sizes of the first pair stand for the whole batch
+    he_reserve(ptable->flags, ptable->parena, pkey_sizes[0], pvalue_sizes[0], count);
+
+    if(ptable->flags & HT_CUCKOO) {
+        for(index = 0; index < count; index++)
+            ht_insert(ptable, ppkeys[index], pkey_sizes[index], ppvalues[index], pvalue_sizes[index]);
+        return;
+    }
+
+    /*! HT_BATCH_GROUP keys at a time: hash them all, then prefetch their
+        buckets, then create the entries and prefetch the chain heads, then
+        link. A resize in the middle only makes some prefetches useless */
+    for(group = 0; group < count; group += HT_BATCH_GROUP)
+    {
+        size = (count - group < HT_BATCH_GROUP) ? count - group : HT_BATCH_GROUP;
+
+        ht_hash_batch(ptable, ppkeys + group, pkey_sizes + group, size, hash);
+
+        for(index = 0; index < size; index++)
+            __builtin_prefetch(&ptable->pparray[ht_bucket_sz(ptable, hash[index])]);
+
+        for(index = 0; index < size; index++)
+        {
+            pentries[index] = he_create_p(ptable->flags, ptable->parena,
+                                          ppkeys[group + index], pkey_sizes[group + index],
+                                          ppvalues[group + index], pvalue_sizes[group + index]);
+            if(NULL == pentries[index]) {
+                debug("ht_insert_batch failed to create an entry\n");
+                continue;
+            }
+
+            pentries[index]->hash = hash[index];
+            phead = ptable->pparray[ht_bucket_sz(ptable, hash[index])];
+            if(NULL != phead)
+                __builtin_prefetch(phead);
+        }
+
+        for(index = 0; index < size; index++)
+        {
+            if(NULL != pentries[index])
+                ht_chain_insert(ptable, pentries[index]);
+        }
+    }
+}
+
+void ht_insert_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes,
+                     void **ppvalues, size_t *pvalue_sizes, size_t count)
+{
+    struct hash_wal *pwal = ptable->pwal;
+
+    if(NULL == pwal) {
+        ht_batch_insert(ptable, ppkeys, pkey_sizes, ppvalues, pvalue_sizes, count);
+        return;
+    }
+
+    // logged once here, not again by the ht_insert calls of the slot engines
+    hw_log_batch(pwal, ppkeys, pkey_sizes, ppvalues, pvalue_sizes, count);
+    ptable->pwal = NULL;
+    ht_batch_insert(ptable, ppkeys, pkey_sizes, ppvalues, pvalue_sizes, count);
+    ptable->pwal = pwal;
+}
+
+void ht_remove(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    hash_code_t code;
+
+    ht_hash_code(ptable, pkey, key_size, &code);
+    ht_remove_hashed(ptable, &code, pkey, key_size);
+}
+
+void ht_remove_hashed(hash_table_t *ptable, hash_code_t *pcode, void *pkey, size_t key_size)
+{
+    if(NULL != ptable->pwal)
+        hw_log_remove(ptable->pwal, pkey, key_size);
+    ht_thaw(ptable);
+
+    if(ptable->flags & HT_ROBIN_HOOD) {
+        rh_remove_hash(ptable, pcode->hash, pkey, key_size);
+        return;
+    }
+    if(ptable->flags & HT_SWISS) {
+        sw_remove_hash(ptable, pcode->hash, pkey, key_size);
+        return;
+    }
+    if(ptable->flags & HT_CUCKOO) {
+        ck_remove_hash(ptable, pcode->hash, pcode->tag, pkey, key_size);
+        return;
+    }
+
+    uint64_t hash = pcode->hash;
+    ht_migrate_key(ptable, hash);
+    size_t index  = ht_bucket_sz(ptable, hash);
+
+    hash_entry_t *pentry = ptable->pparray[index];
+
+    hash_entry_t tmp;
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    /// walk down the chain
+    hash_entry_t *pprev = NULL;
+    while(NULL != pentry)
+    {
+        /// if the pkey matches, take it out and connect its
+        /// parent and child in its place
+        if(pentry->hash == hash && he_key_compare_i(pentry, &tmp))
+        {
+            // release: the readers of an HT_EPOCH table may be walking the chain
+            if(NULL == pprev)
+                __atomic_store_n(&ptable->pparray[index], pentry->pnext, __ATOMIC_RELEASE);
+            else
+                __atomic_store_n(&pprev->pnext, pentry->pnext, __ATOMIC_RELEASE);
+
+            ptable->key_count--;
+
+            // the chain loses a collision unless the node was alone
+            if(NULL != pprev || NULL != pentry->pnext)
+              ptable->collisions--;
+
+            if(NULL != ptable->pepoch)
+                ep_retire(ptable->pepoch, pentry, ht_epoch_free_entry, ptable);
+            else
+                he_destroy(ptable->flags, ptable->parena, pentry);
+            return;
+        }
+        else
+        {
+            pprev = pentry;
+            pentry = pentry->pnext;
+        }
+    }
+}
+
+/************************************************************************************************>
+ * UTILS
+ ************************************************************************************************/
+void ht_set_seed(uint32_t seed){
+    global_seed = seed;
+}
+
+uint32_t ht_get_seed_ui(void)
+{
+    return global_seed;
+}
+
+size_t ht_size_sz(hash_table_t *ptable)
+{
+    return ptable->key_count;
+}
+
+unsigned int ht_size_ui(hash_table_t *ptable)
+{
+    return (unsigned int)ht_size_sz(ptable);
+}
+
+void** ht_keys_pp_sz(hash_table_t *ptable, size_t *pkey_count)
+{
+    void **ppret;
+
+    ht_thaw(ptable);
+
+    /// table validity check
+    if(0 == ptable->key_count){
+      *pkey_count = 0;
+      return NULL;
+    }
+
+    /// pparray of pointers to keys
+    ppret = malloc(ptable->key_count * sizeof(void *));
+    if(NULL == ppret) {
+        debug("ht_keys_pp_sz failed to allocate memory\n");
+    }
+
+    /// loop over all of the chains,
+    /// walk the chains,
+    /// add each entry to the pparray of keys
+    *pkey_count = 0;
+
+    size_t index;
+    hash_entry_t *ptmp;
+
+    /// a resize in progress is completed, this walk is as long anyway
+    ht_migrate(ptable, ptable->old_size);
+
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        for(index = 0; index < ptable->array_size; index++)
+        {
+            if(0 != ptable->pslots[index].dist)
+                ppret[(*pkey_count)++] = ptable->pslots[index].entry.pkey;
+        }
+        return ppret;
+    }
+
+    if(ptable->flags & HT_CUCKOO) {
+        hash_cuckoo_t *pck = ptable->pcuckoo;
+        for(index = 0; index < ptable->array_size; index++)
+        {
+            ptmp = pck->pbuckets[index / CK_BUCKET_SLOTS].pentry[index % CK_BUCKET_SLOTS];
+            if(NULL != ptmp)
+                ppret[(*pkey_count)++] = ptmp->pkey;
+        }
+        for(index = 0; index < pck->stash_count; index++)
+            ppret[(*pkey_count)++] = pck->pstash[index]->pkey;
+        return ppret;
+    }
+
+    for(index = 0; index < ptable->array_size; index++)
+    {
+        ptmp = ptable->pparray[index];
+
+        while(NULL != ptmp)
+        {
+            ppret[*pkey_count]=ptmp->pkey;
+            *pkey_count += 1;
+            ptmp = ptmp->pnext;
+            // sanity check, should never actually happen
+            if(*pkey_count >= ptable->key_count) {
+                debug("ht_keys_pp_sz: too many keys, expected %zu, got %zu\n",
+                        ptable->key_count, *pkey_count);
+            }
+        }
+    }
+
+    return ppret;
+}
+
+void** ht_keys_pp(hash_table_t *ptable, unsigned int *pkey_count)
+{
+    size_t key_count;
+    void **ppret = ht_keys_pp_sz(ptable, &key_count);
+
+    *pkey_count = (unsigned int)key_count;
+    return ppret;
+}
+
+void ht_scan_start(hash_cursor_t *pcursor)
+{
+    memset(pcursor, 0, sizeof(*pcursor));
+}
+
+// the place of a hash in the scan order, a 32 bit hash spread as the high half
+static uint64_t ht_scan_position_ul(int flags, uint64_t hash)
+{
+    return (flags & HT_HASH64) ? hash : (uint64_t)(uint32_t)hash << 32;
+}
+
+/*! the first position past a bucket of a table indexed by the high bits
+    (HT_POW2, HT_FASTRANGE), plast is set for the last bucket, which ends
+    at 2^64 */
+static uint64_t ht_scan_end_ul(int flags, size_t size, size_t bucket, int *plast)
+{
+    *plast = (bucket + 1 >= size);
+    if(*plast)
+        return 0;
+
+    if(flags & HT_POW2)
+        return (uint64_t)(bucket + 1) << (64 - __builtin_ctzll(size));
+
+    /// the smallest p with p * size / 2^64 >= bucket + 1
+    return (uint64_t)((((unsigned __int128)(bucket + 1) << 64) + size - 1) / size);
+}
+
+// copies an entry into the next item of a scan
+static void ht_scan_item(hash_scan_item_t *pitem, hash_entry_t *pentry)
+{
+    pitem->pkey = pentry->pkey;
+    pitem->key_size = pentry->key_size;
+    pitem->pvalue = pentry->pvalue;
+    pitem->value_size = pentry->value_size;
+}
+
+/*! returns the keys of up to two chains whose position is within
+    [pcursor->position, end) (or above pcursor->position if last), one hash
+    after the other in ascending order, moving the cursor past each of them.
+    pfinished is cleared when pitems is full before the range is */
+static size_t ht_scan_chains_sz(int flags, hash_entry_t *pchains[2], hash_cursor_t *pcursor,
+                                uint64_t end, int last, hash_scan_item_t *pitems, size_t capacity,
+                                size_t count, int *pfinished)
+{
+    hash_entry_t *pentry;
+    uint64_t position;
+    uint64_t lowest;
+    size_t group;
+    size_t seen;
+    int found;
+    int chain;
+
+    /// a range that fits whole is returned as its chains go, in any order
+    if(0 == pcursor->offset) {
+        group = 0;
+        for(chain = 0; chain < 2; chain++)
+        {
+            for(pentry = pchains[chain]; NULL != pentry; pentry = pentry->pnext)
+            {
+                position = ht_scan_position_ul(flags, pentry->hash);
+                group += (position >= pcursor->position && (last || position < end));
+            }
+        }
+
+        if(group <= capacity - count) {
+            for(chain = 0; chain < 2; chain++)
+            {
+                for(pentry = pchains[chain]; NULL != pentry; pentry = pentry->pnext)
+                {
+                    position = ht_scan_position_ul(flags, pentry->hash);
+                    if(position < pcursor->position || (!last && position >= end))
+                        continue;
+                    ht_scan_item(&pitems[count++], pentry);
+                }
+            }
+            *pfinished = 1;
+            return count;
+        }
+    }
+
+    *pfinished = 0;
+    while(1)
+    {
+        /// the lowest position left in the range, and how many keys have it
+        found = 0;
+        lowest = 0;
+        group = 0;
+        for(chain = 0; chain < 2; chain++)
+        {
+            for(pentry = pchains[chain]; NULL != pentry; pentry = pentry->pnext)
+            {
+                position = ht_scan_position_ul(flags, pentry->hash);
+                if(position < pcursor->position || (!last && position >= end))
+                    continue;
+                if(!found || position < lowest) {
+                    found = 1;
+                    lowest = position;
+                    group = 0;
+                }
+                if(position == lowest)
+                    group++;
+            }
+        }
+
+        if(!found) {
+            *pfinished = 1;
+            return count;
+        }
+
+        // a hash is not split across calls if it fits the next one
+        if(count == capacity || (0 != count && group - pcursor->offset > capacity - count))
+            return count;
+
+        pcursor->position = lowest;
+        seen = 0;
+        for(chain = 0; chain < 2; chain++)
+        {
+            for(pentry = pchains[chain]; NULL != pentry && count < capacity; pentry = pentry->pnext)
+            {
+                if(ht_scan_position_ul(flags, pentry->hash) != lowest || seen++ < pcursor->offset)
+                    continue;
+                ht_scan_item(&pitems[count++], pentry);
+                pcursor->offset++;
+            }
+        }
+
+        if(pcursor->offset < group)
+            return count;
+
+        pcursor->offset = 0;
+        if(UINT64_MAX == lowest) {
+            *pfinished = 1;
+            return count;
+        }
+        pcursor->position = lowest + 1;
+    }
+}
+
+/*! the scan of the tables indexed by the high bits of the hash: a bucket
+    holds a range of positions, in the old array of an incremental resize
+    as in the new one, so the cursor is a position valid for any size */
+static size_t ht_scan_ordered_sz(hash_table_t *ptable, hash_cursor_t *pcursor,
+                                 hash_scan_item_t *pitems, size_t capacity, size_t visits)
+{
+    hash_entry_t *pchains[2];
+    uint64_t end;
+    uint64_t old_end;
+    size_t count = 0;
+    size_t bucket;
+    size_t first;
+    int finished;
+    int last;
+    int old_last;
+
+    while(count < capacity && 0 != visits--)
+    {
+        bucket = ht_reduce_sz(ptable->flags | HT_HASH64, pcursor->position, ptable->array_size);
+
+        /// a run of empty buckets is crossed at once, its last end is the new cursor
+        if(NULL == ptable->ppold && NULL == ptable->pparray[bucket]) {
+            first = bucket;
+            while(NULL == ptable->pparray[bucket] && bucket + 1 < ptable->array_size && 0 != visits)
+            {
+                bucket++;
+                visits--;
+            }
+            if(bucket != first)
+                pcursor->position = ht_scan_end_ul(ptable->flags, ptable->array_size, bucket - 1, &last);
+        }
+
+        end = ht_scan_end_ul(ptable->flags, ptable->array_size, bucket, &last);
+        pchains[0] = ptable->pparray[bucket];
+        pchains[1] = NULL;
+
+        /// the range is cut to the end of the old bucket too, if it is nearer
+        if(NULL != ptable->ppold) {
+            bucket = ht_reduce_sz(ptable->flags | HT_HASH64, pcursor->position, ptable->old_size);
+            old_end = ht_scan_end_ul(ptable->flags, ptable->old_size, bucket, &old_last);
+            pchains[1] = ptable->ppold[bucket];
+            if(!old_last && (last || old_end < end)) {
+                end = old_end;
+                last = 0;
+            }
+        }
+
+        count = ht_scan_chains_sz(ptable->flags, pchains, pcursor, end, last,
+                                  pitems, capacity, count, &finished);
+        if(!finished)
+            break;
+
+        if(last) {
+            pcursor->done = 1;
+            break;
+        }
+        pcursor->position = end;
+    }
+
+    return count;
+}
+
+// starts the scan of an indexed table over, from the old array of a resize in progress
+static void ht_scan_restart(hash_table_t *ptable, hash_cursor_t *pcursor)
+{
+    pcursor->position = 0;
+    pcursor->offset = 0;
+    pcursor->index = 0;
+    pcursor->old_phase = (NULL != ptable->ppold);
+    pcursor->array_size = pcursor->old_phase ? ptable->old_size : ptable->array_size;
+}
+
+/*! the scan of the modulo indexed chains, bucket after bucket: the keys
+    not migrated yet are found in the old array, the others in the new one,
+    which is scanned whole afterwards. Any other resize starts over */
+static size_t ht_scan_indexed_sz(hash_table_t *ptable, hash_cursor_t *pcursor,
+                                 hash_scan_item_t *pitems, size_t capacity, size_t visits)
+{
+    hash_entry_t *pchains[2] = {NULL, NULL};
+    hash_entry_t **pparray;
+    size_t count = 0;
+    int finished;
+
+    if(0 == pcursor->array_size)
+        ht_scan_restart(ptable, pcursor);
+    else if(pcursor->old_phase && NULL == ptable->ppold) {
+        pcursor->old_phase = 0;
+        pcursor->array_size = ptable->array_size;
+        pcursor->position = 0;
+        pcursor->offset = 0;
+        pcursor->index = 0;
+    }
+    else if(pcursor->array_size != (pcursor->old_phase ? ptable->old_size : ptable->array_size))
+        ht_scan_restart(ptable, pcursor);
+
+    while(count < capacity && 0 != visits--)
+    {
+        if(pcursor->index == pcursor->array_size) {
+            if(!pcursor->old_phase) {
+                pcursor->done = 1;
+                break;
+            }
+            pcursor->old_phase = 0;
+            pcursor->array_size = ptable->array_size;
+            pcursor->index = 0;
+            continue;
+        }
+
+        pparray = pcursor->old_phase ? ptable->ppold : ptable->pparray;
+        pchains[0] = pparray[pcursor->index];
+        if(NULL == pchains[0]) {
+            pcursor->index++;
+            continue;
+        }
+        count = ht_scan_chains_sz(ptable->flags, pchains, pcursor, 0, 1,
+                                  pitems, capacity, count, &finished);
+        if(!finished)
+            break;
+
+        pcursor->position = 0;
+        pcursor->index++;
+    }
+
+    return count;
+}
+
+/*! the scan of HT_ROBIN_HOOD and HT_SWISS by home slot, and by hash within
+    a home. The keys of a home sit from it on, before the next empty slot
+    (and before the keys of the next homes with HT_ROBIN_HOOD): the shifts,
+    and the rehashes at the same size, move keys but never change a home */
+static size_t ht_scan_homes_sz(hash_table_t *ptable, hash_cursor_t *pcursor,
+                               hash_scan_item_t *pitems, size_t capacity, size_t visits)
+{
+    hash_slot_t *pslot;
+    uint64_t lowest = 0;
+    size_t count = 0;
+    size_t group;
+    size_t probe;
+    size_t seen;
+    size_t slot;
+    int found;
+    int pass;
+
+    while(count < capacity && 0 != visits-- && pcursor->index < ptable->array_size)
+    {
+        // the first pass finds the lowest hash left in the home and counts its keys, the second returns them
+        found = 0;
+        group = 0;
+        seen = 0;
+        for(pass = 0; pass < 2; pass++)
+        {
+            slot = pcursor->index;
+            for(probe = 0; probe < ptable->array_size; probe++)
+            {
+                pslot = &ptable->pslots[slot];
+                if((ptable->flags & HT_SWISS) ? SW_EMPTY == ptable->pctrl[slot] :
+                   (0 == pslot->dist || pslot->dist - 1 < probe))
+                    break;
+                slot = (slot + 1 == ptable->array_size) ? 0 : slot + 1;
+                if(0 == pslot->dist || pslot->dist - 1 != probe || pslot->entry.hash < pcursor->position)
+                    continue;
+
+                if(0 == pass) {
+                    if(!found || pslot->entry.hash < lowest) {
+                        lowest = pslot->entry.hash;
+                        group = 0;
+                    }
+                    found = 1;
+                    group += (pslot->entry.hash == lowest);
+                }
+                else if(pslot->entry.hash == lowest && seen++ >= pcursor->offset && count < capacity) {
+                    ht_scan_item(&pitems[count++], &pslot->entry);
+                    pcursor->offset++;
+                }
+            }
+
+            if(!found)
+                break;
+            // no key of the home is below lowest, the offset was for a hash gone since
+            if(lowest != pcursor->position) {
+                pcursor->position = lowest;
+                pcursor->offset = 0;
+            }
+            // the keys of a hash are not split across calls if they fit the next one
+            if(0 == pass && 0 != count && group - pcursor->offset > capacity - count)
+                return count;
+        }
+
+        if(found && pcursor->offset < group)
+            return count;
+
+        pcursor->offset = 0;
+        if(found && UINT64_MAX != lowest) {
+            pcursor->position = lowest + 1;
+            continue;
+        }
+        pcursor->position = 0;
+        pcursor->index++;
+    }
+
+    if(pcursor->index >= ptable->array_size)
+        pcursor->done = 1;
+    return count;
+}
+
+/*! the scan of HT_CUCKOO, slot after slot, then the stash. The keys moved
+    behind the cursor since the previous call (see ck_slot_sz) are returned
+    first, a rehash (or too many moves to remember) starts over */
+static size_t ht_scan_cuckoo_sz(hash_table_t *ptable, hash_cursor_t *pcursor,
+                                hash_scan_item_t *pitems, size_t capacity, size_t visits)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    hash_cuckoo_move_t *pmove;
+    hash_entry_t *pentry;
+    size_t count = 0;
+    size_t slot_count = ptable->array_size + pck->stash_count;
+
+    if(pcursor->generation != ptable->resize_count || pck->moves_back - pcursor->moves > HT_CUCKOO_MOVE_LOG) {
+        pcursor->generation = ptable->resize_count;
+        pcursor->moves = pck->moves_back;
+        pcursor->index = 0;
+    }
+
+    for(; count < capacity && 0 != visits && pcursor->moves != pck->moves_back; visits--)
+    {
+        pmove = &pck->moves[pcursor->moves++ % HT_CUCKOO_MOVE_LOG];
+        if(ck_slot_sz(ptable, pmove) < pcursor->index)
+            ht_scan_item(&pitems[count++], pmove->pentry);
+    }
+
+    for(; count < capacity && 0 != visits && pcursor->index < slot_count; pcursor->index++, visits--)
+    {
+        pentry = (pcursor->index < ptable->array_size) ?
+                 pck->pbuckets[pcursor->index / CK_BUCKET_SLOTS].pentry[pcursor->index % CK_BUCKET_SLOTS] :
+                 pck->pstash[pcursor->index - ptable->array_size];
+
+        if(NULL == pentry)
+            continue;
+        ht_scan_item(&pitems[count++], pentry);
+    }
+
+    if(pcursor->index >= slot_count && pcursor->moves == pck->moves_back)
+        pcursor->done = 1;
+    return count;
+}
+
+/*! the scan of the open-addressing engines. A key keeps its home slot
+    while the size does not change, a new size starts over */
+static size_t ht_scan_slots_sz(hash_table_t *ptable, hash_cursor_t *pcursor,
+                               hash_scan_item_t *pitems, size_t capacity, size_t visits)
+{
+    if(pcursor->array_size != ptable->array_size) {
+        pcursor->array_size = ptable->array_size;
+        pcursor->generation = ptable->resize_count;
+        pcursor->moves = (NULL != ptable->pcuckoo) ? ptable->pcuckoo->moves_back : 0;
+        pcursor->position = 0;
+        pcursor->index = 0;
+        pcursor->offset = 0;
+    }
+
+    if(NULL != ptable->pcuckoo)
+        return ht_scan_cuckoo_sz(ptable, pcursor, pitems, capacity, visits);
+    return ht_scan_homes_sz(ptable, pcursor, pitems, capacity, visits);
+}
+
+size_t ht_scan_sz(hash_table_t *ptable, hash_cursor_t *pcursor, hash_scan_item_t *pitems, size_t capacity)
+{
+    size_t visits;
+
+    if(pcursor->done || 0 == capacity)
+        return 0;
+
+    // the snapshot has no cursor order, the table is made a regular one first
+    ht_thaw(ptable);
+
+    if(0 == ptable->key_count) {
+        pcursor->done = 1;
+        return 0;
+    }
+
+    visits = (capacity > SIZE_MAX / HT_SCAN_VISITS) ? SIZE_MAX : capacity * HT_SCAN_VISITS;
+
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS | HT_CUCKOO))
+        return ht_scan_slots_sz(ptable, pcursor, pitems, capacity, visits);
+    if(ptable->flags & (HT_POW2 | HT_FASTRANGE))
+        return ht_scan_ordered_sz(ptable, pcursor, pitems, capacity, visits);
+    return ht_scan_indexed_sz(ptable, pcursor, pitems, capacity, visits);
+}
+
+/*! the number of places ht_foreach_range walks: the buckets (or slots),
+    then the HT_CUCKOO stash or the old buckets of an incremental resize,
+    or the buckets of a snapshot */
+static size_t ht_foreach_size_sz(hash_table_t *ptable)
+{
+    if(NULL != ht_snapshot_p(ptable))
+        return ht_snapshot_p(ptable)->bucket_count;
+    if(NULL != ptable->pcuckoo)
+        return ptable->array_size + ptable->pcuckoo->stash_count;
+    return ptable->array_size + ((NULL != ptable->ppold) ? ptable->old_size : 0);
+}
+
+/*! one pair to pvisit, or to pvisit_hash with the ht_hash_ul of its key as
+    stored in the entry. HT_CUCKOO keeps the first half of ht_hash128, which
+    is ht_hash_ul only with HT_HASH64 */
+static void ht_visit_entry(hash_table_t *ptable, hash_entry_t *pentry, ht_visit_t *pvisit,
+                           ht_visit_hash_t *pvisit_hash, void *pstate)
+{
+    uint64_t hash = pentry->hash;
+
+    if(NULL != pvisit) {
+        pvisit(pstate, pentry->pkey, pentry->key_size, pentry->pvalue, pentry->value_size);
+        return;
+    }
+
+    if(NULL != ptable->pcuckoo && !(ptable->flags & HT_HASH64))
+        hash = ht_hash_ul(ptable, pentry->pkey, pentry->key_size);
+    pvisit_hash(pstate, hash, pentry->pkey, pentry->key_size, pentry->pvalue, pentry->value_size);
+}
+
+/*! calls pvisit (or pvisit_hash, pvisit being NULL) on the pairs of the
+    places [begin, end) (see ht_foreach_size_sz) */
+static void ht_foreach_range(hash_table_t *ptable, size_t begin, size_t end, ht_visit_t *pvisit,
+                             ht_visit_hash_t *pvisit_hash, void *pstate)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    hash_entry_t *pentry;
+    size_t index;
+
+    if(NULL != ht_snapshot_p(ptable)) {
+        sn_foreach_range(ht_snapshot_p(ptable), begin, end, pvisit, pvisit_hash, pstate);
+        return;
+    }
+
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        for(index = begin; index < end; index++)
+        {
+            pentry = &ptable->pslots[index].entry;
+            if(0 != ptable->pslots[index].dist)
+                ht_visit_entry(ptable, pentry, pvisit, pvisit_hash, pstate);
+        }
+        return;
+    }
+
+    for(index = begin; index < end; index++)
+    {
+        if(NULL != pck)
+            pentry = (index < ptable->array_size) ?
+                     pck->pbuckets[index / CK_BUCKET_SLOTS].pentry[index % CK_BUCKET_SLOTS] :
+                     pck->pstash[index - ptable->array_size];
+        else {
+            /*! the heads of the chains ahead are fetched, then the values of
+                those whose heads came in, as in ht_batch_find */
+            if(index + 2 * HT_BATCH_GROUP < ptable->array_size) {
+                __builtin_prefetch(ptable->pparray[index + 2 * HT_BATCH_GROUP]);
+                if(NULL != ptable->pparray[index + HT_BATCH_GROUP])
+                    __builtin_prefetch(ptable->pparray[index + HT_BATCH_GROUP]->pvalue);
+            }
+            pentry = (index < ptable->array_size) ?
+                     ptable->pparray[index] : ptable->ppold[index - ptable->array_size];
+        }
+
+        // the cuckoo slots hold a single entry, pnext is only followed in the chains
+        for(; NULL != pentry; pentry = (NULL != pck) ? NULL : pentry->pnext)
+            ht_visit_entry(ptable, pentry, pvisit, pvisit_hash, pstate);
+    }
+}
+
+void ht_foreach(hash_table_t *ptable, ht_visit_t *pvisit, void *pstate)
+{
+    ht_foreach_range(ptable, 0, ht_foreach_size_sz(ptable), pvisit, NULL, pstate);
+}
+
+void ht_foreach_hash(hash_table_t *ptable, ht_visit_hash_t *pvisit, void *pstate)
+{
+    ht_foreach_range(ptable, 0, ht_foreach_size_sz(ptable), NULL, pvisit, pstate);
+}
+
+/// The share of one thread of ht_foreach_parallel.
+typedef struct ht_foreach_job {
+    hash_table_t *ptable;
+    size_t begin;
+    size_t end;
+    ht_visit_t *pvisit;
+    void *pstate;
+} ht_foreach_job_t;
+
+static void *ht_foreach_run(void *parg)
+{
+    ht_foreach_job_t *pjob = parg;
+
+    ht_foreach_range(pjob->ptable, pjob->begin, pjob->end, pjob->pvisit, NULL, pjob->pstate);
+    return NULL;
+}
+
+void ht_foreach_parallel(hash_table_t *ptable, size_t thread_count, ht_visit_t *pvisit,
+                         void *pstates, size_t state_size, ht_combine_t *pcombine)
+{
+    size_t size = ht_foreach_size_sz(ptable);
+    size_t count = (0 == thread_count) ? 1 : thread_count;
+    ht_foreach_job_t *pjobs;
+    pthread_t *pids;
+    int *pstarted;
+    size_t index;
+
+    if(count > size / HT_FOREACH_SPLIT)
+        count = (size / HT_FOREACH_SPLIT > 1) ? size / HT_FOREACH_SPLIT : 1;
+
+    pjobs = malloc(count * sizeof(*pjobs));
+    pids = malloc(count * sizeof(*pids));
+    pstarted = malloc(count * sizeof(*pstarted));
+    if(NULL == pjobs || NULL == pids || NULL == pstarted) {
+        // a single thread then, into the first state
+        debug("ht_foreach_parallel failed to allocate memory\n");
+        ht_foreach_range(ptable, 0, size, pvisit, NULL, pstates);
+        count = 0;
+    }
+
+    for(index = 0; index < count; index++)
+    {
+        pjobs[index].ptable = ptable;
+        pjobs[index].begin = size * index / count;
+        pjobs[index].end = size * (index + 1) / count;
+        pjobs[index].pvisit = pvisit;
+        pjobs[index].pstate = (char*)pstates + index * state_size;
+    }
+
+    /// the calling thread takes the first range, and those a thread could not be started for
+    for(index = 1; index < count; index++)
+        pstarted[index] = (0 == pthread_create(&pids[index], NULL, ht_foreach_run, &pjobs[index]));
+    if(0 != count)
+        ht_foreach_run(&pjobs[0]);
+    for(index = 1; index < count; index++)
+    {
+        if(pstarted[index])
+            pthread_join(pids[index], NULL);
+        else
+            ht_foreach_run(&pjobs[index]);
+    }
+
+    free(pjobs);
+    free(pids);
+    free(pstarted);
+
+    if(NULL != pcombine) {
+        for(index = 1; index < thread_count; index++)
+            pcombine(pstates, (char*)pstates + index * state_size);
+    }
+}
+
+static void ht_probe_add(hash_probe_stats_t *pstats, unsigned int probe, double *ptotal)
+{
+    *ptotal += probe;
+    if(probe > pstats->max_probe)
+        pstats->max_probe = probe;
+    pstats->histogram[(probe > HT_PROBE_HISTOGRAM_SIZE ? HT_PROBE_HISTOGRAM_SIZE : probe) - 1]++;
+}
+
+void ht_probe_stats(hash_table_t *ptable, hash_probe_stats_t *pstats)
+{
+    size_t index;
+    unsigned int probe;
+    double total = 0.0;
+    hash_entry_t *ptmp;
+
+    ht_thaw(ptable);
+    memset(pstats, 0, sizeof(*pstats));
+    ht_migrate(ptable, ptable->old_size);
+
+    /// a cuckoo entry is found in its first bucket, its alternate one or the stash
+    if(ptable->flags & HT_CUCKOO) {
+        hash_cuckoo_t *pck = ptable->pcuckoo;
+        for(index = 0; index < ptable->array_size; index++)
+        {
+            ptmp = pck->pbuckets[index / CK_BUCKET_SLOTS].pentry[index % CK_BUCKET_SLOTS];
+            if(NULL != ptmp)
+                ht_probe_add(pstats, (index / CK_BUCKET_SLOTS == (ptmp->hash & pck->bucket_mask)) ? 1 : 2, &total);
+        }
+        for(index = 0; index < pck->stash_count; index++)
+            ht_probe_add(pstats, 3, &total);
+
+        pstats->insert_failures = pck->insert_failures;
+        pstats->rehashes = pck->rehashes;
+        if(0 != ptable->key_count)
+            pstats->mean_probe = total / ptable->key_count;
+        return;
+    }
+
+    for(index = 0; index < ptable->array_size; index++)
+    {
+        /// a slot knows how far it is from home,
+        /// the n-th node of a chain is found after n key compares
+        if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+            probe = ptable->pslots[index].dist;
+            if(0 != probe)
+                ht_probe_add(pstats, probe, &total);
+            continue;
+        }
+
+        probe = 0;
+        for(ptmp = ptable->pparray[index]; NULL != ptmp; ptmp = ptmp->pnext)
+            ht_probe_add(pstats, ++probe, &total);
+    }
+
+    if(0 != ptable->key_count)
+        pstats->mean_probe = total / ptable->key_count;
+}
+
+static void ht_chain_add(hash_stats_t *pstats, size_t length)
+{
+    if(length > pstats->max_chain)
+        pstats->max_chain = length;
+    pstats->chain_histogram[(length < HT_CHAIN_HISTOGRAM_SIZE) ? length : HT_CHAIN_HISTOGRAM_SIZE - 1]++;
+}
+
+// node_size is 0 for an entry stored in a slot
+static void ht_entry_bytes(hash_table_t *ptable, hash_stats_t *pstats, hash_entry_t *pentry, size_t node_size)
+{
+    pstats->node_bytes += node_size;
+    he_bytes(ptable->flags, pentry, &pstats->key_bytes, &pstats->value_bytes);
+}
+
+void ht_stats(hash_table_t *ptable, hash_stats_t *pstats)
+{
+    size_t index;
+    size_t length;
+    size_t *plengths;
+    hash_slot_t *pslot;
+    hash_entry_t *ptmp;
+    size_t misses = 0;
+
+    /// the probes thaw a snapshot and complete a resize in progress, the rest walks what is left
+    memset(pstats, 0, sizeof(*pstats));
+    ht_probe_stats(ptable, &pstats->hits);
+    pstats->resize_count = ptable->resize_count;
+    pstats->resize_seconds = ptable->resize_ns / 1e9;
+
+    /// a missing key is looked for in both its buckets, then in the stash if it holds anything
+    if(ptable->flags & HT_CUCKOO) {
+        hash_cuckoo_t *pck = ptable->pcuckoo;
+        unsigned int slot;
+
+        pstats->array_bytes = sizeof(*pck) + (pck->bucket_mask + 1) * sizeof(*(pck->pbuckets));
+        for(index = 0; index <= pck->bucket_mask; index++)
+        {
+            length = 0;
+            for(slot = 0; slot < CK_BUCKET_SLOTS; slot++)
+            {
+                ptmp = pck->pbuckets[index].pentry[slot];
+                if(NULL != ptmp) {
+                    ht_entry_bytes(ptable, pstats, ptmp, sizeof(*ptmp));
+                    length++;
+                }
+            }
+            ht_chain_add(pstats, length);
+        }
+        for(slot = 0; slot < pck->stash_count; slot++)
+            ht_entry_bytes(ptable, pstats, pck->pstash[slot], sizeof(hash_entry_t));
+
+        pstats->miss_probes = (0 != pck->stash_count) ? 3.0 : 2.0;
+        return;
+    }
+
+    /// the chain of a slot is counted from the entries that have it as home
+    if(ptable->flags & (HT_ROBIN_HOOD | HT_SWISS)) {
+        pstats->array_bytes = ptable->array_size * sizeof(*(ptable->pslots));
+        if(ptable->flags & HT_SWISS)
+            pstats->array_bytes += ptable->array_size + SW_GROUP_MAX;
+
+        plengths = calloc(ptable->array_size, sizeof(*plengths));
+        if(NULL == plengths) {
+            debug("ht_stats failed to allocate memory, no chain lengths\n");
+        }
+
+        for(index = 0; index < ptable->array_size; index++)
+        {
+            pslot = &ptable->pslots[index];
+            if(0 == pslot->dist)
+                continue;
+
+            ht_entry_bytes(ptable, pstats, &pslot->entry, 0);
+            if(NULL != plengths)
+                plengths[(index + ptable->array_size - (pslot->dist - 1)) % ptable->array_size]++;
+        }
+        for(index = 0; NULL != plengths && index < ptable->array_size; index++)
+            ht_chain_add(pstats, plengths[index]);
+        free(plengths);
+
+        if(ptable->flags & HT_ROBIN_HOOD)
+            misses = rh_miss_probes_sz(ptable);
+        else
+            misses = sw_miss_probes_sz(ptable);
+        pstats->miss_probes = (double)misses / ptable->array_size;
+        return;
+    }
+
+    /// a missing key is compared with (the hash of) every node of its chain
+    pstats->array_bytes = ptable->array_size * sizeof(*(ptable->pparray));
+    for(index = 0; index < ptable->array_size; index++)
+    {
+        length = 0;
+        for(ptmp = ptable->pparray[index]; NULL != ptmp; ptmp = ptmp->pnext)
+        {
+            ht_entry_bytes(ptable, pstats, ptmp, sizeof(*ptmp));
+            length++;
+        }
+        ht_chain_add(pstats, length);
+        misses += length;
+    }
+    pstats->miss_probes = (double)misses / ptable->array_size;
+}
+
+uint64_t ht_hash_ul(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    uint32_t hash;
+    uint64_t out[2];
+
+    /// one x64_128 call gives all 64 bits at once
+    if(ptable->flags & HT_HASH64) {
+        ptable->phashfunc_x64_128(pkey, key_size, global_seed, out);
+        return out[0];
+    }
 
-unsigned int ht_index_ui(hash_table_t *ptable, void *pkey, size_t key_size)
-{
-    uint32_t index;
     /// 32 bits of murmur seems to fare pretty well
-    ptable->phashfunc_x86_32(pkey, key_size, global_seed, &index);
-    index %= ptable->array_size;
-    return index;
+    ptable->phashfunc_x86_32(pkey, key_size, global_seed, &hash);
+    return hash;
+}
+
+void ht_hash128(hash_table_t *ptable, void *pkey, size_t key_size, uint64_t pout[2])
+{
+    ptable->phashfunc_x64_128(pkey, key_size, global_seed, pout);
+}
+
+void ht_hash_code(hash_table_t *ptable, void *pkey, size_t key_size, hash_code_t *pcode)
+{
+    if(ptable->flags & HT_CUCKOO) {
+        ck_hash(ptable, pkey, key_size, &pcode->hash, &pcode->tag);
+        return;
+    }
+
+    pcode->hash = ht_hash_ul(ptable, pkey, key_size);
+    pcode->tag = 0;
+}
+
+/*! 1 if the keys can go through the multi-key kernels: the table hashes with
+    MurmurHash3 (the function the kernels match) and the keys all have one size */
+static int ht_hash_multi_i(HashFunc *phashfunc, HashFunc *pmurmur, size_t *pkey_sizes, size_t count)
+{
+    size_t index;
+
+    if(phashfunc != pmurmur)
+        return 0;
+
+    for(index = 1; index < count; index++)
+    {
+        if(pkey_sizes[index] != pkey_sizes[0])
+            return 0;
+    }
+
+    return count > 1;
+}
+
+void ht_hash_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count, uint64_t *phash)
+{
+    size_t index;
+    uint32_t hash[HT_BATCH_GROUP];
+    uint64_t out[2 * HT_BATCH_GROUP];
+    size_t group;
+    size_t size;
+
+    if(ptable->flags & HT_HASH64) {
+        if(ht_hash_multi_i(ptable->phashfunc_x64_128, MurmurHash3_x64_128, pkey_sizes, count)) {
+            for(group = 0; group < count; group += HT_BATCH_GROUP)
+            {
+                size = (count - group < HT_BATCH_GROUP) ? count - group : HT_BATCH_GROUP;
+                MurmurHash3_x64_128_multi(ppkeys + group, (int)pkey_sizes[0], global_seed, out, size);
+                for(index = 0; index < size; index++)
+                    phash[group + index] = out[index * 2];
+            }
+            return;
+        }
+    }
+    else if(ht_hash_multi_i(ptable->phashfunc_x86_32, MurmurHash3_x86_32, pkey_sizes, count)) {
+        for(group = 0; group < count; group += HT_BATCH_GROUP)
+        {
+            size = (count - group < HT_BATCH_GROUP) ? count - group : HT_BATCH_GROUP;
+            MurmurHash3_x86_32_multi(ppkeys + group, (int)pkey_sizes[0], global_seed, hash, size);
+            for(index = 0; index < size; index++)
+                phash[group + index] = hash[index];
+        }
+        return;
+    }
+
+    for(index = 0; index < count; index++)
+        phash[index] = ht_hash_ul(ptable, ppkeys[index], pkey_sizes[index]);
+}
+
+void ht_hash128_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count, uint64_t *pout)
+{
+    size_t index;
+
+    if(ht_hash_multi_i(ptable->phashfunc_x64_128, MurmurHash3_x64_128, pkey_sizes, count)) {
+        MurmurHash3_x64_128_multi(ppkeys, (int)pkey_sizes[0], global_seed, pout, count);
+        return;
+    }
+
+    for(index = 0; index < count; index++)
+        ht_hash128(ptable, ppkeys[index], pkey_sizes[index], &pout[index * 2]);
+}
+
+size_t ht_reduce_sz(int flags, uint64_t hash, size_t size)
+{
+    uint32_t hash32 = (uint32_t)hash;
+
+    /// a 32 bit hash indexes up to 2^32 buckets with 32 bit arithmetic,
+    /// beyond that it is spread as the high half of a 64 bit one
+    if(!(flags & HT_HASH64)) {
+        if(size <= UINT32_MAX) {
+            if(flags & HT_POW2)
+                return (size > 1) ? hash32 >> (32 - __builtin_ctzll(size)) : 0;
+            if(flags & HT_FASTRANGE)
+                return (size_t)(((uint64_t)hash32 * size) >> 32);
+            return hash32 % (uint32_t)size;
+        }
+        hash <<= 32;
+    }
+
+    /// the high bits of the hash pick one of the 2^n buckets
+    if(flags & HT_POW2)
+        return (size > 1) ? hash >> (64 - __builtin_ctzll(size)) : 0;
+
+    /// hash / 2^64 scaled to the size: a multiply and a shift, no division
+    if(flags & HT_FASTRANGE)
+        return (size_t)(((unsigned __int128)hash * size) >> 64);
+
+    return hash % size;
+}
+
+size_t ht_bucket_sz(hash_table_t *ptable, uint64_t hash)
+{
+    return ht_reduce_sz(ptable->flags, hash, ptable->array_size);
+}
+
+size_t ht_capacity_sz(hash_table_t *ptable, size_t size)
+{
+    size_t capacity = 1;
+
+    if(!(ptable->flags & HT_POW2))
+        return size;
+
+    while(capacity < size)
+        capacity <<= 1;
+    return capacity;
+}
+
+size_t ht_index_sz(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    return ht_bucket_sz(ptable, ht_hash_ul(ptable, pkey, key_size));
+}
+
+unsigned int ht_index_ui(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    return (unsigned int)ht_index_sz(ptable, pkey, key_size);
 }
@@ -0,0 +1,468 @@
+/// @cond PRIVATE
+/// @file hashcuckoo.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashcuckoo.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/************************************************************************************************>
+ * BUCKETS
+ ************************************************************************************************/
+/*! both halves of the 128 bit hash are used: the first one is the entry
+    hash (and gives the first bucket), the second one is the tag */
+void ck_hash(hash_table_t *ptable, void *pkey, size_t key_size, uint64_t *phash, uint32_t *ptag)
+{
+    uint64_t out[2];
+
+    ht_hash128(ptable, pkey, key_size, out);
+    *phash = out[0];
+    *ptag = (uint32_t)out[1];
+}
+
+void ck_hash_batch(hash_table_t *ptable, void **ppkeys, size_t *pkey_sizes, size_t count,
+                   uint64_t *phash, uint32_t *ptag)
+{
+    uint64_t out[2 * HT_BATCH_GROUP];
+    size_t index;
+
+    ht_hash128_batch(ptable, ppkeys, pkey_sizes, count, out);
+    for(index = 0; index < count; index++)
+    {
+        phash[index] = out[index * 2];
+        ptag[index] = (uint32_t)out[index * 2 + 1];
+    }
+}
+
+/*! the alternate bucket only depends on the bucket and the tag, so an
+    entry can be displaced without hashing its key again (either bucket
+    gives the other one). The tag is spread over 64 bits first */
+static size_t ck_alt_sz(hash_cuckoo_t *pck, size_t bucket, uint32_t tag)
+{
+    return (bucket ^ (size_t)(tag * UINT64_C(0x9E3779B97F4A7C15))) & pck->bucket_mask;
+}
+
+// 1 if the entry sits in its first bucket (it is not a collision)
+static int ck_home_i(hash_cuckoo_t *pck, hash_entry_t *pentry, size_t bucket)
+{
+    return bucket == (pentry->hash & pck->bucket_mask);
+}
+
+// remembers an entry moved to a slot before the one it left, see ck_slot_sz
+static void ck_moved(hash_cuckoo_t *pck, hash_entry_t *pentry, uint32_t tag)
+{
+    hash_cuckoo_move_t *pmove = &pck->moves[pck->moves_back++ % HT_CUCKOO_MOVE_LOG];
+
+    pmove->pentry = pentry;
+    pmove->hash = pentry->hash;
+    pmove->tag = tag;
+}
+
+static int ck_alloc_i(hash_cuckoo_t *pck, size_t bucket_count)
+{
+    pck->pbuckets = aligned_alloc(sizeof(hash_cuckoo_bucket_t), bucket_count * sizeof(hash_cuckoo_bucket_t));
+    if(NULL == pck->pbuckets)
+        return 0;
+
+    memset(pck->pbuckets, 0, bucket_count * sizeof(hash_cuckoo_bucket_t));
+    pck->bucket_mask = bucket_count - 1;
+    pck->stash_count = 0;
+    return 1;
+}
+
+// puts the entry in a free slot of the bucket, 0 if the bucket is full
+static int ck_put_i(hash_table_t *ptable, hash_cuckoo_t *pck, size_t bucket, hash_entry_t *pentry, uint32_t tag)
+{
+    hash_cuckoo_bucket_t *pbucket = &pck->pbuckets[bucket];
+    unsigned int slot;
+
+    for(slot = 0; slot < CK_BUCKET_SLOTS; slot++)
+    {
+        if(NULL == pbucket->pentry[slot]) {
+            pbucket->pentry[slot] = pentry;
+            pbucket->tag[slot] = tag;
+            if(!ck_home_i(pck, pentry, bucket))
+                ptable->collisions++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*! places an entry that is not in the table: in a free slot of either
+    bucket, or by displacing entries to their alternate bucket (a random
+    walk of up to HT_CUCKOO_MAX_KICKS steps), or else in the stash.
+    Returns 0 only if the stash is full, with the entries shuffled around
+    and the one left out, which may be another than the one given, in
+    *ppentry and *ptag: the caller must then rebuild the table and place it */
+static int ck_place_i(hash_table_t *ptable, hash_cuckoo_t *pck, hash_entry_t **ppentry, uint32_t *ptag)
+{
+    hash_entry_t *pentry = *ppentry;
+    uint32_t tag = *ptag;
+    size_t bucket = pentry->hash & pck->bucket_mask;
+    hash_cuckoo_bucket_t *pbucket;
+    hash_entry_t *pvictim;
+    uint32_t victim_tag;
+    unsigned int slot;
+    unsigned int kicks;
+    size_t from;
+
+    if(ck_put_i(ptable, pck, bucket, pentry, tag))
+        return 1;
+
+    for(kicks = 0; kicks < HT_CUCKOO_MAX_KICKS; kicks++)
+    {
+        from = bucket;
+        bucket = ck_alt_sz(pck, bucket, tag);
+        // past the first round pentry is a victim, leaving the bucket it was in
+        if(0 != kicks && bucket <= from)
+            ck_moved(pck, pentry, tag);
+        if(ck_put_i(ptable, pck, bucket, pentry, tag))
+            return 1;
+
+        // take the place of a victim, which goes on to its other bucket
+        pbucket = &pck->pbuckets[bucket];
+        slot = pck->kick++ % CK_BUCKET_SLOTS;
+        pvictim = pbucket->pentry[slot];
+        victim_tag = pbucket->tag[slot];
+        if(!ck_home_i(pck, pvictim, bucket))
+            ptable->collisions--;
+
+        pbucket->pentry[slot] = pentry;
+        pbucket->tag[slot] = tag;
+        if(!ck_home_i(pck, pentry, bucket))
+            ptable->collisions++;
+
+        pentry = pvictim;
+        tag = victim_tag;
+    }
+
+    if(CK_STASH_SIZE == pck->stash_count) {
+        *ppentry = pentry;
+        *ptag = tag;
+        return 0;
+    }
+
+    debug("ck_place_i: no room after %d kicks, stashing\n", HT_CUCKOO_MAX_KICKS);
+    pck->pstash[pck->stash_count] = pentry;
+    pck->stash_tag[pck->stash_count] = tag;
+    pck->stash_count++;
+    pck->insert_failures++;
+    ptable->collisions++;
+    return 1;
+}
+
+/*! finds the place of a key: a slot of either bucket or of the stash.
+    Tags are compared first, then the entry hash, then the key */
+static hash_entry_t **ck_lookup_pp(hash_cuckoo_t *pck, uint64_t hash, uint32_t tag, void *pkey, size_t key_size)
+{
+    size_t first = hash & pck->bucket_mask;
+    size_t second = ck_alt_sz(pck, first, tag);
+    hash_cuckoo_bucket_t *pbucket;
+    unsigned int slot;
+    unsigned int round;
+
+    hash_entry_t tmp;
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    // both lines are fetched at once
+    __builtin_prefetch(&pck->pbuckets[second]);
+
+    for(round = 0; round < 2; round++)
+    {
+        pbucket = &pck->pbuckets[0 == round ? first : second];
+        for(slot = 0; slot < CK_BUCKET_SLOTS; slot++)
+        {
+            if(pbucket->tag[slot] == tag && NULL != pbucket->pentry[slot] &&
+               pbucket->pentry[slot]->hash == hash && he_key_compare_i(pbucket->pentry[slot], &tmp))
+                return &pbucket->pentry[slot];
+        }
+    }
+
+    for(slot = 0; slot < pck->stash_count; slot++)
+    {
+        if(pck->stash_tag[slot] == tag && pck->pstash[slot]->hash == hash &&
+           he_key_compare_i(pck->pstash[slot], &tmp))
+            return &pck->pstash[slot];
+    }
+
+    return NULL;
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void ck_init(hash_table_t *ptable)
+{
+    size_t bucket_count = 1;
+
+    while(bucket_count * CK_BUCKET_SLOTS < ptable->array_size)
+        bucket_count *= 2;
+
+    ptable->pcuckoo = calloc(1, sizeof(*(ptable->pcuckoo)));
+    if(NULL == ptable->pcuckoo || !ck_alloc_i(ptable->pcuckoo, bucket_count)) {
+        debug("ck_init failed to allocate memory\n");
+        exit(-1);
+    }
+    ptable->array_size = bucket_count * CK_BUCKET_SLOTS;
+}
+
+void ck_destroy(hash_table_t *ptable)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    size_t bucket;
+    unsigned int slot;
+
+    if(NULL == pck) {
+        debug("ck_destroy got a bad ptable\n");
+        return;
+    }
+
+    // entries allocated from an arena are freed with it
+    for(bucket = 0; NULL == ptable->parena && bucket <= pck->bucket_mask; bucket++)
+    {
+        for(slot = 0; slot < CK_BUCKET_SLOTS; slot++)
+        {
+            if(NULL != pck->pbuckets[bucket].pentry[slot])
+                he_destroy(ptable->flags, ptable->parena, pck->pbuckets[bucket].pentry[slot]);
+        }
+    }
+    for(slot = 0; NULL == ptable->parena && slot < pck->stash_count; slot++)
+        he_destroy(ptable->flags, ptable->parena, pck->pstash[slot]);
+
+    free(pck->pbuckets);
+    free(pck);
+    ptable->pcuckoo = NULL;
+}
+
+void ck_resize(hash_table_t *ptable, size_t new_size)
+{
+    hash_cuckoo_t *pold = ptable->pcuckoo;
+    hash_cuckoo_t next;
+    hash_cuckoo_bucket_t *pbucket;
+    size_t bucket_count = 1;
+    size_t bucket;
+    unsigned int slot;
+    int placed;
+    hash_entry_t *pentry;
+    uint32_t tag;
+    uint64_t start = ht_clock_ul();
+
+    if(new_size <= ptable->key_count)
+        new_size = ptable->key_count + 1;
+    while(bucket_count * CK_BUCKET_SLOTS < new_size)
+        bucket_count *= 2;
+
+    /*! the old buckets are only read, so an attempt that runs out of
+        room is thrown away and retried twice as large */
+    for(;;)
+    {
+        next = *pold;
+        next.rehashes++;
+        if(!ck_alloc_i(&next, bucket_count)) {
+            debug("ck_resize failed to allocate memory\n");
+            return;
+        }
+
+        debug("ck_resize(old=%zu, new=%zu)\n", ptable->array_size, bucket_count * CK_BUCKET_SLOTS);
+        ptable->collisions = 0;
+        placed = 1;
+        for(bucket = 0; placed && bucket <= pold->bucket_mask; bucket++)
+        {
+            pbucket = &pold->pbuckets[bucket];
+            for(slot = 0; placed && slot < CK_BUCKET_SLOTS; slot++)
+            {
+                pentry = pbucket->pentry[slot];
+                tag = pbucket->tag[slot];
+                if(NULL != pentry)
+                    placed = ck_place_i(ptable, &next, &pentry, &tag);
+            }
+        }
+        for(slot = 0; placed && slot < pold->stash_count; slot++)
+        {
+            pentry = pold->pstash[slot];
+            tag = pold->stash_tag[slot];
+            placed = ck_place_i(ptable, &next, &pentry, &tag);
+        }
+
+        if(placed)
+            break;
+
+        free(next.pbuckets);
+        pold->rehashes = next.rehashes;
+        pold->insert_failures = next.insert_failures;
+        bucket_count *= 2;
+    }
+
+    free(pold->pbuckets);
+    *pold = next;
+    ptable->array_size = bucket_count * CK_BUCKET_SLOTS;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+    ht_resize_done(ptable, start);
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+void ck_he_insert(hash_table_t *ptable, hash_entry_t *pentry)
+{
+    uint64_t hash;
+    uint32_t tag;
+
+    ck_hash(ptable, pentry->pkey, pentry->key_size, &hash, &tag);
+    ck_he_insert_hash(ptable, pentry, hash, tag);
+}
+
+void ck_he_insert_hash(hash_table_t *ptable, hash_entry_t *pentry, uint64_t hash, uint32_t tag)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    hash_entry_t **ppfound;
+    size_t size;
+
+    pentry->hash = hash;
+    pentry->pnext = NULL;
+
+    ppfound = ck_lookup_pp(pck, pentry->hash, tag, pentry->pkey, pentry->key_size);
+    if(NULL != ppfound) {
+        he_set_value(ptable->flags, ptable->parena, *ppfound, pentry->pvalue, pentry->value_size);
+        he_destroy(ptable->flags, ptable->parena, pentry);
+        return;
+    }
+
+    // grow on load, and make sure the stash has room for this insert (see below)
+    if(ptable->key_count + 1 > ptable->array_size * HT_CUCKOO_MAX_LOAD ||
+       (CK_STASH_SIZE == pck->stash_count && ptable->key_count >= ptable->array_size / 8))
+        ck_resize(ptable, ptable->array_size * 2);
+
+    /*! a rebuild can leave the stash full again, the entry left out (this
+        one or one it displaced) is placed into the next, larger one. At a
+        low load a full stash means keys sharing their hash and tag, which
+        no size parts, so the table stops growing there */
+    while(!ck_place_i(ptable, pck, &pentry, &tag))
+    {
+        size = ptable->array_size;
+        if(ptable->key_count >= size / 8)
+            ck_resize(ptable, size * 2);
+        if(size == ptable->array_size) {
+            // one entry is in and one is out, or the new one never got in
+            debug("ck_he_insert could not make room, an entry is lost\n");
+            he_destroy(ptable->flags, ptable->parena, pentry);
+            return;
+        }
+    }
+
+    ptable->key_count++;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+hash_entry_t *ck_find_p(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    hash_entry_t **ppfound;
+    uint64_t hash;
+    uint32_t tag;
+
+    ck_hash(ptable, pkey, key_size, &hash, &tag);
+    ppfound = ck_lookup_pp(ptable->pcuckoo, hash, tag, pkey, key_size);
+    return (NULL == ppfound) ? NULL : *ppfound;
+}
+
+hash_entry_t *ck_find_hash_p(hash_table_t *ptable, uint64_t hash, uint32_t tag, void *pkey, size_t key_size)
+{
+    hash_entry_t **ppfound = ck_lookup_pp(ptable->pcuckoo, hash, tag, pkey, key_size);
+    return (NULL == ppfound) ? NULL : *ppfound;
+}
+
+void ck_prefetch(hash_table_t *ptable, uint64_t hash, uint32_t tag)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    size_t first = hash & pck->bucket_mask;
+
+    __builtin_prefetch(&pck->pbuckets[first]);
+    __builtin_prefetch(&pck->pbuckets[ck_alt_sz(pck, first, tag)]);
+}
+
+void ck_remove(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    uint64_t hash;
+    uint32_t tag;
+
+    ck_hash(ptable, pkey, key_size, &hash, &tag);
+    ck_remove_hash(ptable, hash, tag, pkey, key_size);
+}
+
+void ck_remove_hash(hash_table_t *ptable, uint64_t hash, uint32_t tag, void *pkey, size_t key_size)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    hash_entry_t **ppfound;
+    hash_entry_t *pentry;
+    size_t bucket;
+    unsigned int index;
+
+    ppfound = ck_lookup_pp(pck, hash, tag, pkey, key_size);
+    if(NULL == ppfound)
+        return;
+
+    pentry = *ppfound;
+    if(ppfound >= pck->pstash && ppfound < pck->pstash + CK_STASH_SIZE) {
+        // the last stashed entry fills the hole
+        index = (unsigned int)(ppfound - pck->pstash);
+        pck->stash_count--;
+        pck->pstash[index] = pck->pstash[pck->stash_count];
+        pck->stash_tag[index] = pck->stash_tag[pck->stash_count];
+        if(index != pck->stash_count)
+            ck_moved(pck, pck->pstash[index], pck->stash_tag[index]);
+        ptable->collisions--;
+    }
+    else {
+        bucket = (size_t)(((char *)ppfound - (char *)pck->pbuckets) / sizeof(hash_cuckoo_bucket_t));
+        if(!ck_home_i(pck, pentry, bucket))
+            ptable->collisions--;
+        *ppfound = NULL;
+    }
+
+    he_destroy(ptable->flags, ptable->parena, pentry);
+    ptable->key_count--;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+/*! only the pointers are compared: a moved entry removed since is not
+    found, or another one took its memory and is in the table anyway */
+size_t ck_slot_sz(hash_table_t *ptable, const hash_cuckoo_move_t *pmove)
+{
+    hash_cuckoo_t *pck = ptable->pcuckoo;
+    size_t bucket = pmove->hash & pck->bucket_mask;
+    unsigned int slot;
+    unsigned int round;
+
+    for(round = 0; round < 2; round++)
+    {
+        for(slot = 0; slot < CK_BUCKET_SLOTS; slot++)
+        {
+            if(pck->pbuckets[bucket].pentry[slot] == pmove->pentry)
+                return bucket * CK_BUCKET_SLOTS + slot;
+        }
+        bucket = ck_alt_sz(pck, bucket, pmove->tag);
+    }
+
+    for(slot = 0; slot < pck->stash_count; slot++)
+    {
+        if(pck->pstash[slot] == pmove->pentry)
+            return ptable->array_size + slot;
+    }
+
+    return SIZE_MAX;
+}
@@ -0,0 +1,284 @@
+/// @cond PRIVATE
+/// @file hashepoch.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashepoch.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <sched.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void ep_init(hash_epoch_t *pepoch)
+{
+    int index;
+
+    pepoch->global = 1;
+    pepoch->precords = NULL;
+    pepoch->pending = 0;
+    pthread_mutex_init(&pepoch->lock, NULL);
+
+    for(index = 0; index < EP_LIMBO_COUNT; index++)
+    {
+        pepoch->limbo[index].pitems = NULL;
+        pepoch->limbo[index].count = 0;
+        pepoch->limbo[index].capacity = 0;
+    }
+}
+
+// frees every pointer of a limbo list, keeping the list's array for reuse
+static void ep_free_limbo(hash_epoch_limbo_t *plimbo)
+{
+    size_t index;
+
+    for(index = 0; index < plimbo->count; index++)
+        plimbo->pitems[index].pfree(plimbo->pitems[index].pctx, plimbo->pitems[index].p);
+    plimbo->count = 0;
+}
+
+void ep_destroy(hash_epoch_t *pepoch)
+{
+    hash_epoch_record_t *precord;
+    hash_epoch_record_t *pnext;
+    int index;
+
+    for(index = 0; index < EP_LIMBO_COUNT; index++)
+    {
+        ep_free_limbo(&pepoch->limbo[index]);
+        free(pepoch->limbo[index].pitems);
+        pepoch->limbo[index].pitems = NULL;
+        pepoch->limbo[index].capacity = 0;
+    }
+
+    for(precord = pepoch->precords; NULL != precord; precord = pnext)
+    {
+        pnext = precord->pnext;
+        for(index = 0; index < EP_LIMBO_COUNT; index++)
+        {
+            ep_free_limbo(&precord->limbo[index]);
+            free(precord->limbo[index].pitems);
+        }
+        free(precord);
+    }
+    pepoch->precords = NULL;
+
+    pthread_mutex_destroy(&pepoch->lock);
+}
+
+/************************************************************************************************>
+ * READERS
+ ************************************************************************************************/
+hash_epoch_record_t *ep_register_p(hash_epoch_t *pepoch)
+{
+    hash_epoch_record_t *precord;
+    int index;
+
+    pthread_mutex_lock(&pepoch->lock);
+
+    for(precord = pepoch->precords; NULL != precord; precord = precord->pnext)
+    {
+        if(!precord->in_use) {
+            precord->in_use = 1;
+            pthread_mutex_unlock(&pepoch->lock);
+            return precord;
+        }
+    }
+
+    precord = aligned_alloc(__alignof__(hash_epoch_record_t), sizeof(hash_epoch_record_t));
+    if(NULL == precord) {
+        debug("ep_register_p failed to allocate memory\n");
+        exit(-1);
+    }
+    precord->epoch = 0;
+    precord->pepoch = pepoch;
+    precord->in_use = 1;
+    precord->pending = 0;
+    for(index = 0; index < EP_LIMBO_COUNT; index++)
+    {
+        precord->limbo[index].pitems = NULL;
+        precord->limbo[index].count = 0;
+        precord->limbo[index].capacity = 0;
+        precord->limbo_epoch[index] = 0;
+    }
+    precord->pnext = pepoch->precords;
+
+    // writers walk the list without the lock, the record is complete before it is linked
+    __atomic_store_n(&pepoch->precords, precord, __ATOMIC_RELEASE);
+
+    pthread_mutex_unlock(&pepoch->lock);
+    return precord;
+}
+
+// frees the local limbo lists filled two epochs or more before global
+static void ep_collect_local(hash_epoch_record_t *precord, uint64_t global)
+{
+    int index;
+
+    for(index = 0; index < EP_LIMBO_COUNT; index++)
+    {
+        if(0 != precord->limbo[index].count && precord->limbo_epoch[index] + 2 <= global)
+            ep_free_limbo(&precord->limbo[index]);
+    }
+}
+
+void ep_unregister(hash_epoch_record_t *precord)
+{
+    // what is already safe is freed now, the rest waits for the next user of the record
+    ep_collect_local(precord, __atomic_load_n(&precord->pepoch->global, __ATOMIC_ACQUIRE));
+
+    pthread_mutex_lock(&precord->pepoch->lock);
+    __atomic_store_n(&precord->epoch, 0, __ATOMIC_RELEASE);
+    precord->in_use = 0;
+    pthread_mutex_unlock(&precord->pepoch->lock);
+}
+
+void ep_enter(hash_epoch_record_t *precord)
+{
+    __atomic_store_n(&precord->epoch, __atomic_load_n(&precord->pepoch->global, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELAXED);
+
+    /*! the announcement has to be visible before the first pointer is read,
+        or a writer scanning the records could miss it. A fence, no RMW */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void ep_exit(hash_epoch_record_t *precord)
+{
+    __atomic_store_n(&precord->epoch, 0, __ATOMIC_RELEASE);
+}
+
+/************************************************************************************************>
+ * WRITERS
+ ************************************************************************************************/
+/*! moves the epoch from global to global + 1 if every reader inside one
+    entered global. Several threads may try at once, one of them moves it */
+static int ep_try_advance_i(hash_epoch_t *pepoch, uint64_t global)
+{
+    hash_epoch_record_t *precord;
+    uint64_t epoch;
+
+    // pairs with the fence of ep_enter: the unlinks are visible or the reader is
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    for(precord = __atomic_load_n(&pepoch->precords, __ATOMIC_ACQUIRE); NULL != precord;
+        precord = precord->pnext)
+    {
+        epoch = __atomic_load_n(&precord->epoch, __ATOMIC_ACQUIRE);
+        if(0 != epoch && epoch != global)
+            return 0;
+    }
+
+    return __atomic_compare_exchange_n(&pepoch->global, &global, global + 1, 0,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+void ep_retire(hash_epoch_t *pepoch, void *p, ep_free_t *pfree, void *pctx)
+{
+    hash_epoch_limbo_t *plimbo = &pepoch->limbo[pepoch->global % EP_LIMBO_COUNT];
+    hash_epoch_retired_t *pitems;
+    size_t capacity;
+
+    if(plimbo->count == plimbo->capacity) {
+        capacity = (0 == plimbo->capacity) ? EP_RETIRE_BATCH : plimbo->capacity * 2;
+        pitems = realloc(plimbo->pitems, capacity * sizeof(*pitems));
+        if(NULL == pitems) {
+            // better to wait for the readers than to free under them
+            debug("ep_retire failed to allocate memory, synchronizing\n");
+            ep_synchronize(pepoch);
+            pfree(pctx, p);
+            return;
+        }
+        plimbo->pitems = pitems;
+        plimbo->capacity = capacity;
+    }
+
+    plimbo->pitems[plimbo->count].p = p;
+    plimbo->pitems[plimbo->count].pfree = pfree;
+    plimbo->pitems[plimbo->count].pctx = pctx;
+    plimbo->count++;
+
+    // the records are only scanned every EP_RETIRE_BATCH retirements, advanced or not
+    if(++pepoch->pending >= EP_RETIRE_BATCH) {
+        pepoch->pending = 0;
+        ep_advance_i(pepoch);
+    }
+}
+
+void ep_retire_local(hash_epoch_record_t *precord, void *p, ep_free_t *pfree, void *pctx)
+{
+    hash_epoch_limbo_t *plimbo;
+    hash_epoch_retired_t *pitems;
+    uint64_t global;
+    size_t capacity;
+
+    /*! the pointer is tagged with the global epoch read after it was
+        unlinked, not the one the thread entered: a reader that entered
+        since may still have read it before the unlink */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    global = __atomic_load_n(&precord->pepoch->global, __ATOMIC_ACQUIRE);
+
+    // what was retired two epochs before can go, which empties this epoch's list if it held an older one
+    ep_collect_local(precord, global);
+    precord->limbo_epoch[global % EP_LIMBO_COUNT] = global;
+    plimbo = &precord->limbo[global % EP_LIMBO_COUNT];
+
+    if(plimbo->count == plimbo->capacity) {
+        capacity = (0 == plimbo->capacity) ? EP_RETIRE_BATCH : plimbo->capacity * 2;
+        pitems = realloc(plimbo->pitems, capacity * sizeof(*pitems));
+        if(NULL == pitems) {
+            // leaked rather than freed under a reader, nothing is waited for inside an epoch
+            debug("ep_retire_local failed to allocate memory, leaking\n");
+            return;
+        }
+        plimbo->pitems = pitems;
+        plimbo->capacity = capacity;
+    }
+
+    plimbo->pitems[plimbo->count].p = p;
+    plimbo->pitems[plimbo->count].pfree = pfree;
+    plimbo->pitems[plimbo->count].pctx = pctx;
+    plimbo->count++;
+
+    if(++precord->pending >= EP_RETIRE_BATCH) {
+        precord->pending = 0;
+        ep_try_advance_i(precord->pepoch, global);
+    }
+}
+
+int ep_advance_i(hash_epoch_t *pepoch)
+{
+    uint64_t global = __atomic_load_n(&pepoch->global, __ATOMIC_ACQUIRE);
+
+    if(!ep_try_advance_i(pepoch, global))
+        return 0;
+
+    // retired in global - 1: every reader that could see them has left
+    ep_free_limbo(&pepoch->limbo[(global + 2) % EP_LIMBO_COUNT]);
+    return 1;
+}
+
+void ep_synchronize(hash_epoch_t *pepoch)
+{
+    int advances = 0;
+
+    // each limbo list is freed once along the way
+    while(advances < EP_LIMBO_COUNT)
+    {
+        if(ep_advance_i(pepoch))
+            advances++;
+        else
+            sched_yield();
+    }
+}
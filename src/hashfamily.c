@@ -0,0 +1,212 @@
+/// @cond PRIVATE
+/// @file hashfamily.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashfamily.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define HF_X86
+#endif
+
+/// The multiply-mix constants (odd, with balanced bits, as in wyhash).
+#define HF_P0 0xa0761d6478bd642fULL
+#define HF_P1 0xe7037ed1a0b428dbULL
+#define HF_P2 0x8ebc6af09c88c6e3ULL
+#define HF_P3 0x589965cc75374cc3ULL
+
+/// The reflected CRC32C (Castagnoli) polynomial, the one of the SSE4.2 instruction.
+#define HF_CRC32C_POLY 0x82f63b78U
+
+/************************************************************************************************>
+ * MULTIPLY-MIX
+ ************************************************************************************************/
+static inline uint64_t hf_read64(const uint8_t *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t hf_read32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// 1 to 3 bytes, the first, middle and last one (some of them the same)
+static inline uint64_t hf_read3(const uint8_t *p, size_t size)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[size >> 1] << 8) | p[size - 1];
+}
+
+// the full 128 bit product of a and b, low half in a, high half in b
+static inline void hf_mum(uint64_t *pa, uint64_t *pb)
+{
+    __uint128_t r = (__uint128_t)*pa * *pb;
+    *pa = (uint64_t)r;
+    *pb = (uint64_t)(r >> 64);
+}
+
+static inline uint64_t hf_fold(uint64_t a, uint64_t b)
+{
+    hf_mum(&a, &b);
+    return a ^ b;
+}
+
+/*! reduces a key to a 128 bit state (pa, pb): a key of up to 16 bytes is read as
+    two possibly overlapping words, longer ones are first folded 16 bytes at a time */
+static inline void hf_mix_state(const void *key, int len, uint32_t seed, uint64_t *pa, uint64_t *pb)
+{
+    const uint8_t *p = key;
+    size_t size = (size_t)len;
+    uint64_t s = seed ^ hf_fold(seed ^ HF_P0, HF_P1);
+    uint64_t a;
+    uint64_t b;
+
+    if(size <= 16) {
+        if(size >= 4) {
+            a = (hf_read32(p) << 32) | hf_read32(p + ((size >> 3) << 2));
+            b = (hf_read32(p + size - 4) << 32) | hf_read32(p + size - 4 - ((size >> 3) << 2));
+        }
+        else if(size > 0) {
+            a = hf_read3(p, size);
+            b = 0;
+        }
+        else {
+            a = 0;
+            b = 0;
+        }
+    }
+    else {
+        while(size > 16)
+        {
+            s = hf_fold(hf_read64(p) ^ HF_P1, hf_read64(p + 8) ^ s);
+            p += 16;
+            size -= 16;
+        }
+        // the last 16 bytes, overlapping the ones already folded
+        a = hf_read64(p + size - 16);
+        b = hf_read64(p + size - 8);
+    }
+
+    a ^= HF_P1;
+    b ^= s;
+    hf_mum(&a, &b);
+
+    *pa = a;
+    *pb = b;
+}
+
+void hf_mix_32(const void *key, int len, uint32_t seed, void *out)
+{
+    uint64_t a;
+    uint64_t b;
+
+    hf_mix_state(key, len, seed, &a, &b);
+    *(uint32_t *)out = (uint32_t)hf_fold(a ^ HF_P0 ^ (uint64_t)len, b ^ HF_P1);
+}
+
+void hf_mix_128(const void *key, int len, uint32_t seed, void *out)
+{
+    uint64_t a;
+    uint64_t b;
+
+    hf_mix_state(key, len, seed, &a, &b);
+    ((uint64_t *)out)[0] = hf_fold(a ^ HF_P0 ^ (uint64_t)len, b ^ HF_P1);
+    ((uint64_t *)out)[1] = hf_fold(a ^ HF_P2, b ^ HF_P3 ^ (uint64_t)len);
+}
+
+/************************************************************************************************>
+ * CRC32C
+ ************************************************************************************************/
+// one bit at a time: only used without SSE4.2, where speed is not the point
+static uint32_t hf_crc_sw(uint32_t crc, const uint8_t *p, size_t size)
+{
+    int bit;
+
+    while(size--)
+    {
+        crc ^= *p++;
+        for(bit = 0; bit < 8; bit++)
+            crc = (crc >> 1) ^ (HF_CRC32C_POLY & (0U - (crc & 1)));
+    }
+
+    return crc;
+}
+
+#ifdef HF_X86
+__attribute__((target("sse4.2")))
+static uint32_t hf_crc_hw(uint32_t crc, const uint8_t *p, size_t size)
+{
+    uint64_t crc64 = crc;
+
+    for(; size >= 8; p += 8, size -= 8)
+        crc64 = _mm_crc32_u64(crc64, hf_read64(p));
+    crc = (uint32_t)crc64;
+
+    if(size >= 4) {
+        crc = _mm_crc32_u32(crc, (uint32_t)hf_read32(p));
+        p += 4;
+        size -= 4;
+    }
+    while(size--)
+        crc = _mm_crc32_u8(crc, *p++);
+
+    return crc;
+}
+#endif //HF_X86
+
+// -1 until the cpu is checked on first use
+static int hf_crc_hw_enabled = -1;
+
+int hf_set_crc_hw_i(int enable)
+{
+#ifdef HF_X86
+    __builtin_cpu_init();
+    if(enable && !__builtin_cpu_supports("sse4.2"))
+        return 0;
+#else
+    if(enable)
+        return 0;
+#endif //HF_X86
+
+    hf_crc_hw_enabled = enable ? 1 : 0;
+    return 1;
+}
+
+uint32_t hf_crc32c_ui(uint32_t crc, const void *pdata, size_t size)
+{
+    if(hf_crc_hw_enabled < 0 && !hf_set_crc_hw_i(1))
+        hf_set_crc_hw_i(0);
+
+#ifdef HF_X86
+    if(hf_crc_hw_enabled)
+        return hf_crc_hw(crc, pdata, size);
+#endif //HF_X86
+
+    return hf_crc_sw(crc, pdata, size);
+}
+
+void hf_crc32c_32(const void *key, int len, uint32_t seed, void *out)
+{
+    uint32_t h = hf_crc32c_ui(seed ^ (uint32_t)len, key, (size_t)len);
+
+    /// a crc is linear in its input: one odd multiply and a shift carry every
+    /// bit into the high half (which fastrange and HT_POW2 read)
+    h *= 0x9e3779b1U;
+    h ^= h >> 16;
+    *(uint32_t *)out = h;
+}
+
+void hf_crc32c_128(const void *key, int len, uint32_t seed, void *out)
+{
+    uint64_t v = ((uint64_t)hf_crc32c_ui(seed ^ (uint32_t)len, key, (size_t)len) << 32) |
+                 hf_crc32c_ui(~seed ^ (uint32_t)len, key, (size_t)len);
+
+    ((uint64_t *)out)[0] = hf_fold(v ^ HF_P0, HF_P1);
+    ((uint64_t *)out)[1] = hf_fold(v ^ HF_P2, HF_P3);
+}
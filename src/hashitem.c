@@ -6,9 +6,7 @@
 #include "../inc/hashcore.h"
 #include "../inc/hashfunc.h"
 
-#ifdef __WITH_MURMUR
 #include "../inc/murmur.h"
-#endif //__WITH_MURMUR
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -24,30 +22,103 @@
 #define debug(M, ...)
 #endif
 
+//----------------------------------
+// Allocation
+//----------------------------------
+
+static void *he_alloc_p(hash_arena_t *parena, size_t size)
+{
+    return (NULL != parena) ? ha_alloc_p(parena, size) : malloc(size);
+}
+
+static void he_free(hash_arena_t *parena, void *p, size_t size)
+{
+    if(NULL != parena)
+        ha_free(parena, p, size);
+    else
+        free(p);
+}
+
+//----------------------------------
+// Inline storage
+//----------------------------------
+
+/// Inline bytes are kept 8 byte aligned so that values can be read in place.
+#define HE_ALIGN(size) (((size) + 7) & ~(size_t)7)
+
+static size_t he_inline_key_bytes(int flags, size_t key_size)
+{
+    if((flags & HT_INLINE) && !(flags & HT_KEY_CONST) && key_size <= HT_INLINE_MAX)
+        return HE_ALIGN(key_size);
+
+    return 0;
+}
+
+static size_t he_inline_value_bytes(int flags, size_t value_size)
+{
+    if((flags & HT_INLINE) && !(flags & HT_VALUE_CONST) && value_size <= HT_INLINE_MAX)
+        return HE_ALIGN(value_size);
+
+    return 0;
+}
+
+// the inline key, when there is one, is the first thing after the entry
+static int he_key_is_inline_i(hash_entry_t *pentry)
+{
+    return pentry->key_inline;
+}
+
+// the inline value space follows the inline key, if any
+static void *he_inline_value_p(hash_entry_t *pentry)
+{
+    char *pinline = (char *)(pentry + 1);
+
+    if(he_key_is_inline_i(pentry))
+        pinline += HE_ALIGN(pentry->key_size);
+
+    return pinline;
+}
+
+static int he_value_is_inline_i(hash_entry_t *pentry)
+{
+    return 0 != pentry->value_capacity && pentry->pvalue == he_inline_value_p(pentry);
+}
+
+// the size of the allocation made by he_create_p for this entry
+static size_t he_node_size(hash_entry_t *pentry)
+{
+    size_t size = sizeof(hash_entry_t) + pentry->value_capacity;
+
+    if(he_key_is_inline_i(pentry))
+        size += HE_ALIGN(pentry->key_size);
+
+    return size;
+}
+
 //----------------------------------
 // HashEntry functions
 //----------------------------------
 
-hash_entry_t *he_create_p(int flags, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+/*! fills an entry that has key_bytes and value_bytes of inline space
+    after it (none for he_fill_i), copying what does not fit to the heap */
+static int he_fill_inline_i(int flags, hash_arena_t *parena, hash_entry_t *pentry, void *pkey, size_t key_size,
+                            void *pvalue, size_t value_size, size_t key_bytes, size_t value_bytes)
 {
     //-----------------------------------------------------------------------------
-    hash_entry_t *pentry = malloc(sizeof(hash_entry_t));
-    if(NULL == pentry) {
-        debug("Failed to create hash_entry_t\n");
-        return NULL;
+    pentry->key_size = (uint32_t)key_size;
+    pentry->key_inline = (0 != key_bytes);
+    if (key_bytes) {
+        pentry->pkey = pentry + 1;
+        memcpy(pentry->pkey, pkey, key_size);
     }
-
-    //-----------------------------------------------------------------------------
-    pentry->key_size = key_size;
-    if (flags & HT_KEY_CONST){
+    else if (flags & HT_KEY_CONST){
         pentry->pkey = pkey;
     }
     else {
-        pentry->pkey = malloc(key_size);
+        pentry->pkey = he_alloc_p(parena, key_size);
         if(NULL == pentry->pkey) {
-            debug("Failed to create hash_entry_t\n");
-            free(pentry);
-            return NULL;
+            debug("Failed to fill hash_entry_t\n");
+            return 0;
         }
 
         memcpy(pentry->pkey, pkey, key_size);
@@ -55,16 +126,21 @@ hash_entry_t *he_create_p(int flags, void *pkey, size_t key_size, void *pvalue,
 
     //-----------------------------------------------------------------------------
     pentry->value_size = value_size;
-    if (flags & HT_VALUE_CONST){
+    pentry->value_capacity = (uint16_t)value_bytes;
+    if (value_bytes) {
+        pentry->pvalue = (char *)(pentry + 1) + key_bytes;
+        memcpy(pentry->pvalue, pvalue, value_size);
+    }
+    else if (flags & HT_VALUE_CONST){
         pentry->pvalue = pvalue;
     }
     else {
-        pentry->pvalue = malloc(value_size);
+        pentry->pvalue = he_alloc_p(parena, value_size);
         if(NULL == pentry->pvalue) {
-            debug("Failed to create hash_entry_t\n");
-            free(pentry->pkey);
-            free(pentry);
-            return NULL;
+            debug("Failed to fill hash_entry_t\n");
+            if (!(flags & HT_KEY_CONST) && !key_bytes)
+                he_free(parena, pentry->pkey, key_size);
+            return 0;
         }
 
         memcpy(pentry->pvalue, pvalue, value_size);
@@ -73,20 +149,124 @@ hash_entry_t *he_create_p(int flags, void *pkey, size_t key_size, void *pvalue,
     //-----------------------------------------------------------------------------
     pentry->pnext = NULL;
 
-    return pentry;
+    return 1;
+}
+
+int he_fill_i(int flags, hash_arena_t *parena, hash_entry_t *pentry, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    return he_fill_inline_i(flags, parena, pentry, pkey, key_size, pvalue, value_size, 0, 0);
 }
 
-void he_destroy(int flags, hash_entry_t *pentry)
+void he_release(int flags, hash_arena_t *parena, hash_entry_t *pentry)
 {
+    if (!(flags & HT_KEY_CONST) && !he_key_is_inline_i(pentry))
+        he_free(parena, pentry->pkey, pentry->key_size);
+
+    if (!(flags & HT_VALUE_CONST) && !he_value_is_inline_i(pentry))
+        he_free(parena, pentry->pvalue, pentry->value_size);
+}
+
+int he_move_i(int flags, hash_arena_t *parena, hash_entry_t *pdst, hash_entry_t *psrc)
+{
+    // inline bytes go away with the node, so they are copied out first
+    if(he_key_is_inline_i(psrc) || he_value_is_inline_i(psrc)) {
+        if(!he_fill_i(flags, parena, pdst, psrc->pkey, psrc->key_size, psrc->pvalue, psrc->value_size))
+            return 0;
+
+        he_destroy(flags, parena, psrc);
+        return 1;
+    }
+
+    *pdst = *psrc;
+    pdst->pnext = NULL;
+    pdst->value_capacity = 0;
+    he_free(parena, psrc, he_node_size(psrc));
+    return 1;
+}
+
+hash_entry_t *he_create_p(int flags, hash_arena_t *parena, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    size_t key_bytes = he_inline_key_bytes(flags, key_size);
+    size_t value_bytes = he_inline_value_bytes(flags, value_size);
+
     //-----------------------------------------------------------------------------
-    if (!(flags & HT_KEY_CONST))
-        free(pentry->pkey);
+    // a single allocation holds the entry and its inline key and value
+    hash_entry_t *pentry = he_alloc_p(parena, sizeof(hash_entry_t) + key_bytes + value_bytes);
+    if(NULL == pentry) {
+        debug("Failed to create hash_entry_t\n");
+        return NULL;
+    }
+
+    //-----------------------------------------------------------------------------
+    if(!he_fill_inline_i(flags, parena, pentry, pkey, key_size, pvalue, value_size, key_bytes, value_bytes)) {
+        debug("Failed to create hash_entry_t\n");
+        he_free(parena, pentry, sizeof(hash_entry_t) + key_bytes + value_bytes);
+        return NULL;
+    }
 
-    if (!(flags & HT_VALUE_CONST))
-        free(pentry->pvalue);
+    return pentry;
+}
+
+// adds count allocations of size to the reservations, merging equal size classes
+static void he_reserve_add(size_t *psizes, size_t *pcounts, unsigned int *pused, size_t size, size_t count)
+{
+    unsigned int index;
 
+    for(index = 0; index < *pused; index++)
+    {
+        if((psizes[index] + HA_CLASS_SIZE - 1) / HA_CLASS_SIZE == (size + HA_CLASS_SIZE - 1) / HA_CLASS_SIZE) {
+            pcounts[index] += count;
+            return;
+        }
+    }
+
+    psizes[*pused] = size;
+    pcounts[*pused] = count;
+    (*pused)++;
+}
+
+void he_reserve(int flags, hash_arena_t *parena, size_t key_size, size_t value_size, size_t count)
+{
+    size_t key_bytes = he_inline_key_bytes(flags, key_size);
+    size_t value_bytes = he_inline_value_bytes(flags, value_size);
+    size_t sizes[3];
+    size_t counts[3];
+    unsigned int used = 0;
+    unsigned int index;
+
+    if(NULL == parena)
+        return;
+
+    he_reserve_add(sizes, counts, &used, sizeof(hash_entry_t) + key_bytes + value_bytes, count);
+    if(!key_bytes && !(flags & HT_KEY_CONST))
+        he_reserve_add(sizes, counts, &used, key_size, count);
+    if(!value_bytes && !(flags & HT_VALUE_CONST))
+        he_reserve_add(sizes, counts, &used, value_size, count);
+
+    for(index = 0; index < used; index++)
+        ha_reserve_i(parena, sizes[index], counts[index]);
+}
+
+void he_bytes(int flags, hash_entry_t *pentry, size_t *pkey_bytes, size_t *pvalue_bytes)
+{
+    if(he_key_is_inline_i(pentry))
+        *pkey_bytes += HE_ALIGN(pentry->key_size);
+    else if(!(flags & HT_KEY_CONST))
+        *pkey_bytes += pentry->key_size;
+
+    // the inline space stays reserved when a larger value went to the heap
+    *pvalue_bytes += pentry->value_capacity;
+    if(!(flags & HT_VALUE_CONST) && !he_value_is_inline_i(pentry))
+        *pvalue_bytes += pentry->value_size;
+}
+
+void he_destroy(int flags, hash_arena_t *parena, hash_entry_t *pentry)
+{
     //-----------------------------------------------------------------------------
-    free(pentry);
+    he_release(flags, parena, pentry);
+
+    //-----------------------------------------------------------------------------
+    he_free(parena, pentry, he_node_size(pentry));
 }
 
 int he_key_compare_i(hash_entry_t *pe1, hash_entry_t *pe2)
@@ -100,19 +280,29 @@ int he_key_compare_i(hash_entry_t *pe1, hash_entry_t *pe2)
     return (memcmp(k1,k2,pe1->key_size) == 0);
 }
 
-void he_set_value(int flags, hash_entry_t *pentry, void *pvalue, size_t value_size)
+void he_set_value(int flags, hash_arena_t *parena, hash_entry_t *pentry, void *pvalue, size_t value_size)
 {
     if (!(flags & HT_VALUE_CONST)) {
-        if(pentry->pvalue)
-            free(pentry->pvalue);
+        // the inline space is reused whenever the new value fits in it
+        if(value_size <= pentry->value_capacity) {
+            if(!he_value_is_inline_i(pentry))
+                he_free(parena, pentry->pvalue, pentry->value_size);
 
-        pentry->pvalue = malloc(value_size);
-        if(NULL == pentry->pvalue) {
-            debug("Failed to set pentry pvalue\n");
-            return;
-        }
+            pentry->pvalue = he_inline_value_p(pentry);
+            memmove(pentry->pvalue, pvalue, value_size);
 
-        memcpy(pentry->pvalue, pvalue, value_size);
+        } else {
+            if(pentry->pvalue && !he_value_is_inline_i(pentry))
+                he_free(parena, pentry->pvalue, pentry->value_size);
+
+            pentry->pvalue = he_alloc_p(parena, value_size);
+            if(NULL == pentry->pvalue) {
+                debug("Failed to set pentry pvalue\n");
+                return;
+            }
+
+            memcpy(pentry->pvalue, pvalue, value_size);
+        }
 
     } else {
         pentry->pvalue = pvalue;
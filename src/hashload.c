@@ -0,0 +1,410 @@
+/// @cond PRIVATE
+/// @file hashload.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashload.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+// the records a chunk has room for before its arrays first grow
+#define HL_INITIAL_RECORDS 4096
+
+/// A chunk of the file and the records parsed from it.
+typedef struct hl_chunk {
+    /// The offset of the first byte of the chunk.
+    uint64_t begin;
+    /// The offset past its last byte, on a record boundary (with HL_BINARY,
+    /// the offset the parse walks up to until it is parsed).
+    uint64_t end;
+    void **ppkeys;
+    size_t *pkey_sizes;
+    void **ppvalues;
+    size_t *pvalue_sizes;
+    /// The number of records parsed.
+    size_t count;
+    /// The size of the arrays.
+    size_t capacity;
+    /// The number of records skipped.
+    size_t skipped;
+    /// 1 once parsed, 0 again once inserted.
+    int ready;
+} hl_chunk_t;
+
+/// What the parse threads and the inserting thread share.
+typedef struct hl_pipeline {
+    uint8_t *pbase;
+    uint64_t size;
+    hash_load_format_t format;
+    char delimiter;
+    /// Where the next chunk starts.
+    uint64_t next_offset;
+    /// 0 while next_offset waits for the parse of the chunk before (HL_BINARY).
+    int next_known;
+    /// The number of chunks handed to a parse thread.
+    size_t claimed;
+    /// The number of chunks inserted.
+    size_t inserted;
+    /// Chunk n in slot n % HL_WINDOW.
+    hl_chunk_t chunks[HL_WINDOW];
+    pthread_mutex_t lock;
+    /// Signaled when a chunk is parsed or inserted.
+    pthread_cond_t cond;
+} hl_pipeline_t;
+
+/************************************************************************************************>
+ * RECORDS
+ ************************************************************************************************/
+/*! reads the record at offset and returns the offset of the next one.
+    *pvalid is 1 for a record, -1 for an empty line, and 0 for a line
+    without the delimiter or a binary record cut short (the end of the
+    file follows it) */
+static uint64_t hl_next_ul(hl_pipeline_t *pp, uint64_t offset, void **ppkey, size_t *pkey_size, void **ppvalue,
+                           size_t *pvalue_size, int *pvalid)
+{
+    uint8_t *precord = pp->pbase + offset;
+    uint8_t *pfound;
+    uint32_t sizes[2];
+    uint64_t next;
+    size_t length;
+
+    if(HL_BINARY == pp->format) {
+        *pvalid = 0;
+        if(pp->size - offset < sizeof(sizes))
+            return pp->size;
+        memcpy(sizes, precord, sizeof(sizes));
+        if((uint64_t)sizes[0] + sizes[1] > pp->size - offset - sizeof(sizes))
+            return pp->size;
+
+        *ppkey = precord + sizeof(sizes);
+        *pkey_size = sizes[0];
+        *ppvalue = precord + sizeof(sizes) + sizes[0];
+        *pvalue_size = sizes[1];
+        *pvalid = 1;
+        return offset + sizeof(sizes) + sizes[0] + sizes[1];
+    }
+
+    pfound = memchr(precord, '\n', pp->size - offset);
+    length = (NULL != pfound) ? (size_t)(pfound - precord) : pp->size - offset;
+    next = offset + length + (NULL != pfound);
+    if(0 != length && '\r' == precord[length - 1])
+        length--;
+
+    *pvalid = -1;
+    if(0 == length)
+        return next;
+
+    *pvalid = 0;
+    pfound = memchr(precord, pp->delimiter, length);
+    if(NULL == pfound)
+        return next;
+
+    *ppkey = precord;
+    *pkey_size = (size_t)(pfound - precord);
+    *ppvalue = pfound + 1;
+    *pvalue_size = length - *pkey_size - 1;
+    *pvalid = 1;
+    return next;
+}
+
+/*! the number of records the file holds, going by those of its first
+    HL_SAMPLE_BYTES */
+static size_t hl_estimate_sz(hl_pipeline_t *pp)
+{
+    uint64_t end = (pp->size < HL_SAMPLE_BYTES) ? pp->size : HL_SAMPLE_BYTES;
+    uint64_t offset = 0;
+    size_t records = 0;
+    size_t key_size;
+    size_t value_size;
+    void *pkey;
+    void *pvalue;
+    int valid;
+
+    while(offset < end)
+    {
+        offset = hl_next_ul(pp, offset, &pkey, &key_size, &pvalue, &value_size, &valid);
+        records += (1 == valid);
+    }
+
+    return (size_t)((double)records * pp->size / offset);
+}
+
+/*! the end of the chunk starting at begin, the first record boundary
+    HL_CHUNK_BYTES or more past it. A line ends right after its '\n', but a
+    binary record is only found from the one before: for HL_BINARY this is
+    the offset the parse walks up to, the boundary past it is where the walk
+    stops (see hl_parse) */
+static uint64_t hl_chunk_end_ul(hl_pipeline_t *pp, uint64_t begin)
+{
+    uint64_t target = begin + HL_CHUNK_BYTES;
+    uint8_t *pfound;
+
+    if(target >= pp->size)
+        return pp->size;
+
+    if(HL_BINARY == pp->format)
+        return target;
+
+    pfound = memchr(pp->pbase + target - 1, '\n', pp->size - target + 1);
+    return (NULL != pfound) ? (uint64_t)(pfound - pp->pbase) + 1 : pp->size;
+}
+
+/************************************************************************************************>
+ * PIPELINE
+ ************************************************************************************************/
+static void hl_chunk_grow(hl_chunk_t *pchunk)
+{
+    size_t capacity = (0 == pchunk->capacity) ? HL_INITIAL_RECORDS : pchunk->capacity * 2;
+
+    pchunk->ppkeys = realloc(pchunk->ppkeys, capacity * sizeof(void *));
+    pchunk->pkey_sizes = realloc(pchunk->pkey_sizes, capacity * sizeof(size_t));
+    pchunk->ppvalues = realloc(pchunk->ppvalues, capacity * sizeof(void *));
+    pchunk->pvalue_sizes = realloc(pchunk->pvalue_sizes, capacity * sizeof(size_t));
+    if(NULL == pchunk->ppkeys || NULL == pchunk->pkey_sizes || NULL == pchunk->ppvalues ||
+       NULL == pchunk->pvalue_sizes) {
+        debug("hl_chunk_grow failed to allocate memory\n");
+        exit(-1);
+    }
+    pchunk->capacity = capacity;
+}
+
+static void hl_parse(hl_pipeline_t *pp, hl_chunk_t *pchunk)
+{
+    uint64_t offset = pchunk->begin;
+    size_t key_size;
+    size_t value_size;
+    void *pkey;
+    void *pvalue;
+    int valid;
+
+    pchunk->count = 0;
+    pchunk->skipped = 0;
+
+    while(offset < pchunk->end)
+    {
+        offset = hl_next_ul(pp, offset, &pkey, &key_size, &pvalue, &value_size, &valid);
+        if(valid <= 0) {
+            pchunk->skipped += (0 == valid);
+            continue;
+        }
+
+        if(pchunk->count == pchunk->capacity)
+            hl_chunk_grow(pchunk);
+        pchunk->ppkeys[pchunk->count] = pkey;
+        pchunk->pkey_sizes[pchunk->count] = key_size;
+        pchunk->ppvalues[pchunk->count] = pvalue;
+        pchunk->pvalue_sizes[pchunk->count] = value_size;
+        pchunk->count++;
+    }
+
+    // the boundary the walk stopped on, past the end of a binary chunk
+    pchunk->end = offset;
+}
+
+/*! claims the next chunk and parses it, unless the file is done, the
+    start of the next chunk isn't known yet or HL_WINDOW chunks already wait
+    for the inserting thread. Called, and returns, with the lock held.
+    Returns 1 if it parsed a chunk */
+static int hl_parse_next_i(hl_pipeline_t *pp)
+{
+    hl_chunk_t *pchunk;
+
+    if(!pp->next_known || pp->next_offset >= pp->size || pp->claimed - pp->inserted >= HL_WINDOW)
+        return 0;
+
+    pchunk = &pp->chunks[pp->claimed % HL_WINDOW];
+    pp->claimed++;
+    pchunk->begin = pp->next_offset;
+    pchunk->end = hl_chunk_end_ul(pp, pchunk->begin);
+    pp->next_offset = pchunk->end;
+    /// the next binary chunk starts where the parse of this one stops, the
+    /// records are walked once and outside the lock
+    pp->next_known = (HL_BINARY != pp->format);
+    pthread_mutex_unlock(&pp->lock);
+
+    hl_parse(pp, pchunk);
+
+    pthread_mutex_lock(&pp->lock);
+    if(HL_BINARY == pp->format) {
+        pp->next_offset = pchunk->end;
+        pp->next_known = 1;
+    }
+    pchunk->ready = 1;
+    pthread_cond_broadcast(&pp->cond);
+    return 1;
+}
+
+static void *hl_parse_run(void *parg)
+{
+    hl_pipeline_t *pp = parg;
+
+    pthread_mutex_lock(&pp->lock);
+    while(pp->next_offset < pp->size)
+    {
+        if(!hl_parse_next_i(pp))
+            pthread_cond_wait(&pp->cond, &pp->lock);
+    }
+    pthread_mutex_unlock(&pp->lock);
+
+    return NULL;
+}
+
+/*! inserts the chunks in file order as they are parsed, parsing them
+    itself if no parse thread could be started */
+static void hl_insert_all(hl_pipeline_t *pp, hash_table_t *ptable, hash_load_t *pload, int parsers)
+{
+    hl_chunk_t *pchunk;
+    size_t index;
+
+    for(index = 0; ; index++)
+    {
+        pchunk = &pp->chunks[index % HL_WINDOW];
+
+        pthread_mutex_lock(&pp->lock);
+        while(!pchunk->ready && (pp->next_offset < pp->size || index < pp->claimed))
+        {
+            if(0 != parsers || !hl_parse_next_i(pp))
+                pthread_cond_wait(&pp->cond, &pp->lock);
+        }
+        pthread_mutex_unlock(&pp->lock);
+        if(!pchunk->ready)
+            break;
+
+        ht_insert_batch(ptable, pchunk->ppkeys, pchunk->pkey_sizes, pchunk->ppvalues, pchunk->pvalue_sizes,
+                        pchunk->count);
+        pload->record_count += pchunk->count;
+        pload->skipped += pchunk->skipped;
+
+        pthread_mutex_lock(&pp->lock);
+        pchunk->ready = 0;
+        pp->inserted++;
+        pthread_cond_broadcast(&pp->cond);
+        pthread_mutex_unlock(&pp->lock);
+    }
+}
+
+/************************************************************************************************>
+ * LOAD
+ ************************************************************************************************/
+int hl_load_i(hash_load_t *pload, hash_table_t *ptable, const char *ppath, hash_load_format_t format,
+              char delimiter, size_t thread_count)
+{
+    hl_pipeline_t *pp;
+    pthread_t *pids;
+    int *pstarted;
+    struct stat st;
+    uint8_t *pbase;
+    size_t index;
+    int parsers = 0;
+    int fd;
+
+    pload->pbase = NULL;
+    pload->size = 0;
+    pload->record_count = 0;
+    pload->skipped = 0;
+
+    fd = open(ppath, O_RDONLY);
+    if(fd < 0) {
+        debug("hl_load_i could not open %s\n", ppath);
+        return 0;
+    }
+    if(0 != fstat(fd, &st)) {
+        close(fd);
+        return 0;
+    }
+    if(0 == st.st_size) {
+        close(fd);
+        return 1;
+    }
+
+    /// private pages: a value written through ht_get_p is copied, never stored back
+    pbase = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(MAP_FAILED == pbase) {
+        debug("hl_load_i could not map %s\n", ppath);
+        return 0;
+    }
+    madvise(pbase, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    if(0 == thread_count)
+        thread_count = HL_PARSE_THREADS;
+    pp = calloc(1, sizeof(*pp));
+    pids = malloc(thread_count * sizeof(*pids));
+    pstarted = malloc(thread_count * sizeof(*pstarted));
+    if(NULL == pp || NULL == pids || NULL == pstarted) {
+        debug("hl_load_i failed to allocate memory\n");
+        exit(-1);
+    }
+    pp->pbase = pbase;
+    pp->size = (uint64_t)st.st_size;
+    pp->format = format;
+    pp->delimiter = delimiter;
+    pp->next_known = 1;
+    pthread_mutex_init(&pp->lock, NULL);
+    pthread_cond_init(&pp->cond, NULL);
+
+    ht_reserve(ptable, ptable->key_count + hl_estimate_sz(pp));
+
+    for(index = 0; index < thread_count; index++)
+    {
+        pstarted[index] = (0 == pthread_create(&pids[index], NULL, hl_parse_run, pp));
+        parsers += pstarted[index];
+    }
+    hl_insert_all(pp, ptable, pload, parsers);
+    for(index = 0; index < thread_count; index++)
+    {
+        if(pstarted[index])
+            pthread_join(pids[index], NULL);
+    }
+    debug("hl_load_i: %zu records, %zu skipped\n", pload->record_count, pload->skipped);
+
+    for(index = 0; index < HL_WINDOW; index++)
+    {
+        free(pp->chunks[index].ppkeys);
+        free(pp->chunks[index].pkey_sizes);
+        free(pp->chunks[index].ppvalues);
+        free(pp->chunks[index].pvalue_sizes);
+    }
+    pthread_cond_destroy(&pp->cond);
+    pthread_mutex_destroy(&pp->lock);
+    free(pp);
+    free(pids);
+    free(pstarted);
+
+    // constant entries point into the mapping, the other ones were copied
+    if(ptable->flags & (HT_KEY_CONST | HT_VALUE_CONST)) {
+        pload->pbase = pbase;
+        pload->size = (size_t)st.st_size;
+    }
+    else
+        munmap(pbase, (size_t)st.st_size);
+
+    return 1;
+}
+
+void hl_unmap(hash_load_t *pload)
+{
+    if(NULL == pload->pbase)
+        return;
+
+    munmap(pload->pbase, pload->size);
+    pload->pbase = NULL;
+    pload->size = 0;
+}
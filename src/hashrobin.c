@@ -0,0 +1,303 @@
+/// @cond PRIVATE
+/// @file hashrobin.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashrobin.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/************************************************************************************************>
+ * PLACEMENT
+ ************************************************************************************************/
+/*! walks from index, swapping the carried slot with any slot that sits closer to
+    its home than the carried one would (robin hood), until an empty slot is found.
+    No key comparison is done: the caller made sure the key is not in the table */
+static void rh_place(hash_table_t *ptable, hash_slot_t carry, size_t index)
+{
+    hash_slot_t tmp;
+    hash_slot_t *pslot;
+
+    for(;;)
+    {
+        pslot = &ptable->pslots[index];
+        if(0 == pslot->dist)
+        {
+            *pslot = carry;
+            if(carry.dist > 1)
+                ptable->collisions++;
+            return;
+        }
+
+        if(pslot->dist < carry.dist)
+        {
+            if(carry.dist > 1)
+                ptable->collisions++;
+            if(pslot->dist > 1)
+                ptable->collisions--;
+
+            tmp = *pslot;
+            *pslot = carry;
+            carry = tmp;
+        }
+
+        index = (index + 1 == ptable->array_size) ? 0 : index + 1;
+        carry.dist++;
+    }
+}
+
+static hash_slot_t *rh_lookup_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    size_t index = ht_bucket_sz(ptable, hash);
+    uint32_t dist = 1;
+    hash_slot_t *pslot;
+
+    hash_entry_t tmp;
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    /*! an entry can't be further from home than the slots it was walked over,
+        so the walk ends on the first slot that is poorer than the probe (or empty) */
+    for(;;)
+    {
+        pslot = &ptable->pslots[index];
+        if(pslot->dist < dist)
+            return NULL;
+
+        if(pslot->entry.hash == hash && he_key_compare_i(&pslot->entry, &tmp))
+            return pslot;
+
+        index = (index + 1 == ptable->array_size) ? 0 : index + 1;
+        dist++;
+    }
+}
+
+// grows the table before an insert if the load (or the lack of room) requires it
+static void rh_reserve(hash_table_t *ptable)
+{
+    if(ptable->key_count + 1 >= ptable->array_size) {
+        debug("rh_reserve: table is full, growing it\n");
+        rh_resize(ptable, ptable->array_size * 2);
+    }
+    else if(!(ptable->flags & HT_NO_AUTORESIZE) &&
+            (ptable->key_count + 1 > ptable->array_size * HT_ROBIN_MAX_LOAD)) {
+        rh_resize(ptable, ptable->array_size * 2);
+    }
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void rh_init(hash_table_t *ptable)
+{
+    ptable->pslots = calloc(ptable->array_size, sizeof(*(ptable->pslots)));
+    if(NULL == ptable->pslots) {
+        debug("rh_init failed to allocate memory\n");
+        exit(-1);
+    }
+}
+
+void rh_destroy(hash_table_t *ptable)
+{
+    size_t index;
+
+    if(NULL == ptable->pslots) {
+        debug("rh_destroy got a bad ptable\n");
+        return;
+    }
+
+    // keys and values allocated from an arena are freed with it
+    for(index = 0; NULL == ptable->parena && index < ptable->array_size; index++)
+    {
+        if(0 != ptable->pslots[index].dist)
+            he_release(ptable->flags, ptable->parena, &ptable->pslots[index].entry);
+    }
+
+    free(ptable->pslots);
+    ptable->pslots = NULL;
+}
+
+void rh_resize(hash_table_t *ptable, size_t new_size)
+{
+    hash_slot_t *pold = ptable->pslots;
+    size_t old_size = ptable->array_size;
+    size_t index;
+    hash_slot_t slot;
+    uint64_t start = ht_clock_ul();
+
+    if(new_size <= ptable->key_count)
+        new_size = ptable->key_count + 1;
+    new_size = ht_capacity_sz(ptable, new_size);
+
+    debug("rh_resize(old=%zu, new=%zu)\n", old_size, new_size);
+    ptable->pslots = calloc(new_size, sizeof(*(ptable->pslots)));
+    if(NULL == ptable->pslots) {
+        debug("rh_resize failed to allocate memory\n");
+        ptable->pslots = pold;
+        return;
+    }
+
+    ptable->array_size = new_size;
+    ptable->collisions = 0;
+
+    // the hash is kept in the entry, so moving never calls the hash function
+    for(index = 0; index < old_size; index++)
+    {
+        if(0 == pold[index].dist)
+            continue;
+
+        slot = pold[index];
+        slot.dist = 1;
+        rh_place(ptable, slot, ht_bucket_sz(ptable, slot.entry.hash));
+    }
+
+    free(pold);
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+    ht_resize_done(ptable, start);
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+void rh_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    rh_insert_hash(ptable, ht_hash_ul(ptable, pkey, key_size), pkey, key_size, pvalue, value_size);
+}
+
+void rh_insert_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hash_slot_t *pslot = rh_lookup_p(ptable, hash, pkey, key_size);
+    hash_slot_t carry;
+
+    if(NULL != pslot) {
+        he_set_value(ptable->flags, ptable->parena, &pslot->entry, pvalue, value_size);
+        return;
+    }
+
+    rh_reserve(ptable);
+
+    if(!he_fill_i(ptable->flags, ptable->parena, &carry.entry, pkey, key_size, pvalue, value_size)) {
+        debug("rh_insert failed to allocate memory\n");
+        return;
+    }
+
+    carry.entry.hash = hash;
+    carry.dist = 1;
+    rh_place(ptable, carry, ht_bucket_sz(ptable, hash));
+
+    ptable->key_count++;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+void rh_he_insert(hash_table_t *ptable, hash_entry_t *pentry)
+{
+    uint64_t hash = ht_hash_ul(ptable, pentry->pkey, pentry->key_size);
+    hash_slot_t *pslot = rh_lookup_p(ptable, hash, pentry->pkey, pentry->key_size);
+    hash_slot_t carry;
+
+    if(NULL != pslot) {
+        he_set_value(ptable->flags, ptable->parena, &pslot->entry, pentry->pvalue, pentry->value_size);
+        he_destroy(ptable->flags, ptable->parena, pentry);
+        return;
+    }
+
+    rh_reserve(ptable);
+
+    // the slot takes over the key and value, only the node itself goes away
+    if(!he_move_i(ptable->flags, ptable->parena, &carry.entry, pentry)) {
+        debug("rh_he_insert failed to allocate memory\n");
+        he_destroy(ptable->flags, ptable->parena, pentry);
+        return;
+    }
+
+    carry.entry.hash = hash;
+    carry.dist = 1;
+
+    rh_place(ptable, carry, ht_bucket_sz(ptable, hash));
+
+    ptable->key_count++;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+hash_slot_t *rh_find_p(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    return rh_lookup_p(ptable, ht_hash_ul(ptable, pkey, key_size), pkey, key_size);
+}
+
+hash_slot_t *rh_find_hash_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    return rh_lookup_p(ptable, hash, pkey, key_size);
+}
+
+void rh_prefetch(hash_table_t *ptable, uint64_t hash)
+{
+    __builtin_prefetch(&ptable->pslots[ht_bucket_sz(ptable, hash)]);
+}
+
+void rh_remove(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    rh_remove_hash(ptable, ht_hash_ul(ptable, pkey, key_size), pkey, key_size);
+}
+
+void rh_remove_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    hash_slot_t *pslot = rh_lookup_p(ptable, hash, pkey, key_size);
+    size_t index;
+    size_t next;
+
+    if(NULL == pslot)
+        return;
+
+    he_release(ptable->flags, ptable->parena, &pslot->entry);
+    if(pslot->dist > 1)
+        ptable->collisions--;
+    ptable->key_count--;
+
+    /*! backward shift: pull every following displaced slot one step closer
+        to its home, which keeps the table free of tombstones */
+    index = (size_t)(pslot - ptable->pslots);
+    next = (index + 1 == ptable->array_size) ? 0 : index + 1;
+    while(ptable->pslots[next].dist > 1)
+    {
+        ptable->pslots[index] = ptable->pslots[next];
+        ptable->pslots[index].dist--;
+        if(1 == ptable->pslots[index].dist)
+            ptable->collisions--;
+
+        index = next;
+        next = (index + 1 == ptable->array_size) ? 0 : index + 1;
+    }
+    ptable->pslots[index].dist = 0;
+
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+size_t rh_miss_probes_sz(hash_table_t *ptable)
+{
+    size_t total = 0;
+    size_t home;
+    size_t index;
+    uint32_t dist;
+
+    // the walk of rh_lookup_p, which no key ends early
+    for(home = 0; home < ptable->array_size; home++)
+    {
+        index = home;
+        for(dist = 1; ptable->pslots[index].dist >= dist; dist++)
+            index = (index + 1 == ptable->array_size) ? 0 : index + 1;
+        total += dist;
+    }
+
+    return total;
+}
@@ -0,0 +1,219 @@
+/// @cond PRIVATE
+/// @file hashshard.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashshard.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void hs_init(hash_table_sharded_t *phs, hash_flags_t flags, double max_load_factor, size_t shard_count
+#ifndef __WITH_MURMUR
+        , HashFunc *for_x86_32, HashFunc *for_x86_128, HashFunc *for_x64_128
+#endif //__WITH_MURMUR
+)
+{
+    size_t index;
+
+    // lookups of an incremental resize move buckets, which a read lock can't cover
+    flags &= ~HT_INCREMENTAL;
+
+    if(0 == shard_count)
+        shard_count = HS_SHARD_COUNT;
+    for(phs->shard_bits = 0; ((size_t)1 << phs->shard_bits) < shard_count; phs->shard_bits++)
+        ;
+    phs->shard_count = (size_t)1 << phs->shard_bits;
+
+    phs->pshards = aligned_alloc(__alignof__(hash_shard_t), phs->shard_count * sizeof(hash_shard_t));
+    if(NULL == phs->pshards) {
+        debug("hs_init failed to allocate memory\n");
+        exit(-1);
+    }
+
+    for(index = 0; index < phs->shard_count; index++)
+    {
+        pthread_rwlock_init(&phs->pshards[index].lock, NULL);
+        ht_init(&phs->pshards[index].table, flags, max_load_factor
+#       ifndef __WITH_MURMUR
+                , for_x86_32, for_x86_128, for_x64_128
+#       endif //__WITH_MURMUR
+                );
+    }
+}
+
+void hs_destroy(hash_table_sharded_t *phs)
+{
+    size_t index;
+
+    if(NULL == phs->pshards) {
+        debug("hs_destroy got a bad phs\n");
+        return;
+    }
+
+    for(index = 0; index < phs->shard_count; index++)
+    {
+        ht_destroy(&phs->pshards[index].table);
+        pthread_rwlock_destroy(&phs->pshards[index].lock);
+    }
+
+    free(phs->pshards);
+    phs->pshards = NULL;
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+/*! the shard of a key and the hash its table uses, so that the key is hashed
+    once: every shard hashes the same way, the first one stands for all */
+static hash_shard_t *hs_shard_code_p(hash_table_sharded_t *phs, void *pkey, size_t key_size, hash_code_t *pcode)
+{
+    uint64_t hash;
+
+    ht_hash_code(&phs->pshards[0].table, pkey, key_size, pcode);
+    hash = pcode->hash;
+
+    if(1 == phs->shard_count)
+        return phs->pshards;
+
+    /// the engines read the high bits of the hash, a bijective remix (the
+    /// murmur 64 bit finalizer) keeps them spread within each shard
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    hash *= UINT64_C(0xc4ceb9fe1a85ec53);
+    hash ^= hash >> 33;
+
+    return &phs->pshards[hash >> (64 - phs->shard_bits)];
+}
+
+hash_shard_t *hs_shard_p(hash_table_sharded_t *phs, void *pkey, size_t key_size)
+{
+    hash_code_t code;
+
+    return hs_shard_code_p(phs, pkey, key_size, &code);
+}
+
+void hs_insert(hash_table_sharded_t *phs, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hash_code_t code;
+    hash_shard_t *pshard = hs_shard_code_p(phs, pkey, key_size, &code);
+
+    pthread_rwlock_wrlock(&pshard->lock);
+    ht_insert_hashed(&pshard->table, &code, pkey, key_size, pvalue, value_size);
+    pthread_rwlock_unlock(&pshard->lock);
+}
+
+int hs_get_i(hash_table_sharded_t *phs, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size)
+{
+    hash_code_t code;
+    hash_shard_t *pshard = hs_shard_code_p(phs, pkey, key_size, &code);
+    size_t value_size = 0;
+    void *pfound;
+
+    pthread_rwlock_rdlock(&pshard->lock);
+
+    pfound = ht_get_hashed_p(&pshard->table, &code, pkey, key_size, &value_size);
+    if(NULL != pfound && NULL != pvalue_size) {
+        if(NULL != pvalue)
+            memcpy(pvalue, pfound, (value_size < *pvalue_size) ? value_size : *pvalue_size);
+        *pvalue_size = value_size;
+    }
+
+    pthread_rwlock_unlock(&pshard->lock);
+    return NULL != pfound;
+}
+
+int hs_contains_i(hash_table_sharded_t *phs, void *pkey, size_t key_size)
+{
+    hash_code_t code;
+    hash_shard_t *pshard = hs_shard_code_p(phs, pkey, key_size, &code);
+    int found;
+
+    pthread_rwlock_rdlock(&pshard->lock);
+    found = ht_contains_hashed_i(&pshard->table, &code, pkey, key_size);
+    pthread_rwlock_unlock(&pshard->lock);
+
+    return found;
+}
+
+void hs_remove(hash_table_sharded_t *phs, void *pkey, size_t key_size)
+{
+    hash_code_t code;
+    hash_shard_t *pshard = hs_shard_code_p(phs, pkey, key_size, &code);
+
+    pthread_rwlock_wrlock(&pshard->lock);
+    ht_remove_hashed(&pshard->table, &code, pkey, key_size);
+    pthread_rwlock_unlock(&pshard->lock);
+}
+
+/************************************************************************************************>
+ * UTILS
+ ************************************************************************************************/
+size_t hs_size_sz(hash_table_sharded_t *phs)
+{
+    size_t count = 0;
+    size_t index;
+
+    for(index = 0; index < phs->shard_count; index++)
+    {
+        pthread_rwlock_rdlock(&phs->pshards[index].lock);
+        count += ht_size_sz(&phs->pshards[index].table);
+        pthread_rwlock_unlock(&phs->pshards[index].lock);
+    }
+
+    return count;
+}
+
+void **hs_keys_pp(hash_table_sharded_t *phs, size_t *pkey_count)
+{
+    void **ppret = NULL;
+    void **ppkeys;
+    size_t total = 0;
+    size_t count;
+    size_t index;
+
+    *pkey_count = 0;
+
+    // every shard stays locked, the keys are those of a single moment
+    for(index = 0; index < phs->shard_count; index++)
+    {
+        pthread_rwlock_rdlock(&phs->pshards[index].lock);
+        total += ht_size_sz(&phs->pshards[index].table);
+    }
+
+    if(0 != total) {
+        ppret = malloc(total * sizeof(void *));
+        if(NULL == ppret) {
+            debug("hs_keys_pp failed to allocate memory\n");
+        }
+    }
+
+    for(index = 0; index < phs->shard_count; index++)
+    {
+        if(NULL != ppret) {
+            ppkeys = ht_keys_pp_sz(&phs->pshards[index].table, &count);
+            if(NULL != ppkeys)
+                memcpy(ppret + *pkey_count, ppkeys, count * sizeof(void *));
+            *pkey_count += (NULL != ppkeys) ? count : 0;
+            free(ppkeys);
+        }
+        pthread_rwlock_unlock(&phs->pshards[index].lock);
+    }
+
+    return ppret;
+}
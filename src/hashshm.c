@@ -0,0 +1,480 @@
+/// @cond PRIVATE
+/// @file hashshm.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashshm.h"
+#include "../inc/hashfamily.h"
+#include "../inc/murmur.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+// keys and values start on 8 bytes
+#define HM_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+
+// the first block, past the header
+#define HM_START ((sizeof(hash_shm_header_t) + HM_MIN_BLOCK - 1) & ~(uint64_t)(HM_MIN_BLOCK - 1))
+
+/************************************************************************************************>
+ * SEGMENT ALLOCATOR
+ ************************************************************************************************/
+// the smallest class holding size bytes, HM_CLASS_COUNT if none does
+static int hm_class_i(uint64_t size)
+{
+    int size_class = 0;
+
+    while(size_class < HM_CLASS_COUNT && ((uint64_t)HM_MIN_BLOCK << size_class) < size)
+        size_class++;
+    return size_class;
+}
+
+/*! the offset of a block of the class, from its free list or else from
+    the top of the segment. 0 if the segment is full */
+static uint64_t hm_alloc_ul(hash_table_shm_t *phm, int size_class)
+{
+    hash_shm_header_t *pheader = phm->pheader;
+    uint64_t block = (uint64_t)HM_MIN_BLOCK << size_class;
+    uint64_t offset;
+
+    if(size_class >= HM_CLASS_COUNT)
+        return 0;
+
+    offset = pheader->free_lists[size_class];
+    if(0 != offset) {
+        pheader->free_lists[size_class] = *(uint64_t *)(phm->pbase + offset);
+        return offset;
+    }
+
+    if(block > pheader->size - pheader->top)
+        return 0;
+    offset = pheader->top;
+    pheader->top += block;
+    return offset;
+}
+
+// blocks are never merged, a freed one only serves its own class again
+static void hm_free(hash_table_shm_t *phm, uint64_t offset, int size_class)
+{
+    *(uint64_t *)(phm->pbase + offset) = phm->pheader->free_lists[size_class];
+    phm->pheader->free_lists[size_class] = offset;
+}
+
+/************************************************************************************************>
+ * LAYOUT
+ ************************************************************************************************/
+static hash_shm_record_t *hm_record_p(hash_table_shm_t *phm, uint64_t offset)
+{
+    return (hash_shm_record_t *)(phm->pbase + offset);
+}
+
+static uint64_t *hm_buckets_p(hash_table_shm_t *phm)
+{
+    return (uint64_t *)(phm->pbase + phm->pheader->buckets);
+}
+
+static uint64_t hm_hash_ul(hash_table_shm_t *phm, void *pkey, size_t key_size)
+{
+    uint64_t out[2];
+
+    phm->phashfunc(pkey, (int)key_size, phm->pheader->seed, out);
+    return out[0];
+}
+
+// the hash function is the segment's, whatever process maps it
+static void hm_attach(hash_table_shm_t *phm, uint8_t *pbase, size_t size)
+{
+    phm->pbase = pbase;
+    phm->pheader = (hash_shm_header_t *)pbase;
+    phm->size = size;
+
+    if(phm->pheader->flags & HT_HASH_MIX)
+        phm->phashfunc = hf_mix_128;
+    else if(phm->pheader->flags & HT_HASH_CRC32C)
+        phm->phashfunc = hf_crc32c_128;
+    else
+        phm->phashfunc = MurmurHash3_x64_128;
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+int hm_create_i(hash_table_shm_t *phm, const char *pname, size_t size, hash_flags_t flags)
+{
+    hash_shm_header_t *pheader;
+    pthread_mutexattr_t attr;
+    uint8_t *pbase;
+    int fd;
+
+    if(size < HM_START + (sizeof(uint64_t) << HM_INITIAL_BITS)) {
+        debug("hm_create_i: %zu bytes can't hold a table\n", size);
+        return 0;
+    }
+
+    fd = shm_open(pname, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0) {
+        debug("hm_create_i could not create %s\n", pname);
+        return 0;
+    }
+    if(0 != ftruncate(fd, (off_t)size)) {
+        debug("hm_create_i could not size %s\n", pname);
+        close(fd);
+        shm_unlink(pname);
+        return 0;
+    }
+    pbase = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(MAP_FAILED == pbase) {
+        debug("hm_create_i could not map %s\n", pname);
+        shm_unlink(pname);
+        return 0;
+    }
+
+    /// the segment starts zeroed: no keys, empty free lists
+    pheader = (hash_shm_header_t *)pbase;
+    pheader->version = HM_VERSION;
+    pheader->flags = flags & (HT_HASH_MIX | HT_HASH_CRC32C);
+    pheader->seed = ht_get_seed_ui();
+    pheader->size = size;
+    pheader->top = HM_START;
+
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutex_init(&pheader->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+
+    hm_attach(phm, pbase, size);
+    pheader->buckets = hm_alloc_ul(phm, hm_class_i(sizeof(uint64_t) << HM_INITIAL_BITS));
+    pheader->bucket_bits = HM_INITIAL_BITS;
+
+    // a process opening the segment meanwhile finds no magic and fails
+    __atomic_store_n(&pheader->magic, HM_MAGIC, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int hm_open_i(hash_table_shm_t *phm, const char *pname)
+{
+    hash_shm_header_t *pheader;
+    struct stat st;
+    uint8_t *pbase;
+    size_t size;
+    int fd;
+
+    fd = shm_open(pname, O_RDWR, 0);
+    if(fd < 0) {
+        debug("hm_open_i could not open %s\n", pname);
+        return 0;
+    }
+    if(0 != fstat(fd, &st) || (size_t)st.st_size < HM_START) {
+        debug("hm_open_i: %s is too short\n", pname);
+        close(fd);
+        return 0;
+    }
+
+    size = (size_t)st.st_size;
+    pbase = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(MAP_FAILED == pbase) {
+        debug("hm_open_i could not map %s\n", pname);
+        return 0;
+    }
+
+    pheader = (hash_shm_header_t *)pbase;
+    if(HM_MAGIC != __atomic_load_n(&pheader->magic, __ATOMIC_ACQUIRE) || HM_VERSION != pheader->version ||
+       pheader->size != size) {
+        debug("hm_open_i: %s holds no table\n", pname);
+        munmap(pbase, size);
+        return 0;
+    }
+
+    hm_attach(phm, pbase, size);
+    return 1;
+}
+
+void hm_close(hash_table_shm_t *phm)
+{
+    if(NULL == phm->pbase) {
+        debug("hm_close got a bad phm\n");
+        return;
+    }
+
+    munmap(phm->pbase, phm->size);
+    phm->pbase = NULL;
+    phm->pheader = NULL;
+}
+
+int hm_unlink_i(const char *pname)
+{
+    return 0 == shm_unlink(pname);
+}
+
+/************************************************************************************************>
+ * WRITERS
+ ************************************************************************************************/
+static void hm_write_begin(hash_shm_header_t *pheader)
+{
+    pthread_mutex_lock(&pheader->lock);
+    __atomic_store_n(&pheader->sequence, pheader->sequence + 1, __ATOMIC_RELAXED);
+
+    // the odd sequence is visible before any of the changes it covers
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void hm_write_end(hash_shm_header_t *pheader)
+{
+    __atomic_store_n(&pheader->sequence, pheader->sequence + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pheader->lock);
+}
+
+// the link (bucket or next field) to the record of the key, holding 0 if there is none
+static uint64_t *hm_link_p(hash_table_shm_t *phm, uint64_t hash, void *pkey, size_t key_size)
+{
+    uint64_t *plink = &hm_buckets_p(phm)[hash >> (64 - phm->pheader->bucket_bits)];
+    hash_shm_record_t *precord;
+
+    while(0 != *plink)
+    {
+        precord = hm_record_p(phm, *plink);
+        if(precord->hash == hash && precord->key_size == key_size && 0 == memcmp(precord + 1, pkey, key_size))
+            break;
+        plink = &precord->next;
+    }
+
+    return plink;
+}
+
+/*! doubles the buckets if the segment has room for them, the chains only
+    growing longer otherwise */
+static void hm_grow(hash_table_shm_t *phm)
+{
+    hash_shm_header_t *pheader = phm->pheader;
+    uint32_t bits = pheader->bucket_bits + 1;
+    uint64_t buckets = hm_alloc_ul(phm, hm_class_i(sizeof(uint64_t) << bits));
+    hash_shm_record_t *precord;
+    uint64_t *pold = hm_buckets_p(phm);
+    uint64_t *pnew;
+    uint64_t offset;
+    uint64_t next;
+    size_t bucket;
+    size_t index;
+
+    if(0 == buckets) {
+        debug("hm_grow: no room to grow the buckets\n");
+        return;
+    }
+
+    pnew = (uint64_t *)(phm->pbase + buckets);
+    memset(pnew, 0, sizeof(uint64_t) << bits);
+    for(bucket = 0; bucket < ((size_t)1 << (bits - 1)); bucket++)
+    {
+        for(offset = pold[bucket]; 0 != offset; offset = next)
+        {
+            precord = hm_record_p(phm, offset);
+            next = precord->next;
+            index = precord->hash >> (64 - bits);
+            precord->next = pnew[index];
+            pnew[index] = offset;
+        }
+    }
+
+    hm_free(phm, pheader->buckets, hm_class_i(sizeof(uint64_t) << (bits - 1)));
+    pheader->buckets = buckets;
+    pheader->bucket_bits = bits;
+}
+
+int hm_insert_i(hash_table_shm_t *phm, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hash_shm_header_t *pheader = phm->pheader;
+    uint64_t hash = hm_hash_ul(phm, pkey, key_size);
+    int size_class = hm_class_i(sizeof(hash_shm_record_t) + HM_ALIGN(key_size) + value_size);
+    hash_shm_record_t *precord;
+    hash_shm_record_t *pold;
+    uint64_t *plink;
+    uint64_t offset;
+
+    hm_write_begin(pheader);
+
+    plink = hm_link_p(phm, hash, pkey, key_size);
+    pold = (0 != *plink) ? hm_record_p(phm, *plink) : NULL;
+
+    /// a new value that fits the key's block is written over the old one
+    if(NULL != pold && size_class <= (int)pold->size_class) {
+        memcpy((uint8_t *)(pold + 1) + HM_ALIGN(key_size), pvalue, value_size);
+        pold->value_size = value_size;
+        hm_write_end(pheader);
+        return 1;
+    }
+
+    offset = hm_alloc_ul(phm, size_class);
+    if(0 == offset) {
+        debug("hm_insert_i: the segment is full\n");
+        hm_write_end(pheader);
+        return 0;
+    }
+
+    precord = hm_record_p(phm, offset);
+    precord->hash = hash;
+    precord->next = (NULL != pold) ? pold->next : 0;
+    precord->value_size = value_size;
+    precord->key_size = (uint32_t)key_size;
+    precord->size_class = (uint32_t)size_class;
+    memcpy(precord + 1, pkey, key_size);
+    memcpy((uint8_t *)(precord + 1) + HM_ALIGN(key_size), pvalue, value_size);
+
+    /// the record takes the place of the old one, or ends the chain
+    if(NULL != pold)
+        hm_free(phm, *plink, (int)pold->size_class);
+    *plink = offset;
+
+    if(NULL == pold && ++pheader->key_count > ((uint64_t)1 << pheader->bucket_bits) * HM_MAX_LOAD)
+        hm_grow(phm);
+
+    hm_write_end(pheader);
+    return 1;
+}
+
+void hm_remove(hash_table_shm_t *phm, void *pkey, size_t key_size)
+{
+    hash_shm_header_t *pheader = phm->pheader;
+    uint64_t hash = hm_hash_ul(phm, pkey, key_size);
+    hash_shm_record_t *precord;
+    uint64_t *plink;
+    uint64_t offset;
+
+    hm_write_begin(pheader);
+
+    plink = hm_link_p(phm, hash, pkey, key_size);
+    if(0 != *plink) {
+        offset = *plink;
+        precord = hm_record_p(phm, offset);
+        *plink = precord->next;
+        hm_free(phm, offset, (int)precord->size_class);
+        pheader->key_count--;
+    }
+
+    hm_write_end(pheader);
+}
+
+/************************************************************************************************>
+ * READERS
+ ************************************************************************************************/
+/*! looks the key up and copies its value, once. A writer may be changing
+    anything meanwhile: every field is read once, and every offset and size
+    checked against the segment before use. Returns 1 if found, 0 if not,
+    -1 if what was read can't be the table (the caller retries) */
+static int hm_lookup_i(hash_table_shm_t *phm, uint64_t hash, void *pkey, size_t key_size, void *pvalue,
+                       size_t capacity, size_t *pvalue_size)
+{
+    hash_shm_header_t *pheader = phm->pheader;
+    uint32_t bits = __atomic_load_n(&pheader->bucket_bits, __ATOMIC_RELAXED);
+    uint64_t buckets = __atomic_load_n(&pheader->buckets, __ATOMIC_RELAXED);
+    hash_shm_record_t *precord;
+    uint64_t value_size;
+    uint64_t offset;
+    uint64_t room;
+    size_t steps;
+
+    if(0 == bits || bits > 48 || buckets < HM_START || buckets > phm->size ||
+       (sizeof(uint64_t) << bits) > phm->size - buckets)
+        return -1;
+
+    offset = __atomic_load_n(&((uint64_t *)(phm->pbase + buckets))[hash >> (64 - bits)], __ATOMIC_RELAXED);
+    for(steps = 0; 0 != offset; steps++)
+    {
+        /// a chain longer than the segment has blocks loops through freed ones
+        if(offset < HM_START || offset % sizeof(uint64_t) || offset > phm->size - sizeof(*precord) ||
+           steps > phm->size / HM_MIN_BLOCK)
+            return -1;
+
+        precord = hm_record_p(phm, offset);
+        if(__atomic_load_n(&precord->hash, __ATOMIC_RELAXED) == hash &&
+           __atomic_load_n(&precord->key_size, __ATOMIC_RELAXED) == key_size) {
+            room = phm->size - offset - sizeof(*precord);
+            value_size = __atomic_load_n(&precord->value_size, __ATOMIC_RELAXED);
+            if(HM_ALIGN(key_size) > room || value_size > room - HM_ALIGN(key_size))
+                return -1;
+
+            if(0 == memcmp(precord + 1, pkey, key_size)) {
+                if(NULL != pvalue)
+                    memcpy(pvalue, (uint8_t *)(precord + 1) + HM_ALIGN(key_size),
+                           (value_size < capacity) ? value_size : capacity);
+                *pvalue_size = value_size;
+                return 1;
+            }
+        }
+        offset = __atomic_load_n(&precord->next, __ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+/*! hm_lookup_i until it ran between two writes: the sequence, even
+    before, is the same after */
+static int hm_read_i(hash_table_shm_t *phm, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size)
+{
+    hash_shm_header_t *pheader = phm->pheader;
+    uint64_t hash = hm_hash_ul(phm, pkey, key_size);
+    size_t capacity = (NULL != pvalue_size) ? *pvalue_size : 0;
+    size_t value_size = 0;
+    uint64_t sequence;
+    int found;
+
+    for(;;)
+    {
+        sequence = __atomic_load_n(&pheader->sequence, __ATOMIC_ACQUIRE);
+        if(sequence & 1) {
+            sched_yield();
+            continue;
+        }
+
+        found = hm_lookup_i(phm, hash, pkey, key_size, pvalue, capacity, &value_size);
+
+        // the reads of the lookup are done before the sequence is read again
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if(found >= 0 && sequence == __atomic_load_n(&pheader->sequence, __ATOMIC_RELAXED))
+            break;
+    }
+
+    if(found && NULL != pvalue_size)
+        *pvalue_size = value_size;
+    return found;
+}
+
+int hm_get_i(hash_table_shm_t *phm, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size)
+{
+    return hm_read_i(phm, pkey, key_size, pvalue, pvalue_size);
+}
+
+int hm_contains_i(hash_table_shm_t *phm, void *pkey, size_t key_size)
+{
+    return hm_read_i(phm, pkey, key_size, NULL, NULL);
+}
+
+/************************************************************************************************>
+ * UTILS
+ ************************************************************************************************/
+size_t hm_size_sz(hash_table_shm_t *phm)
+{
+    return (size_t)__atomic_load_n(&phm->pheader->key_count, __ATOMIC_RELAXED);
+}
+
+size_t hm_used_sz(hash_table_shm_t *phm)
+{
+    return (size_t)__atomic_load_n(&phm->pheader->top, __ATOMIC_RELAXED);
+}
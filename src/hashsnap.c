@@ -0,0 +1,311 @@
+/// @cond PRIVATE
+/// @file hashsnap.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashsnap.h"
+#include "../inc/hashfamily.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+// keys and values start on 8 bytes
+#define SN_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+
+/************************************************************************************************>
+ * LAYOUT
+ ************************************************************************************************/
+// the bucket of a hash, the same in every snapshot whatever the engine of the table
+static size_t sn_bucket_sz(int flags, uint64_t hash, uint64_t bucket_count)
+{
+    return ht_reduce_sz(HT_FASTRANGE | (flags & HT_HASH64), hash, bucket_count);
+}
+
+static uint64_t sn_record_size_ul(size_t key_size, size_t value_size)
+{
+    return sizeof(hash_snapshot_record_t) + SN_ALIGN(key_size) + SN_ALIGN(value_size);
+}
+
+// the CRC32C of the header, header_crc counting as 0
+static uint32_t sn_header_crc_ui(const hash_snapshot_header_t *pheader)
+{
+    hash_snapshot_header_t copy = *pheader;
+
+    copy.header_crc = 0;
+    return hf_crc32c_ui(~0u, &copy, sizeof(copy));
+}
+
+/************************************************************************************************>
+ * SAVE
+ ************************************************************************************************/
+/// What ht_save_i carries through its two walks of the table.
+typedef struct sn_save {
+    hash_table_t *ptable;
+    uint64_t bucket_count;
+    /// First the bytes of each bucket, then where its next record goes.
+    uint64_t *pcursors;
+    /// The offset past the last record of each bucket.
+    uint64_t *pends;
+    /// The file being written.
+    uint8_t *pbase;
+} sn_save_t;
+
+// first walk: the bytes each bucket takes (the hashes are those the table stored)
+static void sn_save_size(void *pstate, uint64_t hash, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    sn_save_t *psave = pstate;
+
+    (void) pkey;
+    (void) pvalue;
+    psave->pcursors[sn_bucket_sz(psave->ptable->flags, hash, psave->bucket_count)] +=
+        sn_record_size_ul(key_size, value_size);
+}
+
+// second walk: each record in its bucket's space, linked to the one written after it
+static void sn_save_record(void *pstate, uint64_t hash, void *pkey, size_t key_size, void *pvalue,
+                           size_t value_size)
+{
+    sn_save_t *psave = pstate;
+    size_t bucket = sn_bucket_sz(psave->ptable->flags, hash, psave->bucket_count);
+    uint64_t offset = psave->pcursors[bucket];
+    hash_snapshot_record_t *precord = (hash_snapshot_record_t *)(psave->pbase + offset);
+
+    psave->pcursors[bucket] += sn_record_size_ul(key_size, value_size);
+
+    precord->hash = hash;
+    precord->next = (psave->pcursors[bucket] < psave->pends[bucket]) ? psave->pcursors[bucket] : 0;
+    precord->value_size = value_size;
+    precord->key_size = (uint32_t)key_size;
+    precord->value_offset = (uint32_t)(sizeof(*precord) + SN_ALIGN(key_size));
+    memcpy(precord + 1, pkey, key_size);
+    memcpy((uint8_t *)precord + precord->value_offset, pvalue, value_size);
+}
+
+/*! fills the file fd, already size bytes long, through a shared mapping:
+    the bucket offsets, the records then the header. Returns 1 once it is
+    synced */
+static int sn_write_i(sn_save_t *psave, int fd, uint64_t size)
+{
+    hash_snapshot_header_t *pheader;
+    uint64_t *pbuckets;
+    uint64_t bucket;
+    int written;
+
+    psave->pbase = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(MAP_FAILED == psave->pbase) {
+        debug("sn_write_i could not map the file\n");
+        return 0;
+    }
+
+    pbuckets = (uint64_t *)(psave->pbase + sizeof(hash_snapshot_header_t));
+    for(bucket = 0; bucket < psave->bucket_count; bucket++)
+        pbuckets[bucket] = (psave->pcursors[bucket] != psave->pends[bucket]) ? psave->pcursors[bucket] : 0;
+    ht_foreach_hash(psave->ptable, sn_save_record, psave);
+
+    pheader = (hash_snapshot_header_t *)psave->pbase;
+    memset(pheader, 0, sizeof(*pheader));
+    pheader->magic = SN_MAGIC;
+    pheader->version = SN_VERSION;
+    pheader->flags = (uint32_t)psave->ptable->flags;
+    pheader->seed = ht_get_seed_ui();
+    pheader->probe_hash = ht_hash_ul(psave->ptable, SN_PROBE_KEY, sizeof(SN_PROBE_KEY) - 1);
+    pheader->key_count = psave->ptable->key_count;
+    pheader->bucket_count = psave->bucket_count;
+    pheader->file_size = size;
+    pheader->body_crc = hf_crc32c_ui(~0u, psave->pbase + sizeof(*pheader), size - sizeof(*pheader));
+    pheader->header_crc = sn_header_crc_ui(pheader);
+
+    written = (0 == msync(psave->pbase, size, MS_SYNC));
+    munmap(psave->pbase, size);
+    return written;
+}
+
+int ht_save_i(hash_table_t *ptable, const char *ppath)
+{
+    sn_save_t save;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t bucket;
+    size_t path_size = strlen(ppath);
+    char *ptmp = malloc(path_size + sizeof(".tmp"));
+    int saved = 0;
+    int fd;
+
+    save.ptable = ptable;
+    save.bucket_count = (0 != ptable->key_count) ? ptable->key_count : 1;
+    save.pcursors = calloc(save.bucket_count, sizeof(uint64_t));
+    save.pends = malloc(save.bucket_count * sizeof(uint64_t));
+
+    if(NULL != ptmp && NULL != save.pcursors && NULL != save.pends) {
+        /// the records of a bucket go one after the other, past the header and the bucket offsets
+        ht_foreach_hash(ptable, sn_save_size, &save);
+        offset = sizeof(hash_snapshot_header_t) + save.bucket_count * sizeof(uint64_t);
+        for(bucket = 0; bucket < save.bucket_count; bucket++)
+        {
+            size = save.pcursors[bucket];
+            save.pcursors[bucket] = offset;
+            offset += size;
+            save.pends[bucket] = offset;
+        }
+
+        /// the file only takes its name once every byte of it is on disk
+        memcpy(ptmp, ppath, path_size);
+        memcpy(ptmp + path_size, ".tmp", sizeof(".tmp"));
+        fd = open(ptmp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if(fd >= 0) {
+            saved = (0 == ftruncate(fd, (off_t)offset) && sn_write_i(&save, fd, offset));
+            close(fd);
+            saved = saved && (0 == rename(ptmp, ppath));
+            if(!saved)
+                unlink(ptmp);
+        }
+        if(!saved) {
+            debug("ht_save_i could not write %s\n", ppath);
+        }
+    }
+    else {
+        debug("ht_save_i failed to allocate memory\n");
+    }
+
+    free(ptmp);
+    free(save.pcursors);
+    free(save.pends);
+    return saved;
+}
+
+/************************************************************************************************>
+ * LOAD
+ ************************************************************************************************/
+int ht_load_i(hash_table_t *ptable, const char *ppath, int verify)
+{
+    hash_snapshot_header_t *pheader;
+    hash_snapshot_t *psnap;
+    struct stat st;
+    uint8_t *pbase;
+    size_t size;
+    int valid;
+    int fd;
+
+    // the log could not replay contents it never saw
+    if(NULL != ptable->pwal) {
+        debug("ht_load_i can't replace the contents of a table with a log attached\n");
+        return 0;
+    }
+
+    fd = open(ppath, O_RDONLY);
+    if(fd < 0) {
+        debug("ht_load_i could not open %s\n", ppath);
+        return 0;
+    }
+    if(0 != fstat(fd, &st) || (size_t)st.st_size < sizeof(hash_snapshot_header_t)) {
+        debug("ht_load_i: %s is too short\n", ppath);
+        close(fd);
+        return 0;
+    }
+
+    /// private pages: a value written through ht_get_p is copied, never stored back
+    size = (size_t)st.st_size;
+    pbase = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(MAP_FAILED == pbase) {
+        debug("ht_load_i could not map %s\n", ppath);
+        return 0;
+    }
+
+    pheader = (hash_snapshot_header_t *)pbase;
+    valid = SN_MAGIC == pheader->magic && SN_VERSION == pheader->version &&
+            pheader->header_crc == sn_header_crc_ui(pheader) && pheader->file_size == size &&
+            0 != pheader->bucket_count &&
+            pheader->bucket_count <= (size - sizeof(*pheader)) / sizeof(uint64_t) &&
+            pheader->probe_hash == ht_hash_ul(ptable, SN_PROBE_KEY, sizeof(SN_PROBE_KEY) - 1);
+    if(valid && verify)
+        valid = pheader->body_crc == hf_crc32c_ui(~0u, pbase + sizeof(*pheader), size - sizeof(*pheader));
+
+    psnap = valid ? malloc(sizeof(*psnap)) : NULL;
+    if(NULL == psnap) {
+        debug("ht_load_i: %s is not a snapshot of this table\n", ppath);
+        munmap(pbase, size);
+        return 0;
+    }
+
+    // lookups jump from bucket to record, read-ahead would only fetch pages nobody asked for
+    madvise(pbase, size, MADV_RANDOM);
+
+    psnap->pbase = pbase;
+    psnap->size = size;
+    psnap->pbuckets = (uint64_t *)(pbase + sizeof(*pheader));
+    psnap->bucket_count = pheader->bucket_count;
+    psnap->key_count = pheader->key_count;
+    psnap->thawing = 0;
+    psnap->thawed = 0;
+
+    ht_clear(ptable);
+    ptable->key_count = psnap->key_count;
+    __atomic_store_n(&ptable->psnapshot, psnap, __ATOMIC_RELEASE);
+    return 1;
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+void *sn_get_p(hash_snapshot_t *psnap, int flags, uint64_t hash, void *pkey, size_t key_size, size_t *pvalue_size)
+{
+    hash_snapshot_record_t *precord;
+    uint64_t offset = psnap->pbuckets[sn_bucket_sz(flags, hash, psnap->bucket_count)];
+
+    while(0 != offset)
+    {
+        precord = (hash_snapshot_record_t *)(psnap->pbase + offset);
+        if(precord->hash == hash && precord->key_size == key_size && 0 == memcmp(precord + 1, pkey, key_size)) {
+            if(NULL != pvalue_size)
+                *pvalue_size = precord->value_size;
+            return (uint8_t *)precord + precord->value_offset;
+        }
+        offset = precord->next;
+    }
+
+    return NULL;
+}
+
+void sn_foreach_range(hash_snapshot_t *psnap, size_t begin, size_t end, ht_visit_t *pvisit,
+                      ht_visit_hash_t *pvisit_hash, void *pstate)
+{
+    hash_snapshot_record_t *precord;
+    uint64_t offset;
+    size_t bucket;
+
+    for(bucket = begin; bucket < end; bucket++)
+    {
+        for(offset = psnap->pbuckets[bucket]; 0 != offset; offset = precord->next)
+        {
+            precord = (hash_snapshot_record_t *)(psnap->pbase + offset);
+            if(NULL != pvisit)
+                pvisit(pstate, precord + 1, precord->key_size, (uint8_t *)precord + precord->value_offset,
+                       precord->value_size);
+            else
+                pvisit_hash(pstate, precord->hash, precord + 1, precord->key_size,
+                            (uint8_t *)precord + precord->value_offset, precord->value_size);
+        }
+    }
+}
+
+void sn_unmap(hash_snapshot_t *psnap)
+{
+    munmap(psnap->pbase, psnap->size);
+    free(psnap);
+}
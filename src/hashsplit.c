@@ -0,0 +1,448 @@
+/// @cond PRIVATE
+/// @file hashsplit.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashsplit.h"
+#include "../inc/hashfamily.h"
+#include "../inc/murmur.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/// The flags sentinels are created and destroyed with: no key, no value.
+#define SO_SENTINEL_FLAGS (HT_KEY_CONST | HT_VALUE_CONST)
+
+/************************************************************************************************>
+ * SPLIT ORDER
+ ************************************************************************************************/
+// the bits of x in the reverse order
+static uint64_t so_reverse_ul(uint64_t x)
+{
+    x = ((x >> 1) & UINT64_C(0x5555555555555555)) | ((x & UINT64_C(0x5555555555555555)) << 1);
+    x = ((x >> 2) & UINT64_C(0x3333333333333333)) | ((x & UINT64_C(0x3333333333333333)) << 2);
+    x = ((x >> 4) & UINT64_C(0x0f0f0f0f0f0f0f0f)) | ((x & UINT64_C(0x0f0f0f0f0f0f0f0f)) << 4);
+    return __builtin_bswap64(x);
+}
+
+/*! the sort key of an entry, stored in its hash field: the reversed hash
+    with the low bit set, which puts it after the sentinel of its bucket
+    (reversed bucket, low bit clear) whatever the number of buckets */
+static uint64_t so_regular_key_ul(uint64_t hash)
+{
+    return so_reverse_ul(hash | (UINT64_C(1) << 63));
+}
+
+static uint64_t so_sentinel_key_ul(uint64_t bucket)
+{
+    return so_reverse_ul(bucket);
+}
+
+static int so_is_sentinel_i(hash_entry_t *pentry)
+{
+    return 0 == (pentry->hash & 1);
+}
+
+//----------------------------------
+// Marked pointers
+//----------------------------------
+
+// the next pointer of a deleted entry has its low bit set
+static int so_marked_i(hash_entry_t *pentry)
+{
+    return (uintptr_t)pentry & 1;
+}
+
+static hash_entry_t *so_mark_p(hash_entry_t *pentry)
+{
+    return (hash_entry_t *)((uintptr_t)pentry | 1);
+}
+
+static hash_entry_t *so_unmark_p(hash_entry_t *pentry)
+{
+    return (hash_entry_t *)((uintptr_t)pentry & ~(uintptr_t)1);
+}
+
+static uint64_t so_hash_ul(hash_table_split_t *pso, void *pkey, size_t key_size)
+{
+    uint64_t out[2];
+
+    pso->phashfunc(pkey, (int)key_size, ht_get_seed_ui(), out);
+    return out[0];
+}
+
+// frees an entry once no thread can reach it
+static void so_free_entry(void *pctx, void *p)
+{
+    hash_table_split_t *pso = pctx;
+
+    he_destroy(pso->flags, NULL, p);
+}
+
+/************************************************************************************************>
+ * LIST
+ ************************************************************************************************/
+/*! finds the entry of a sort key (and key, for regular entries) in the list,
+    starting at a sentinel before it. Sets *pppprev to the link that points
+    at the entry, or at the first one after it if there is none, and *ppcur
+    to that entry. Deleted entries met on the way are unlinked and retired;
+    if a link changes under the walk, it starts over */
+static int so_find_i(hash_table_split_t *pso, hash_epoch_record_t *precord, hash_entry_t *phead,
+                     uint64_t sort_key, void *pkey, size_t key_size,
+                     hash_entry_t ***pppprev, hash_entry_t **ppcur)
+{
+    hash_entry_t **ppprev;
+    hash_entry_t *pcur;
+    hash_entry_t *pnext;
+    hash_entry_t tmp;
+    int restart;
+
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    for(;;)
+    {
+        ppprev = &phead->pnext;
+        pcur = __atomic_load_n(ppprev, __ATOMIC_ACQUIRE);
+        restart = 0;
+
+        while(!restart)
+        {
+            if(NULL == pcur)
+                break;
+
+            pnext = __atomic_load_n(&pcur->pnext, __ATOMIC_ACQUIRE);
+
+            // the link was changed, or its entry deleted, since pcur was read from it
+            if(__atomic_load_n(ppprev, __ATOMIC_ACQUIRE) != pcur) {
+                restart = 1;
+                continue;
+            }
+
+            if(so_marked_i(pnext)) {
+                if(!__atomic_compare_exchange_n(ppprev, &pcur, so_unmark_p(pnext), 0,
+                                                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                    restart = 1;
+                    continue;
+                }
+                ep_retire_local(precord, pcur, so_free_entry, pso);
+                pcur = so_unmark_p(pnext);
+                continue;
+            }
+
+            if(pcur->hash > sort_key)
+                break;
+            if(pcur->hash == sort_key && (so_is_sentinel_i(pcur) || he_key_compare_i(pcur, &tmp))) {
+                *pppprev = ppprev;
+                *ppcur = pcur;
+                return 1;
+            }
+
+            ppprev = &pcur->pnext;
+            pcur = pnext;
+        }
+
+        if(!restart) {
+            *pppprev = ppprev;
+            *ppcur = pcur;
+            return 0;
+        }
+    }
+}
+
+/************************************************************************************************>
+ * BUCKETS
+ ************************************************************************************************/
+/*! the slot of a bucket in its segment, the segment being allocated on first
+    use. Racing threads allocate one each, the first to publish it wins */
+static hash_entry_t **so_slot_pp(hash_table_split_t *pso, uint64_t bucket)
+{
+    hash_entry_t **psegment;
+    hash_entry_t **pexpected = NULL;
+    size_t segment = 0;
+    size_t size = (size_t)1 << SO_INITIAL_BITS;
+    uint64_t first = 0;
+    int high;
+
+    if(bucket >= ((uint64_t)1 << SO_INITIAL_BITS)) {
+        high = 63 - __builtin_clzll(bucket);
+        segment = (size_t)(high - SO_INITIAL_BITS + 1);
+        first = (uint64_t)1 << high;
+        size = (size_t)first;
+    }
+
+    psegment = __atomic_load_n(&pso->ppsegments[segment], __ATOMIC_ACQUIRE);
+    if(NULL == psegment) {
+        psegment = calloc(size, sizeof(hash_entry_t *));
+        if(NULL == psegment) {
+            debug("so_slot_pp failed to allocate memory\n");
+            exit(-1);
+        }
+        if(!__atomic_compare_exchange_n(&pso->ppsegments[segment], &pexpected, psegment, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            free(psegment);
+            psegment = pexpected;
+        }
+    }
+
+    return &psegment[bucket - first];
+}
+
+/*! the sentinel of a bucket. An uninitialized bucket gets its sentinel linked
+    in from its parent's (the bucket without its highest bit, initialized
+    first), the one of an earlier split of the same range */
+static hash_entry_t *so_bucket_p(hash_table_split_t *pso, hash_epoch_record_t *precord, uint64_t bucket)
+{
+    hash_entry_t **pslot = so_slot_pp(pso, bucket);
+    hash_entry_t *psentinel = __atomic_load_n(pslot, __ATOMIC_ACQUIRE);
+    hash_entry_t *pexpected = NULL;
+    hash_entry_t *pparent;
+    hash_entry_t **ppprev;
+    hash_entry_t *pcur;
+    uint64_t sort_key = so_sentinel_key_ul(bucket);
+
+    if(NULL != psentinel)
+        return psentinel;
+
+    pparent = so_bucket_p(pso, precord, bucket & ~((uint64_t)1 << (63 - __builtin_clzll(bucket))));
+
+    psentinel = he_create_p(SO_SENTINEL_FLAGS, NULL, NULL, 0, NULL, 0);
+    if(NULL == psentinel) {
+        debug("so_bucket_p failed to allocate memory\n");
+        exit(-1);
+    }
+    psentinel->hash = sort_key;
+
+    for(;;)
+    {
+        // another thread linked the sentinel first, ours was never seen
+        if(so_find_i(pso, precord, pparent, sort_key, NULL, 0, &ppprev, &pcur)) {
+            he_destroy(SO_SENTINEL_FLAGS, NULL, psentinel);
+            psentinel = pcur;
+            break;
+        }
+
+        psentinel->pnext = pcur;
+        if(__atomic_compare_exchange_n(ppprev, &pcur, psentinel, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            break;
+    }
+
+    // every thread found the same sentinel, whichever stores it
+    __atomic_compare_exchange_n(pslot, &pexpected, psentinel, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+    return psentinel;
+}
+
+// the sentinel to start the search for a hash from
+static hash_entry_t *so_head_p(hash_table_split_t *pso, hash_epoch_record_t *precord, uint64_t hash)
+{
+    uint64_t bucket_count = __atomic_load_n(&pso->bucket_count, __ATOMIC_ACQUIRE);
+
+    return so_bucket_p(pso, precord, hash & (bucket_count - 1));
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void so_init(hash_table_split_t *pso, hash_flags_t flags, double max_load_factor)
+{
+    hash_entry_t *psentinel;
+    size_t index;
+
+    for(index = 0; index < SO_SEGMENT_COUNT; index++)
+        pso->ppsegments[index] = NULL;
+
+    pso->bucket_count = (uint64_t)1 << SO_INITIAL_BITS;
+    pso->key_count = 0;
+    pso->max_load_factor = (max_load_factor > 0.0) ? max_load_factor : SO_MAX_LOAD;
+    pso->flags = flags & (HT_KEY_CONST | HT_VALUE_CONST | HT_INLINE);
+
+    if(flags & HT_HASH_MIX)
+        pso->phashfunc = hf_mix_128;
+    else if(flags & HT_HASH_CRC32C)
+        pso->phashfunc = hf_crc32c_128;
+    else
+        pso->phashfunc = MurmurHash3_x64_128;
+
+    ep_init(&pso->epoch);
+
+    // the sentinel of bucket 0 is the head of the list
+    psentinel = he_create_p(SO_SENTINEL_FLAGS, NULL, NULL, 0, NULL, 0);
+    if(NULL == psentinel) {
+        debug("so_init failed to allocate memory\n");
+        exit(-1);
+    }
+    psentinel->hash = so_sentinel_key_ul(0);
+    psentinel->pnext = NULL;
+    *so_slot_pp(pso, 0) = psentinel;
+}
+
+void so_destroy(hash_table_split_t *pso)
+{
+    hash_entry_t *pentry;
+    hash_entry_t *pnext;
+    size_t index;
+
+    if(NULL == pso->ppsegments[0]) {
+        debug("so_destroy got a bad pso\n");
+        return;
+    }
+
+    // what was unlinked is only in the limbo lists, what is left only in the list
+    ep_destroy(&pso->epoch);
+
+    for(pentry = pso->ppsegments[0][0]; NULL != pentry; pentry = pnext)
+    {
+        pnext = so_unmark_p(pentry->pnext);
+        he_destroy(so_is_sentinel_i(pentry) ? SO_SENTINEL_FLAGS : pso->flags, NULL, pentry);
+    }
+
+    for(index = 0; index < SO_SEGMENT_COUNT; index++)
+    {
+        free(pso->ppsegments[index]);
+        pso->ppsegments[index] = NULL;
+    }
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+void so_insert(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size,
+               void *pvalue, size_t value_size)
+{
+    uint64_t hash = so_hash_ul(pso, pkey, key_size);
+    uint64_t sort_key = so_regular_key_ul(hash);
+    uint64_t bucket_count;
+    uint64_t key_count;
+    hash_entry_t **ppprev;
+    hash_entry_t *pentry;
+    hash_entry_t *phead;
+    hash_entry_t *pcur;
+    hash_entry_t *pnext;
+
+    pentry = he_create_p(pso->flags, NULL, pkey, key_size, pvalue, value_size);
+    if(NULL == pentry) {
+        debug("so_insert failed to allocate memory\n");
+        return;
+    }
+    pentry->hash = sort_key;
+
+    ep_enter(precord);
+    phead = so_head_p(pso, precord, hash);
+
+    for(;;)
+    {
+        if(so_find_i(pso, precord, phead, sort_key, pkey, key_size, &ppprev, &pcur)) {
+            /*! the key is there: the new entry replaces it by becoming the
+                marked next of the old one, which deletes the old entry and
+                links the new one in a single step */
+            pnext = __atomic_load_n(&pcur->pnext, __ATOMIC_ACQUIRE);
+            if(so_marked_i(pnext))
+                continue;
+
+            pentry->pnext = pnext;
+            if(__atomic_compare_exchange_n(&pcur->pnext, &pnext, so_mark_p(pentry), 0,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                // unlinks the old entry, unless another thread already did
+                so_find_i(pso, precord, phead, sort_key, pkey, key_size, &ppprev, &pcur);
+                break;
+            }
+            continue;
+        }
+
+        pentry->pnext = pcur;
+        if(__atomic_compare_exchange_n(ppprev, &pcur, pentry, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            key_count = __atomic_add_fetch(&pso->key_count, 1, __ATOMIC_RELAXED);
+
+            /// the buckets double by a single store, the new ones are only
+            /// initialized once a key falls in them
+            bucket_count = __atomic_load_n(&pso->bucket_count, __ATOMIC_RELAXED);
+            if(key_count > pso->max_load_factor * bucket_count &&
+               bucket_count < ((uint64_t)1 << (SO_INITIAL_BITS + SO_SEGMENT_COUNT - 2)))
+                __atomic_compare_exchange_n(&pso->bucket_count, &bucket_count, bucket_count * 2, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+
+    ep_exit(precord);
+}
+
+int so_get_i(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size,
+             void *pvalue, size_t *pvalue_size)
+{
+    uint64_t hash = so_hash_ul(pso, pkey, key_size);
+    hash_entry_t **ppprev;
+    hash_entry_t *pcur;
+    int found;
+
+    ep_enter(precord);
+
+    found = so_find_i(pso, precord, so_head_p(pso, precord, hash), so_regular_key_ul(hash),
+                      pkey, key_size, &ppprev, &pcur);
+    if(found && NULL != pvalue_size) {
+        if(NULL != pvalue)
+            memcpy(pvalue, pcur->pvalue, (pcur->value_size < *pvalue_size) ? pcur->value_size : *pvalue_size);
+        *pvalue_size = pcur->value_size;
+    }
+
+    ep_exit(precord);
+    return found;
+}
+
+int so_contains_i(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size)
+{
+    return so_get_i(pso, precord, pkey, key_size, NULL, NULL);
+}
+
+void so_remove(hash_table_split_t *pso, hash_epoch_record_t *precord, void *pkey, size_t key_size)
+{
+    uint64_t hash = so_hash_ul(pso, pkey, key_size);
+    uint64_t sort_key = so_regular_key_ul(hash);
+    hash_entry_t **ppprev;
+    hash_entry_t *phead;
+    hash_entry_t *pcur;
+    hash_entry_t *pnext;
+
+    ep_enter(precord);
+    phead = so_head_p(pso, precord, hash);
+
+    while(so_find_i(pso, precord, phead, sort_key, pkey, key_size, &ppprev, &pcur))
+    {
+        // marking the next pointer is what deletes the entry
+        pnext = __atomic_load_n(&pcur->pnext, __ATOMIC_ACQUIRE);
+        if(so_marked_i(pnext) ||
+           !__atomic_compare_exchange_n(&pcur->pnext, &pnext, so_mark_p(pnext), 0,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            continue;
+
+        __atomic_sub_fetch(&pso->key_count, 1, __ATOMIC_RELAXED);
+
+        // then it is unlinked, here or by the next search to meet it
+        if(__atomic_compare_exchange_n(ppprev, &pcur, pnext, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+            ep_retire_local(precord, pcur, so_free_entry, pso);
+        else
+            so_find_i(pso, precord, phead, sort_key, pkey, key_size, &ppprev, &pcur);
+        break;
+    }
+
+    ep_exit(precord);
+}
+
+/************************************************************************************************>
+ * UTILS
+ ************************************************************************************************/
+size_t so_size_sz(hash_table_split_t *pso)
+{
+    return (size_t)__atomic_load_n(&pso->key_count, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,370 @@
+/// @cond PRIVATE
+/// @file hashstripe.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashstripe.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+/************************************************************************************************>
+ * STRIPES
+ ************************************************************************************************/
+// the stripe of a bucket: the array is cut into stripe_count ranges
+static size_t hts_stripe_sz(hash_table_striped_t *pts, size_t bucket, size_t array_size)
+{
+    return (size_t)(((__uint128_t)bucket * pts->stripe_count) / array_size);
+}
+
+/*! locks the stripe of a hash. The size is read without a lock to find the
+    stripe, but it only changes with every stripe locked: once the stripe is
+    held, the size it was picked with is still current or the lock is retried */
+static hash_stripe_t *hts_lock_p(hash_table_striped_t *pts, uint64_t hash, int write)
+{
+    hash_stripe_t *pstripe;
+    size_t array_size;
+
+    for(;;)
+    {
+        array_size = __atomic_load_n(&pts->array_size, __ATOMIC_ACQUIRE);
+        pstripe = &pts->pstripes[hts_stripe_sz(pts, ht_reduce_sz(pts->table.flags, hash, array_size), array_size)];
+
+        if(write)
+            pthread_rwlock_wrlock(&pstripe->lock);
+        else
+            pthread_rwlock_rdlock(&pstripe->lock);
+
+        if(array_size == pts->table.array_size)
+            return pstripe;
+
+        pthread_rwlock_unlock(&pstripe->lock);
+    }
+}
+
+// locks every stripe for writing, always in the same order
+static void hts_lock_all(hash_table_striped_t *pts)
+{
+    size_t index;
+
+    for(index = 0; index < pts->stripe_count; index++)
+        pthread_rwlock_wrlock(&pts->pstripes[index].lock);
+}
+
+static void hts_unlock_all(hash_table_striped_t *pts)
+{
+    size_t index = pts->stripe_count;
+
+    while(index-- > 0)
+        pthread_rwlock_unlock(&pts->pstripes[index].lock);
+}
+
+/*! recounts the keys and collisions of every stripe from the chains (after
+    a resize, every stripe locked), the table counters are set to their sum */
+static void hts_recount(hash_table_striped_t *pts)
+{
+    hash_table_t *ptable = &pts->table;
+    hash_stripe_t *pstripe;
+    hash_entry_t *pentry;
+    size_t index;
+
+    __atomic_store_n(&pts->array_size, ptable->array_size, __ATOMIC_RELEASE);
+    if(!pts->striped)
+        return;
+
+    for(index = 0; index < pts->stripe_count; index++)
+    {
+        pts->pstripes[index].key_count = 0;
+        pts->pstripes[index].collisions = 0;
+    }
+
+    for(index = 0; index < ptable->array_size; index++)
+    {
+        pentry = ptable->pparray[index];
+        if(NULL == pentry)
+            continue;
+
+        pstripe = &pts->pstripes[hts_stripe_sz(pts, index, ptable->array_size)];
+        pstripe->collisions--;
+        for(; NULL != pentry; pentry = pentry->pnext)
+        {
+            pstripe->key_count++;
+            pstripe->collisions++;
+        }
+    }
+
+    ptable->key_count = 0;
+    for(index = 0; index < pts->stripe_count; index++)
+        ptable->key_count += pts->pstripes[index].key_count;
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+void hts_init(hash_table_striped_t *pts, hash_flags_t flags, double max_load_factor, size_t stripe_count
+#ifndef __WITH_MURMUR
+        , HashFunc *for_x86_32, HashFunc *for_x86_128, HashFunc *for_x64_128
+#endif //__WITH_MURMUR
+)
+{
+    size_t index;
+
+    // lookups of an incremental resize move buckets, which a read lock can't cover
+    flags &= ~HT_INCREMENTAL;
+
+    ht_init(&pts->table, flags, max_load_factor
+#   ifndef __WITH_MURMUR
+            , for_x86_32, for_x86_128, for_x64_128
+#   endif //__WITH_MURMUR
+            );
+
+    pts->stripe_count = (0 == stripe_count) ? HTS_STRIPE_COUNT : stripe_count;
+    pts->array_size = pts->table.array_size;
+    pts->striped = !(flags & (HT_ROBIN_HOOD | HT_SWISS | HT_CUCKOO | HT_ARENA));
+
+    pts->pstripes = aligned_alloc(sizeof(hash_stripe_t), pts->stripe_count * sizeof(hash_stripe_t));
+    if(NULL == pts->pstripes) {
+        debug("hts_init failed to allocate memory\n");
+        exit(-1);
+    }
+
+    for(index = 0; index < pts->stripe_count; index++)
+    {
+        pthread_rwlock_init(&pts->pstripes[index].lock, NULL);
+        pts->pstripes[index].key_count = 0;
+        pts->pstripes[index].collisions = 0;
+    }
+}
+
+void hts_destroy(hash_table_striped_t *pts)
+{
+    size_t index;
+
+    if(NULL == pts->pstripes) {
+        debug("hts_destroy got a bad pts\n");
+        return;
+    }
+
+    for(index = 0; index < pts->stripe_count; index++)
+        pthread_rwlock_destroy(&pts->pstripes[index].lock);
+
+    free(pts->pstripes);
+    pts->pstripes = NULL;
+    ht_destroy(&pts->table);
+}
+
+void hts_resize(hash_table_striped_t *pts, size_t new_size)
+{
+    hts_lock_all(pts);
+    ht_resize(&pts->table, new_size);
+    hts_recount(pts);
+    hts_unlock_all(pts);
+}
+
+/*! doubles the array once a stripe holds more than its share of the allowed
+    collisions, unless another thread already did it since size was read */
+static void hts_grow(hash_table_striped_t *pts, size_t array_size)
+{
+    hts_lock_all(pts);
+    if(array_size == pts->table.array_size) {
+        debug("hts_grow: stripe over its load, growing to %zu\n", array_size * 2);
+        ht_resize(&pts->table, array_size * 2);
+        hts_recount(pts);
+    }
+    hts_unlock_all(pts);
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+// the entry of a key in its chain, the stripe of the hash being locked
+static hash_entry_t *hts_find_p(hash_table_striped_t *pts, uint64_t hash, void *pkey, size_t key_size)
+{
+    hash_entry_t *pentry = pts->table.pparray[ht_bucket_sz(&pts->table, hash)];
+    hash_entry_t tmp;
+
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    for(; NULL != pentry; pentry = pentry->pnext)
+    {
+        if(pentry->hash == hash && he_key_compare_i(pentry, &tmp))
+            return pentry;
+    }
+
+    return NULL;
+}
+
+void hts_insert(hash_table_striped_t *pts, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hash_table_t *ptable = &pts->table;
+    uint64_t hash = ht_hash_ul(ptable, pkey, key_size);
+    hash_stripe_t *pstripe;
+    hash_entry_t *pentry;
+    hash_entry_t *ptmp;
+    size_t array_size;
+    size_t index;
+    int grow = 0;
+
+    if(!pts->striped) {
+        hts_lock_all(pts);
+        ht_insert(ptable, pkey, key_size, pvalue, value_size);
+        hts_recount(pts);
+        hts_unlock_all(pts);
+        return;
+    }
+
+    // the copies are made before locking, only the linking is done under the lock
+    pentry = he_create_p(ptable->flags, NULL, pkey, key_size, pvalue, value_size);
+    if(NULL == pentry) {
+        debug("hts_insert failed to allocate memory\n");
+        return;
+    }
+    pentry->hash = hash;
+    pentry->pnext = NULL;
+
+    pstripe = hts_lock_p(pts, hash, 1);
+    array_size = ptable->array_size;
+
+    ptmp = hts_find_p(pts, hash, pkey, key_size);
+    if(NULL != ptmp) {
+        he_set_value(ptable->flags, NULL, ptmp, pvalue, value_size);
+        pthread_rwlock_unlock(&pstripe->lock);
+        he_destroy(ptable->flags, NULL, pentry);
+        return;
+    }
+
+    index = ht_bucket_sz(ptable, hash);
+    if(NULL != ptable->pparray[index]) {
+        pstripe->collisions++;
+        /// each stripe checks its own share of the load, no counter is shared
+        grow = !(ptable->flags & HT_NO_AUTORESIZE) &&
+               (pstripe->collisions * pts->stripe_count > ptable->max_load_factor * array_size);
+    }
+    pentry->pnext = ptable->pparray[index];
+    ptable->pparray[index] = pentry;
+    pstripe->key_count++;
+
+    pthread_rwlock_unlock(&pstripe->lock);
+
+    if(grow)
+        hts_grow(pts, array_size);
+}
+
+int hts_get_i(hash_table_striped_t *pts, void *pkey, size_t key_size, void *pvalue, size_t *pvalue_size)
+{
+    uint64_t hash = ht_hash_ul(&pts->table, pkey, key_size);
+    hash_stripe_t *pstripe = hts_lock_p(pts, hash, 0);
+    hash_entry_t *pentry;
+    size_t value_size = 0;
+    void *pfound;
+
+    if(pts->striped) {
+        pentry = hts_find_p(pts, hash, pkey, key_size);
+        pfound = (NULL == pentry) ? NULL : pentry->pvalue;
+        if(NULL != pentry)
+            value_size = pentry->value_size;
+    }
+    else
+        pfound = ht_get_p(&pts->table, pkey, key_size, &value_size);
+
+    if(NULL != pfound && NULL != pvalue_size) {
+        if(NULL != pvalue)
+            memcpy(pvalue, pfound, (value_size < *pvalue_size) ? value_size : *pvalue_size);
+        *pvalue_size = value_size;
+    }
+
+    pthread_rwlock_unlock(&pstripe->lock);
+    return NULL != pfound;
+}
+
+int hts_contains_i(hash_table_striped_t *pts, void *pkey, size_t key_size)
+{
+    uint64_t hash = ht_hash_ul(&pts->table, pkey, key_size);
+    hash_stripe_t *pstripe = hts_lock_p(pts, hash, 0);
+    int found;
+
+    if(pts->striped)
+        found = (NULL != hts_find_p(pts, hash, pkey, key_size));
+    else
+        found = ht_contains_i(&pts->table, pkey, key_size);
+
+    pthread_rwlock_unlock(&pstripe->lock);
+    return found;
+}
+
+void hts_remove(hash_table_striped_t *pts, void *pkey, size_t key_size)
+{
+    hash_table_t *ptable = &pts->table;
+    uint64_t hash = ht_hash_ul(ptable, pkey, key_size);
+    hash_stripe_t *pstripe;
+    hash_entry_t **ppentry;
+    hash_entry_t *pentry = NULL;
+    hash_entry_t tmp;
+    size_t index;
+
+    if(!pts->striped) {
+        hts_lock_all(pts);
+        ht_remove(ptable, pkey, key_size);
+        hts_recount(pts);
+        hts_unlock_all(pts);
+        return;
+    }
+
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    pstripe = hts_lock_p(pts, hash, 1);
+    index = ht_bucket_sz(ptable, hash);
+    for(ppentry = &ptable->pparray[index]; NULL != *ppentry; ppentry = &(*ppentry)->pnext)
+    {
+        if((*ppentry)->hash == hash && he_key_compare_i(*ppentry, &tmp)) {
+            pentry = *ppentry;
+            *ppentry = pentry->pnext;
+
+            // the chain loses a collision unless the node was alone
+            if(ptable->pparray[index] != NULL)
+                pstripe->collisions--;
+            pstripe->key_count--;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&pstripe->lock);
+
+    // nobody can reach the node anymore, it is freed without the lock
+    if(NULL != pentry)
+        he_destroy(ptable->flags, NULL, pentry);
+}
+
+size_t hts_size_sz(hash_table_striped_t *pts)
+{
+    size_t count = 0;
+    size_t index;
+
+    if(!pts->striped) {
+        pthread_rwlock_rdlock(&pts->pstripes[0].lock);
+        count = pts->table.key_count;
+        pthread_rwlock_unlock(&pts->pstripes[0].lock);
+        return count;
+    }
+
+    for(index = 0; index < pts->stripe_count; index++)
+    {
+        pthread_rwlock_rdlock(&pts->pstripes[index].lock);
+        count += pts->pstripes[index].key_count;
+        pthread_rwlock_unlock(&pts->pstripes[index].lock);
+    }
+
+    return count;
+}
@@ -0,0 +1,471 @@
+/// @cond PRIVATE
+/// @file hashswiss.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashswiss.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SW_X86
+#endif
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+//----------------------------------
+// Control bytes
+//----------------------------------
+
+/// A full slot holds the 7 high bits of the hash (of 32 or, with HT_HASH64,
+/// of 64 bits), the low bits pick the home slot.
+#define SW_H2(flags, hash) ((uint8_t)(((flags) & HT_HASH64) ? (hash) >> 57 : (hash) >> 25))
+
+/// The result of probing one group, bit i standing for slot pos + i.
+typedef struct sw_masks {
+    /// Slots whose fingerprint matches.
+    uint32_t match;
+    /// Empty slots.
+    uint32_t empty;
+    /// Empty or deleted slots.
+    uint32_t free;
+} sw_masks_t;
+
+typedef void (sw_probe_t)(const uint8_t *pctrl, uint8_t h2, sw_masks_t *pmasks);
+
+/************************************************************************************************>
+ * GROUP PROBES
+ ************************************************************************************************/
+static void sw_probe_scalar(const uint8_t *pctrl, uint8_t h2, sw_masks_t *pmasks)
+{
+    unsigned int i;
+
+    pmasks->match = 0;
+    pmasks->empty = 0;
+    pmasks->free  = 0;
+    for(i = 0; i < 16; i++)
+    {
+        if(pctrl[i] == h2)
+            pmasks->match |= 1u << i;
+        if(pctrl[i] == SW_EMPTY)
+            pmasks->empty |= 1u << i;
+        if(pctrl[i] & 0x80)
+            pmasks->free |= 1u << i;
+    }
+}
+
+#ifdef SW_X86
+__attribute__((target("sse2")))
+static void sw_probe_sse2(const uint8_t *pctrl, uint8_t h2, sw_masks_t *pmasks)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)pctrl);
+
+    pmasks->match = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)h2)));
+    pmasks->empty = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)SW_EMPTY)));
+    // empty and deleted are the only control bytes with the high bit set
+    pmasks->free  = (uint32_t)_mm_movemask_epi8(group);
+}
+
+__attribute__((target("avx2")))
+static void sw_probe_avx2(const uint8_t *pctrl, uint8_t h2, sw_masks_t *pmasks)
+{
+    __m256i group = _mm256_loadu_si256((const __m256i *)pctrl);
+
+    pmasks->match = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8((char)h2)));
+    pmasks->empty = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8((char)SW_EMPTY)));
+    pmasks->free  = (uint32_t)_mm256_movemask_epi8(group);
+}
+#endif //SW_X86
+
+static sw_probe_t *sw_probe = NULL;
+static unsigned int sw_width = 16;
+static sw_isa_t sw_isa = SW_ISA_SCALAR;
+
+int sw_set_isa_i(sw_isa_t isa)
+{
+#ifdef SW_X86
+    __builtin_cpu_init();
+
+    if(SW_ISA_AUTO == isa) {
+        if(__builtin_cpu_supports("avx2"))
+            isa = SW_ISA_AVX2;
+        else if(__builtin_cpu_supports("sse2"))
+            isa = SW_ISA_SSE2;
+        else
+            isa = SW_ISA_SCALAR;
+    }
+
+    if(SW_ISA_AVX2 == isa) {
+        if(!__builtin_cpu_supports("avx2"))
+            return 0;
+        sw_probe = sw_probe_avx2;
+        sw_width = 32;
+    }
+    else if(SW_ISA_SSE2 == isa) {
+        if(!__builtin_cpu_supports("sse2"))
+            return 0;
+        sw_probe = sw_probe_sse2;
+        sw_width = 16;
+    }
+#else
+    if(SW_ISA_AUTO == isa)
+        isa = SW_ISA_SCALAR;
+    if(SW_ISA_SCALAR != isa)
+        return 0;
+#endif //SW_X86
+
+    if(SW_ISA_SCALAR == isa) {
+        sw_probe = sw_probe_scalar;
+        sw_width = 16;
+    }
+
+    sw_isa = isa;
+    return 1;
+}
+
+sw_isa_t sw_get_isa(void)
+{
+    if(NULL == sw_probe)
+        sw_set_isa_i(SW_ISA_AUTO);
+
+    return sw_isa;
+}
+
+/************************************************************************************************>
+ * PLACEMENT
+ ************************************************************************************************/
+// sets a control byte and its mirror after the last slot
+static void sw_set_ctrl(hash_table_t *ptable, size_t index, uint8_t ctrl)
+{
+    ptable->pctrl[index] = ctrl;
+    if(index < SW_GROUP_MAX)
+        ptable->pctrl[ptable->array_size + index] = ctrl;
+}
+
+/*! probing is linear, a group at a time: a key always sits before the first
+    empty slot following its home slot, whatever the group width is */
+static hash_slot_t *sw_lookup_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    size_t mask = ptable->array_size - 1;
+    size_t pos = hash & mask;
+    uint8_t h2 = SW_H2(ptable->flags, hash);
+    uint32_t bits;
+    hash_slot_t *pslot;
+    sw_masks_t masks;
+
+    hash_entry_t tmp;
+    tmp.pkey = pkey;
+    tmp.key_size = (uint32_t)key_size;
+
+    for(;;)
+    {
+        sw_probe(&ptable->pctrl[pos], h2, &masks);
+
+        // key memory is only touched on a fingerprint (and full hash) match
+        for(bits = masks.match; bits; bits &= bits - 1)
+        {
+            pslot = &ptable->pslots[(pos + __builtin_ctz(bits)) & mask];
+            if(pslot->entry.hash == hash && he_key_compare_i(&pslot->entry, &tmp))
+                return pslot;
+        }
+
+        if(masks.empty)
+            return NULL;
+
+        pos = (pos + sw_width) & mask;
+    }
+}
+
+// stores a slot in the first empty or deleted slot of its probe sequence
+static void sw_place(hash_table_t *ptable, hash_slot_t slot)
+{
+    size_t mask = ptable->array_size - 1;
+    size_t home = slot.entry.hash & mask;
+    size_t pos = home;
+    size_t index;
+    sw_masks_t masks;
+
+    for(;;)
+    {
+        sw_probe(&ptable->pctrl[pos], 0, &masks);
+        if(masks.free)
+            break;
+
+        pos = (pos + sw_width) & mask;
+    }
+
+    index = (pos + __builtin_ctz(masks.free)) & mask;
+    if(SW_DELETED == ptable->pctrl[index])
+        ptable->tombstones--;
+
+    sw_set_ctrl(ptable, index, SW_H2(ptable->flags, slot.entry.hash));
+    slot.dist = (uint32_t)((index - home) & mask) + 1;
+    if(slot.dist > 1)
+        ptable->collisions++;
+
+    ptable->pslots[index] = slot;
+}
+
+// rehashes before an insert once the empty slots run low
+static void sw_reserve(hash_table_t *ptable)
+{
+    double limit = ptable->array_size * HT_SWISS_MAX_LOAD;
+
+    // at least one empty slot must always be left to end the probes
+    if(ptable->flags & HT_NO_AUTORESIZE)
+        limit = ptable->array_size - 1;
+
+    if(ptable->key_count + ptable->tombstones + 1 <= limit)
+        return;
+
+    /*! grow if the entries themselves fill the table, otherwise
+        a rehash at the same size is enough to clear the tombstones */
+    if((ptable->key_count + 1) * 8 > limit * 7)
+        sw_resize(ptable, ptable->array_size * 2);
+    else
+        sw_resize(ptable, ptable->array_size);
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+static int sw_alloc_i(hash_table_t *ptable, size_t size)
+{
+    ptable->pslots = calloc(size, sizeof(*(ptable->pslots)));
+    ptable->pctrl = malloc(size + SW_GROUP_MAX);
+    if(NULL == ptable->pslots || NULL == ptable->pctrl) {
+        free(ptable->pslots);
+        free(ptable->pctrl);
+        return 0;
+    }
+
+    memset(ptable->pctrl, SW_EMPTY, size + SW_GROUP_MAX);
+    ptable->array_size = size;
+    ptable->tombstones = 0;
+    ptable->collisions = 0;
+    return 1;
+}
+
+void sw_init(hash_table_t *ptable)
+{
+    size_t size = SW_GROUP_MAX;
+
+    if(NULL == sw_probe)
+        sw_set_isa_i(SW_ISA_AUTO);
+
+    while(size < ptable->array_size)
+        size *= 2;
+
+    if(!sw_alloc_i(ptable, size)) {
+        debug("sw_init failed to allocate memory\n");
+        exit(-1);
+    }
+}
+
+void sw_destroy(hash_table_t *ptable)
+{
+    size_t index;
+
+    if(NULL == ptable->pslots) {
+        debug("sw_destroy got a bad ptable\n");
+        return;
+    }
+
+    // keys and values allocated from an arena are freed with it
+    for(index = 0; NULL == ptable->parena && index < ptable->array_size; index++)
+    {
+        if(0 != ptable->pslots[index].dist)
+            he_release(ptable->flags, ptable->parena, &ptable->pslots[index].entry);
+    }
+
+    free(ptable->pslots);
+    free(ptable->pctrl);
+    ptable->pslots = NULL;
+    ptable->pctrl = NULL;
+}
+
+void sw_resize(hash_table_t *ptable, size_t new_size)
+{
+    hash_slot_t *pold_slots = ptable->pslots;
+    uint8_t *pold_ctrl = ptable->pctrl;
+    size_t old_size = ptable->array_size;
+    size_t old_tombstones = ptable->tombstones;
+    size_t old_collisions = ptable->collisions;
+    size_t size = SW_GROUP_MAX;
+    size_t index;
+    uint64_t start = ht_clock_ul();
+
+    while(size < new_size || ptable->key_count >= size * HT_SWISS_MAX_LOAD)
+        size *= 2;
+
+    debug("sw_resize(old=%zu, new=%zu)\n", old_size, size);
+    if(!sw_alloc_i(ptable, size)) {
+        debug("sw_resize failed to allocate memory\n");
+        ptable->pslots = pold_slots;
+        ptable->pctrl = pold_ctrl;
+        ptable->array_size = old_size;
+        ptable->tombstones = old_tombstones;
+        ptable->collisions = old_collisions;
+        return;
+    }
+
+    // the hash is kept in the entry, so moving never calls the hash function
+    for(index = 0; index < old_size; index++)
+    {
+        if(0 != pold_slots[index].dist)
+            sw_place(ptable, pold_slots[index]);
+    }
+
+    free(pold_slots);
+    free(pold_ctrl);
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+    ht_resize_done(ptable, start);
+}
+
+/************************************************************************************************>
+ * ACCESS
+ ************************************************************************************************/
+void sw_insert(hash_table_t *ptable, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    sw_insert_hash(ptable, ht_hash_ul(ptable, pkey, key_size), pkey, key_size, pvalue, value_size);
+}
+
+void sw_insert_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hash_slot_t *pslot = sw_lookup_p(ptable, hash, pkey, key_size);
+    hash_slot_t slot;
+
+    if(NULL != pslot) {
+        he_set_value(ptable->flags, ptable->parena, &pslot->entry, pvalue, value_size);
+        return;
+    }
+
+    sw_reserve(ptable);
+
+    if(!he_fill_i(ptable->flags, ptable->parena, &slot.entry, pkey, key_size, pvalue, value_size)) {
+        debug("sw_insert failed to allocate memory\n");
+        return;
+    }
+
+    slot.entry.hash = hash;
+    sw_place(ptable, slot);
+
+    ptable->key_count++;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+void sw_he_insert(hash_table_t *ptable, hash_entry_t *pentry)
+{
+    uint64_t hash = ht_hash_ul(ptable, pentry->pkey, pentry->key_size);
+    hash_slot_t *pslot = sw_lookup_p(ptable, hash, pentry->pkey, pentry->key_size);
+    hash_slot_t slot;
+
+    if(NULL != pslot) {
+        he_set_value(ptable->flags, ptable->parena, &pslot->entry, pentry->pvalue, pentry->value_size);
+        he_destroy(ptable->flags, ptable->parena, pentry);
+        return;
+    }
+
+    sw_reserve(ptable);
+
+    // the slot takes over the key and value, only the node itself goes away
+    if(!he_move_i(ptable->flags, ptable->parena, &slot.entry, pentry)) {
+        debug("sw_he_insert failed to allocate memory\n");
+        he_destroy(ptable->flags, ptable->parena, pentry);
+        return;
+    }
+
+    slot.entry.hash = hash;
+
+    sw_place(ptable, slot);
+
+    ptable->key_count++;
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+hash_slot_t *sw_find_p(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    return sw_lookup_p(ptable, ht_hash_ul(ptable, pkey, key_size), pkey, key_size);
+}
+
+hash_slot_t *sw_find_hash_p(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    return sw_lookup_p(ptable, hash, pkey, key_size);
+}
+
+void sw_prefetch(hash_table_t *ptable, uint64_t hash)
+{
+    size_t pos = hash & (ptable->array_size - 1);
+
+    __builtin_prefetch(&ptable->pctrl[pos]);
+    __builtin_prefetch(&ptable->pslots[pos]);
+}
+
+void sw_remove(hash_table_t *ptable, void *pkey, size_t key_size)
+{
+    sw_remove_hash(ptable, ht_hash_ul(ptable, pkey, key_size), pkey, key_size);
+}
+
+void sw_remove_hash(hash_table_t *ptable, uint64_t hash, void *pkey, size_t key_size)
+{
+    hash_slot_t *pslot = sw_lookup_p(ptable, hash, pkey, key_size);
+    size_t mask = ptable->array_size - 1;
+    size_t index;
+
+    if(NULL == pslot)
+        return;
+
+    he_release(ptable->flags, ptable->parena, &pslot->entry);
+    if(pslot->dist > 1)
+        ptable->collisions--;
+    pslot->dist = 0;
+    ptable->key_count--;
+
+    /*! any entry stored past this slot found the next slot full when it was
+        placed, so if the next slot is empty no probe needs to cross this one */
+    index = (size_t)(pslot - ptable->pslots);
+    if(SW_EMPTY == ptable->pctrl[(index + 1) & mask]) {
+        sw_set_ctrl(ptable, index, SW_EMPTY);
+    }
+    else {
+        sw_set_ctrl(ptable, index, SW_DELETED);
+        ptable->tombstones++;
+    }
+
+    ptable->current_load_factor = (double)ptable->key_count / ptable->array_size;
+}
+
+size_t sw_miss_probes_sz(hash_table_t *ptable)
+{
+    size_t mask = ptable->array_size - 1;
+    size_t total = 0;
+    size_t run = 0;
+    size_t index;
+    size_t count;
+
+    /*! walking back from an empty slot (there is always one), each slot is
+        one further from the next empty slot than the slot after it */
+    index = 0;
+    while(SW_EMPTY != ptable->pctrl[index])
+        index++;
+
+    for(count = 0; count < ptable->array_size; count++)
+    {
+        run = (SW_EMPTY == ptable->pctrl[index]) ? 1 : run + 1;
+        total += run;
+        index = (index - 1) & mask;
+    }
+
+    return total;
+}
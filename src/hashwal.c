@@ -0,0 +1,420 @@
+/// @cond PRIVATE
+/// @file hashwal.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text
+
+#include "../inc/hashcore.h"
+#include "../inc/hashwal.h"
+#include "../inc/hashsnap.h"
+#include "../inc/hashfamily.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//----------------------------------
+// Debug macro
+//----------------------------------
+
+#ifdef DEBUG
+#define debug(M, ...) fprintf(stderr, "%s:%d - " M, __FILE__, __LINE__, ##__VA_ARGS__)
+#else
+#define debug(M, ...)
+#endif
+
+// keys, values and records start on 8 bytes, the padding being zeros
+#define HW_ALIGN(size) (((size) + 7) & ~(uint64_t)7)
+
+/************************************************************************************************>
+ * LAYOUT
+ ************************************************************************************************/
+static uint64_t hw_record_size_ul(uint64_t key_size, uint64_t value_size)
+{
+    return sizeof(hash_wal_record_t) + HW_ALIGN(key_size) + HW_ALIGN(value_size);
+}
+
+// the CRC32C of a record past its crc field, key, value and padding included
+static uint32_t hw_record_crc_ui(const hash_wal_record_t *precord)
+{
+    return hf_crc32c_ui(~0u, &precord->op,
+                        hw_record_size_ul(precord->key_size, precord->value_size) - sizeof(precord->crc));
+}
+
+/************************************************************************************************>
+ * APPEND
+ ************************************************************************************************/
+// writes the whole buffer to the file, and syncs it as the policy says
+static int hw_write_i(hash_wal_t *pwal)
+{
+    size_t written = 0;
+    ssize_t size;
+
+    while(written < pwal->used)
+    {
+        size = write(pwal->fd, pwal->pbuffer + written, pwal->used - written);
+        if(size < 0 && EINTR == errno)
+            continue;
+        if(size <= 0) {
+            debug("hw_write_i could not write the log\n");
+            pwal->healthy = 0;
+            break;
+        }
+        written += (size_t)size;
+    }
+    pwal->used = 0;
+
+    if(pwal->healthy && HW_SYNC_NONE != pwal->sync && 0 != fdatasync(pwal->fd)) {
+        debug("hw_write_i could not sync the log\n");
+        pwal->healthy = 0;
+    }
+
+    return pwal->healthy;
+}
+
+int hw_commit_i(hash_wal_t *pwal)
+{
+    if(0 == pwal->used)
+        return pwal->healthy;
+
+    return hw_write_i(pwal);
+}
+
+/*! copies a record into the buffer, first committing what it holds if the
+    record would take it past HW_BATCH_BYTES */
+static void hw_append(hash_wal_t *pwal, hash_wal_op_t op, void *pkey, size_t key_size, void *pvalue,
+                      size_t value_size)
+{
+    uint64_t size = hw_record_size_ul(key_size, value_size);
+    hash_wal_record_t *precord;
+    uint8_t *pbuffer;
+
+    if(0 != pwal->used && pwal->used + size > HW_BATCH_BYTES)
+        hw_commit_i(pwal);
+
+    // only a record larger than HW_BATCH_BYTES grows the buffer
+    if(size > pwal->capacity) {
+        pbuffer = realloc(pwal->pbuffer, size);
+        if(NULL == pbuffer) {
+            debug("hw_append failed to allocate memory, the record is lost\n");
+            pwal->healthy = 0;
+            return;
+        }
+        pwal->pbuffer = pbuffer;
+        pwal->capacity = size;
+    }
+
+    precord = (hash_wal_record_t *)(pwal->pbuffer + pwal->used);
+    memset(precord, 0, size);
+    precord->op = op;
+    precord->key_size = (uint32_t)key_size;
+    precord->value_size = value_size;
+    if(0 != key_size)
+        memcpy(precord + 1, pkey, key_size);
+    if(0 != value_size)
+        memcpy((uint8_t *)(precord + 1) + HW_ALIGN(key_size), pvalue, value_size);
+    precord->crc = hw_record_crc_ui(precord);
+
+    pwal->used += size;
+    pwal->record_count++;
+}
+
+void hw_log_insert(hash_wal_t *pwal, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    hw_append(pwal, HW_INSERT, pkey, key_size, pvalue, value_size);
+    if(HW_SYNC_EACH == pwal->sync)
+        hw_commit_i(pwal);
+}
+
+void hw_log_batch(hash_wal_t *pwal, void **ppkeys, size_t *pkey_sizes, void **ppvalues, size_t *pvalue_sizes,
+                  size_t count)
+{
+    size_t index;
+
+    for(index = 0; index < count; index++)
+        hw_append(pwal, HW_INSERT, ppkeys[index], pkey_sizes[index], ppvalues[index], pvalue_sizes[index]);
+    if(HW_SYNC_EACH == pwal->sync)
+        hw_commit_i(pwal);
+}
+
+void hw_log_remove(hash_wal_t *pwal, void *pkey, size_t key_size)
+{
+    hw_append(pwal, HW_REMOVE, pkey, key_size, NULL, 0);
+    if(HW_SYNC_EACH == pwal->sync)
+        hw_commit_i(pwal);
+}
+
+void hw_log_clear(hash_wal_t *pwal)
+{
+    hw_append(pwal, HW_CLEAR, NULL, 0, NULL, 0);
+    if(HW_SYNC_EACH == pwal->sync)
+        hw_commit_i(pwal);
+}
+
+/************************************************************************************************>
+ * REPLAY
+ ************************************************************************************************/
+/// The inserts of hw_recover_i waiting for their ht_insert_batch.
+typedef struct hw_replay {
+    hash_table_t *ptable;
+    void *ppkeys[HW_REPLAY_BATCH];
+    size_t key_sizes[HW_REPLAY_BATCH];
+    void *ppvalues[HW_REPLAY_BATCH];
+    size_t value_sizes[HW_REPLAY_BATCH];
+    /// The number of inserts waiting.
+    size_t count;
+    /// The number of records replayed so far.
+    size_t replayed;
+} hw_replay_t;
+
+static void hw_replay_flush(hw_replay_t *preplay)
+{
+    ht_insert_batch(preplay->ptable, preplay->ppkeys, preplay->key_sizes, preplay->ppvalues,
+                    preplay->value_sizes, preplay->count);
+    preplay->count = 0;
+}
+
+// a remove or a clear waits for the inserts before it, they may be of its key
+static void hw_replay_record(hw_replay_t *preplay, hash_wal_record_t *precord)
+{
+    if(HW_REMOVE == precord->op) {
+        hw_replay_flush(preplay);
+        ht_remove(preplay->ptable, precord + 1, precord->key_size);
+    }
+    else if(HW_CLEAR == precord->op) {
+        hw_replay_flush(preplay);
+        ht_clear(preplay->ptable);
+    }
+    else {
+        preplay->ppkeys[preplay->count] = precord + 1;
+        preplay->key_sizes[preplay->count] = precord->key_size;
+        preplay->ppvalues[preplay->count] = (uint8_t *)(precord + 1) + HW_ALIGN(precord->key_size);
+        preplay->value_sizes[preplay->count] = precord->value_size;
+        if(++preplay->count == HW_REPLAY_BATCH)
+            hw_replay_flush(preplay);
+    }
+    preplay->replayed++;
+}
+
+/*! walks the records of a mapped log, replaying each one if preplay is not
+    NULL. Returns the offset past the last whole record passing its check */
+static uint64_t hw_scan_ul(uint8_t *pbase, uint64_t size, hw_replay_t *preplay)
+{
+    uint64_t offset = sizeof(hash_wal_header_t);
+    hash_wal_record_t *precord;
+
+    while(size - offset >= sizeof(*precord))
+    {
+        precord = (hash_wal_record_t *)(pbase + offset);
+        if(precord->value_size > size ||
+           hw_record_size_ul(precord->key_size, precord->value_size) > size - offset ||
+           (HW_INSERT != precord->op && HW_REMOVE != precord->op && HW_CLEAR != precord->op) ||
+           precord->crc != hw_record_crc_ui(precord))
+            break;
+
+        if(NULL != preplay)
+            hw_replay_record(preplay, precord);
+        offset += hw_record_size_ul(precord->key_size, precord->value_size);
+    }
+
+    return offset;
+}
+
+// maps a log to read it, NULL if it can't be or has no valid header
+static uint8_t *hw_map_p(int fd, uint64_t size)
+{
+    hash_wal_header_t *pheader;
+    uint8_t *pbase;
+
+    if(size < sizeof(*pheader))
+        return NULL;
+
+    pbase = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(MAP_FAILED == pbase)
+        return NULL;
+
+    pheader = (hash_wal_header_t *)pbase;
+    if(HW_MAGIC != pheader->magic || HW_VERSION != pheader->version) {
+        munmap(pbase, size);
+        return NULL;
+    }
+
+    return pbase;
+}
+
+int hw_recover_i(hash_table_t *ptable, const char *psnapshot, const char *plog, size_t *preplayed)
+{
+    hash_wal_t *pwal = ptable->pwal;
+    hw_replay_t *preplay;
+    struct stat st;
+    uint8_t *pbase;
+    int fd;
+
+    if(NULL != preplayed)
+        *preplayed = 0;
+
+    // the entries would point into the log, unmapped once replayed
+    if(ptable->flags & (HT_KEY_CONST | HT_VALUE_CONST)) {
+        debug("hw_recover_i can't replay into a table of constant keys or values\n");
+        return 0;
+    }
+
+    /// what is loaded and replayed is already in the snapshot and the log,
+    /// it is not logged again
+    ptable->pwal = NULL;
+    if(NULL != psnapshot && 0 == access(psnapshot, F_OK) && !ht_load_i(ptable, psnapshot, 1)) {
+        debug("hw_recover_i could not load %s\n", psnapshot);
+        ptable->pwal = pwal;
+        return 0;
+    }
+    ptable->pwal = pwal;
+
+    /// no log, or one a crash left without its header: nothing was logged
+    fd = open(plog, O_RDONLY);
+    if(fd < 0)
+        return ENOENT == errno;
+    if(0 != fstat(fd, &st)) {
+        close(fd);
+        return 0;
+    }
+    if((size_t)st.st_size < sizeof(hash_wal_header_t)) {
+        close(fd);
+        return 1;
+    }
+
+    pbase = hw_map_p(fd, (uint64_t)st.st_size);
+    close(fd);
+    preplay = (NULL != pbase) ? malloc(sizeof(*preplay)) : NULL;
+    if(NULL == preplay) {
+        debug("hw_recover_i: %s is not a log\n", plog);
+        if(NULL != pbase)
+            munmap(pbase, (size_t)st.st_size);
+        return 0;
+    }
+
+    madvise(pbase, (size_t)st.st_size, MADV_SEQUENTIAL);
+    preplay->ptable = ptable;
+    preplay->count = 0;
+    preplay->replayed = 0;
+
+    ptable->pwal = NULL;
+    hw_scan_ul(pbase, (uint64_t)st.st_size, preplay);
+    hw_replay_flush(preplay);
+    ptable->pwal = pwal;
+
+    if(NULL != preplayed)
+        *preplayed = preplay->replayed;
+    debug("hw_recover_i replayed %zu records\n", preplay->replayed);
+
+    free(preplay);
+    munmap(pbase, (size_t)st.st_size);
+    return 1;
+}
+
+/************************************************************************************************>
+ * LIFECYCLE
+ ************************************************************************************************/
+// the end of the valid records of an existing log, or a new header, so appends follow them
+static int hw_prepare_i(int fd)
+{
+    hash_wal_header_t header;
+    struct stat st;
+    uint8_t *pbase;
+    uint64_t end;
+
+    if(0 != fstat(fd, &st))
+        return 0;
+
+    if((size_t)st.st_size < sizeof(header)) {
+        header.magic = HW_MAGIC;
+        header.version = HW_VERSION;
+        header.reserved = 0;
+        return 0 == ftruncate(fd, 0) && (ssize_t)sizeof(header) == write(fd, &header, sizeof(header)) &&
+               0 == fdatasync(fd);
+    }
+
+    pbase = hw_map_p(fd, (uint64_t)st.st_size);
+    if(NULL == pbase)
+        return 0;
+    end = hw_scan_ul(pbase, (uint64_t)st.st_size, NULL);
+    munmap(pbase, (size_t)st.st_size);
+
+    /// a torn last record would hide every record appended after it
+    return end == (uint64_t)st.st_size || 0 == ftruncate(fd, (off_t)end);
+}
+
+int hw_open_i(hash_wal_t *pwal, hash_table_t *ptable, const char *ppath, hash_wal_sync_t sync)
+{
+    int fd;
+
+    fd = open(ppath, O_RDWR | O_CREAT | O_APPEND, 0644);
+    if(fd < 0) {
+        debug("hw_open_i could not open %s\n", ppath);
+        return 0;
+    }
+    if(!hw_prepare_i(fd)) {
+        debug("hw_open_i: %s is not a log\n", ppath);
+        close(fd);
+        return 0;
+    }
+
+    pwal->pbuffer = malloc(HW_BATCH_BYTES);
+    if(NULL == pwal->pbuffer) {
+        debug("hw_open_i failed to allocate memory\n");
+        exit(-1);
+    }
+    pwal->ptable = ptable;
+    pwal->fd = fd;
+    pwal->sync = sync;
+    pwal->used = 0;
+    pwal->capacity = HW_BATCH_BYTES;
+    pwal->record_count = 0;
+    pwal->healthy = 1;
+
+    ptable->pwal = pwal;
+    return 1;
+}
+
+void hw_close(hash_wal_t *pwal)
+{
+    if(NULL == pwal->pbuffer) {
+        debug("hw_close got a bad pwal\n");
+        return;
+    }
+
+    hw_commit_i(pwal);
+    if(NULL != pwal->ptable && pwal == pwal->ptable->pwal)
+        pwal->ptable->pwal = NULL;
+
+    close(pwal->fd);
+    free(pwal->pbuffer);
+    pwal->pbuffer = NULL;
+    pwal->fd = -1;
+}
+
+int hw_checkpoint_i(hash_wal_t *pwal, const char *psnapshot)
+{
+    if(NULL == pwal->ptable) {
+        debug("hw_checkpoint_i: the table of the log was destroyed\n");
+        return 0;
+    }
+
+    hw_commit_i(pwal);
+
+    if(!ht_save_i(pwal->ptable, psnapshot)) {
+        debug("hw_checkpoint_i could not save %s\n", psnapshot);
+        return 0;
+    }
+
+    /// the snapshot holds every record, only the header stays
+    if(0 != ftruncate(pwal->fd, sizeof(hash_wal_header_t)) || 0 != fdatasync(pwal->fd)) {
+        debug("hw_checkpoint_i could not empty the log\n");
+        return 0;
+    }
+
+    pwal->record_count = 0;
+    return 1;
+}
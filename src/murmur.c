@@ -1,5 +1,3 @@
-#ifdef __WITH_MURMUR
-
 //-----------------------------------------------------------------------------
 // MurmurHash3 was written by Austin Appleby, and is placed in the public
 // domain. The author hereby disclaims copyright to this source code.
@@ -11,6 +9,13 @@
 
 #include "../inc/murmur.h"
 
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define MU_X86
+#endif
+
 #define MU_FORCE_INLINE inline __attribute__((always_inline))
 
 MU_FORCE_INLINE uint32_t mu_rotl32(uint32_t x, int8_t r)
@@ -28,7 +33,22 @@ MU_FORCE_INLINE uint64_t mu_rotl64(uint64_t x, int8_t r)
 
 #define MU_BIG_CONSTANT(x) (x##LLU)
 
-#define mu_getblock(x, i) (x[i])
+// keys may start at any address (inside a mapped file for instance), blocks are read through memcpy
+MU_FORCE_INLINE uint32_t mu_getblock32(const uint32_t *p, int i)
+{
+    uint32_t block;
+
+    memcpy(&block, p + i, sizeof(block));
+    return block;
+}
+
+MU_FORCE_INLINE uint64_t mu_getblock64(const uint64_t *p, int i)
+{
+    uint64_t block;
+
+    memcpy(&block, p + i, sizeof(block));
+    return block;
+}
 
 //-----------------------------------------------------------------------------
 // Finalization mix - force all bits of a hash block to avalanche
@@ -77,7 +97,7 @@ void MurmurHash3_x86_32(const void *pkey, int len, uint32_t seed, void *pout )
     const uint32_t * blocks = (const uint32_t *)(data + nblocks*4);
 
     for(i = -nblocks; i; i++) {
-        uint32_t k1 = mu_getblock(blocks,i);
+        uint32_t k1 = mu_getblock32(blocks,i);
 
         k1 *= c1;
         k1 = MU_ROTL32(k1, 15);
@@ -137,10 +157,10 @@ void MurmurHash3_x86_128(const void *pkey, const int len, uint32_t seed, void *p
     const uint32_t * blocks = (const uint32_t *)(data + nblocks*16);
 
     for(i = -nblocks; i; i++) {
-        uint32_t k1 = mu_getblock(blocks,i*4+0);
-        uint32_t k2 = mu_getblock(blocks,i*4+1);
-        uint32_t k3 = mu_getblock(blocks,i*4+2);
-        uint32_t k4 = mu_getblock(blocks,i*4+3);
+        uint32_t k1 = mu_getblock32(blocks,i*4+0);
+        uint32_t k2 = mu_getblock32(blocks,i*4+1);
+        uint32_t k3 = mu_getblock32(blocks,i*4+2);
+        uint32_t k4 = mu_getblock32(blocks,i*4+3);
 
         k1 *= c1;
         k1  = MU_ROTL32(k1, 15);
@@ -280,8 +300,8 @@ void MurmurHash3_x64_128(const void *pkey, const int len, const uint32_t seed, v
     const uint64_t * blocks = (const uint64_t *)(data);
 
     for(i = 0; i < nblocks; i++) {
-        uint64_t k1 = mu_getblock(blocks,i*2+0);
-        uint64_t k2 = mu_getblock(blocks,i*2+1);
+        uint64_t k1 = mu_getblock64(blocks,i*2+0);
+        uint64_t k2 = mu_getblock64(blocks,i*2+1);
 
         k1 *= c1;
         k1  = MU_ROTL64(k1, 31);
@@ -358,4 +378,454 @@ void MurmurHash3_x64_128(const void *pkey, const int len, const uint32_t seed, v
 
 //-----------------------------------------------------------------------------
 
-#endif //__WITH_MURMUR
+//-----------------------------------------------------------------------------
+// Multi-key kernels - the rounds above, one key per vector lane. Every key
+// has the same length, so every lane runs the same blocks and tail. The
+// lanes are filled with one scalar load per key, which beats the gather
+// instructions on current cores, and never reads past the end of a key.
+
+typedef void (mu_multi32_t)(void **ppkeys, int len, uint32_t seed, uint32_t *pout, size_t count);
+typedef void (mu_multi128_t)(void **ppkeys, int len, uint32_t seed, uint64_t *pout, size_t count);
+
+static void mu_x86_32_scalar(void **ppkeys, int len, uint32_t seed, uint32_t *pout, size_t count)
+{
+    size_t key;
+
+    for(key = 0; key < count; key++)
+        MurmurHash3_x86_32(ppkeys[key], len, seed, &pout[key]);
+}
+
+static void mu_x64_128_scalar(void **ppkeys, int len, uint32_t seed, uint64_t *pout, size_t count)
+{
+    size_t key;
+
+    for(key = 0; key < count; key++)
+        MurmurHash3_x64_128(ppkeys[key], len, seed, &pout[key * 2]);
+}
+
+// the bytes of a key from offset, at most 8, as the little endian word the
+// scalar functions read (a whole block, or the tail their switch builds)
+MU_FORCE_INLINE uint64_t mu_word(const void *pkey, int offset, int size)
+{
+    const uint8_t *pbytes = (const uint8_t *)pkey + offset;
+    uint64_t k = 0;
+    uint32_t half;
+    int i = 0;
+
+    if(size >= 4) {
+        memcpy(&half, pbytes, 4);
+        k = half;
+        i = 4;
+    }
+    if(8 == size) {
+        memcpy(&half, pbytes + 4, 4);
+        return k | (uint64_t)half << 32;
+    }
+
+    for(; i < size; i++)
+        k |= (uint64_t)pbytes[i] << (i * 8);
+
+    return k;
+}
+
+#ifdef MU_X86
+
+#define MU_ROTL32_AVX2(x, r) _mm256_or_si256(_mm256_slli_epi32((x), (r)), _mm256_srli_epi32((x), 32 - (r)))
+#define MU_ROTL64_AVX2(x, r) _mm256_or_si256(_mm256_slli_epi64((x), (r)), _mm256_srli_epi64((x), 64 - (r)))
+
+// the words of 8 keys, 4 bytes at most each
+__attribute__((target("avx2")))
+static inline __m256i mu_lanes32_avx2(void **ppkeys, int offset, int size)
+{
+    return _mm256_setr_epi32((int)mu_word(ppkeys[0], offset, size), (int)mu_word(ppkeys[1], offset, size),
+                             (int)mu_word(ppkeys[2], offset, size), (int)mu_word(ppkeys[3], offset, size),
+                             (int)mu_word(ppkeys[4], offset, size), (int)mu_word(ppkeys[5], offset, size),
+                             (int)mu_word(ppkeys[6], offset, size), (int)mu_word(ppkeys[7], offset, size));
+}
+
+// the words of 4 keys, 8 bytes at most each
+__attribute__((target("avx2")))
+static inline __m256i mu_lanes64_avx2(void **ppkeys, int offset, int size)
+{
+    return _mm256_setr_epi64x((long long)mu_word(ppkeys[0], offset, size), (long long)mu_word(ppkeys[1], offset, size),
+                              (long long)mu_word(ppkeys[2], offset, size), (long long)mu_word(ppkeys[3], offset, size));
+}
+
+// the low 64 bits of a 64 x 64 product, AVX2 only multiplies 32 bit halves
+__attribute__((target("avx2")))
+static inline __m256i mu_mul64_avx2(__m256i a, __m256i b)
+{
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+
+    return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mu_fmix32_avx2(__m256i h)
+{
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x85ebca6b));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0xc2b2ae35));
+    return _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i mu_fmix64_avx2(__m256i k)
+{
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mu_mul64_avx2(k, _mm256_set1_epi64x((long long)MU_BIG_CONSTANT(0xff51afd7ed558ccd)));
+    k = _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+    k = mu_mul64_avx2(k, _mm256_set1_epi64x((long long)MU_BIG_CONSTANT(0xc4ceb9fe1a85ec53)));
+    return _mm256_xor_si256(k, _mm256_srli_epi64(k, 33));
+}
+
+__attribute__((target("avx2")))
+static void mu_x86_32_avx2(void **ppkeys, int len, uint32_t seed, uint32_t *pout, size_t count)
+{
+    const __m256i c1 = _mm256_set1_epi32((int)0xcc9e2d51);
+    const __m256i c2 = _mm256_set1_epi32(0x1b873593);
+    const int nblocks = len / 4;
+    __m256i h1;
+    __m256i k1;
+    size_t key;
+    int i;
+
+    for(key = 0; key + 8 <= count; key += 8)
+    {
+        h1 = _mm256_set1_epi32((int)seed);
+
+        for(i = 0; i < nblocks; i++) {
+            k1 = mu_lanes32_avx2(ppkeys + key, i * 4, 4);
+
+            k1 = _mm256_mullo_epi32(k1, c1);
+            k1 = MU_ROTL32_AVX2(k1, 15);
+            k1 = _mm256_mullo_epi32(k1, c2);
+
+            h1 = _mm256_xor_si256(h1, k1);
+            h1 = MU_ROTL32_AVX2(h1, 13);
+            h1 = _mm256_add_epi32(_mm256_add_epi32(_mm256_slli_epi32(h1, 2), h1), _mm256_set1_epi32((int)0xe6546b64));
+        }
+
+        if(len & 3) {
+            k1 = mu_lanes32_avx2(ppkeys + key, nblocks * 4, len & 3);
+            k1 = _mm256_mullo_epi32(k1, c1);
+            k1 = MU_ROTL32_AVX2(k1, 15);
+            k1 = _mm256_mullo_epi32(k1, c2);
+            h1 = _mm256_xor_si256(h1, k1);
+        }
+
+        h1 = _mm256_xor_si256(h1, _mm256_set1_epi32(len));
+        h1 = mu_fmix32_avx2(h1);
+        _mm256_storeu_si256((__m256i *)&pout[key], h1);
+    }
+
+    mu_x86_32_scalar(ppkeys + key, len, seed, pout + key, count - key);
+}
+
+__attribute__((target("avx2")))
+static void mu_x64_128_avx2(void **ppkeys, int len, uint32_t seed, uint64_t *pout, size_t count)
+{
+    const __m256i c1 = _mm256_set1_epi64x((long long)MU_BIG_CONSTANT(0x87c37b91114253d5));
+    const __m256i c2 = _mm256_set1_epi64x((long long)MU_BIG_CONSTANT(0x4cf5ad432745937f));
+    const int nblocks = len / 16;
+    const int tail = len & 15;
+    __m256i h1;
+    __m256i h2;
+    __m256i k1;
+    __m256i k2;
+    size_t key;
+    int i;
+
+    for(key = 0; key + 4 <= count; key += 4)
+    {
+        h1 = _mm256_set1_epi64x(seed);
+        h2 = _mm256_set1_epi64x(seed);
+
+        for(i = 0; i < nblocks; i++) {
+            k1 = mu_lanes64_avx2(ppkeys + key, i * 16, 8);
+            k2 = mu_lanes64_avx2(ppkeys + key, i * 16 + 8, 8);
+
+            k1 = mu_mul64_avx2(k1, c1);
+            k1 = MU_ROTL64_AVX2(k1, 31);
+            k1 = mu_mul64_avx2(k1, c2);
+            h1 = _mm256_xor_si256(h1, k1);
+
+            h1 = MU_ROTL64_AVX2(h1, 27);
+            h1 = _mm256_add_epi64(h1, h2);
+            h1 = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(h1, 2), h1), _mm256_set1_epi64x(0x52dce729));
+
+            k2 = mu_mul64_avx2(k2, c2);
+            k2 = MU_ROTL64_AVX2(k2, 33);
+            k2 = mu_mul64_avx2(k2, c1);
+            h2 = _mm256_xor_si256(h2, k2);
+
+            h2 = MU_ROTL64_AVX2(h2, 31);
+            h2 = _mm256_add_epi64(h2, h1);
+            h2 = _mm256_add_epi64(_mm256_add_epi64(_mm256_slli_epi64(h2, 2), h2), _mm256_set1_epi64x(0x38495ab5));
+        }
+
+        if(tail > 8) {
+            k2 = mu_lanes64_avx2(ppkeys + key, nblocks * 16 + 8, tail - 8);
+            k2 = mu_mul64_avx2(k2, c2);
+            k2 = MU_ROTL64_AVX2(k2, 33);
+            k2 = mu_mul64_avx2(k2, c1);
+            h2 = _mm256_xor_si256(h2, k2);
+        }
+        if(tail) {
+            k1 = mu_lanes64_avx2(ppkeys + key, nblocks * 16, tail < 8 ? tail : 8);
+            k1 = mu_mul64_avx2(k1, c1);
+            k1 = MU_ROTL64_AVX2(k1, 31);
+            k1 = mu_mul64_avx2(k1, c2);
+            h1 = _mm256_xor_si256(h1, k1);
+        }
+
+        h1 = _mm256_xor_si256(h1, _mm256_set1_epi64x(len));
+        h2 = _mm256_xor_si256(h2, _mm256_set1_epi64x(len));
+        h1 = _mm256_add_epi64(h1, h2);
+        h2 = _mm256_add_epi64(h2, h1);
+        h1 = mu_fmix64_avx2(h1);
+        h2 = mu_fmix64_avx2(h2);
+        h1 = _mm256_add_epi64(h1, h2);
+        h2 = _mm256_add_epi64(h2, h1);
+
+        // interleaved back into {h1, h2} pairs
+        k1 = _mm256_unpacklo_epi64(h1, h2);
+        k2 = _mm256_unpackhi_epi64(h1, h2);
+        _mm256_storeu_si256((__m256i *)&pout[key * 2], _mm256_permute2x128_si256(k1, k2, 0x20));
+        _mm256_storeu_si256((__m256i *)&pout[key * 2 + 4], _mm256_permute2x128_si256(k1, k2, 0x31));
+    }
+
+    mu_x64_128_scalar(ppkeys + key, len, seed, pout + key * 2, count - key);
+}
+
+// the words of 16 keys, 4 bytes at most each
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512i mu_lanes32_avx512(void **ppkeys, int offset, int size)
+{
+    return _mm512_inserti64x4(_mm512_castsi256_si512(mu_lanes32_avx2(ppkeys, offset, size)),
+                              mu_lanes32_avx2(ppkeys + 8, offset, size), 1);
+}
+
+// the words of 8 keys, 8 bytes at most each
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512i mu_lanes64_avx512(void **ppkeys, int offset, int size)
+{
+    return _mm512_inserti64x4(_mm512_castsi256_si512(mu_lanes64_avx2(ppkeys, offset, size)),
+                              mu_lanes64_avx2(ppkeys + 4, offset, size), 1);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512i mu_fmix32_avx512(__m512i h)
+{
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+    h = _mm512_mullo_epi32(h, _mm512_set1_epi32((int)0x85ebca6b));
+    h = _mm512_xor_si512(h, _mm512_srli_epi32(h, 13));
+    h = _mm512_mullo_epi32(h, _mm512_set1_epi32((int)0xc2b2ae35));
+    return _mm512_xor_si512(h, _mm512_srli_epi32(h, 16));
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static inline __m512i mu_fmix64_avx512(__m512i k)
+{
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64((long long)MU_BIG_CONSTANT(0xff51afd7ed558ccd)));
+    k = _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+    k = _mm512_mullo_epi64(k, _mm512_set1_epi64((long long)MU_BIG_CONSTANT(0xc4ceb9fe1a85ec53)));
+    return _mm512_xor_si512(k, _mm512_srli_epi64(k, 33));
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void mu_x86_32_avx512(void **ppkeys, int len, uint32_t seed, uint32_t *pout, size_t count)
+{
+    const __m512i c1 = _mm512_set1_epi32((int)0xcc9e2d51);
+    const __m512i c2 = _mm512_set1_epi32(0x1b873593);
+    const int nblocks = len / 4;
+    __m512i h1;
+    __m512i k1;
+    size_t key;
+    int i;
+
+    for(key = 0; key + 16 <= count; key += 16)
+    {
+        h1 = _mm512_set1_epi32((int)seed);
+
+        for(i = 0; i < nblocks; i++) {
+            k1 = mu_lanes32_avx512(ppkeys + key, i * 4, 4);
+
+            k1 = _mm512_mullo_epi32(k1, c1);
+            k1 = _mm512_rol_epi32(k1, 15);
+            k1 = _mm512_mullo_epi32(k1, c2);
+
+            h1 = _mm512_xor_si512(h1, k1);
+            h1 = _mm512_rol_epi32(h1, 13);
+            h1 = _mm512_add_epi32(_mm512_add_epi32(_mm512_slli_epi32(h1, 2), h1), _mm512_set1_epi32((int)0xe6546b64));
+        }
+
+        if(len & 3) {
+            k1 = mu_lanes32_avx512(ppkeys + key, nblocks * 4, len & 3);
+            k1 = _mm512_mullo_epi32(k1, c1);
+            k1 = _mm512_rol_epi32(k1, 15);
+            k1 = _mm512_mullo_epi32(k1, c2);
+            h1 = _mm512_xor_si512(h1, k1);
+        }
+
+        h1 = _mm512_xor_si512(h1, _mm512_set1_epi32(len));
+        h1 = mu_fmix32_avx512(h1);
+        _mm512_storeu_si512(&pout[key], h1);
+    }
+
+    mu_x86_32_scalar(ppkeys + key, len, seed, pout + key, count - key);
+}
+
+__attribute__((target("avx512f,avx512dq")))
+static void mu_x64_128_avx512(void **ppkeys, int len, uint32_t seed, uint64_t *pout, size_t count)
+{
+    const __m512i c1 = _mm512_set1_epi64((long long)MU_BIG_CONSTANT(0x87c37b91114253d5));
+    const __m512i c2 = _mm512_set1_epi64((long long)MU_BIG_CONSTANT(0x4cf5ad432745937f));
+    const __m512i even = _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, 11);
+    const __m512i odd = _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, 15);
+    const int nblocks = len / 16;
+    const int tail = len & 15;
+    __m512i h1;
+    __m512i h2;
+    __m512i k1;
+    __m512i k2;
+    size_t key;
+    int i;
+
+    for(key = 0; key + 8 <= count; key += 8)
+    {
+        h1 = _mm512_set1_epi64(seed);
+        h2 = _mm512_set1_epi64(seed);
+
+        for(i = 0; i < nblocks; i++) {
+            k1 = mu_lanes64_avx512(ppkeys + key, i * 16, 8);
+            k2 = mu_lanes64_avx512(ppkeys + key, i * 16 + 8, 8);
+
+            k1 = _mm512_mullo_epi64(k1, c1);
+            k1 = _mm512_rol_epi64(k1, 31);
+            k1 = _mm512_mullo_epi64(k1, c2);
+            h1 = _mm512_xor_si512(h1, k1);
+
+            h1 = _mm512_rol_epi64(h1, 27);
+            h1 = _mm512_add_epi64(h1, h2);
+            h1 = _mm512_add_epi64(_mm512_add_epi64(_mm512_slli_epi64(h1, 2), h1), _mm512_set1_epi64(0x52dce729));
+
+            k2 = _mm512_mullo_epi64(k2, c2);
+            k2 = _mm512_rol_epi64(k2, 33);
+            k2 = _mm512_mullo_epi64(k2, c1);
+            h2 = _mm512_xor_si512(h2, k2);
+
+            h2 = _mm512_rol_epi64(h2, 31);
+            h2 = _mm512_add_epi64(h2, h1);
+            h2 = _mm512_add_epi64(_mm512_add_epi64(_mm512_slli_epi64(h2, 2), h2), _mm512_set1_epi64(0x38495ab5));
+        }
+
+        if(tail > 8) {
+            k2 = mu_lanes64_avx512(ppkeys + key, nblocks * 16 + 8, tail - 8);
+            k2 = _mm512_mullo_epi64(k2, c2);
+            k2 = _mm512_rol_epi64(k2, 33);
+            k2 = _mm512_mullo_epi64(k2, c1);
+            h2 = _mm512_xor_si512(h2, k2);
+        }
+        if(tail) {
+            k1 = mu_lanes64_avx512(ppkeys + key, nblocks * 16, tail < 8 ? tail : 8);
+            k1 = _mm512_mullo_epi64(k1, c1);
+            k1 = _mm512_rol_epi64(k1, 31);
+            k1 = _mm512_mullo_epi64(k1, c2);
+            h1 = _mm512_xor_si512(h1, k1);
+        }
+
+        h1 = _mm512_xor_si512(h1, _mm512_set1_epi64(len));
+        h2 = _mm512_xor_si512(h2, _mm512_set1_epi64(len));
+        h1 = _mm512_add_epi64(h1, h2);
+        h2 = _mm512_add_epi64(h2, h1);
+        h1 = mu_fmix64_avx512(h1);
+        h2 = mu_fmix64_avx512(h2);
+        h1 = _mm512_add_epi64(h1, h2);
+        h2 = _mm512_add_epi64(h2, h1);
+
+        // interleaved back into {h1, h2} pairs
+        _mm512_storeu_si512(&pout[key * 2], _mm512_permutex2var_epi64(h1, even, h2));
+        _mm512_storeu_si512(&pout[key * 2 + 8], _mm512_permutex2var_epi64(h1, odd, h2));
+    }
+
+    mu_x64_128_scalar(ppkeys + key, len, seed, pout + key * 2, count - key);
+}
+
+#endif //MU_X86
+
+static mu_multi32_t *mu_multi32 = NULL;
+static mu_multi128_t *mu_multi128 = NULL;
+static mu_isa_t mu_isa = MU_ISA_SCALAR;
+
+int mu_set_isa_i(mu_isa_t isa)
+{
+#ifdef MU_X86
+    __builtin_cpu_init();
+
+    if(MU_ISA_AUTO == isa) {
+        if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+            isa = MU_ISA_AVX512;
+        else if(__builtin_cpu_supports("avx2"))
+            isa = MU_ISA_AVX2;
+        else
+            isa = MU_ISA_SCALAR;
+    }
+
+    if(MU_ISA_AVX512 == isa) {
+        if(!__builtin_cpu_supports("avx512f") || !__builtin_cpu_supports("avx512dq"))
+            return 0;
+        mu_multi32 = mu_x86_32_avx512;
+        mu_multi128 = mu_x64_128_avx512;
+    }
+    else if(MU_ISA_AVX2 == isa) {
+        if(!__builtin_cpu_supports("avx2"))
+            return 0;
+        mu_multi32 = mu_x86_32_avx2;
+        mu_multi128 = mu_x64_128_avx2;
+    }
+#else
+    if(MU_ISA_AUTO == isa)
+        isa = MU_ISA_SCALAR;
+    if(MU_ISA_SCALAR != isa)
+        return 0;
+#endif //MU_X86
+
+    if(MU_ISA_SCALAR == isa) {
+        mu_multi32 = mu_x86_32_scalar;
+        mu_multi128 = mu_x64_128_scalar;
+    }
+
+    mu_isa = isa;
+    return 1;
+}
+
+mu_isa_t mu_get_isa(void)
+{
+    if(NULL == mu_multi32)
+        mu_set_isa_i(MU_ISA_AUTO);
+
+    return mu_isa;
+}
+
+void MurmurHash3_x86_32_multi(void **ppkeys, int len, uint32_t seed, uint32_t *pout, size_t count)
+{
+    if(NULL == mu_multi32)
+        mu_set_isa_i(MU_ISA_AUTO);
+
+    mu_multi32(ppkeys, len, seed, pout, count);
+}
+
+void MurmurHash3_x64_128_multi(void **ppkeys, int len, uint32_t seed, uint64_t *pout, size_t count)
+{
+    if(NULL == mu_multi128)
+        mu_set_isa_i(MU_ISA_AUTO);
+
+    mu_multi128(ppkeys, len, seed, pout, count);
+}
+
+//-----------------------------------------------------------------------------
+
@@ -0,0 +1,2104 @@
+/// @file bench.c
+/// @copyright BSD 2-clause. See LICENSE.txt for the complete license text.
+/// @brief Throughput benchmarks for the hashtable library. Run with the names
+///        of the benchmarks to run (see bench_list), or with no argument to
+///        run all of them.
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif //__GLIBC__
+
+#include "../inc/hashcore.h"
+#include "../inc/hashswiss.h"
+#include "../inc/hashstripe.h"
+#include "../inc/hashepoch.h"
+#include "../inc/hashshard.h"
+#include "../inc/hashsplit.h"
+#include "../inc/hashsnap.h"
+#include "../inc/hashshm.h"
+#include "../inc/hashwal.h"
+#include "../inc/hashload.h"
+#include "../inc/murmur.h"
+#include "../inc/timer.h"
+
+/// The number of keys used by the benchmarks.
+#ifndef BENCH_KEY_COUNT
+#define BENCH_KEY_COUNT 1000000
+#endif //BENCH_KEY_COUNT
+
+/// The largest number of threads of the threads benchmark (or $BENCH_THREADS).
+#ifndef BENCH_THREADS
+#define BENCH_THREADS 8
+#endif //BENCH_THREADS
+
+static void bench_lookup(void);
+static void bench_inline(void);
+static void bench_arena(void);
+static void bench_resize(void);
+static void bench_incremental(void);
+static void bench_index(void);
+static void bench_cuckoo(void);
+static void bench_hash64(void);
+static void bench_batch(void);
+static void bench_insert(void);
+static void bench_hash(void);
+static void bench_hashfunc(void);
+static void bench_threads(void);
+static void bench_epoch(void);
+static void bench_shard(void);
+static void bench_rethread(void);
+static void bench_split(void);
+static void bench_scan(void);
+static void bench_foreach(void);
+static void bench_snapshot(void);
+static void bench_shm(void);
+static void bench_wal(void);
+static void bench_load(void);
+
+/// A named benchmark.
+typedef struct bench {
+    const char *pname;
+    void (*prun)(void);
+} bench_t;
+
+static const bench_t bench_list[] = {
+    { "lookup", bench_lookup },
+    { "inline", bench_inline },
+    { "arena", bench_arena },
+    { "resize", bench_resize },
+    { "incremental", bench_incremental },
+    { "index", bench_index },
+    { "cuckoo", bench_cuckoo },
+    { "hash64", bench_hash64 },
+    { "batch", bench_batch },
+    { "insert", bench_insert },
+    { "hash", bench_hash },
+    { "hashfunc", bench_hashfunc },
+    { "threads", bench_threads },
+    { "epoch", bench_epoch },
+    { "shard", bench_shard },
+    { "rethread", bench_rethread },
+    { "split", bench_split },
+    { "scan", bench_scan },
+    { "foreach", bench_foreach },
+    { "snapshot", bench_snapshot },
+    { "shm", bench_shm },
+    { "wal", bench_wal },
+    { "load", bench_load },
+};
+
+/*!***********************************************************
+ * VISIBLE IMPLEMENTATION
+ ************************************************************/
+
+/*! \brief Runs the benchmarks named on the command line, or all of them.
+ */
+int main(int argc, char *argv[])
+{
+    unsigned int index;
+    int arg;
+    int found;
+
+    for(arg = 1; arg < argc; arg++)
+    {
+        found = 0;
+        for(index = 0; index < sizeof(bench_list) / sizeof(bench_list[0]); index++)
+        {
+            if(0 == strcmp(argv[arg], bench_list[index].pname)) {
+                bench_list[index].prun();
+                found = 1;
+            }
+        }
+
+        if(!found) {
+            fprintf(stderr, "Unknown benchmark \"%s\"\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(argc < 2) {
+        for(index = 0; index < sizeof(bench_list) / sizeof(bench_list[0]); index++)
+            bench_list[index].prun();
+    }
+
+    return 0;
+}
+
+/*!***********************************************************
+ * NON-VISIBLE IMPLEMENTATION
+ ************************************************************/
+
+/*! \brief A small xorshift generator, so that runs are repeatable.
+ */
+static uint32_t bench_random_ui(void)
+{
+    static uint32_t state = 2463534242u;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+/*! \brief Fills pkeys with first, first + 1, ... in a random order.
+ */
+static void bench_shuffled_keys(int *pkeys, int count, int first)
+{
+    int index;
+    int other;
+    int tmp;
+
+    for(index = 0; index < count; index++)
+        pkeys[index] = first + index;
+
+    for(index = count - 1; index > 0; index--)
+    {
+        other = bench_random_ui() % (index + 1);
+        tmp = pkeys[index];
+        pkeys[index] = pkeys[other];
+        pkeys[other] = tmp;
+    }
+}
+
+/*! \brief Millions of operations per second.
+ */
+static double bench_mops(int count, struct timespec t1, struct timespec t2)
+{
+    return count / get_elapsed(t1, t2) / 1e6;
+}
+
+/*! \brief Bytes currently allocated from the heap, mapped blocks included
+ *         (0 where unknown).
+ */
+static size_t bench_heap_bytes(void)
+{
+#ifdef __GLIBC__
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif //__GLIBC__
+}
+
+/*! \brief Hit and miss lookup throughput of one table configuration.
+ */
+static void bench_lookup_table(const char *pname, hash_flags_t flags, int *phits, int *pmisses, int count)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    double hit_rate;
+    double miss_rate;
+    int index;
+    int found = 0;
+
+    ht_init(&table, flags, 0.05);
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &phits[index], sizeof(int), &index, sizeof(index));
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += ht_contains_i(&table, &phits[index], sizeof(int));
+    t2 = snap_time();
+    hit_rate = bench_mops(count, t1, t2);
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += (NULL != ht_get_p(&table, &pmisses[index], sizeof(int), NULL));
+    t2 = snap_time();
+    miss_rate = bench_mops(count, t1, t2);
+
+    fprintf(stderr, "%-16s hit %7.2f Mops/s   miss %7.2f Mops/s   (%d found)\n",
+            pname, hit_rate, miss_rate, found);
+
+    ht_destroy(&table);
+}
+
+/*! \brief Lookup throughput of the chained engine against the fingerprint
+ *         group probes (per instruction set) and Robin Hood probing.
+ */
+static void bench_lookup(void)
+{
+    static const sw_isa_t isas[] = { SW_ISA_AVX2, SW_ISA_SSE2, SW_ISA_SCALAR };
+    static const char *isa_names[] = { "swiss/avx2", "swiss/sse2", "swiss/scalar" };
+    sw_isa_t initial = sw_get_isa();
+    unsigned int isa;
+
+    int count = BENCH_KEY_COUNT;
+    int *phits = malloc(count * sizeof(*phits));
+    int *pmisses = malloc(count * sizeof(*pmisses));
+
+    fprintf(stderr, "-----\nLookup throughput, %d int keys\n", count);
+    bench_shuffled_keys(phits, count, 0);
+    bench_shuffled_keys(pmisses, count, count);
+
+    bench_lookup_table("chained", HT_NONE, phits, pmisses, count);
+    bench_lookup_table("robin hood", HT_ROBIN_HOOD, phits, pmisses, count);
+    bench_lookup_table("cuckoo", HT_CUCKOO, phits, pmisses, count);
+    for(isa = 0; isa < sizeof(isas) / sizeof(isas[0]); isa++)
+    {
+        if(sw_set_isa_i(isas[isa]))
+            bench_lookup_table(isa_names[isa], HT_SWISS, phits, pmisses, count);
+    }
+    sw_set_isa_i(initial);
+
+    free(phits);
+    free(pmisses);
+}
+
+/*! \brief Insert throughput and heap use of one table configuration.
+ *         Runs in a child process so that every configuration starts
+ *         from the same (fresh) heap.
+ */
+static void bench_inline_table(const char *pname, hash_flags_t flags, int *pkeys, int count)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    size_t heap_before;
+    size_t heap_after;
+    int index;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    heap_before = bench_heap_bytes();
+    ht_init(&table, flags, 0.05);
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &index, sizeof(index));
+    t2 = snap_time();
+    heap_after = bench_heap_bytes() - table.array_size * sizeof(*table.pparray);
+
+    fprintf(stderr, "%-16s insert %7.2f Mops/s   %6.1f heap bytes per entry\n",
+            pname, bench_mops(count, t1, t2), (double)(heap_after - heap_before) / count);
+
+    t1 = snap_time();
+    ht_destroy(&table);
+    t2 = snap_time();
+    fprintf(stderr, "%-16s destroy %.3f s\n", pname, get_elapsed(t1, t2));
+    exit(0);
+}
+
+/*! \brief Separately allocated against inline int keys and values.
+ */
+static void bench_inline(void)
+{
+    int count = BENCH_KEY_COUNT;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+
+    fprintf(stderr, "-----\nInsert with inline keys and values, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_inline_table("separate", HT_NONE, pkeys, count);
+    bench_inline_table("inline", HT_INLINE, pkeys, count);
+
+    free(pkeys);
+}
+
+/*! \brief The main_test4 stress scenario (autoresizing then preallocated
+ *         inserts) for one configuration, in a child process.
+ */
+static void bench_arena_table(const char *pname, hash_flags_t flags, int *pkeys, int *pvalues, int count)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    double insert_rate;
+    int index;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    ht_init(&table, flags, 0.05);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pvalues[index], sizeof(int));
+    t2 = snap_time();
+    insert_rate = bench_mops(count, t1, t2);
+
+    t1 = snap_time();
+    ht_clear(&table);
+    t2 = snap_time();
+    fprintf(stderr, "%-24s autoresize insert %6.2f Mops/s   clear %.3f s\n",
+            pname, insert_rate, get_elapsed(t1, t2));
+
+    ht_resize(&table, 4194304);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pvalues[index], sizeof(int));
+    t2 = snap_time();
+    insert_rate = bench_mops(count, t1, t2);
+
+    t1 = snap_time();
+    ht_destroy(&table);
+    t2 = snap_time();
+    fprintf(stderr, "%-24s preallocated insert %6.2f Mops/s   destroy %.3f s\n",
+            pname, insert_rate, get_elapsed(t1, t2));
+    exit(0);
+}
+
+/*! \brief Insert and teardown with and without the per-table arena.
+ */
+static void bench_arena(void)
+{
+    int count = BENCH_KEY_COUNT;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    int *pvalues = malloc(count * sizeof(*pvalues));
+    int index;
+
+    fprintf(stderr, "-----\nStress scenario with and without arena, %d int keys\n", count);
+    for(index = 0; index < count; index++)
+    {
+        pkeys[index] = index;
+        pvalues[index] = (int)bench_random_ui();
+    }
+
+    bench_arena_table("const", HT_KEY_CONST | HT_VALUE_CONST, pkeys, pvalues, count);
+    bench_arena_table("const + arena", HT_KEY_CONST | HT_VALUE_CONST | HT_ARENA, pkeys, pvalues, count);
+    bench_arena_table("copied", HT_NONE, pkeys, pvalues, count);
+    bench_arena_table("copied + arena", HT_ARENA, pkeys, pvalues, count);
+    bench_arena_table("copied + inline + arena", HT_INLINE | HT_ARENA, pkeys, pvalues, count);
+
+    free(pkeys);
+    free(pvalues);
+}
+
+/*! \brief Explicit resizes and lookups on collided chains with long keys,
+ *         which the hash stored in each entry keeps from rehashing and
+ *         from comparing keys byte by byte.
+ */
+static void bench_resize(void)
+{
+    static const unsigned int sizes[] = { 1u << 20, 1u << 10, 1u << 20 };
+    int count = BENCH_KEY_COUNT / 4;
+    size_t key_size = 256;
+    char *pkeys = malloc(count * key_size);
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    unsigned int size;
+    int index;
+    int found = 0;
+
+    fprintf(stderr, "-----\nResize and collided lookups, %d keys of %zu bytes\n", count, key_size);
+
+    // keys share everything but their last bytes
+    memset(pkeys, 'k', count * key_size);
+    for(index = 0; index < count; index++)
+        memcpy(pkeys + (index + 1) * key_size - sizeof(index), &index, sizeof(index));
+
+    ht_init(&table, HT_KEY_CONST | HT_VALUE_CONST | HT_NO_AUTORESIZE, 0.05);
+    for(index = 0; index < count; index++)
+        ht_insert(&table, pkeys + index * key_size, key_size, &index, sizeof(index));
+
+    for(size = 0; size < sizeof(sizes) / sizeof(sizes[0]); size++)
+    {
+        t1 = snap_time();
+        ht_resize(&table, sizes[size]);
+        t2 = snap_time();
+        fprintf(stderr, "resize to %-8u %.3f s\n", sizes[size], get_elapsed(t1, t2));
+    }
+
+    // about 64 keys per chain
+    ht_resize(&table, count / 64);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += ht_contains_i(&table, pkeys + index * key_size, key_size);
+    t2 = snap_time();
+    fprintf(stderr, "collided lookup  %7.2f Mops/s   (%d found, %zu buckets)\n",
+            bench_mops(count, t1, t2), found, table.array_size);
+
+    ht_destroy(&table);
+    free(pkeys);
+}
+
+/*! \brief Insert throughput and worst single insert of one configuration,
+ *         in a child process.
+ */
+static void bench_incremental_table(const char *pname, hash_flags_t flags, unsigned int budget, int *pkeys, int count)
+{
+    hash_table_t table;
+    struct timespec t0;
+    struct timespec t1;
+    struct timespec t2;
+    double latency;
+    double max_latency = 0.0;
+    int index;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    ht_init(&table, flags, 0.05);
+    ht_set_migrate_budget(&table, budget);
+
+    t0 = snap_time();
+    t1 = t0;
+    for(index = 0; index < count; index++)
+    {
+        ht_insert(&table, &pkeys[index], sizeof(int), &index, sizeof(index));
+        t2 = snap_time();
+        latency = get_elapsed(t1, t2);
+        if(latency > max_latency)
+            max_latency = latency;
+        t1 = t2;
+    }
+
+    fprintf(stderr, "%-20s insert %6.2f Mops/s   max single insert %9.1f us\n",
+            pname, bench_mops(count, t0, t2), max_latency * 1e6);
+
+    ht_destroy(&table);
+    exit(0);
+}
+
+/*! \brief Worst insert latency of a stop-the-world resize against
+ *         incremental resizes with several migration budgets.
+ */
+static void bench_incremental(void)
+{
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+
+    fprintf(stderr, "-----\nInsert latency with incremental resize, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_incremental_table("stop the world", HT_NONE, HT_MIGRATE_BUDGET, pkeys, count);
+    bench_incremental_table("incremental/8", HT_INCREMENTAL, 8, pkeys, count);
+    bench_incremental_table("incremental/64", HT_INCREMENTAL, 64, pkeys, count);
+    bench_incremental_table("incremental/512", HT_INCREMENTAL, 512, pkeys, count);
+
+    free(pkeys);
+}
+
+/*! \brief Hashes reduced to bucket indexes per second, for one policy.
+ *         Each reduction depends on the previous one, as a lookup waits
+ *         for its index before loading the bucket.
+ */
+static void bench_index_reduce(const char *pname, hash_flags_t flags, unsigned int size, uint32_t *phashes, int count)
+{
+    struct timespec t1;
+    struct timespec t2;
+    unsigned int sum = 0;
+    int round;
+    int index;
+
+    t1 = snap_time();
+    for(round = 0; round < 10; round++)
+    {
+        for(index = 0; index < count; index++)
+            sum += ht_reduce_sz(flags, phashes[index] ^ sum, size);
+    }
+    t2 = snap_time();
+
+    fprintf(stderr, "%-16s %8u buckets   %8.2f M reductions/s   (sum %u)\n",
+            pname, size, bench_mops(count * 10, t1, t2), sum);
+}
+
+/*! \brief The bucket reduction alone, then int key lookups, with the
+ *         default modulo against HT_POW2 and HT_FASTRANGE.
+ */
+static void bench_index(void)
+{
+    int count = BENCH_KEY_COUNT;
+    uint32_t *phashes = malloc(count * sizeof(*phashes));
+    int *phits = malloc(count * sizeof(*phits));
+    int *pmisses = malloc(count * sizeof(*pmisses));
+    int index;
+
+    fprintf(stderr, "-----\nBucket index policies, %d hashes / int keys\n", count);
+    for(index = 0; index < count; index++)
+        phashes[index] = bench_random_ui();
+
+    bench_index_reduce("modulo", HT_NONE, 4194304, phashes, count);
+    bench_index_reduce("modulo", HT_NONE, 4000037, phashes, count);
+    bench_index_reduce("pow2", HT_POW2, 4194304, phashes, count);
+    bench_index_reduce("fastrange", HT_FASTRANGE, 4000037, phashes, count);
+
+    bench_shuffled_keys(phits, count, 0);
+    bench_shuffled_keys(pmisses, count, count);
+    bench_lookup_table("chained modulo", HT_NONE, phits, pmisses, count);
+    bench_lookup_table("chained pow2", HT_POW2, phits, pmisses, count);
+    bench_lookup_table("chained fastrng", HT_FASTRANGE, phits, pmisses, count);
+    bench_lookup_table("robin modulo", HT_ROBIN_HOOD, phits, pmisses, count);
+    bench_lookup_table("robin pow2", HT_ROBIN_HOOD | HT_POW2, phits, pmisses, count);
+
+    free(phashes);
+    free(phits);
+    free(pmisses);
+}
+
+/*! \brief Insert throughput and worst case probe of one engine.
+ */
+static void bench_cuckoo_table(const char *pname, hash_flags_t flags, int *pkeys, int count)
+{
+    hash_table_t table;
+    hash_probe_stats_t stats;
+    struct timespec t1;
+    struct timespec t2;
+    int index;
+
+    ht_init(&table, flags, 0.05);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &index, sizeof(index));
+    t2 = snap_time();
+
+    ht_probe_stats(&table, &stats);
+    fprintf(stderr, "%-12s insert %6.2f Mops/s   probe mean %.3f max %2u   load %.3f   "
+            "%u failed inserts, %u rehashes\n",
+            pname, bench_mops(count, t1, t2), stats.mean_probe, stats.max_probe,
+            (double)table.key_count / table.array_size, stats.insert_failures, stats.rehashes);
+
+    ht_destroy(&table);
+}
+
+/*! \brief The cuckoo engine at high load, against the engines whose worst
+ *         probe is not bounded. Probes count chain nodes, slots or buckets.
+ */
+static void bench_cuckoo(void)
+{
+    // 89% of 2^20 cuckoo slots, right below its growth threshold
+    int count = 933000;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+
+    fprintf(stderr, "-----\nWorst case probes, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_cuckoo_table("chained", HT_NONE, pkeys, count);
+    bench_cuckoo_table("robin hood", HT_ROBIN_HOOD, pkeys, count);
+    bench_cuckoo_table("cuckoo", HT_CUCKOO, pkeys, count);
+
+    free(pkeys);
+}
+
+/*! \brief Insert and lookup throughput of tables of count keys, built and
+ *         destroyed again until BENCH_KEY_COUNT keys were inserted in all.
+ */
+static void bench_hash64_table(const char *pname, hash_flags_t flags, int count)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    double insert_time = 0;
+    double lookup_time = 0;
+    int rounds = BENCH_KEY_COUNT / count;
+    int round;
+    int index;
+    int found = 0;
+
+    for(round = 0; round < rounds; round++)
+    {
+        ht_init(&table, flags, 0.05);
+        t1 = snap_time();
+        for(index = 0; index < count; index++)
+            ht_insert(&table, &index, sizeof(index), &index, sizeof(index));
+        t2 = snap_time();
+        insert_time += get_elapsed(t1, t2);
+
+        t1 = snap_time();
+        for(index = 0; index < count; index++)
+            found += ht_contains_i(&table, &index, sizeof(index));
+        t2 = snap_time();
+        lookup_time += get_elapsed(t1, t2);
+        ht_destroy(&table);
+    }
+
+    fprintf(stderr, "%-14s %6d keys   insert %6.2f Mops/s   lookup %6.2f Mops/s   (%d found)\n",
+            pname, count, (double)count * rounds / insert_time / 1e6,
+            (double)count * rounds / lookup_time / 1e6, found);
+}
+
+/*! \brief The 32-bit hash against HT_HASH64 on every engine, down to tables
+ *         small enough that the hash is most of the cost of an operation.
+ */
+static void bench_hash64(void)
+{
+    static const hash_flags_t engines[] = { HT_NONE, HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO };
+    static const char *engine_names[] = { "chained", "robin hood", "swiss", "cuckoo" };
+    static const int counts[] = { 100, 1000, 100000 };
+    char name[32];
+    unsigned int count;
+    unsigned int engine;
+
+    fprintf(stderr, "-----\n32 against 64-bit hashes, int keys\n");
+    for(count = 0; count < sizeof(counts) / sizeof(counts[0]); count++)
+    {
+        for(engine = 0; engine < sizeof(engines) / sizeof(engines[0]); engine++)
+        {
+            bench_hash64_table(engine_names[engine], engines[engine], counts[count]);
+            snprintf(name, sizeof(name), "%s/64", engine_names[engine]);
+            bench_hash64_table(name, engines[engine] | HT_HASH64, counts[count]);
+        }
+    }
+}
+
+/*! \brief Lookups of shuffled keys one ht_get_p at a time, then by batches
+ *         of batch_size keys, half of them hits.
+ */
+static void bench_batch_table(const char *pname, hash_flags_t flags, int *pkeys, int count, int batch_size)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    double single_rate;
+    double batch_rate;
+    void **ppkeys = malloc(count * sizeof(*ppkeys));
+    size_t *pkey_sizes = malloc(count * sizeof(*pkey_sizes));
+    void **ppvalues = malloc(batch_size * sizeof(*ppvalues));
+    size_t *pvalue_sizes = malloc(batch_size * sizeof(*pvalue_sizes));
+    int index;
+    int batch;
+    int found = 0;
+
+    ht_init(&table, flags, 0.05);
+    for(index = 0; index < count; index += 2)
+        ht_insert(&table, &index, sizeof(index), &index, sizeof(index));
+    for(index = 0; index < count; index++)
+    {
+        ppkeys[index] = &pkeys[index];
+        pkey_sizes[index] = sizeof(int);
+    }
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += (NULL != ht_get_p(&table, &pkeys[index], sizeof(int), NULL));
+    t2 = snap_time();
+    single_rate = bench_mops(count, t1, t2);
+
+    t1 = snap_time();
+    for(index = 0; index + batch_size <= count; index += batch_size)
+    {
+        ht_get_batch(&table, ppkeys + index, pkey_sizes + index, batch_size, ppvalues, pvalue_sizes);
+        for(batch = 0; batch < batch_size; batch++)
+            found += (NULL != ppvalues[batch]);
+    }
+    t2 = snap_time();
+    batch_rate = bench_mops(index, t1, t2);
+
+    fprintf(stderr, "%-12s single %6.2f Mops/s   batch %6.2f Mops/s   x%.2f   (%d found)\n",
+            pname, single_rate, batch_rate, batch_rate / single_rate, found);
+
+    ht_destroy(&table);
+    free(ppkeys);
+    free(pkey_sizes);
+    free(ppvalues);
+    free(pvalue_sizes);
+}
+
+/*! \brief Batched lookups against a loop over ht_get_p, on tables several
+ *         times larger than the last level cache.
+ */
+static void bench_batch(void)
+{
+    int count = BENCH_KEY_COUNT * 4;
+    int batch_size = 256;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+
+    fprintf(stderr, "-----\nBatched lookups, %d int keys (%d in the table), batches of %d\n",
+            count, count / 2, batch_size);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_batch_table("chained", HT_NONE, pkeys, count, batch_size);
+    bench_batch_table("inline arena", HT_INLINE | HT_ARENA, pkeys, count, batch_size);
+    bench_batch_table("robin hood", HT_ROBIN_HOOD, pkeys, count, batch_size);
+    bench_batch_table("swiss", HT_SWISS, pkeys, count, batch_size);
+    bench_batch_table("cuckoo", HT_CUCKOO, pkeys, count, batch_size);
+
+    free(pkeys);
+}
+
+/*! \brief Insert throughput of one engine: a loop over ht_insert from the
+ *         initial size, the same loop on a table resized beforehand (as in
+ *         main_test4), and ht_insert_batch from the initial size.
+ */
+static void bench_insert_table(const char *pname, hash_flags_t flags, int *pkeys, int count)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    double rates[3];
+    void **ppkeys = malloc(count * sizeof(*ppkeys));
+    size_t *psizes = malloc(count * sizeof(*psizes));
+    int run;
+    int index;
+
+    for(index = 0; index < count; index++)
+    {
+        ppkeys[index] = &pkeys[index];
+        psizes[index] = sizeof(int);
+    }
+
+    for(run = 0; run < 3; run++)
+    {
+        ht_init(&table, flags, 0.05);
+        if(1 == run)
+            ht_resize(&table, 4194304);
+
+        t1 = snap_time();
+        if(2 == run)
+            ht_insert_batch(&table, ppkeys, psizes, ppkeys, psizes, count);
+        else
+            for(index = 0; index < count; index++)
+                ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+        t2 = snap_time();
+        rates[run] = bench_mops(count, t1, t2);
+
+        ht_destroy(&table);
+    }
+
+    fprintf(stderr, "%-12s autoresize %6.2f   preallocated %6.2f   batch %6.2f Mops/s   x%.2f / x%.2f\n",
+            pname, rates[0], rates[1], rates[2], rates[2] / rates[0], rates[2] / rates[1]);
+
+    free(ppkeys);
+    free(psizes);
+}
+
+/*! \brief Batched inserts against the two loops of main_test4.
+ */
+static void bench_insert(void)
+{
+    int count = BENCH_KEY_COUNT;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+
+    fprintf(stderr, "-----\nInserts, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_insert_table("chained", HT_NONE, pkeys, count);
+    bench_insert_table("arena", HT_ARENA, pkeys, count);
+    bench_insert_table("inline arena", HT_INLINE | HT_ARENA, pkeys, count);
+    bench_insert_table("robin hood", HT_ROBIN_HOOD, pkeys, count);
+    bench_insert_table("swiss", HT_SWISS, pkeys, count);
+    bench_insert_table("cuckoo", HT_CUCKOO, pkeys, count);
+
+    free(pkeys);
+}
+
+/*! \brief Hash throughput by key length: the multi-key murmur kernels on
+ *         every instruction set the cpu has, HT_BATCH_GROUP keys per call
+ *         as the batched paths use them.
+ */
+static void bench_hash(void)
+{
+    static const mu_isa_t isas[] = { MU_ISA_SCALAR, MU_ISA_AVX2, MU_ISA_AVX512 };
+    static const char *isa_names[] = { "scalar", "avx2", "avx512" };
+    static const int lengths[] = { 4, 8, 16, 32, 64 };
+    mu_isa_t initial = mu_get_isa();
+    int count = BENCH_KEY_COUNT;
+    char *pbuffer = malloc((size_t)count * 64);
+    void **ppkeys = malloc(count * sizeof(*ppkeys));
+    uint32_t hash32[HT_BATCH_GROUP];
+    uint64_t hash128[HT_BATCH_GROUP * 2];
+    uint64_t sink = 0;
+    struct timespec t1;
+    struct timespec t2;
+    double rate32;
+    unsigned int isa;
+    unsigned int length;
+    int index;
+
+    fprintf(stderr, "-----\nMulti-key murmur, %d keys, %d per call\n", count, HT_BATCH_GROUP);
+    for(index = 0; index < count * 64; index++)
+        pbuffer[index] = (char)bench_random_ui();
+    for(index = 0; index < count; index++)
+        ppkeys[index] = pbuffer + (size_t)index * 64;
+
+    for(length = 0; length < sizeof(lengths) / sizeof(lengths[0]); length++)
+    {
+        for(isa = 0; isa < sizeof(isas) / sizeof(isas[0]); isa++)
+        {
+            if(!mu_set_isa_i(isas[isa]))
+                continue;
+
+            t1 = snap_time();
+            for(index = 0; index + HT_BATCH_GROUP <= count; index += HT_BATCH_GROUP)
+            {
+                MurmurHash3_x86_32_multi(ppkeys + index, lengths[length], 42, hash32, HT_BATCH_GROUP);
+                sink += hash32[0];
+            }
+            t2 = snap_time();
+            rate32 = bench_mops(index, t1, t2);
+
+            t1 = snap_time();
+            for(index = 0; index + HT_BATCH_GROUP <= count; index += HT_BATCH_GROUP)
+            {
+                MurmurHash3_x64_128_multi(ppkeys + index, lengths[length], 42, hash128, HT_BATCH_GROUP);
+                sink += hash128[0];
+            }
+            t2 = snap_time();
+
+            fprintf(stderr, "%2d bytes %-7s x86_32 %7.2f Mkeys/s   x64_128 %7.2f Mkeys/s\n",
+                    lengths[length], isa_names[isa], rate32, bench_mops(index, t1, t2));
+        }
+    }
+    fprintf(stderr, "(checksum %llu)\n", (unsigned long long)sink);
+
+    mu_set_isa_i(initial);
+    free(pbuffer);
+    free(ppkeys);
+}
+
+/*! \brief Lookup throughput and chain length distribution of one hash
+ *         function (picked by flags) on count keys of key_size bytes.
+ */
+static void bench_hashfunc_table(const char *pname, hash_flags_t flags, char *pkeys, size_t key_size, int count)
+{
+    hash_table_t table;
+    hash_probe_stats_t stats;
+    struct timespec t1;
+    struct timespec t2;
+    double hash_rate;
+    double chained_rate;
+    size_t longer = 0;
+    uint64_t sink = 0;
+    int index;
+    int found = 0;
+
+    ht_init(&table, flags, 0.05);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        sink += ht_hash_ul(&table, pkeys + (size_t)index * key_size, key_size);
+    t2 = snap_time();
+    hash_rate = bench_mops(count, t1, t2);
+    found += (0 == sink);
+
+    for(index = 0; index < count; index++)
+        ht_insert(&table, pkeys + (size_t)index * key_size, key_size, &index, sizeof(index));
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += ht_contains_i(&table, pkeys + (size_t)index * key_size, key_size);
+    t2 = snap_time();
+    chained_rate = bench_mops(count, t1, t2);
+
+    ht_probe_stats(&table, &stats);
+    for(index = 3; index < HT_PROBE_HISTOGRAM_SIZE; index++)
+        longer += stats.histogram[index];
+    ht_destroy(&table);
+
+    ht_init(&table, flags | HT_SWISS, 0.05);
+    for(index = 0; index < count; index++)
+        ht_insert(&table, pkeys + (size_t)index * key_size, key_size, &index, sizeof(index));
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += ht_contains_i(&table, pkeys + (size_t)index * key_size, key_size);
+    t2 = snap_time();
+
+    fprintf(stderr, "%-8s hash %7.2f Mkeys/s   chained %6.2f Mops/s   swiss %6.2f Mops/s   "
+            "chain mean %.3f max %2u   1:%zu 2:%zu 3:%zu 4+:%zu   (%d found)\n",
+            pname, hash_rate, chained_rate, bench_mops(count, t1, t2), stats.mean_probe, stats.max_probe,
+            stats.histogram[0], stats.histogram[1], stats.histogram[2],
+            longer, found);
+
+    ht_destroy(&table);
+}
+
+/*! \brief The bundled hash functions (HT_HASH_ flags) against each other,
+ *         on sequential int keys (which a weak hash maps to few chains)
+ *         and on random 8 and 16 byte keys.
+ */
+static void bench_hashfunc(void)
+{
+    static const hash_flags_t hashes[] = { HT_HASH_MURMUR, HT_HASH_MIX, HT_HASH_CRC32C };
+    static const char *hash_names[] = { "murmur", "mix", "crc32c" };
+    static const size_t key_sizes[] = { 8, 16 };
+    int count = BENCH_KEY_COUNT;
+    char *pkeys = malloc((size_t)count * 16);
+    unsigned int hash;
+    unsigned int size;
+    int index;
+
+    fprintf(stderr, "-----\nHash functions, %d keys\n", count);
+
+    fprintf(stderr, "4 byte sequential keys\n");
+    bench_shuffled_keys((int *)pkeys, count, 0);
+    for(hash = 0; hash < sizeof(hashes) / sizeof(hashes[0]); hash++)
+        bench_hashfunc_table(hash_names[hash], hashes[hash], pkeys, sizeof(int), count);
+
+    for(index = 0; index < count * 4; index++)
+        ((uint32_t *)pkeys)[index] = bench_random_ui();
+    for(size = 0; size < sizeof(key_sizes) / sizeof(key_sizes[0]); size++)
+    {
+        fprintf(stderr, "%zu byte random keys\n", key_sizes[size]);
+        for(hash = 0; hash < sizeof(hashes) / sizeof(hashes[0]); hash++)
+            bench_hashfunc_table(hash_names[hash], hashes[hash], pkeys, key_sizes[size], count);
+    }
+
+    free(pkeys);
+}
+
+/// The table of one run of the threads benchmark, behind one of the locking schemes.
+typedef struct bench_shared {
+    /// The striped table (stripe_count > 0).
+    hash_table_striped_t striped;
+    /// The plain table behind the global mutex (stripe_count == 0).
+    hash_table_t table;
+    pthread_mutex_t mutex;
+    size_t stripe_count;
+    /// The percentage of operations that are inserts.
+    int write_percent;
+    /// The number of operations of each thread.
+    int ops;
+} bench_shared_t;
+
+/// The state of one thread of the threads benchmark.
+typedef struct bench_thread {
+    bench_shared_t *pshared;
+    uint32_t seed;
+    int found;
+} bench_thread_t;
+
+/*! \brief Random lookups and inserts (replacing the values of existing keys)
+ *         on the shared table.
+ */
+static void *bench_threads_worker(void *parg)
+{
+    bench_thread_t *pworker = parg;
+    bench_shared_t *pshared = pworker->pshared;
+    uint32_t state = pworker->seed;
+    size_t value_size;
+    int value;
+    int key;
+    int op;
+
+    for(op = 0; op < pshared->ops; op++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        key = (int)(state % BENCH_KEY_COUNT);
+
+        if((int)((state >> 8) % 100) < pshared->write_percent) {
+            if(0 == pshared->stripe_count) {
+                pthread_mutex_lock(&pshared->mutex);
+                ht_insert(&pshared->table, &key, sizeof(key), &op, sizeof(op));
+                pthread_mutex_unlock(&pshared->mutex);
+            }
+            else
+                hts_insert(&pshared->striped, &key, sizeof(key), &op, sizeof(op));
+        }
+        else {
+            value_size = sizeof(value);
+            if(0 == pshared->stripe_count) {
+                pthread_mutex_lock(&pshared->mutex);
+                pworker->found += (NULL != ht_get_p(&pshared->table, &key, sizeof(key), NULL));
+                pthread_mutex_unlock(&pshared->mutex);
+            }
+            else
+                pworker->found += hts_get_i(&pshared->striped, &key, sizeof(key), &value, &value_size);
+        }
+    }
+
+    return NULL;
+}
+
+/*! \brief Throughput of thread_count threads sharing one table of
+ *         BENCH_KEY_COUNT keys, with a global mutex (stripe_count 0)
+ *         or stripe_count reader-writer locks.
+ */
+static double bench_threads_run(size_t stripe_count, int write_percent, int thread_count)
+{
+    bench_shared_t shared;
+    bench_thread_t *pthreads = malloc(thread_count * sizeof(*pthreads));
+    pthread_t *pids = malloc(thread_count * sizeof(*pids));
+    struct timespec t1;
+    struct timespec t2;
+    int index;
+
+    shared.stripe_count = stripe_count;
+    shared.write_percent = write_percent;
+    shared.ops = BENCH_KEY_COUNT / thread_count;
+    if(0 == stripe_count) {
+        ht_init(&shared.table, HT_NONE, 0.05);
+        pthread_mutex_init(&shared.mutex, NULL);
+    }
+    else
+        hts_init(&shared.striped, HT_NONE, 0.05, stripe_count);
+
+    for(index = 0; index < BENCH_KEY_COUNT; index++)
+    {
+        if(0 == stripe_count)
+            ht_insert(&shared.table, &index, sizeof(index), &index, sizeof(index));
+        else
+            hts_insert(&shared.striped, &index, sizeof(index), &index, sizeof(index));
+    }
+
+    t1 = snap_time();
+    for(index = 0; index < thread_count; index++)
+    {
+        pthreads[index].pshared = &shared;
+        pthreads[index].seed = 2463534242u + 7919u * index;
+        pthreads[index].found = 0;
+        pthread_create(&pids[index], NULL, bench_threads_worker, &pthreads[index]);
+    }
+    for(index = 0; index < thread_count; index++)
+        pthread_join(pids[index], NULL);
+    t2 = snap_time();
+
+    if(0 == stripe_count) {
+        ht_destroy(&shared.table);
+        pthread_mutex_destroy(&shared.mutex);
+    }
+    else
+        hts_destroy(&shared.striped);
+
+    free(pthreads);
+    free(pids);
+    return bench_mops(shared.ops * thread_count, t1, t2);
+}
+
+/*! \brief Scaling of the striped table against a global mutex, for 1, 2,
+ *         4... up to $BENCH_THREADS threads (BENCH_THREADS by default) and
+ *         the write percentages listed in $BENCH_WRITES ("0,10,50" by default).
+ */
+static void bench_threads(void)
+{
+    const char *pthreads_env = getenv("BENCH_THREADS");
+    const char *pwrites_env = getenv("BENCH_WRITES");
+    char writes[64];
+    char *pwrite;
+    int max_threads = (NULL != pthreads_env) ? atoi(pthreads_env) : BENCH_THREADS;
+    int threads;
+
+    snprintf(writes, sizeof(writes), "%s", (NULL != pwrites_env) ? pwrites_env : "0,10,50");
+    fprintf(stderr, "-----\nThreads sharing a table, %d keys, %d ops per run, %ld cpus\n",
+            BENCH_KEY_COUNT, BENCH_KEY_COUNT, sysconf(_SC_NPROCESSORS_ONLN));
+
+    for(pwrite = strtok(writes, ","); NULL != pwrite; pwrite = strtok(NULL, ","))
+    {
+        fprintf(stderr, "%d%% writes\n", atoi(pwrite));
+        for(threads = 1; threads <= max_threads; threads *= 2)
+        {
+            fprintf(stderr, "%3d threads   mutex %6.2f Mops/s   1 stripe %6.2f Mops/s   %d stripes %6.2f Mops/s\n",
+                    threads, bench_threads_run(0, atoi(pwrite), threads),
+                    bench_threads_run(1, atoi(pwrite), threads),
+                    HTS_STRIPE_COUNT, bench_threads_run(HTS_STRIPE_COUNT, atoi(pwrite), threads));
+        }
+    }
+}
+
+/// The table of one run of the epoch benchmark.
+typedef struct bench_epoch_shared {
+    /// The lock-free table (striped == 0).
+    hash_table_t table;
+    /// The table behind reader-writer stripes (striped == 1).
+    hash_table_striped_t locked;
+    int striped;
+    /// The lookups of each reader.
+    int ops;
+    /// Set once every reader is done, the writer stops.
+    int done;
+    /// The number of values the writer replaced.
+    long writes;
+} bench_epoch_shared_t;
+
+/// A reader thread of the epoch benchmark.
+typedef struct bench_epoch_reader {
+    bench_epoch_shared_t *pshared;
+    uint32_t seed;
+    int found;
+} bench_epoch_reader_t;
+
+/*! \brief Random lookups, each in its own epoch (or under its stripe lock).
+ */
+static void *bench_epoch_read(void *parg)
+{
+    bench_epoch_reader_t *preader = parg;
+    bench_epoch_shared_t *pshared = preader->pshared;
+    hash_epoch_record_t *precord = pshared->striped ? NULL : ep_register_p(pshared->table.pepoch);
+    uint32_t state = preader->seed;
+    size_t value_size;
+    int *pvalue;
+    int value;
+    int key;
+    int op;
+
+    for(op = 0; op < pshared->ops; op++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        key = (int)(state % BENCH_KEY_COUNT);
+
+        if(pshared->striped) {
+            value_size = sizeof(value);
+            preader->found += hts_get_i(&pshared->locked, &key, sizeof(key), &value, &value_size);
+        }
+        else {
+            ep_enter(precord);
+            pvalue = ht_get_p(&pshared->table, &key, sizeof(key), NULL);
+            preader->found += (NULL != pvalue && *pvalue >= 0);
+            ep_exit(precord);
+        }
+    }
+
+    if(NULL != precord)
+        ep_unregister(precord);
+    return NULL;
+}
+
+/*! \brief Replaces random values until the readers are done.
+ */
+static void *bench_epoch_write(void *parg)
+{
+    bench_epoch_shared_t *pshared = parg;
+    uint32_t state = 88675123u;
+    int key;
+
+    while(!__atomic_load_n(&pshared->done, __ATOMIC_ACQUIRE))
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        key = (int)(state % BENCH_KEY_COUNT);
+
+        if(pshared->striped)
+            hts_insert(&pshared->locked, &key, sizeof(key), &key, sizeof(key));
+        else
+            ht_insert(&pshared->table, &key, sizeof(key), &key, sizeof(key));
+        pshared->writes++;
+    }
+
+    return NULL;
+}
+
+/*! \brief Lookup throughput of reader_count readers, with one writer
+ *         replacing values alongside, on a table of BENCH_KEY_COUNT keys.
+ */
+static double bench_epoch_run(int striped, int reader_count, long *pwrites)
+{
+    bench_epoch_shared_t shared;
+    bench_epoch_reader_t *preaders = malloc(reader_count * sizeof(*preaders));
+    pthread_t *pids = malloc(reader_count * sizeof(*pids));
+    pthread_t writer;
+    struct timespec t1;
+    struct timespec t2;
+    int index;
+
+    shared.striped = striped;
+    shared.ops = BENCH_KEY_COUNT;
+    shared.done = 0;
+    shared.writes = 0;
+    if(striped)
+        hts_init(&shared.locked, HT_NONE, 0.05, HTS_STRIPE_COUNT);
+    else
+        ht_init(&shared.table, HT_EPOCH, 0.05);
+
+    for(index = 0; index < BENCH_KEY_COUNT; index++)
+    {
+        if(striped)
+            hts_insert(&shared.locked, &index, sizeof(index), &index, sizeof(index));
+        else
+            ht_insert(&shared.table, &index, sizeof(index), &index, sizeof(index));
+    }
+
+    pthread_create(&writer, NULL, bench_epoch_write, &shared);
+    t1 = snap_time();
+    for(index = 0; index < reader_count; index++)
+    {
+        preaders[index].pshared = &shared;
+        preaders[index].seed = 2463534242u + 7919u * index;
+        preaders[index].found = 0;
+        pthread_create(&pids[index], NULL, bench_epoch_read, &preaders[index]);
+    }
+    for(index = 0; index < reader_count; index++)
+        pthread_join(pids[index], NULL);
+    t2 = snap_time();
+    __atomic_store_n(&shared.done, 1, __ATOMIC_RELEASE);
+    pthread_join(writer, NULL);
+
+    *pwrites = shared.writes;
+    if(striped)
+        hts_destroy(&shared.locked);
+    else
+        ht_destroy(&shared.table);
+
+    free(preaders);
+    free(pids);
+    return bench_mops(BENCH_KEY_COUNT * reader_count, t1, t2);
+}
+
+/*! \brief Scaling of the lock-free HT_EPOCH lookups against reader-writer
+ *         stripes, for 1, 2, 4... readers up to every cpu (or $BENCH_THREADS),
+ *         each run with one writer replacing values the whole time.
+ */
+static void bench_epoch(void)
+{
+    const char *pthreads_env = getenv("BENCH_THREADS");
+    int max_readers = (NULL != pthreads_env) ? atoi(pthreads_env) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    double locked_rate;
+    long locked_writes;
+    long writes;
+    int readers;
+
+    fprintf(stderr, "-----\nLock-free readers and one writer, %d keys, %d lookups per reader, %ld cpus\n",
+            BENCH_KEY_COUNT, BENCH_KEY_COUNT, sysconf(_SC_NPROCESSORS_ONLN));
+
+    // powers of two, and every cpu last
+    for(readers = 1; readers > 0; readers = (readers < max_readers && readers * 2 > max_readers) ?
+                                            max_readers : readers * 2)
+    {
+        if(readers > max_readers)
+            break;
+
+        locked_rate = bench_epoch_run(1, readers, &locked_writes);
+        fprintf(stderr, "%3d readers   stripes %6.2f Mops/s (%ld writes)   epoch %6.2f Mops/s",
+                readers, locked_rate, locked_writes, bench_epoch_run(0, readers, &writes));
+        fprintf(stderr, " (%ld writes)\n", writes);
+    }
+}
+
+/*! \brief Insert throughput and worst single insert of a sharded table, in
+ *         a child process. With one shard, every resize moves the whole table.
+ */
+static void bench_shard_latency(size_t shard_count, int *pkeys, int count)
+{
+    hash_table_sharded_t hs;
+    struct timespec t0;
+    struct timespec t1;
+    struct timespec t2;
+    double latency;
+    double max_latency = 0.0;
+    int index;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    hs_init(&hs, HT_NONE, 0.05, shard_count);
+
+    t0 = snap_time();
+    t1 = t0;
+    for(index = 0; index < count; index++)
+    {
+        hs_insert(&hs, &pkeys[index], sizeof(int), &index, sizeof(index));
+        t2 = snap_time();
+        latency = get_elapsed(t1, t2);
+        if(latency > max_latency)
+            max_latency = latency;
+        t1 = t2;
+    }
+
+    fprintf(stderr, "%3zu shards     insert %6.2f Mops/s   max single insert %9.1f us\n",
+            shard_count, bench_mops(count, t0, t2), max_latency * 1e6);
+
+    hs_destroy(&hs);
+    exit(0);
+}
+
+/// A writer thread of the shard benchmark.
+typedef struct bench_shard_writer {
+    hash_table_sharded_t *phs;
+    int *pkeys;
+    int count;
+} bench_shard_writer_t;
+
+/*! \brief Inserts the keys of its range.
+ */
+static void *bench_shard_write(void *parg)
+{
+    bench_shard_writer_t *pwriter = parg;
+    int index;
+
+    for(index = 0; index < pwriter->count; index++)
+        hs_insert(pwriter->phs, &pwriter->pkeys[index], sizeof(int), &index, sizeof(index));
+
+    return NULL;
+}
+
+/*! \brief Insert throughput of thread_count writers filling an empty
+ *         sharded table, each with its own part of the keys.
+ */
+static double bench_shard_run(size_t shard_count, int thread_count, int *pkeys, int count)
+{
+    hash_table_sharded_t hs;
+    bench_shard_writer_t *pwriters = malloc(thread_count * sizeof(*pwriters));
+    pthread_t *pids = malloc(thread_count * sizeof(*pids));
+    struct timespec t1;
+    struct timespec t2;
+    int index;
+
+    hs_init(&hs, HT_NONE, 0.05, shard_count);
+
+    t1 = snap_time();
+    for(index = 0; index < thread_count; index++)
+    {
+        pwriters[index].phs = &hs;
+        pwriters[index].pkeys = pkeys + (size_t)count / thread_count * index;
+        pwriters[index].count = count / thread_count;
+        pthread_create(&pids[index], NULL, bench_shard_write, &pwriters[index]);
+    }
+    for(index = 0; index < thread_count; index++)
+        pthread_join(pids[index], NULL);
+    t2 = snap_time();
+
+    hs_destroy(&hs);
+    free(pwriters);
+    free(pids);
+    return bench_mops(count / thread_count * thread_count, t1, t2);
+}
+
+/*! \brief Worst insert latency (the resize pause) of a single table against
+ *         HS_SHARD_COUNT shards, then the insert throughput of 1, 2, 4...
+ *         writers up to $BENCH_THREADS (BENCH_THREADS by default).
+ */
+static void bench_shard(void)
+{
+    const char *pthreads_env = getenv("BENCH_THREADS");
+    int max_threads = (NULL != pthreads_env) ? atoi(pthreads_env) : BENCH_THREADS;
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    int threads;
+
+    fprintf(stderr, "-----\nSharded table, %d int keys, %ld cpus\n", count, sysconf(_SC_NPROCESSORS_ONLN));
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_shard_latency(1, pkeys, count);
+    bench_shard_latency(HS_SHARD_COUNT, pkeys, count);
+
+    for(threads = 1; threads <= max_threads; threads *= 2)
+    {
+        fprintf(stderr, "%3d writers    1 shard %6.2f Mops/s   %d shards %6.2f Mops/s\n",
+                threads, bench_shard_run(1, threads, pkeys, count),
+                HS_SHARD_COUNT, bench_shard_run(HS_SHARD_COUNT, threads, pkeys, count));
+    }
+
+    free(pkeys);
+}
+
+/*! \brief Wall time of an explicit ht_resize of a chained table to four
+ *         times its size, with 1, 2, 4... threads up to $BENCH_THREADS
+ *         (BENCH_THREADS by default), for the modulo and HT_POW2 policies.
+ */
+static void bench_rethread(void)
+{
+    static const hash_flags_t policies[] = { HT_NONE, HT_POW2 };
+    static const char *pnames[] = { "modulo", "pow2" };
+    const char *pthreads_env = getenv("BENCH_THREADS");
+    int max_threads = (NULL != pthreads_env) ? atoi(pthreads_env) : BENCH_THREADS;
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    size_t policy;
+    int threads;
+    int index;
+
+    fprintf(stderr, "-----\nParallel resize, %d int keys, %ld cpus\n", count, sysconf(_SC_NPROCESSORS_ONLN));
+    bench_shuffled_keys(pkeys, count, 0);
+
+    for(policy = 0; policy < sizeof(policies) / sizeof(policies[0]); policy++)
+    {
+        ht_init(&table, policies[policy] | HT_NO_AUTORESIZE, 0.05);
+        ht_resize(&table, count);
+        for(index = 0; index < count; index++)
+            ht_insert(&table, &pkeys[index], sizeof(int), &index, sizeof(index));
+
+        for(threads = 1; threads <= max_threads; threads *= 2)
+        {
+            // back to the same size first, the timed resize always starts from there
+            ht_set_resize_threads(&table, threads);
+            ht_resize(&table, count);
+
+            t1 = snap_time();
+            ht_resize(&table, (size_t)count * 4);
+            t2 = snap_time();
+            fprintf(stderr, "%-10s %3d threads   resize to %-9zu %.3f s\n",
+                    pnames[policy], threads, table.array_size, get_elapsed(t1, t2));
+        }
+
+        ht_destroy(&table);
+    }
+
+    free(pkeys);
+}
+
+/// A writer thread of the split benchmark.
+typedef struct bench_split_writer {
+    /// The lock-free table (plocked == NULL).
+    hash_table_split_t *pso;
+    /// The table behind reader-writer stripes.
+    hash_table_striped_t *plocked;
+    int *pkeys;
+    int count;
+    /// The slowest of its inserts, in seconds.
+    double max_latency;
+} bench_split_writer_t;
+
+/*! \brief Inserts the keys of its range, timing each insert.
+ */
+static void *bench_split_write(void *parg)
+{
+    bench_split_writer_t *pwriter = parg;
+    hash_epoch_record_t *precord = (NULL == pwriter->plocked) ? ep_register_p(&pwriter->pso->epoch) : NULL;
+    struct timespec t1 = snap_time();
+    struct timespec t2;
+    double latency;
+    int index;
+
+    for(index = 0; index < pwriter->count; index++)
+    {
+        if(NULL == pwriter->plocked)
+            so_insert(pwriter->pso, precord, &pwriter->pkeys[index], sizeof(int), &index, sizeof(index));
+        else
+            hts_insert(pwriter->plocked, &pwriter->pkeys[index], sizeof(int), &index, sizeof(index));
+
+        t2 = snap_time();
+        latency = get_elapsed(t1, t2);
+        if(latency > pwriter->max_latency)
+            pwriter->max_latency = latency;
+        t1 = t2;
+    }
+
+    if(NULL != precord)
+        ep_unregister(precord);
+    return NULL;
+}
+
+/*! \brief Insert throughput of thread_count writers filling an empty table,
+ *         each with its own part of the keys, and the slowest insert, in a
+ *         child process (the frees of a previous run would otherwise stall
+ *         the allocator of the next one).
+ */
+static void bench_split_table(int striped, int thread_count, int *pkeys, int count)
+{
+    hash_table_split_t so;
+    hash_table_striped_t locked;
+    bench_split_writer_t *pwriters;
+    pthread_t *pids;
+    struct timespec t1;
+    struct timespec t2;
+    double max_latency = 0.0;
+    int index;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    pwriters = malloc(thread_count * sizeof(*pwriters));
+    pids = malloc(thread_count * sizeof(*pids));
+    if(striped)
+        hts_init(&locked, HT_NONE, 0.05, HTS_STRIPE_COUNT);
+    else
+        so_init(&so, HT_NONE, 0);
+
+    t1 = snap_time();
+    for(index = 0; index < thread_count; index++)
+    {
+        pwriters[index].pso = &so;
+        pwriters[index].plocked = striped ? &locked : NULL;
+        pwriters[index].pkeys = pkeys + (size_t)count / thread_count * index;
+        pwriters[index].count = count / thread_count;
+        pwriters[index].max_latency = 0.0;
+        pthread_create(&pids[index], NULL, bench_split_write, &pwriters[index]);
+    }
+    for(index = 0; index < thread_count; index++)
+    {
+        pthread_join(pids[index], NULL);
+        if(pwriters[index].max_latency > max_latency)
+            max_latency = pwriters[index].max_latency;
+    }
+    t2 = snap_time();
+
+    fprintf(stderr, "%3d writers   %-14s insert %6.2f Mops/s   max single insert %9.1f us\n",
+            thread_count, striped ? "stripes" : "split-ordered",
+            bench_mops(count / thread_count * thread_count, t1, t2), max_latency * 1e6);
+    exit(0);
+}
+
+/*! \brief Write-heavy ingestion: the split-ordered table against the striped
+ *         wrapper, for 1, 2, 4... writers up to $BENCH_THREADS (BENCH_THREADS
+ *         by default). The slowest insert shows the pauses of the resizes.
+ */
+static void bench_split(void)
+{
+    const char *pthreads_env = getenv("BENCH_THREADS");
+    int max_threads = (NULL != pthreads_env) ? atoi(pthreads_env) : BENCH_THREADS;
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    int threads;
+
+    fprintf(stderr, "-----\nSplit-ordered table, %d int keys, %ld cpus\n", count, sysconf(_SC_NPROCESSORS_ONLN));
+    bench_shuffled_keys(pkeys, count, 0);
+
+    for(threads = 1; threads <= max_threads; threads *= 2)
+    {
+        bench_split_table(1, threads, pkeys, count);
+        bench_split_table(0, threads, pkeys, count);
+    }
+
+    free(pkeys);
+}
+
+/*! \brief Walks every key with ht_keys_pp_sz then with ht_scan_sz chunks of
+ *         chunk pairs, in a child process: the time, and the heap each one
+ *         takes on top of the table.
+ */
+static void bench_scan_table(const char *pname, hash_flags_t flags, int *pkeys, int count, size_t chunk)
+{
+    hash_scan_item_t items[256];
+    hash_cursor_t cursor;
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    size_t heap_before;
+    size_t heap_peak;
+    size_t key_count;
+    size_t found;
+    size_t index;
+    long sum = 0;
+    void **ppkeys;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    ht_init(&table, flags, 0.05);
+    for(index = 0; index < (size_t)count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+
+    heap_before = bench_heap_bytes();
+    t1 = snap_time();
+    ppkeys = ht_keys_pp_sz(&table, &key_count);
+    heap_peak = bench_heap_bytes();
+    for(index = 0; index < key_count; index++)
+        sum += *(int*)ppkeys[index];
+    free(ppkeys);
+    t2 = snap_time();
+    fprintf(stderr, "%-10s keys_pp        %7.2f Mkeys/s  %10zu heap bytes (sum %ld)\n",
+            pname, bench_mops(count, t1, t2), heap_peak - heap_before, sum);
+
+    sum = 0;
+    found = 0;
+    heap_before = bench_heap_bytes();
+    t1 = snap_time();
+    ht_scan_start(&cursor);
+    while(!cursor.done)
+    {
+        key_count = ht_scan_sz(&table, &cursor, items, chunk);
+        for(index = 0; index < key_count; index++)
+            sum += *(int*)items[index].pkey;
+        found += key_count;
+    }
+    heap_peak = bench_heap_bytes();
+    t2 = snap_time();
+    fprintf(stderr, "%-10s scan by %-6zu %7.2f Mkeys/s  %10zu heap bytes (sum %ld, %zu keys)\n",
+            pname, chunk, bench_mops(count, t1, t2), heap_peak - heap_before, sum, found);
+
+    ht_destroy(&table);
+    exit(0);
+}
+
+/*! \brief Allocating the whole key array against an allocation-free cursor.
+ */
+static void bench_scan(void)
+{
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+
+    fprintf(stderr, "-----\nFull walk, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    bench_scan_table("modulo", HT_NONE, pkeys, count, 16);
+    bench_scan_table("modulo", HT_NONE, pkeys, count, 256);
+    bench_scan_table("pow2", HT_POW2, pkeys, count, 16);
+    bench_scan_table("pow2", HT_POW2, pkeys, count, 256);
+    bench_scan_table("robin hood", HT_ROBIN_HOOD, pkeys, count, 256);
+
+    free(pkeys);
+}
+
+/*! \brief Adds an int value to the long pointed to by pstate.
+ */
+static void bench_sum_visit(void *pstate, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    (void) pkey;
+    (void) key_size;
+    (void) value_size;
+    *(long*)pstate += *(int*)pvalue;
+}
+
+/*! \brief Folds a thread's sum into the first one.
+ */
+static void bench_sum_combine(void *pstate, void *pother)
+{
+    *(long*)pstate += *(long*)pother;
+}
+
+/*! \brief Sums every value: the keys then a lookup per key, against a
+ *         for-each on 1 to $BENCH_THREADS threads.
+ */
+static void bench_foreach(void)
+{
+    const char *pthreads_env = getenv("BENCH_THREADS");
+    int max_threads = (NULL != pthreads_env) ? atoi(pthreads_env) : BENCH_THREADS;
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    long *psums = malloc(max_threads * sizeof(*psums));
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    size_t key_count;
+    size_t value_size;
+    size_t index;
+    void **ppkeys;
+    long sum = 0;
+    int threads;
+
+    fprintf(stderr, "-----\nSum of every value, %d int keys, %ld cpus\n", count, sysconf(_SC_NPROCESSORS_ONLN));
+    bench_shuffled_keys(pkeys, count, 0);
+    ht_init(&table, HT_NONE, 0.05);
+    for(index = 0; index < (size_t)count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+
+    t1 = snap_time();
+    ppkeys = ht_keys_pp_sz(&table, &key_count);
+    for(index = 0; index < key_count; index++)
+        sum += *(int*)ht_get_p(&table, ppkeys[index], sizeof(int), &value_size);
+    free(ppkeys);
+    t2 = snap_time();
+    fprintf(stderr, "keys + get           %7.2f Mkeys/s (sum %ld)\n", bench_mops(count, t1, t2), sum);
+
+    sum = 0;
+    t1 = snap_time();
+    ht_foreach(&table, bench_sum_visit, &sum);
+    t2 = snap_time();
+    fprintf(stderr, "foreach              %7.2f Mkeys/s (sum %ld)\n", bench_mops(count, t1, t2), sum);
+
+    for(threads = 1; threads <= max_threads; threads *= 2)
+    {
+        memset(psums, 0, max_threads * sizeof(*psums));
+        t1 = snap_time();
+        ht_foreach_parallel(&table, threads, bench_sum_visit, psums, sizeof(*psums), bench_sum_combine);
+        t2 = snap_time();
+        fprintf(stderr, "foreach %2d threads   %7.2f Mkeys/s (sum %ld)\n",
+                threads, bench_mops(count, t1, t2), psums[0]);
+    }
+
+    ht_destroy(&table);
+    free(psums);
+    free(pkeys);
+}
+
+/*! \brief Hit lookups of count shuffled keys, in Mops/s.
+ */
+static double bench_hits(hash_table_t *ptable, int *pkeys, int count)
+{
+    struct timespec t1;
+    struct timespec t2;
+    size_t value_size;
+    int found = 0;
+    int index;
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += (NULL != ht_get_p(ptable, &pkeys[index], sizeof(int), &value_size));
+    t2 = snap_time();
+
+    return (found == count) ? bench_mops(count, t1, t2) : 0.0;
+}
+
+/*! \brief Rebuilding a table with inserts against mapping a snapshot of it.
+ */
+static void bench_snapshot(void)
+{
+    int count = BENCH_KEY_COUNT * 4;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    char path[64];
+    hash_table_t table;
+    hash_table_t loaded;
+    struct timespec t1;
+    struct timespec t2;
+    struct stat st;
+    int index;
+
+    snprintf(path, sizeof(path), "/tmp/hashtable_bench_%d.snap", (int)getpid());
+    fprintf(stderr, "-----\nSnapshot, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    t1 = snap_time();
+    ht_init(&table, HT_NONE, 0.05);
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+    t2 = snap_time();
+    fprintf(stderr, "rebuild         %8.3f s\n", get_elapsed(t1, t2));
+
+    t1 = snap_time();
+    ht_save_i(&table, path);
+    t2 = snap_time();
+    stat(path, &st);
+    fprintf(stderr, "save            %8.3f s   %.1f MB\n", get_elapsed(t1, t2), st.st_size / 1e6);
+
+    ht_init(&loaded, HT_NONE, 0.05);
+    t1 = snap_time();
+    ht_load_i(&loaded, path, 1);
+    t2 = snap_time();
+    fprintf(stderr, "load, checked   %8.3f s\n", get_elapsed(t1, t2));
+    ht_destroy(&loaded);
+
+    ht_init(&loaded, HT_NONE, 0.05);
+    t1 = snap_time();
+    ht_load_i(&loaded, path, 0);
+    t2 = snap_time();
+    fprintf(stderr, "load, trusted   %8.3f s\n", get_elapsed(t1, t2));
+
+    bench_shuffled_keys(pkeys, count, 0);
+    fprintf(stderr, "hits, mapped    %8.2f Mops/s (first pass)\n", bench_hits(&loaded, pkeys, count));
+    fprintf(stderr, "hits, mapped    %8.2f Mops/s\n", bench_hits(&loaded, pkeys, count));
+    fprintf(stderr, "hits, heap      %8.2f Mops/s\n", bench_hits(&table, pkeys, count));
+
+    unlink(path);
+    ht_destroy(&loaded);
+    ht_destroy(&table);
+    free(pkeys);
+}
+
+/*! \brief Lookups of every key in a shared table from a process of its own,
+ *         which exits once done.
+ */
+static void bench_shm_reader(const char *pname, int *pkeys, int count)
+{
+    hash_table_shm_t hm;
+    size_t value_size;
+    int found = 0;
+    int value;
+    int index;
+
+    if(!hm_open_i(&hm, pname))
+        _exit(1);
+    for(index = 0; index < count; index++)
+    {
+        value_size = sizeof(value);
+        found += hm_get_i(&hm, &pkeys[index], sizeof(int), &value, &value_size);
+    }
+    hm_close(&hm);
+    _exit(found != count);
+}
+
+/*! \brief Shared memory table: the memory one shared table takes against a
+ *         table per process, and lookup throughput of a process, then of
+ *         $BENCH_THREADS processes at once.
+ */
+static void bench_shm(void)
+{
+    const char *pprocesses_env = getenv("BENCH_THREADS");
+    int processes = (NULL != pprocesses_env) ? atoi(pprocesses_env) : BENCH_THREADS;
+    int count = BENCH_KEY_COUNT;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    pid_t *ppids = malloc(processes * sizeof(*ppids));
+    hash_table_shm_t hm;
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    size_t heap_bytes;
+    size_t value_size;
+    char name[64];
+    int found = 0;
+    int value;
+    int index;
+
+    snprintf(name, sizeof(name), "/hashtable_bench_%d", (int)getpid());
+    fprintf(stderr, "-----\nShared memory table, %d int keys, %d processes\n", count, processes);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    heap_bytes = bench_heap_bytes();
+    ht_init(&table, HT_NONE, 0.5);
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+    heap_bytes = bench_heap_bytes() - heap_bytes;
+
+    if(!hm_create_i(&hm, name, (size_t)count * 128 + (64 << 20), HT_NONE)) {
+        fprintf(stderr, "could not create %s\n", name);
+        ht_destroy(&table);
+        free(ppids);
+        free(pkeys);
+        return;
+    }
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        hm_insert_i(&hm, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+    t2 = snap_time();
+    fprintf(stderr, "insert, shared  %8.2f Mops/s\n", bench_mops(count, t1, t2));
+    fprintf(stderr, "memory, heap    %8.1f MB per process, %.1f MB for %d\n", heap_bytes / 1e6,
+            heap_bytes * (double)processes / 1e6, processes);
+    fprintf(stderr, "memory, shared  %8.1f MB for all\n", hm_used_sz(&hm) / 1e6);
+
+    bench_shuffled_keys(pkeys, count, 0);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        found += NULL != ht_get_p(&table, &pkeys[index], sizeof(int), NULL);
+    t2 = snap_time();
+    fprintf(stderr, "get, heap       %8.2f Mops/s\n", bench_mops(count, t1, t2));
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+    {
+        value_size = sizeof(value);
+        found += hm_get_i(&hm, &pkeys[index], sizeof(int), &value, &value_size);
+    }
+    t2 = snap_time();
+    fprintf(stderr, "get, shared     %8.2f Mops/s\n", bench_mops(count, t1, t2));
+
+    t1 = snap_time();
+    for(index = 0; index < processes; index++)
+    {
+        ppids[index] = fork();
+        if(0 == ppids[index])
+            bench_shm_reader(name, pkeys, count);
+    }
+    for(index = 0; index < processes; index++)
+    {
+        if(ppids[index] > 0)
+            waitpid(ppids[index], NULL, 0);
+    }
+    t2 = snap_time();
+    fprintf(stderr, "get, shared     %8.2f Mops/s over %d processes (%d found)\n",
+            bench_mops(count * processes, t1, t2), processes, found);
+
+    hm_close(&hm);
+    hm_unlink_i(name);
+    ht_destroy(&table);
+    free(ppids);
+    free(pkeys);
+}
+
+/*! \brief Insert throughput of count keys through a log with the policy,
+ *         committed every commit_every inserts (0 for never).
+ */
+static double bench_wal_run(const char *plog, int *pkeys, int count, int logged, hash_wal_sync_t sync,
+                            int commit_every)
+{
+    hash_table_t table;
+    hash_wal_t wal;
+    struct timespec t1;
+    struct timespec t2;
+    int index;
+
+    unlink(plog);
+    ht_init(&table, HT_NONE, 0.5);
+    if(logged && !hw_open_i(&wal, &table, plog, sync)) {
+        ht_destroy(&table);
+        return 0;
+    }
+
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+    {
+        ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+        if(logged && 0 != commit_every && 0 == (index + 1) % commit_every)
+            hw_commit_i(&wal);
+    }
+    if(logged)
+        hw_close(&wal);
+    t2 = snap_time();
+
+    ht_destroy(&table);
+    return bench_mops(count, t1, t2);
+}
+
+/*! \brief Write-ahead log: insert throughput under each sync policy, then
+ *         recovery from the log against inserting the keys again.
+ */
+static void bench_wal(void)
+{
+    int count = BENCH_KEY_COUNT;
+    int each_count = 2000;
+    int *pkeys = malloc(count * sizeof(*pkeys));
+    hash_table_t table;
+    hash_table_t recovered;
+    hash_wal_t wal;
+    struct timespec t1;
+    struct timespec t2;
+    size_t replayed = 0;
+    char log[64];
+    int index;
+
+    snprintf(log, sizeof(log), "/tmp/hashtable_bench_%d.wal", (int)getpid());
+    fprintf(stderr, "-----\nWrite-ahead log, %d int keys\n", count);
+    bench_shuffled_keys(pkeys, count, 0);
+
+    fprintf(stderr, "no log              %8.2f Mops/s\n", bench_wal_run(log, pkeys, count, 0, HW_SYNC_NONE, 0));
+    fprintf(stderr, "none                %8.2f Mops/s\n", bench_wal_run(log, pkeys, count, 1, HW_SYNC_NONE, 0));
+    fprintf(stderr, "batch               %8.2f Mops/s\n", bench_wal_run(log, pkeys, count, 1, HW_SYNC_BATCH, 0));
+    fprintf(stderr, "batch, commit/1000  %8.2f Mops/s\n",
+            bench_wal_run(log, pkeys, count, 1, HW_SYNC_BATCH, 1000));
+    fprintf(stderr, "batch, commit/100   %8.2f Mops/s\n", bench_wal_run(log, pkeys, count, 1, HW_SYNC_BATCH, 100));
+    fprintf(stderr, "each                %8.2f Mops/s (%d keys)\n",
+            bench_wal_run(log, pkeys, each_count, 1, HW_SYNC_EACH, 0), each_count);
+
+    unlink(log);
+    ht_init(&table, HT_NONE, 0.5);
+    hw_open_i(&wal, &table, log, HW_SYNC_NONE);
+    for(index = 0; index < count; index++)
+        ht_insert(&table, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+    hw_close(&wal);
+
+    ht_init(&recovered, HT_NONE, 0.5);
+    t1 = snap_time();
+    hw_recover_i(&recovered, NULL, log, &replayed);
+    t2 = snap_time();
+    fprintf(stderr, "recover             %8.3f s (%zu records)\n", get_elapsed(t1, t2), replayed);
+    ht_destroy(&recovered);
+
+    ht_init(&recovered, HT_NONE, 0.5);
+    t1 = snap_time();
+    for(index = 0; index < count; index++)
+        ht_insert(&recovered, &pkeys[index], sizeof(int), &pkeys[index], sizeof(int));
+    t2 = snap_time();
+    fprintf(stderr, "insert one by one   %8.3f s\n", get_elapsed(t1, t2));
+    ht_destroy(&recovered);
+
+    unlink(log);
+    ht_destroy(&table);
+    free(pkeys);
+}
+
+/*! \brief The seconds a load took, and per GB of file.
+ */
+static void bench_load_report(const char *pname, struct timespec t1, struct timespec t2, long file_size)
+{
+    double seconds = get_elapsed(t1, t2);
+
+    fprintf(stderr, "%-26s %8.3f s   %8.3f s/GB\n", pname, seconds, seconds * 1e9 / file_size);
+}
+
+/*! \brief One hl_load_i of the file into a table with the flags.
+ */
+static void bench_load_run(const char *pname, const char *ppath, long file_size, hash_load_format_t format,
+                           hash_flags_t flags, size_t thread_count)
+{
+    hash_table_t table;
+    hash_load_t load;
+    struct timespec t1;
+    struct timespec t2;
+
+    // each load in a fresh process, not in the heap the previous one freed
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    ht_init(&table, flags, 0.5);
+    t1 = snap_time();
+    hl_load_i(&load, &table, ppath, format, '\t', thread_count);
+    t2 = snap_time();
+    bench_load_report(pname, t1, t2, file_size);
+    ht_destroy(&table);
+    hl_unmap(&load);
+    exit(0);
+}
+
+/*! \brief What the reload did before: a line at a time, an ht_insert per record.
+ */
+static void bench_load_lines(const char *ppath, long file_size)
+{
+    hash_table_t table;
+    struct timespec t1;
+    struct timespec t2;
+    char line[64];
+    char *pdelimiter;
+    FILE *pfile;
+
+    fflush(stderr);
+    if(0 != fork()) {
+        wait(NULL);
+        return;
+    }
+
+    ht_init(&table, HT_NONE, 0.5);
+    t1 = snap_time();
+    pfile = fopen(ppath, "r");
+    while(NULL != pfile && NULL != fgets(line, sizeof(line), pfile))
+    {
+        pdelimiter = strchr(line, '\t');
+        if(NULL != pdelimiter)
+            ht_insert(&table, line, pdelimiter - line, pdelimiter + 1, strcspn(pdelimiter + 1, "\r\n"));
+    }
+    if(NULL != pfile)
+        fclose(pfile);
+    t2 = snap_time();
+    bench_load_report("fgets + ht_insert", t1, t2, file_size);
+    ht_destroy(&table);
+    exit(0);
+}
+
+/*! \brief Bulk loading: a delimited and a binary file of $BENCH_KEY_COUNT * 4
+ *         records, read line by line into ht_insert, then by hl_load_i
+ *         copying or pointing into the mapping.
+ */
+static void bench_load(void)
+{
+    int count = BENCH_KEY_COUNT * 4;
+    char text[64];
+    char binary[64];
+    char line[64];
+    uint32_t sizes[2];
+    long text_size;
+    long binary_size;
+    FILE *ptext;
+    FILE *pbinary;
+    int index;
+
+    snprintf(text, sizeof(text), "/tmp/hashtable_bench_%d.tsv", (int)getpid());
+    snprintf(binary, sizeof(binary), "/tmp/hashtable_bench_%d.bin", (int)getpid());
+    ptext = fopen(text, "w");
+    pbinary = fopen(binary, "wb");
+    if(NULL == ptext || NULL == pbinary) {
+        fprintf(stderr, "could not create the files\n");
+        if(NULL != ptext)
+            fclose(ptext);
+        if(NULL != pbinary)
+            fclose(pbinary);
+        return;
+    }
+    for(index = 0; index < count; index++)
+    {
+        fprintf(ptext, "key%09d\tvalue%09d\n", index, index);
+        snprintf(line, sizeof(line), "key%09dvalue%09d", index, index);
+        sizes[0] = 12;
+        sizes[1] = 14;
+        fwrite(sizes, sizeof(sizes), 1, pbinary);
+        fwrite(line, 1, sizes[0] + sizes[1], pbinary);
+    }
+    text_size = ftell(ptext);
+    binary_size = ftell(pbinary);
+    fclose(ptext);
+    fclose(pbinary);
+    fprintf(stderr, "-----\nBulk load, %d records, %.1f MB delimited, %.1f MB binary\n",
+            count, text_size / 1e6, binary_size / 1e6);
+
+    bench_load_lines(text, text_size);
+    bench_load_run("delimited, 1 thread", text, text_size, HL_DELIMITED, HT_NONE, 1);
+    bench_load_run("delimited", text, text_size, HL_DELIMITED, HT_NONE, 0);
+    bench_load_run("delimited, zero-copy", text, text_size, HL_DELIMITED, HT_KEY_CONST | HT_VALUE_CONST, 0);
+    bench_load_run("binary", binary, binary_size, HL_BINARY, HT_NONE, 0);
+    bench_load_run("binary, zero-copy", binary, binary_size, HL_BINARY, HT_KEY_CONST | HT_VALUE_CONST, 0);
+
+    unlink(text);
+    unlink(binary);
+}
@@ -7,8 +7,24 @@
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/wait.h>
 
 #include "../inc/hashcore.h"
+#include "../inc/hashswiss.h"
+#include "../inc/hashcuckoo.h"
+#include "../inc/murmur.h"
+#include "../inc/hashfamily.h"
+#include "../inc/hashstripe.h"
+#include "../inc/hashepoch.h"
+#include "../inc/hashshard.h"
+#include "../inc/hashsplit.h"
+#include "../inc/hashsnap.h"
+#include "../inc/hashshm.h"
+#include "../inc/hashwal.h"
+#include "../inc/hashload.h"
 #include "../inc/test.h"
 #include "../inc/timer.h"
 
@@ -16,6 +32,32 @@ static void main_test1(hash_table_t *pht);
 static void main_test2(hash_table_t *pht);
 static void main_test3(hash_table_t *pht);
 static void main_test4(hash_table_t *pht);
+static void main_test5(void);
+static void main_test6(void);
+static void main_test7(void);
+static void main_test8(void);
+static void main_test9(void);
+static void main_test10(void);
+static void main_test11(void);
+static void main_test12(void);
+static void main_test13(void);
+static void main_test14(void);
+static void main_test15(void);
+static void main_test16(void);
+static void main_test17(void);
+static void main_test18(void);
+static void main_test19(void);
+static void main_test20(void);
+static void main_test21(void);
+static void main_test22(void);
+static void main_test23(void);
+static void main_test24(void);
+static void main_test25(void);
+static void main_test26(void);
+static void main_test27(void);
+static void main_test28(void);
+static void main_test29(void);
+static void main_test30(void);
 
 static const char *main_testkey_1 = (const char*)"testKEY 1";
 static const char *main_testdata_1 = (const char*)"testDATA 1";
@@ -43,6 +85,32 @@ int main(int argc, char *argv[])
     main_test2(&ht);
     main_test3(&ht);
     main_test4(&ht);
+    main_test5();
+    main_test6();
+    main_test7();
+    main_test8();
+    main_test9();
+    main_test10();
+    main_test11();
+    main_test12();
+    main_test13();
+    main_test14();
+    main_test15();
+    main_test16();
+    main_test17();
+    main_test18();
+    main_test19();
+    main_test20();
+    main_test21();
+    main_test22();
+    main_test23();
+    main_test24();
+    main_test25();
+    main_test26();
+    main_test27();
+    main_test28();
+    main_test29();
+    main_test30();
 
     //------------------------------------------------------------------------------------
     ht_destroy(&ht);
@@ -271,6 +339,37 @@ void main_test4(hash_table_t *pht)
     test(ht_size_ui(pht) == 0, "%d ppkeys remaining", ht_size_ui(pht));
 
     //------------------------------------------------------------------------------------
+    // action 4.3
+    void **ppkeys = malloc(key_count * sizeof(*ppkeys));
+    void **ppvalues = malloc(key_count * sizeof(*ppvalues));
+    size_t *psizes = malloc(key_count * sizeof(*psizes));
+    for(index = 0; index < key_count; index++)
+    {
+        ppkeys[index] = &(pmany_keys[index]);
+        ppvalues[index] = &(pmany_values[index]);
+        psizes[index] = sizeof(int);
+    }
+    ht_resize(pht, HT_INITIAL_SIZE);
+
+    t1 = snap_time();
+    ht_insert_batch(pht, ppkeys, psizes, ppvalues, psizes, key_count);
+    t2 = snap_time();
+    fprintf(stderr,
+            "3-Inserting %d ppkeys (batch, presized once) took %.2f seconds\n",
+            key_count, get_elapsed(t1, t2));
+
+    //------------------------------------------------------------------------------------
+    //verif 4.3
+    ht_get_batch(pht, ppkeys, psizes, key_count, ppvalues, NULL);
+    ok_flag = (ht_size_sz(pht) == (size_t)key_count);
+    for(index = 0; index < key_count && ok_flag; index++)
+        ok_flag = (NULL != ppvalues[index]) && (*(int *)ppvalues[index] == pmany_values[index]);
+    test(ok_flag == 1, "Batch insert contents");
+
+    //------------------------------------------------------------------------------------
+    free(ppkeys);
+    free(ppvalues);
+    free(psizes);
     free(pmany_keys);
     free(pmany_values);
 //    for(int i = 0; i < 50; i++){
@@ -278,3 +377,2697 @@ void main_test4(hash_table_t *pht)
 //    }
 
 }
+
+/*! \brief Robin Hood engine: same calls as the chained table, plus
+ *         a probe length comparison between both engines.
+ */
+void main_test5(void)
+{
+    fprintf(stderr, "-----\nRobin Hood engine\n");
+
+    hash_table_t chained;
+    hash_table_t robin;
+    ht_init(&chained, HT_NONE, 0.05);
+    ht_init(&robin, HT_ROBIN_HOOD, 0.05);
+
+    int index;
+    int key_count = 100000;
+
+    //------------------------------------------------------------------------------------
+    //action 5
+    for(index = 0; index < key_count; index++)
+    {
+        int value = index * 3;
+        ht_insert(&chained, &index, sizeof(index), &value, sizeof(value));
+        ht_insert(&robin, &index, sizeof(index), &value, sizeof(value));
+    }
+
+    // replace the even values, remove the multiples of 3
+    for(index = 0; index < key_count; index += 2)
+    {
+        int value = -index;
+        ht_insert(&robin, &index, sizeof(index), &value, sizeof(value));
+    }
+    for(index = 0; index < key_count; index += 3)
+    {
+        ht_remove(&robin, &index, sizeof(index));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 5
+    int ok_flag = 1;
+    for(index = 0; index < key_count && ok_flag; index++)
+    {
+        size_t value_size = 0;
+        int *pvalue = ht_get_p(&robin, &index, sizeof(index), &value_size);
+
+        if(0 == index % 3)
+            ok_flag = (NULL == pvalue) && !ht_contains_i(&robin, &index, sizeof(index));
+        else
+            ok_flag = (NULL != pvalue) && (value_size == sizeof(int)) &&
+                      (*pvalue == ((index % 2) ? index * 3 : -index));
+
+        if(!ok_flag)
+            fprintf(stderr, "Robin Hood mismatch on key %d\n", index);
+    }
+    test(ok_flag == 1, "Robin Hood contents after replace/remove");
+
+    size_t num_keys;
+    void **ppkeys = ht_keys_pp_sz(&robin, &num_keys);
+    test(num_keys == ht_size_sz(&robin) && num_keys == (size_t)(key_count - (key_count + 2) / 3),
+         "Robin Hood table has %zu keys", num_keys);
+    free(ppkeys);
+
+    hash_probe_stats_t chained_stats;
+    hash_probe_stats_t robin_stats;
+    ht_probe_stats(&chained, &chained_stats);
+    ht_probe_stats(&robin, &robin_stats);
+    fprintf(stderr,
+            "Probe length (mean/max): chained %.3f/%u on %zu buckets, robin hood %.3f/%u on %zu slots\n",
+            chained_stats.mean_probe, chained_stats.max_probe, chained.array_size,
+            robin_stats.mean_probe, robin_stats.max_probe, robin.array_size);
+    test(robin_stats.max_probe >= 1 && robin_stats.mean_probe >= 1.0,
+         "Robin Hood probe stats were collected");
+
+    //------------------------------------------------------------------------------------
+    ht_destroy(&chained);
+    ht_destroy(&robin);
+}
+
+/*! \brief Fingerprint group probing engine: the table is filled with one
+ *         instruction set and checked with every other one, since the probe
+ *         sequence must not depend on the group width.
+ */
+void main_test6(void)
+{
+    fprintf(stderr, "-----\nSwiss engine\n");
+
+    static const sw_isa_t isas[] = { SW_ISA_AVX2, SW_ISA_SSE2, SW_ISA_SCALAR };
+    static const char *isa_names[] = { "avx2", "sse2", "scalar" };
+    sw_isa_t initial = sw_get_isa();
+
+    hash_table_t swiss;
+    ht_init(&swiss, HT_SWISS, 0.05);
+
+    int index;
+    int key_count = 100000;
+
+    //------------------------------------------------------------------------------------
+    //action 6
+    for(index = 0; index < key_count; index++)
+    {
+        int value = index * 7;
+        ht_insert(&swiss, &index, sizeof(index), &value, sizeof(value));
+    }
+    for(index = 0; index < key_count; index += 4)
+    {
+        ht_remove(&swiss, &index, sizeof(index));
+    }
+    // reinsert a few removed keys so that tombstones get reused
+    for(index = 0; index < key_count; index += 8)
+    {
+        int value = -index;
+        ht_insert(&swiss, &index, sizeof(index), &value, sizeof(value));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 6
+    unsigned int isa;
+    for(isa = 0; isa < sizeof(isas) / sizeof(isas[0]); isa++)
+    {
+        if(!sw_set_isa_i(isas[isa]))
+            continue;
+
+        int ok_flag = 1;
+        for(index = 0; index < key_count * 2 && ok_flag; index++)
+        {
+            int *pvalue = ht_get_p(&swiss, &index, sizeof(index), NULL);
+
+            if(index >= key_count || 4 == index % 8)
+                ok_flag = (NULL == pvalue);
+            else if(0 == index % 8)
+                ok_flag = (NULL != pvalue) && (*pvalue == -index);
+            else
+                ok_flag = (NULL != pvalue) && (*pvalue == index * 7);
+
+            if(!ok_flag)
+                fprintf(stderr, "Swiss mismatch on key %d\n", index);
+        }
+        test(ok_flag == 1, "Swiss contents with %s probes", isa_names[isa]);
+    }
+    sw_set_isa_i(initial);
+
+    test(ht_size_sz(&swiss) == (unsigned int)(key_count - key_count / 8),
+         "Swiss table has %zu keys", ht_size_sz(&swiss));
+
+    //------------------------------------------------------------------------------------
+    ht_destroy(&swiss);
+}
+
+/*! \brief Inline keys and values: short and long keys side by side,
+ *         values replaced in place while they fit.
+ */
+void main_test7(void)
+{
+    fprintf(stderr, "-----\nInline keys and values\n");
+
+    hash_table_t ht;
+    ht_init(&ht, HT_INLINE, 0.05);
+
+    static const char *short_key = "short";
+    static const char *long_key = "a key that is much longer than the inline threshold";
+    char long_value[HT_INLINE_MAX * 2];
+    int value = 42;
+    size_t value_size;
+
+    memset(long_value, 'v', sizeof(long_value));
+
+    //------------------------------------------------------------------------------------
+    //action 7
+    ht_insert(&ht, (void *)short_key, strlen(short_key) + 1, &value, sizeof(value));
+    ht_insert(&ht, (void *)long_key, strlen(long_key) + 1, long_value, sizeof(long_value));
+
+    int *pfirst = ht_get_p(&ht, (void *)short_key, strlen(short_key) + 1, &value_size);
+    test(NULL != pfirst && *pfirst == 42 && value_size == sizeof(int),
+         "Inline value read back");
+
+    // same size: the inline space is reused
+    value = 43;
+    ht_insert(&ht, (void *)short_key, strlen(short_key) + 1, &value, sizeof(value));
+    int *psecond = ht_get_p(&ht, (void *)short_key, strlen(short_key) + 1, &value_size);
+    test(psecond == pfirst && *psecond == 43, "Fitting value replaced in place");
+
+    // too large for the inline space, then small again
+    ht_insert(&ht, (void *)short_key, strlen(short_key) + 1, long_value, sizeof(long_value));
+    char *plong = ht_get_p(&ht, (void *)short_key, strlen(short_key) + 1, &value_size);
+    test(NULL != plong && value_size == sizeof(long_value) &&
+         0 == memcmp(plong, long_value, sizeof(long_value)),
+         "Large value moved out of line");
+
+    value = 44;
+    ht_insert(&ht, (void *)short_key, strlen(short_key) + 1, &value, sizeof(value));
+    int *pthird = ht_get_p(&ht, (void *)short_key, strlen(short_key) + 1, &value_size);
+    test(pthird == pfirst && *pthird == 44, "Small value back in place");
+
+    //------------------------------------------------------------------------------------
+    //verif 7
+    char *pgot = ht_get_p(&ht, (void *)long_key, strlen(long_key) + 1, &value_size);
+    test(NULL != pgot && value_size == sizeof(long_value) &&
+         0 == memcmp(pgot, long_value, sizeof(long_value)),
+         "Long key read back");
+
+    ht_remove(&ht, (void *)short_key, strlen(short_key) + 1);
+    test(!ht_contains_i(&ht, (void *)short_key, strlen(short_key) + 1) && 1 == ht_size_sz(&ht),
+         "Inline entry removed");
+
+    //------------------------------------------------------------------------------------
+    ht_destroy(&ht);
+}
+
+/*! \brief Arena allocation: values of every size class and beyond, entries
+ *         recycled after removal, and the whole arena dropped by ht_clear.
+ */
+void main_test8(void)
+{
+    fprintf(stderr, "-----\nArena allocation\n");
+
+    static const hash_flags_t configs[] = { HT_ARENA, HT_ARENA | HT_INLINE, HT_ARENA | HT_ROBIN_HOOD };
+    static const char *config_names[] = { "chained", "inline", "robin hood" };
+    char value[HA_MAX_SMALL * 2];
+    unsigned int config;
+    int index;
+    int key_count = 20000;
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_t ht;
+        ht_init(&ht, configs[config], 0.05);
+
+        //--------------------------------------------------------------------------------
+        //action 8: value sizes cycle through every class and the large allocations
+        for(index = 0; index < key_count; index++)
+        {
+            memset(value, index & 0xff, sizeof(value));
+            ht_insert(&ht, &index, sizeof(index), value, index % sizeof(value) + 1);
+        }
+        for(index = 0; index < key_count; index += 2)
+        {
+            ht_remove(&ht, &index, sizeof(index));
+        }
+        for(index = 0; index < key_count; index += 2)
+        {
+            memset(value, index & 0xff, sizeof(value));
+            ht_insert(&ht, &index, sizeof(index), value, (index * 7) % sizeof(value) + 1);
+        }
+
+        //--------------------------------------------------------------------------------
+        //verif 8
+        int ok_flag = 1;
+        for(index = 0; index < key_count && ok_flag; index++)
+        {
+            size_t value_size = 0;
+            unsigned char *pgot = ht_get_p(&ht, &index, sizeof(index), &value_size);
+            size_t expected = (index % 2) ? index % sizeof(value) + 1 : (index * 7) % sizeof(value) + 1;
+
+            ok_flag = (NULL != pgot) && (value_size == expected) &&
+                      (pgot[0] == (index & 0xff)) && (pgot[value_size - 1] == (index & 0xff));
+            if(!ok_flag)
+                fprintf(stderr, "Arena mismatch on key %d\n", index);
+        }
+        test(ok_flag == 1, "Arena contents (%s)", config_names[config]);
+
+        ht_clear(&ht);
+        test(0 == ht_size_sz(&ht) && !ht_contains_i(&ht, &index, sizeof(index)),
+             "Arena table cleared (%s)", config_names[config]);
+
+        index = 1;
+        ht_insert(&ht, &index, sizeof(index), value, 8);
+        test(NULL != ht_get_p(&ht, &index, sizeof(index), NULL),
+             "Arena table reused after clear (%s)", config_names[config]);
+
+        ht_destroy(&ht);
+    }
+}
+
+/*! \brief Stored hashes: long keys on long chains (no autoresize), moved
+ *         by explicit resizes up and down, then replaced and removed.
+ */
+void main_test9(void)
+{
+    fprintf(stderr, "-----\nStored hashes across resizes\n");
+
+    hash_table_t ht;
+    ht_init(&ht, HT_NO_AUTORESIZE, 0.05);
+
+    static const unsigned int sizes[] = { 4096, 7, 1000003 };
+    char key[128];
+    int index;
+    int key_count = 20000;
+    unsigned int size;
+
+    // long keys sharing a long prefix, so that a key compare is never cheap
+    memset(key, 'k', sizeof(key));
+
+    //------------------------------------------------------------------------------------
+    //action 9
+    for(index = 0; index < key_count; index++)
+    {
+        memcpy(key + sizeof(key) - sizeof(index), &index, sizeof(index));
+        ht_insert(&ht, key, sizeof(key), &index, sizeof(index));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 9
+    for(size = 0; size < sizeof(sizes) / sizeof(sizes[0]); size++)
+    {
+        ht_resize(&ht, sizes[size]);
+
+        int ok_flag = 1;
+        for(index = 0; index < key_count && ok_flag; index++)
+        {
+            memcpy(key + sizeof(key) - sizeof(index), &index, sizeof(index));
+            int *pvalue = ht_get_p(&ht, key, sizeof(key), NULL);
+
+            ok_flag = (NULL != pvalue) && (*pvalue == index);
+            if(!ok_flag)
+                fprintf(stderr, "Mismatch on key %d after resize to %u\n", index, sizes[size]);
+        }
+        test(ok_flag == 1 && ht_size_sz(&ht) == (unsigned int)key_count,
+             "Contents after resize to %u buckets", sizes[size]);
+
+        unsigned int bucket;
+        unsigned int used = 0;
+        for(bucket = 0; bucket < ht.array_size; bucket++)
+            used += (NULL != ht.pparray[bucket]);
+        test(ht.collisions == (unsigned int)key_count - used,
+             "Collision count after resize to %u buckets", sizes[size]);
+    }
+
+    for(index = 0; index < key_count; index += 2)
+    {
+        int value = -index;
+        memcpy(key + sizeof(key) - sizeof(index), &index, sizeof(index));
+        ht_insert(&ht, key, sizeof(key), &value, sizeof(value));
+    }
+    for(index = 0; index < key_count; index += 3)
+    {
+        memcpy(key + sizeof(key) - sizeof(index), &index, sizeof(index));
+        ht_remove(&ht, key, sizeof(key));
+    }
+    ht_resize(&ht, 64);
+
+    int ok_flag = 1;
+    for(index = 0; index < key_count && ok_flag; index++)
+    {
+        memcpy(key + sizeof(key) - sizeof(index), &index, sizeof(index));
+        int *pvalue = ht_get_p(&ht, key, sizeof(key), NULL);
+
+        if(0 == index % 3)
+            ok_flag = (NULL == pvalue);
+        else
+            ok_flag = (NULL != pvalue) && (*pvalue == ((index % 2) ? index : -index));
+    }
+    test(ok_flag == 1, "Contents after replace/remove and a shrink");
+
+    //------------------------------------------------------------------------------------
+    ht_destroy(&ht);
+}
+
+/*! \brief Incremental resize: with a budget of one bucket per operation,
+ *         lookups, replacements and removals happen while the old array
+ *         is still being migrated.
+ */
+void main_test10(void)
+{
+    fprintf(stderr, "-----\nIncremental resize\n");
+
+    hash_table_t ht;
+    ht_init(&ht, HT_INCREMENTAL, 0.05);
+    ht_set_migrate_budget(&ht, 1);
+
+    int index;
+    int key_count = 50000;
+    int in_progress = 0;
+    int ok_flag = 1;
+
+    //------------------------------------------------------------------------------------
+    //action 10: every key inserted so far is looked up while a resize is in progress
+    for(index = 0; index < key_count; index++)
+    {
+        ht_insert(&ht, &index, sizeof(index), &index, sizeof(index));
+
+        if(NULL != ht.ppold && 0 == index % 97) {
+            int other;
+            in_progress++;
+            for(other = 0; other <= index && ok_flag; other += 13)
+            {
+                int *pvalue = ht_get_p(&ht, &other, sizeof(other), NULL);
+                ok_flag = (NULL != pvalue) && (*pvalue == other);
+                if(!ok_flag)
+                    fprintf(stderr, "Mismatch on key %d during migration\n", other);
+            }
+        }
+    }
+    test(ok_flag == 1 && in_progress > 0,
+         "Lookups during %d checks with a resize in progress", in_progress);
+
+    // replace and remove, likely before the last resize is over
+    for(index = 0; index < key_count; index += 2)
+    {
+        int value = -index;
+        ht_insert(&ht, &index, sizeof(index), &value, sizeof(value));
+    }
+    for(index = 0; index < key_count; index += 3)
+    {
+        ht_remove(&ht, &index, sizeof(index));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 10
+    for(index = 0; index < key_count && ok_flag; index++)
+    {
+        int *pvalue = ht_get_p(&ht, &index, sizeof(index), NULL);
+
+        if(0 == index % 3)
+            ok_flag = (NULL == pvalue);
+        else
+            ok_flag = (NULL != pvalue) && (*pvalue == ((index % 2) ? index : -index));
+    }
+    test(ok_flag == 1 && ht_size_sz(&ht) == (size_t)(key_count - (key_count + 2) / 3),
+         "Contents after replace/remove, %zu keys", ht_size_sz(&ht));
+
+    size_t num_keys;
+    void **ppkeys = ht_keys_pp_sz(&ht, &num_keys);
+    unsigned int bucket;
+    unsigned int used = 0;
+    for(bucket = 0; bucket < ht.array_size; bucket++)
+        used += (NULL != ht.pparray[bucket]);
+    test(NULL == ht.ppold && num_keys == ht_size_sz(&ht) && ht.collisions == num_keys - used,
+         "Migration completed by ht_keys_pp_sz");
+    free(ppkeys);
+
+    //------------------------------------------------------------------------------------
+    ht_destroy(&ht);
+}
+
+/*! \brief Capacity policies: power-of-two sizes indexed by the high bits
+ *         of the hash and fastrange indexing of arbitrary sizes, on the
+ *         chained and Robin Hood engines.
+ */
+void main_test11(void)
+{
+    fprintf(stderr, "-----\nCapacity policies\n");
+
+    static const hash_flags_t configs[] = {
+        HT_NONE, HT_POW2, HT_FASTRANGE, HT_POW2 | HT_ROBIN_HOOD,
+        HT_FASTRANGE | HT_ROBIN_HOOD, HT_POW2 | HT_INCREMENTAL
+    };
+    static const char *config_names[] = {
+        "modulo", "pow2", "fastrange", "robin hood pow2",
+        "robin hood fastrange", "incremental pow2"
+    };
+    static const uint32_t hashes[] = { 0, 1, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF };
+    unsigned int config;
+    int index;
+    int key_count = 30000;
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_t ht;
+        ht_init(&ht, configs[config], 0.05);
+
+        //--------------------------------------------------------------------------------
+        //action 11
+        for(index = 0; index < key_count; index++)
+        {
+            ht_insert(&ht, &index, sizeof(index), &index, sizeof(index));
+        }
+        ht_resize(&ht, 100000);
+
+        //--------------------------------------------------------------------------------
+        //verif 11
+        unsigned int expected_size = (configs[config] & HT_POW2) ? 131072 : 100000;
+        int ok_flag = (ht.array_size == expected_size);
+        unsigned int hash;
+        for(hash = 0; hash < sizeof(hashes) / sizeof(hashes[0]); hash++)
+            ok_flag = ok_flag && (ht_bucket_sz(&ht, hashes[hash]) < ht.array_size);
+
+        for(index = 0; index < key_count && ok_flag; index++)
+        {
+            int *pvalue = ht_get_p(&ht, &index, sizeof(index), NULL);
+            ok_flag = (NULL != pvalue) && (*pvalue == index);
+        }
+        test(ok_flag == 1, "Contents and bucket range (%s, %zu buckets)",
+             config_names[config], ht.array_size);
+
+        ht_destroy(&ht);
+    }
+}
+
+// every key gets the same hash and tag 0: they all share one bucket, its own alternate
+static void main_same_hash128(const void *pkey, int len, uint32_t seed, void *pout)
+{
+    (void)pkey;
+    (void)len;
+    (void)seed;
+    memset(pout, 0, 16);
+}
+
+/*! \brief Cuckoo engine: same calls as the other engines, a lookup never
+ *         looks further than the alternate bucket or the stash, and the
+ *         table survives being shrunk to its minimal size.
+ */
+void main_test12(void)
+{
+    fprintf(stderr, "-----\nCuckoo engine\n");
+
+    static const hash_flags_t configs[] = { HT_CUCKOO, HT_CUCKOO | HT_INLINE | HT_ARENA };
+    static const char *config_names[] = { "cuckoo", "cuckoo inline arena" };
+    unsigned int config;
+    int index;
+    // just below the growth threshold of a 128K slot table
+    int key_count = 117000;
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_t ht;
+        hash_probe_stats_t stats;
+        ht_init(&ht, configs[config], 0.05);
+
+        //--------------------------------------------------------------------------------
+        //action 12
+        for(index = 0; index < key_count; index++)
+        {
+            int value = index * 5;
+            ht_insert(&ht, &index, sizeof(index), &value, sizeof(value));
+        }
+
+        ht_probe_stats(&ht, &stats);
+        fprintf(stderr, "Load %.3f, buckets read (mean/max): %.3f/%u, %u failed inserts, %u rehashes\n",
+                ht.current_load_factor, stats.mean_probe, stats.max_probe, stats.insert_failures, stats.rehashes);
+        test(stats.max_probe <= 3 && ht.current_load_factor > 0.85,
+             "Cuckoo lookups are bounded at high load (%s)", config_names[config]);
+
+        for(index = 0; index < key_count; index += 2)
+        {
+            int value = -index;
+            ht_insert(&ht, &index, sizeof(index), &value, sizeof(value));
+        }
+        for(index = 0; index < key_count; index += 3)
+        {
+            ht_remove(&ht, &index, sizeof(index));
+        }
+        // every entry is placed again in the fewest slots
+        ht_resize(&ht, 0);
+
+        //--------------------------------------------------------------------------------
+        //verif 12
+        int ok_flag = 1;
+        for(index = 0; index < key_count && ok_flag; index++)
+        {
+            int *pvalue = ht_get_p(&ht, &index, sizeof(index), NULL);
+
+            if(0 == index % 3)
+                ok_flag = (NULL == pvalue) && !ht_contains_i(&ht, &index, sizeof(index));
+            else
+                ok_flag = (NULL != pvalue) && (*pvalue == ((index % 2) ? index * 5 : -index));
+
+            if(!ok_flag)
+                fprintf(stderr, "Cuckoo mismatch on key %d\n", index);
+        }
+        test(ok_flag == 1, "Cuckoo contents (%s)", config_names[config]);
+
+        size_t num_keys;
+        void **ppkeys = ht_keys_pp_sz(&ht, &num_keys);
+        test(num_keys == ht_size_sz(&ht) && num_keys == (size_t)(key_count - (key_count + 2) / 3),
+             "Cuckoo table has %zu keys (%s)", num_keys, config_names[config]);
+        free(ppkeys);
+
+        ht_probe_stats(&ht, &stats);
+        test(stats.max_probe <= 3 && stats.rehashes > 0 &&
+             ht.key_count <= ht.array_size * HT_CUCKOO_MAX_LOAD,
+             "Cuckoo lookups are bounded after a rebuild (%s)", config_names[config]);
+
+        ht_destroy(&ht);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 12.2: a bucket and the stash hold 12 keys of one hash, the 13th never fits
+    hash_table_t same;
+    int found = 0;
+    ht_init(&same, HT_CUCKOO, 0.05);
+    same.phashfunc_x64_128 = main_same_hash128;
+    for(index = 0; index < CK_BUCKET_SLOTS + CK_STASH_SIZE + 4; index++)
+        ht_insert(&same, &index, sizeof(index), &index, sizeof(index));
+    for(index = 0; index < CK_BUCKET_SLOTS + CK_STASH_SIZE + 4; index++)
+    {
+        int *pvalue = ht_get_p(&same, &index, sizeof(index), NULL);
+        found += (NULL != pvalue && *pvalue == index);
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 12.2
+    test(found == CK_BUCKET_SLOTS + CK_STASH_SIZE && ht_size_sz(&same) == (size_t)found &&
+         same.array_size <= 1024,
+         "Cuckoo keys that never fit are dropped, not counted, and stop the growth (%d kept, %zu slots)",
+         found, same.array_size);
+    ht_destroy(&same);
+}
+
+/*! \brief 64-bit hashing: every engine and index policy keeps its contents
+ *         with HT_HASH64, and the hash really spans 64 bits.
+ */
+void main_test13(void)
+{
+    fprintf(stderr, "-----\n64-bit hashing\n");
+
+    static const hash_flags_t configs[] = {
+        HT_HASH64, HT_HASH64 | HT_POW2, HT_HASH64 | HT_FASTRANGE,
+        HT_HASH64 | HT_INCREMENTAL, HT_HASH64 | HT_ROBIN_HOOD,
+        HT_HASH64 | HT_SWISS, HT_HASH64 | HT_CUCKOO
+    };
+    static const char *config_names[] = {
+        "chained", "chained pow2", "chained fastrange", "incremental",
+        "robin hood", "swiss", "cuckoo"
+    };
+    unsigned int config;
+    int index;
+    int key_count = 50000;
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_t ht;
+        ht_init(&ht, configs[config], 0.05);
+
+        //--------------------------------------------------------------------------------
+        //action 13
+        uint64_t high_bits = 0;
+        for(index = 0; index < key_count; index++)
+        {
+            int value = index * 3;
+            ht_insert(&ht, &index, sizeof(index), &value, sizeof(value));
+            high_bits |= ht_hash_ul(&ht, &index, sizeof(index)) >> 32;
+        }
+        for(index = 0; index < key_count; index += 4)
+            ht_remove(&ht, &index, sizeof(index));
+
+        //--------------------------------------------------------------------------------
+        //verif 13
+        int ok_flag = (0 != high_bits);
+        for(index = 0; index < key_count && ok_flag; index++)
+        {
+            int *pvalue = ht_get_p(&ht, &index, sizeof(index), NULL);
+            if(0 == index % 4)
+                ok_flag = (NULL == pvalue);
+            else
+                ok_flag = (NULL != pvalue) && (*pvalue == index * 3);
+
+            if(!ok_flag)
+                fprintf(stderr, "64-bit mismatch on key %d\n", index);
+        }
+        test(ok_flag == 1 && ht_size_sz(&ht) == (size_t)(key_count - key_count / 4),
+             "Contents with 64-bit hashes (%s, %zu keys)", config_names[config], ht_size_sz(&ht));
+
+        ht_destroy(&ht);
+    }
+
+    hash_table_t narrow;
+    int key = 42;
+    ht_init(&narrow, HT_NONE, 0.05);
+    test(ht_hash_ul(&narrow, &key, sizeof(key)) <= UINT32_MAX,
+         "Hashes stay 32 bits without HT_HASH64");
+    ht_insert(&narrow, &key, sizeof(key), &key, sizeof(key));
+    test(1 == ht_size_ui(&narrow) && ht_size_sz(&narrow) == ht_size_ui(&narrow) &&
+         ht_index_sz(&narrow, &key, sizeof(key)) == ht_index_ui(&narrow, &key, sizeof(key)),
+         "The unsigned int sizes match the size_t ones");
+    ht_destroy(&narrow);
+}
+
+/*! \brief Batched lookups: same answers as one ht_get_p per key on every
+ *         engine, for hits and misses, partial groups and a resize in progress.
+ */
+void main_test14(void)
+{
+    fprintf(stderr, "-----\nBatched lookups\n");
+
+    static const hash_flags_t configs[] = {
+        HT_NONE, HT_INCREMENTAL, HT_INLINE | HT_ARENA, HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO
+    };
+    static const char *config_names[] = {
+        "chained", "incremental", "inline arena", "robin hood", "swiss", "cuckoo"
+    };
+    unsigned int config;
+    int index;
+    int key_count = 20000;
+    // more than the keys inserted, and not a multiple of the group size
+    size_t batch_count = (size_t)key_count * 2 + 3;
+    int *pkeys = malloc(batch_count * sizeof(*pkeys));
+    void **ppkeys = malloc(batch_count * sizeof(*ppkeys));
+    size_t *pkey_sizes = malloc(batch_count * sizeof(*pkey_sizes));
+    void **ppvalues = malloc(batch_count * sizeof(*ppvalues));
+    size_t *pvalue_sizes = malloc(batch_count * sizeof(*pvalue_sizes));
+    int *pfound = malloc(batch_count * sizeof(*pfound));
+    size_t key;
+
+    for(key = 0; key < batch_count; key++)
+    {
+        // hits and misses interleaved
+        pkeys[key] = (int)((key * 7919) % batch_count);
+        ppkeys[key] = &pkeys[key];
+        pkey_sizes[key] = sizeof(int);
+    }
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_t ht;
+        ht_init(&ht, configs[config], 0.05);
+        ht_set_migrate_budget(&ht, 1);
+
+        //--------------------------------------------------------------------------------
+        //action 14
+        for(index = 0; index < key_count; index++)
+        {
+            int value = index * 9;
+            ht_insert(&ht, &index, sizeof(index), &value, sizeof(value));
+        }
+        ht_get_batch(&ht, ppkeys, pkey_sizes, batch_count, ppvalues, pvalue_sizes);
+        ht_contains_batch(&ht, ppkeys, pkey_sizes, batch_count, pfound);
+
+        //--------------------------------------------------------------------------------
+        //verif 14
+        int ok_flag = 1;
+        for(key = 0; key < batch_count && ok_flag; key++)
+        {
+            size_t value_size = 0;
+            int *pvalue = ht_get_p(&ht, &pkeys[key], sizeof(int), &value_size);
+
+            ok_flag = (ppvalues[key] == (void *)pvalue) && (pvalue_sizes[key] == value_size) &&
+                      (pfound[key] == (NULL != pvalue)) &&
+                      ((NULL != pvalue) == (pkeys[key] < key_count));
+            if(!ok_flag)
+                fprintf(stderr, "Batch mismatch on key %d\n", pkeys[key]);
+        }
+        test(ok_flag == 1, "Batched lookups match single lookups (%s)", config_names[config]);
+
+        ht_destroy(&ht);
+    }
+
+    free(pkeys);
+    free(ppkeys);
+    free(pkey_sizes);
+    free(ppvalues);
+    free(pvalue_sizes);
+    free(pfound);
+}
+
+/*! \brief Batched inserts: same contents as one ht_insert per pair on every
+ *         engine, later duplicates winning, and an empty batch changes nothing.
+ */
+void main_test15(void)
+{
+    fprintf(stderr, "-----\nBatched inserts\n");
+
+    static const hash_flags_t configs[] = {
+        HT_NONE, HT_INCREMENTAL, HT_INLINE | HT_ARENA, HT_ARENA, HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO
+    };
+    static const char *config_names[] = {
+        "chained", "incremental", "inline arena", "arena", "robin hood", "swiss", "cuckoo"
+    };
+    unsigned int config;
+    int key_count = 50000;
+    // the last fifth of the batch repeats keys with new values
+    size_t batch_count = (size_t)key_count + key_count / 5;
+    int *pkeys = malloc(batch_count * sizeof(*pkeys));
+    int *pvalues = malloc(batch_count * sizeof(*pvalues));
+    void **ppkeys = malloc(batch_count * sizeof(*ppkeys));
+    void **ppvalues = malloc(batch_count * sizeof(*ppvalues));
+    size_t *psizes = malloc(batch_count * sizeof(*psizes));
+    size_t pair;
+
+    for(pair = 0; pair < batch_count; pair++)
+    {
+        pkeys[pair] = (int)(pair % key_count);
+        pvalues[pair] = (int)pair;
+        ppkeys[pair] = &pkeys[pair];
+        ppvalues[pair] = &pvalues[pair];
+        psizes[pair] = sizeof(int);
+    }
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_t ht;
+        ht_init(&ht, configs[config], 0.05);
+
+        //--------------------------------------------------------------------------------
+        //action 15
+        ht_insert_batch(&ht, ppkeys, psizes, ppvalues, psizes, batch_count);
+        size_t array_size = ht.array_size;
+        ht_insert_batch(&ht, ppkeys, psizes, ppvalues, psizes, 0);
+
+        //--------------------------------------------------------------------------------
+        //verif 15
+        int ok_flag = (ht_size_sz(&ht) == (size_t)key_count) && (ht.array_size == array_size);
+        int index;
+        for(index = 0; index < key_count && ok_flag; index++)
+        {
+            int *pvalue = ht_get_p(&ht, &index, sizeof(index), NULL);
+            int expected = (index < key_count / 5) ? index + key_count : index;
+            ok_flag = (NULL != pvalue) && (*pvalue == expected);
+            if(!ok_flag)
+                fprintf(stderr, "Batch insert mismatch on key %d\n", index);
+        }
+        test(ok_flag == 1, "Batched inserts match single inserts (%s, %zu slots)",
+             config_names[config], ht.array_size);
+
+        ht_destroy(&ht);
+    }
+
+    free(pkeys);
+    free(pvalues);
+    free(ppkeys);
+    free(ppvalues);
+    free(psizes);
+}
+
+/*! \brief Multi-key murmur kernels: bit-identical to the scalar functions
+ *         on every instruction set the cpu has, whatever the key length
+ *         and the number of keys, and behind ht_hash_batch.
+ */
+void main_test16(void)
+{
+    fprintf(stderr, "-----\nMulti-key hashing\n");
+
+    static const mu_isa_t isas[] = { MU_ISA_SCALAR, MU_ISA_AVX2, MU_ISA_AVX512 };
+    static const char *isa_names[] = { "scalar", "avx2", "avx512" };
+    mu_isa_t initial = mu_get_isa();
+    unsigned int isa;
+    // 37 keys: full vectors plus a remainder on every instruction set
+    enum { key_count = 37, max_len = 40 };
+    // keys 8 byte aligned, as the scalar functions read whole blocks
+    uint64_t buffer[key_count * (max_len / 8 + 1)];
+    void *ppkeys[key_count];
+    uint32_t hash32[key_count];
+    uint64_t hash128[key_count * 2];
+    size_t index;
+    int len;
+
+    for(index = 0; index < sizeof(buffer); index++)
+        ((uint8_t *)buffer)[index] = (uint8_t)(index * 131 + 7);
+    for(index = 0; index < key_count; index++)
+        ppkeys[index] = &buffer[index * (max_len / 8 + 1)];
+
+    for(isa = 0; isa < sizeof(isas) / sizeof(isas[0]); isa++)
+    {
+        if(!mu_set_isa_i(isas[isa])) {
+            fprintf(stderr, "%s not supported, skipped\n", isa_names[isa]);
+            continue;
+        }
+
+        //--------------------------------------------------------------------------------
+        //action 16
+        int ok_flag = 1;
+        for(len = 0; len <= max_len && ok_flag; len++)
+        {
+            MurmurHash3_x86_32_multi(ppkeys, len, 42, hash32, key_count);
+            MurmurHash3_x64_128_multi(ppkeys, len, 42, hash128, key_count);
+
+            //----------------------------------------------------------------------------
+            //verif 16
+            for(index = 0; index < key_count && ok_flag; index++)
+            {
+                uint32_t expected32;
+                uint64_t expected128[2];
+                MurmurHash3_x86_32(ppkeys[index], len, 42, &expected32);
+                MurmurHash3_x64_128(ppkeys[index], len, 42, expected128);
+
+                ok_flag = (hash32[index] == expected32) &&
+                          (hash128[index * 2] == expected128[0]) && (hash128[index * 2 + 1] == expected128[1]);
+                if(!ok_flag)
+                    fprintf(stderr, "Multi-key mismatch on key %zu, length %d\n", index, len);
+            }
+        }
+        test(ok_flag == 1, "Multi-key hashes match the scalar ones (%s)", isa_names[isa]);
+    }
+    mu_set_isa_i(initial);
+
+    hash_table_t ht;
+    size_t key_sizes[key_count];
+    uint64_t hashes[key_count];
+    ht_init(&ht, HT_HASH64, 0.05);
+    for(index = 0; index < key_count; index++)
+        key_sizes[index] = 12;
+    ht_hash_batch(&ht, ppkeys, key_sizes, key_count, hashes);
+
+    int ok_flag = 1;
+    for(index = 0; index < key_count; index++)
+        ok_flag = ok_flag && (hashes[index] == ht_hash_ul(&ht, ppkeys[index], 12));
+    test(ok_flag == 1, "Batched hashes match ht_hash_ul");
+    ht_destroy(&ht);
+}
+
+/*! \brief Hash family: the CRC32C paths agree, every bundled function tells
+ *         close keys apart, and tables keep their contents with each of them.
+ */
+void main_test17(void)
+{
+    fprintf(stderr, "-----\nHash family\n");
+
+    static HashFunc *funcs[] = { hf_mix_32, hf_mix_128, hf_crc32c_32, hf_crc32c_128 };
+    static const char *func_names[] = { "mix 32", "mix 128", "crc32c 32", "crc32c 128" };
+    static const hash_flags_t hashes[] = { HT_HASH_MIX, HT_HASH_CRC32C, HT_HASH_MURMUR };
+    static const char *hash_names[] = { "mix", "crc32c", "murmur" };
+    static const hash_flags_t configs[] = { HT_NONE, HT_HASH64 | HT_POW2, HT_SWISS, HT_CUCKOO };
+    static const char *config_names[] = { "chained", "chained 64 bit pow2", "swiss", "cuckoo" };
+    const char *pcheck = "123456789";
+    unsigned int func;
+    unsigned int hash;
+    unsigned int config;
+    int index;
+    int key_count = 20000;
+
+    //------------------------------------------------------------------------------------
+    //action 17.1
+    int hw = hf_set_crc_hw_i(1);
+    uint32_t crc_hw = hf_crc32c_ui(0xffffffffU, pcheck, strlen(pcheck)) ^ 0xffffffffU;
+    hf_set_crc_hw_i(0);
+    uint32_t crc_sw = hf_crc32c_ui(0xffffffffU, pcheck, strlen(pcheck)) ^ 0xffffffffU;
+    hf_set_crc_hw_i(1);
+
+    //------------------------------------------------------------------------------------
+    //verif 17.1
+    test(crc_sw == 0xe3069283U && (!hw || crc_hw == crc_sw),
+         "CRC32C check value (sw %08x, hw %08x)", crc_sw, hw ? crc_hw : crc_sw);
+
+    //------------------------------------------------------------------------------------
+    //action 17.2
+    // every prefix of a 32 byte key, then every single bit flip of it
+    uint8_t key[32];
+    uint64_t seen[32 + 1 + 32 * 8];
+    for(func = 0; func < sizeof(funcs) / sizeof(funcs[0]); func++)
+    {
+        size_t seen_count = 0;
+        uint64_t out[2] = { 0, 0 };
+        int bit;
+
+        memset(key, 0x5a, sizeof(key));
+        for(index = 0; index <= (int)sizeof(key); index++)
+        {
+            funcs[func](key, index, 42, out);
+            seen[seen_count++] = out[0];
+        }
+        for(bit = 0; bit < (int)sizeof(key) * 8; bit++)
+        {
+            key[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+            funcs[func](key, sizeof(key), 42, out);
+            seen[seen_count++] = out[0];
+            key[bit / 8] ^= (uint8_t)(1 << (bit % 8));
+        }
+
+        //--------------------------------------------------------------------------------
+        //verif 17.2
+        size_t duplicates = 0;
+        size_t i;
+        size_t j;
+        for(i = 0; i < seen_count; i++)
+        {
+            for(j = i + 1; j < seen_count; j++)
+                duplicates += (seen[i] == seen[j]);
+        }
+        test(duplicates == 0, "Close keys hash apart (%s, %zu duplicates)", func_names[func], duplicates);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 17.3
+    for(hash = 0; hash < sizeof(hashes) / sizeof(hashes[0]); hash++)
+    {
+        int ok_flag = 1;
+
+        for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+        {
+            hash_table_t ht;
+            ht_init(&ht, hashes[hash] | configs[config], 0.05);
+
+            for(index = 0; index < key_count; index++)
+            {
+                int value = index * 7;
+                ht_insert(&ht, &index, sizeof(index), &value, sizeof(value));
+            }
+            for(index = 0; index < key_count; index += 3)
+                ht_remove(&ht, &index, sizeof(index));
+
+            //----------------------------------------------------------------------------
+            //verif 17.3
+            for(index = 0; index < key_count && ok_flag; index++)
+            {
+                int *pvalue = ht_get_p(&ht, &index, sizeof(index), NULL);
+                if(0 == index % 3)
+                    ok_flag = (NULL == pvalue);
+                else
+                    ok_flag = (NULL != pvalue) && (*pvalue == index * 7);
+
+                if(!ok_flag)
+                    fprintf(stderr, "%s mismatch on key %d (%s)\n", hash_names[hash], index, config_names[config]);
+            }
+            ok_flag = ok_flag && ht_size_sz(&ht) == (size_t)(key_count - (key_count + 2) / 3);
+
+            ht_destroy(&ht);
+        }
+        test(ok_flag == 1, "Contents with the %s hash on every engine", hash_names[hash]);
+    }
+
+    hash_table_t mix;
+    hash_table_t crc;
+    int probe = 42;
+    ht_init(&mix, HT_HASH_MIX, 0.05);
+    ht_init(&crc, HT_HASH_CRC32C, 0.05);
+    test(ht_hash_ul(&mix, &probe, sizeof(probe)) != ht_hash_ul(&crc, &probe, sizeof(probe)),
+         "Tables hash with the function their flags select");
+    ht_destroy(&mix);
+    ht_destroy(&crc);
+}
+
+/// The work of one thread of main_test18.
+typedef struct main_stripe_job {
+    hash_table_striped_t *pts;
+    /// The first key of the thread's own range.
+    int first;
+    /// The number of keys of the range.
+    int count;
+    /// Set to the number of wrong values the thread read.
+    int errors;
+} main_stripe_job_t;
+
+/*! \brief Inserts its range, removes every third key of it and reads
+ *         the rest back, while the other threads do the same on theirs.
+ */
+static void *main_stripe_worker(void *parg)
+{
+    main_stripe_job_t *pjob = parg;
+    int key;
+    int value;
+    size_t value_size;
+
+    for(key = pjob->first; key < pjob->first + pjob->count; key++)
+    {
+        value = key * 5;
+        hts_insert(pjob->pts, &key, sizeof(key), &value, sizeof(value));
+    }
+    for(key = pjob->first; key < pjob->first + pjob->count; key += 3)
+        hts_remove(pjob->pts, &key, sizeof(key));
+
+    for(key = pjob->first; key < pjob->first + pjob->count; key++)
+    {
+        value = -1;
+        value_size = sizeof(value);
+        if(0 == (key - pjob->first) % 3)
+            pjob->errors += hts_get_i(pjob->pts, &key, sizeof(key), &value, &value_size);
+        else
+            pjob->errors += !hts_get_i(pjob->pts, &key, sizeof(key), &value, &value_size) ||
+                            value != key * 5 || value_size != sizeof(value);
+    }
+
+    return NULL;
+}
+
+/*! \brief Striped table: threads inserting, removing and reading their own
+ *         keys concurrently (growing the table from its initial size) end
+ *         with the same contents a single thread would, on every engine.
+ */
+void main_test18(void)
+{
+    fprintf(stderr, "-----\nStriped thread-safe table\n");
+
+    static const hash_flags_t configs[] = { HT_NONE, HT_INLINE | HT_POW2, HT_SWISS, HT_CUCKOO | HT_ARENA };
+    static const char *config_names[] = { "chained", "chained inline pow2", "swiss", "cuckoo arena" };
+    enum { thread_count = 4, key_count = 20000 };
+    pthread_t threads[thread_count];
+    main_stripe_job_t jobs[thread_count];
+    unsigned int config;
+    int thread;
+    int key;
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        hash_table_striped_t ts;
+        hts_init(&ts, configs[config], 0.05, 16);
+
+        //--------------------------------------------------------------------------------
+        //action 18
+        for(thread = 0; thread < thread_count; thread++)
+        {
+            jobs[thread].pts = &ts;
+            jobs[thread].first = thread * key_count;
+            jobs[thread].count = key_count;
+            jobs[thread].errors = 0;
+            pthread_create(&threads[thread], NULL, main_stripe_worker, &jobs[thread]);
+        }
+
+        int errors = 0;
+        for(thread = 0; thread < thread_count; thread++)
+        {
+            pthread_join(threads[thread], NULL);
+            errors += jobs[thread].errors;
+        }
+
+        //--------------------------------------------------------------------------------
+        //verif 18
+        for(key = 0; key < thread_count * key_count; key++)
+            errors += hts_contains_i(&ts, &key, sizeof(key)) == (0 == (key % key_count) % 3);
+
+        size_t expected = (size_t)thread_count * (key_count - (key_count + 2) / 3);
+        test(errors == 0 && hts_size_sz(&ts) == expected && ts.table.array_size > HT_INITIAL_SIZE,
+             "Concurrent contents (%s, %zu keys, %zu buckets, %d errors)",
+             config_names[config], hts_size_sz(&ts), ts.table.array_size, errors);
+
+        hts_destroy(&ts);
+    }
+}
+
+/// The keys every reader of main_test19 must always find.
+#define MAIN_EPOCH_STABLE 2000
+/// The keys the writer of main_test19 keeps inserting and removing.
+#define MAIN_EPOCH_CHURN 20000
+
+/// The state shared by the threads of main_test19.
+typedef struct main_epoch_job {
+    hash_table_t *pht;
+    /// Set by the writer once it is done.
+    int done;
+    /// Set to the number of wrong lookups a reader saw.
+    int errors;
+    /// Set to the number of lookups a reader made.
+    long lookups;
+} main_epoch_job_t;
+
+/*! \brief Looks up the stable keys (values key * 1000 + version) while the
+ *         writer replaces them, removes and grows: they have to be found every
+ *         time, with a value that stays intact until the epoch is left.
+ */
+static void *main_epoch_reader(void *parg)
+{
+    main_epoch_job_t *pjob = parg;
+    hash_epoch_record_t *precord = ep_register_p(pjob->pht->pepoch);
+    int key = 0;
+    int *pvalue;
+    int first;
+
+    while(!__atomic_load_n(&pjob->done, __ATOMIC_ACQUIRE) || pjob->lookups < 100000)
+    {
+        ep_enter(precord);
+        pvalue = ht_get_p(pjob->pht, &key, sizeof(key), NULL);
+        if(NULL == pvalue || *pvalue / 1000 != key) {
+            pjob->errors++;
+        }
+        else {
+            first = *pvalue;
+            sched_yield();
+            pjob->errors += (*pvalue != first);
+        }
+        ep_exit(precord);
+
+        pjob->lookups++;
+        key = (key + 7) % MAIN_EPOCH_STABLE;
+    }
+
+    ep_unregister(precord);
+    return NULL;
+}
+
+/*! \brief HT_EPOCH: lookups running alongside a writer that replaces,
+ *         inserts, removes and resizes see every stable key with a valid
+ *         value, and the table ends with the writer's contents.
+ */
+void main_test19(void)
+{
+    fprintf(stderr, "-----\nLock-free reads with epoch reclamation\n");
+
+    enum { reader_count = 3 };
+    pthread_t readers[reader_count];
+    main_epoch_job_t jobs[reader_count];
+    hash_table_t ht;
+    int thread;
+    int round;
+    int key;
+    int value;
+
+    ht_init(&ht, HT_EPOCH | HT_INLINE, 0.05);
+    for(key = 0; key < MAIN_EPOCH_STABLE; key++)
+    {
+        value = key * 1000;
+        ht_insert(&ht, &key, sizeof(key), &value, sizeof(value));
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 19
+    for(thread = 0; thread < reader_count; thread++)
+    {
+        jobs[thread].pht = &ht;
+        jobs[thread].done = 0;
+        jobs[thread].errors = 0;
+        jobs[thread].lookups = 0;
+        pthread_create(&readers[thread], NULL, main_epoch_reader, &jobs[thread]);
+    }
+
+    for(round = 1; round < 4; round++)
+    {
+        for(key = 0; key < MAIN_EPOCH_STABLE; key++)
+        {
+            value = key * 1000 + round;
+            ht_insert(&ht, &key, sizeof(key), &value, sizeof(value));
+        }
+        for(key = MAIN_EPOCH_STABLE; key < MAIN_EPOCH_STABLE + MAIN_EPOCH_CHURN; key++)
+            ht_insert(&ht, &key, sizeof(key), &key, sizeof(key));
+        // every resize happens with the readers running, then the array shrinks back
+        if(round < 3) {
+            for(key = MAIN_EPOCH_STABLE; key < MAIN_EPOCH_STABLE + MAIN_EPOCH_CHURN; key++)
+                ht_remove(&ht, &key, sizeof(key));
+            ht_resize(&ht, HT_INITIAL_SIZE);
+        }
+    }
+
+    int errors = 0;
+    long lookups = 0;
+    for(thread = 0; thread < reader_count; thread++)
+    {
+        __atomic_store_n(&jobs[thread].done, 1, __ATOMIC_RELEASE);
+        pthread_join(readers[thread], NULL);
+        errors += jobs[thread].errors;
+        lookups += jobs[thread].lookups;
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 19
+    for(key = 0; key < MAIN_EPOCH_STABLE + MAIN_EPOCH_CHURN; key++)
+    {
+        int *pvalue = ht_get_p(&ht, &key, sizeof(key), NULL);
+        int expected = (key < MAIN_EPOCH_STABLE) ? key * 1000 + 3 : key;
+        errors += (NULL == pvalue || *pvalue != expected);
+    }
+    test(errors == 0 && ht_size_sz(&ht) == MAIN_EPOCH_STABLE + MAIN_EPOCH_CHURN,
+         "Concurrent lock-free lookups (%ld lookups, %d errors)", lookups, errors);
+
+    ep_synchronize(ht.pepoch);
+    int limbo_empty = 1;
+    for(thread = 0; thread < EP_LIMBO_COUNT; thread++)
+        limbo_empty = limbo_empty && (0 == ht.pepoch->limbo[thread].count);
+    test(limbo_empty, "Every retired entry is freed once the readers are gone");
+
+    ht_destroy(&ht);
+}
+
+/// The work of one thread of main_test20.
+typedef struct main_shard_job {
+    hash_table_sharded_t *phs;
+    /// The first key of the thread's own range.
+    int first;
+    /// The number of keys of the range.
+    int count;
+} main_shard_job_t;
+
+/*! \brief Inserts its range, then removes every third key of it.
+ */
+static void *main_shard_worker(void *parg)
+{
+    main_shard_job_t *pjob = parg;
+    int key;
+
+    for(key = pjob->first; key < pjob->first + pjob->count; key++)
+        hs_insert(pjob->phs, &key, sizeof(key), &key, sizeof(key));
+    for(key = pjob->first; key < pjob->first + pjob->count; key += 3)
+        hs_remove(pjob->phs, &key, sizeof(key));
+
+    return NULL;
+}
+
+/*! \brief Sharded table: keys spread evenly over the shards and within
+ *         them, the aggregates cover every shard, and concurrent writers
+ *         keep their contents.
+ */
+void main_test20(void)
+{
+    fprintf(stderr, "-----\nSharded table\n");
+
+    enum { shard_count = 16, key_count = 64000, thread_count = 4 };
+    hash_table_sharded_t hs;
+    hash_table_t whole;
+    pthread_t threads[thread_count];
+    main_shard_job_t jobs[thread_count];
+    size_t index;
+    size_t smallest = SIZE_MAX;
+    size_t largest = 0;
+    size_t shard_buckets = 0;
+    int key;
+
+    //------------------------------------------------------------------------------------
+    //action 20.1
+    hs_init(&hs, HT_POW2, 0.05, shard_count);
+    ht_init(&whole, HT_POW2, 0.05);
+    for(key = 0; key < key_count; key++)
+    {
+        hs_insert(&hs, &key, sizeof(key), &key, sizeof(key));
+        ht_insert(&whole, &key, sizeof(key), &key, sizeof(key));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 20.1
+    for(index = 0; index < hs.shard_count; index++)
+    {
+        size_t size = ht_size_sz(&hs.pshards[index].table);
+        smallest = (size < smallest) ? size : smallest;
+        largest = (size > largest) ? size : largest;
+        shard_buckets += hs.pshards[index].table.array_size;
+    }
+    test(hs_size_sz(&hs) == key_count && smallest > key_count / shard_count * 8 / 10 &&
+         largest < key_count / shard_count * 12 / 10,
+         "Keys spread over the shards (%zu to %zu per shard)", smallest, largest);
+    // shard bits taken straight from the hash would crowd the HT_POW2 buckets of each shard
+    test(shard_buckets <= 2 * whole.array_size,
+         "Keys spread within the shards (%zu buckets in all, %zu unsharded)",
+         shard_buckets, whole.array_size);
+    ht_destroy(&whole);
+
+    //------------------------------------------------------------------------------------
+    //action 20.2
+    for(key = 0; key < key_count; key += 2)
+        hs_remove(&hs, &key, sizeof(key));
+    size_t count;
+    void **ppkeys = hs_keys_pp(&hs, &count);
+
+    //------------------------------------------------------------------------------------
+    //verif 20.2
+    long long sum = 0;
+    for(index = 0; index < count; index++)
+        sum += *(int *)ppkeys[index];
+    test(count == key_count / 2 && sum == (long long)(key_count / 2) * (key_count / 2),
+         "Keys of every shard (%zu keys)", count);
+    free(ppkeys);
+    hs_destroy(&hs);
+
+    //------------------------------------------------------------------------------------
+    //action 20.3
+    hs_init(&hs, HT_NONE, 0.05, 0);
+    for(key = 0; key < thread_count; key++)
+    {
+        jobs[key].phs = &hs;
+        jobs[key].first = key * key_count;
+        jobs[key].count = key_count;
+        pthread_create(&threads[key], NULL, main_shard_worker, &jobs[key]);
+    }
+    for(key = 0; key < thread_count; key++)
+        pthread_join(threads[key], NULL);
+
+    //------------------------------------------------------------------------------------
+    //verif 20.3
+    int errors = 0;
+    for(key = 0; key < thread_count * key_count; key++)
+    {
+        int value = -1;
+        size_t value_size = sizeof(value);
+        int found = hs_get_i(&hs, &key, sizeof(key), &value, &value_size);
+        errors += (0 == (key % key_count) % 3) ? found : (!found || value != key);
+    }
+    test(errors == 0 && hs_size_sz(&hs) == (size_t)thread_count * (key_count - (key_count + 2) / 3),
+         "Concurrent writers on the shards (%zu keys, %d errors)", hs_size_sz(&hs), errors);
+    hs_destroy(&hs);
+
+    //------------------------------------------------------------------------------------
+    //action 20.4
+    // the shards take the hash of hs_shard_p, every engine has to find its keys by it
+    hash_flags_t engines[] = { HT_NONE, HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO };
+    size_t engine;
+    errors = 0;
+    for(engine = 0; engine < sizeof(engines) / sizeof(engines[0]); engine++)
+    {
+        hs_init(&hs, engines[engine], 0.05, 4);
+        for(key = 0; key < key_count / 16; key++)
+            hs_insert(&hs, &key, sizeof(key), &key, sizeof(key));
+        for(key = 0; key < key_count / 16; key += 2)
+            hs_remove(&hs, &key, sizeof(key));
+
+        //--------------------------------------------------------------------------------
+        //verif 20.4
+        for(key = 0; key < key_count / 16; key++)
+        {
+            hash_table_t *ptable = &hs_shard_p(&hs, &key, sizeof(key))->table;
+            int *pvalue = ht_get_p(ptable, &key, sizeof(key), NULL);
+            int found = hs_contains_i(&hs, &key, sizeof(key));
+            errors += (found != (key & 1)) || (found != ht_contains_i(ptable, &key, sizeof(key))) ||
+                      (found && (NULL == pvalue || *pvalue != key));
+        }
+        errors += (hs_size_sz(&hs) != key_count / 32);
+        hs_destroy(&hs);
+    }
+    test(errors == 0, "Keys hashed once by the shards, every engine (%d errors)", errors);
+}
+
+/*! \brief Returns 1 if both tables hold the same chains, node for node in the
+ *         same order, and count the same collisions.
+ */
+static int main_same_chains_i(hash_table_t *pa, hash_table_t *pb)
+{
+    hash_entry_t *pentry_a;
+    hash_entry_t *pentry_b;
+    size_t index;
+
+    if(pa->array_size != pb->array_size || pa->collisions != pb->collisions)
+        return 0;
+
+    for(index = 0; index < pa->array_size; index++)
+    {
+        pentry_a = pa->pparray[index];
+        pentry_b = pb->pparray[index];
+        for(; NULL != pentry_a && NULL != pentry_b; pentry_a = pentry_a->pnext, pentry_b = pentry_b->pnext)
+        {
+            if(pentry_a->hash != pentry_b->hash || pentry_a->key_size != pentry_b->key_size ||
+               0 != memcmp(pentry_a->pkey, pentry_b->pkey, pentry_a->key_size))
+                return 0;
+        }
+        if(pentry_a != pentry_b)
+            return 0;
+    }
+
+    return 1;
+}
+
+/*! \brief Parallel resize: with several threads, growing and shrinking leave
+ *         the very table a single thread does, for every index policy.
+ */
+void main_test21(void)
+{
+    fprintf(stderr, "-----\nParallel resize\n");
+
+    static const hash_flags_t policies[] = { HT_NONE, HT_POW2, HT_FASTRANGE };
+    static const char *pnames[] = { "modulo", "pow2", "fastrange" };
+    enum { key_count = 400000 };
+    hash_table_t serial;
+    hash_table_t parallel;
+    size_t policy;
+    int grown;
+    int shrunk;
+    int found;
+    int key;
+
+    for(policy = 0; policy < sizeof(policies) / sizeof(policies[0]); policy++)
+    {
+        //------------------------------------------------------------------------------------
+        //action 21.1
+        ht_init(&serial, policies[policy] | HT_NO_AUTORESIZE, 0.05);
+        ht_init(&parallel, policies[policy] | HT_NO_AUTORESIZE, 0.05);
+        ht_set_resize_threads(&parallel, 4);
+        ht_resize(&serial, 4 * HT_RESIZE_SPLIT);
+        ht_resize(&parallel, 4 * HT_RESIZE_SPLIT);
+        for(key = 0; key < key_count; key++)
+        {
+            ht_insert(&serial, &key, sizeof(key), &key, sizeof(key));
+            ht_insert(&parallel, &key, sizeof(key), &key, sizeof(key));
+        }
+
+        ht_resize(&serial, 1048576);
+        ht_resize(&parallel, 1048576);
+        grown = main_same_chains_i(&serial, &parallel);
+
+        ht_resize(&serial, 3 * HT_RESIZE_SPLIT);
+        ht_resize(&parallel, 3 * HT_RESIZE_SPLIT);
+        shrunk = main_same_chains_i(&serial, &parallel);
+
+        //------------------------------------------------------------------------------------
+        //verif 21.1
+        found = 0;
+        for(key = 0; key < key_count; key++)
+            found += ht_contains_i(&parallel, &key, sizeof(key));
+        test(grown && shrunk && found == key_count && ht_size_sz(&parallel) == key_count,
+             "%s: 4 threads leave the same chains as 1 (%zu buckets, %d keys found)",
+             pnames[policy], parallel.array_size, found);
+
+        ht_destroy(&serial);
+        ht_destroy(&parallel);
+    }
+}
+
+/// The work of one thread of main_test22.
+typedef struct main_split_job {
+    hash_table_split_t *pso;
+    /// The first key of the thread's own range.
+    int first;
+    /// The number of keys of the range, and of the shared one.
+    int count;
+    /// The lookups of the shared range that found a wrong value.
+    int errors;
+} main_split_job_t;
+
+/*! \brief Inserts its own range, then removes every third key of it, while
+ *         writing and reading the shared range [0, count) with the others.
+ */
+static void *main_split_worker(void *parg)
+{
+    main_split_job_t *pjob = parg;
+    hash_epoch_record_t *precord = ep_register_p(&pjob->pso->epoch);
+    int value;
+    size_t value_size;
+    int key;
+    int index;
+
+    for(index = 0; index < pjob->count; index++)
+    {
+        key = pjob->first + index;
+        so_insert(pjob->pso, precord, &key, sizeof(key), &key, sizeof(key));
+
+        // every thread writes the shared key with the same value, any replace is right
+        key = index;
+        value = -index;
+        so_insert(pjob->pso, precord, &key, sizeof(key), &value, sizeof(value));
+        value_size = sizeof(value);
+        if(!so_get_i(pjob->pso, precord, &key, sizeof(key), &value, &value_size) || value != -index)
+            pjob->errors++;
+    }
+    for(key = pjob->first; key < pjob->first + pjob->count; key += 3)
+        so_remove(pjob->pso, precord, &key, sizeof(key));
+
+    ep_unregister(precord);
+    return NULL;
+}
+
+/*! \brief Split-ordered table: replace, remove and growth by splitting the
+ *         buckets, then concurrent writers on their own and shared keys.
+ */
+void main_test22(void)
+{
+    fprintf(stderr, "-----\nSplit-ordered table\n");
+
+    enum { key_count = 50000, thread_count = 4 };
+    hash_table_split_t so;
+    hash_epoch_record_t *precord;
+    pthread_t threads[thread_count];
+    main_split_job_t jobs[thread_count];
+    size_t value_size;
+    int errors = 0;
+    int value;
+    int key;
+
+    //------------------------------------------------------------------------------------
+    //action 22.1
+    so_init(&so, HT_NONE, 0);
+    precord = ep_register_p(&so.epoch);
+    for(key = 0; key < key_count; key++)
+        so_insert(&so, precord, &key, sizeof(key), &key, sizeof(key));
+    for(key = 0; key < key_count; key += 2)
+    {
+        value = key * 10;
+        so_insert(&so, precord, &key, sizeof(key), &value, sizeof(value));
+    }
+    for(key = 1; key < key_count; key += 4)
+        so_remove(&so, precord, &key, sizeof(key));
+
+    //------------------------------------------------------------------------------------
+    //verif 22.1
+    for(key = 0; key < key_count; key++)
+    {
+        value = -1;
+        value_size = sizeof(value);
+        int found = so_get_i(&so, precord, &key, sizeof(key), &value, &value_size);
+        if(1 == key % 4)
+            errors += found;
+        else
+            errors += !found || value != ((0 == key % 2) ? key * 10 : key);
+    }
+    test(errors == 0 && so_size_sz(&so) == key_count - key_count / 4 &&
+         so.bucket_count * SO_MAX_LOAD >= so_size_sz(&so),
+         "Replaced and removed keys (%zu keys, %llu buckets, %d errors)",
+         so_size_sz(&so), (unsigned long long)so.bucket_count, errors);
+    ep_unregister(precord);
+    so_destroy(&so);
+
+    //------------------------------------------------------------------------------------
+    //action 22.2
+    so_init(&so, HT_HASH_MIX, 0);
+    for(key = 0; key < thread_count; key++)
+    {
+        jobs[key].pso = &so;
+        jobs[key].first = (key + 1) * key_count;
+        jobs[key].count = key_count;
+        jobs[key].errors = 0;
+        pthread_create(&threads[key], NULL, main_split_worker, &jobs[key]);
+    }
+    for(key = 0; key < thread_count; key++)
+    {
+        pthread_join(threads[key], NULL);
+        errors += jobs[key].errors;
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 22.2
+    precord = ep_register_p(&so.epoch);
+    for(key = 0; key < (thread_count + 1) * key_count; key++)
+    {
+        value = -1;
+        value_size = sizeof(value);
+        int found = so_get_i(&so, precord, &key, sizeof(key), &value, &value_size);
+        if(key < key_count)
+            errors += !found || value != -key;
+        else if(0 == (key - key_count) % key_count % 3)
+            errors += found;
+        else
+            errors += !found || value != key;
+    }
+    test(errors == 0 && so_size_sz(&so) == (size_t)key_count + thread_count * (key_count - (key_count + 2) / 3),
+         "Concurrent writers (%zu keys, %d errors)", so_size_sz(&so), errors);
+    ep_unregister(precord);
+    so_destroy(&so);
+}
+
+/*! \brief Scans a table of int keys to int values in chunks of chunk pairs,
+ *         counting in pseen how often each key below key_count comes back.
+ *         Between two calls, when churn is set, keys of [key_count, 2 *
+ *         key_count) are inserted and removed, lookups run (and migrate an
+ *         incremental resize) and the table is grown, rehashed at its size,
+ *         shrunk, then grown. When churn is 2 the table keeps its size
+ *         instead: each call inserts 5 new keys above key_count and removes
+ *         the 5 inserted 30 calls before, and after 100 calls the table is
+ *         rehashed at its size.
+ *  \return The number of pairs whose key or value was wrong.
+ */
+static int main_scan_ints_i(hash_table_t *pht, int key_count, int *pseen, size_t chunk, int churn)
+{
+    hash_scan_item_t items[16];
+    hash_cursor_t cursor;
+    size_t count;
+    size_t index;
+    int errors = 0;
+    int calls = 0;
+    int key;
+
+    ht_scan_start(&cursor);
+    while(!cursor.done)
+    {
+        count = ht_scan_sz(pht, &cursor, items, chunk);
+        for(index = 0; index < count; index++)
+        {
+            key = *(int*)items[index].pkey;
+            if(sizeof(int) != items[index].key_size || sizeof(int) != items[index].value_size ||
+               key != *(int*)items[index].pvalue)
+                errors++;
+            else if(key < key_count)
+                pseen[key]++;
+        }
+
+        calls++;
+        if(!churn)
+            continue;
+        if(2 == churn)
+        {
+            for(index = 0; index < 5; index++)
+            {
+                key = key_count + calls * 5 + (int)index;
+                ht_insert(pht, &key, sizeof(key), &key, sizeof(key));
+                key -= 30 * 5;
+                if(key >= key_count)
+                    ht_remove(pht, &key, sizeof(key));
+            }
+            if(100 == calls)
+                ht_resize(pht, pht->array_size);
+            continue;
+        }
+        for(index = 0; index < 5; index++)
+        {
+            key = key_count + (calls * 5 + (int)index) % key_count;
+            ht_insert(pht, &key, sizeof(key), &key, sizeof(key));
+            key = key_count + (calls * 3 + (int)index) % key_count;
+            ht_remove(pht, &key, sizeof(key));
+            key = calls % key_count;
+            ht_contains_i(pht, &key, sizeof(key));
+        }
+        if(150 == calls || 900 == calls)
+            ht_resize(pht, pht->array_size * 2 + 1);
+        if(300 == calls)
+            ht_resize(pht, pht->array_size);
+        if(450 == calls)
+            ht_resize(pht, pht->array_size / 3 + 1);
+    }
+
+    return errors;
+}
+
+/*! \brief Scan cursor: chunks of every size return every key present all
+ *         along, exactly once for the tables ordered by hash, whatever the
+ *         inserts, removes and resizes between the calls.
+ */
+void main_test23(void)
+{
+    fprintf(stderr, "-----\nScan cursor\n");
+
+    static const hash_flags_t policies[] = {
+        HT_POW2, HT_FASTRANGE, HT_POW2 | HT_HASH64, HT_FASTRANGE | HT_INCREMENTAL,
+        HT_POW2 | HT_INCREMENTAL, HT_NONE, HT_INCREMENTAL };
+    static const char *pnames[] = {
+        "pow2", "fastrange", "pow2 64 bit", "fastrange incremental",
+        "pow2 incremental", "modulo", "modulo incremental" };
+    static const hash_flags_t engines[] = { HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO };
+    static const char *pengines[] = { "robin hood", "swiss", "cuckoo" };
+    enum { key_count = 5000, string_count = 2000, dense_count = 6000 };
+    hash_scan_item_t items[5];
+    hash_cursor_t cursor;
+    hash_table_t ht;
+    char key[32];
+    char value[32];
+    int *pseen = malloc(dense_count * sizeof(int));
+    size_t policy;
+    size_t count;
+    size_t index;
+    int exact = 0;
+    int once;
+    int errors;
+    int k;
+
+    for(policy = 0; policy < sizeof(policies) / sizeof(policies[0]); policy++)
+    {
+        //------------------------------------------------------------------------------------
+        //action 23.1
+        ht_init(&ht, policies[policy], 0.5);
+        ht_set_migrate_budget(&ht, 2);
+        for(k = 0; k < key_count; k++)
+            ht_insert(&ht, &k, sizeof(k), &k, sizeof(k));
+        memset(pseen, 0, key_count * sizeof(int));
+        errors = main_scan_ints_i(&ht, key_count, pseen, 7, 1);
+
+        //------------------------------------------------------------------------------------
+        //verif 23.1
+        exact = (policies[policy] & (HT_POW2 | HT_FASTRANGE)) ? 1 : 0;
+        once = 1;
+        for(k = 0; k < key_count; k++)
+        {
+            errors += (0 == pseen[k]);
+            once &= (1 == pseen[k]);
+        }
+        test(errors == 0 && (once || !exact),
+             "%s: every key returned %s across resizes (%zu buckets)",
+             pnames[policy], exact ? "exactly once" : "at least once", ht.array_size);
+        ht_destroy(&ht);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 23.2
+    ht_init(&ht, HT_FASTRANGE | HT_INLINE, 0.5);
+    for(k = 0; k < string_count; k++)
+    {
+        snprintf(key, sizeof(key), "key %.*d", k % 20, k);
+        snprintf(value, sizeof(value), "value %d", k);
+        ht_insert(&ht, key, strlen(key) + 1, value, strlen(value) + 1);
+    }
+    memset(pseen, 0, string_count * sizeof(int));
+    errors = 0;
+    ht_scan_start(&cursor);
+    while(!cursor.done)
+    {
+        count = ht_scan_sz(&ht, &cursor, items, 5);
+        for(index = 0; index < count; index++)
+        {
+            k = atoi((char*)items[index].pkey + 4);
+            snprintf(key, sizeof(key), "key %.*d", k % 20, k);
+            snprintf(value, sizeof(value), "value %d", k);
+            if(strlen(key) + 1 != items[index].key_size || 0 != strcmp(key, items[index].pkey) ||
+               strlen(value) + 1 != items[index].value_size || 0 != strcmp(value, items[index].pvalue))
+                errors++;
+            else
+                pseen[k]++;
+        }
+        ht_resize(&ht, ht.array_size + 17);
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 23.2
+    for(k = 0; k < string_count; k++)
+        errors += (1 != pseen[k]);
+    test(errors == 0, "String keys and values of any size, resized between calls (%zu buckets)",
+         ht.array_size);
+    ht_destroy(&ht);
+
+    //------------------------------------------------------------------------------------
+    //action 23.3
+    for(policy = 0; policy < sizeof(engines) / sizeof(engines[0]); policy++)
+    {
+        ht_init(&ht, engines[policy], 0);
+        for(k = 0; k < key_count; k++)
+            ht_insert(&ht, &k, sizeof(k), &k, sizeof(k));
+        memset(pseen, 0, key_count * sizeof(int));
+        errors = main_scan_ints_i(&ht, key_count, pseen, 16, 0);
+
+        //------------------------------------------------------------------------------------
+        //verif 23.3
+        for(k = 0; k < key_count; k++)
+            errors += (1 != pseen[k]);
+        test(errors == 0, "%s: every slot returned once without writes", pengines[policy]);
+        ht_destroy(&ht);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 23.4
+    // Robin Hood shifts and cuckoo kicks move keys, swiss clears its tombstones at its size
+    for(policy = 0; policy < sizeof(engines) / sizeof(engines[0]); policy++)
+    {
+        ht_init(&ht, engines[policy], 0);
+        for(k = 0; k < key_count; k++)
+            ht_insert(&ht, &k, sizeof(k), &k, sizeof(k));
+        memset(pseen, 0, key_count * sizeof(int));
+        errors = main_scan_ints_i(&ht, key_count, pseen, 7, 1);
+
+        //------------------------------------------------------------------------------------
+        //verif 23.4
+        for(k = 0; k < key_count; k++)
+            errors += (0 == pseen[k]);
+        test(errors == 0, "%s: every key returned at least once across writes and rehashes (%zu slots)",
+             pengines[policy], ht.array_size);
+        ht_destroy(&ht);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 23.5
+    // near the maximum load, where the writes between two calls move the most keys
+    for(policy = 0; policy < sizeof(engines) / sizeof(engines[0]); policy++)
+    {
+        ht_init(&ht, engines[policy], 0);
+        ht_resize(&ht, 8192);
+        for(k = 0; k < dense_count; k++)
+            ht_insert(&ht, &k, sizeof(k), &k, sizeof(k));
+        memset(pseen, 0, dense_count * sizeof(int));
+        errors = main_scan_ints_i(&ht, dense_count, pseen, 7, 2);
+
+        //------------------------------------------------------------------------------------
+        //verif 23.5
+        for(k = 0; k < dense_count; k++)
+            errors += (0 == pseen[k]);
+        test(errors == 0, "%s: every key returned at least once at %zu keys in %zu slots",
+             pengines[policy], ht.key_count, ht.array_size);
+        ht_destroy(&ht);
+    }
+
+    free(pseen);
+}
+
+/// The state main_test24 accumulates.
+typedef struct main_sum {
+    long long sum;
+    size_t count;
+    int errors;
+} main_sum_t;
+
+/*! \brief Adds an int key to the sum, checking that its value is the same int.
+ */
+static void main_sum_visit(void *pstate, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    main_sum_t *psum = pstate;
+
+    psum->errors += (sizeof(int) != key_size || sizeof(int) != value_size || *(int*)pkey != *(int*)pvalue);
+    psum->sum += *(int*)pkey;
+    psum->count++;
+}
+
+/*! \brief Folds a thread's sum into the first one.
+ */
+static void main_sum_combine(void *pstate, void *pother)
+{
+    main_sum_t *psum = pstate;
+    main_sum_t *pothersum = pother;
+
+    psum->sum += pothersum->sum;
+    psum->count += pothersum->count;
+    psum->errors += pothersum->errors;
+}
+
+/*! \brief For-each: the serial and parallel walks see every pair once, for
+ *         every engine and in the middle of an incremental resize.
+ */
+void main_test24(void)
+{
+    fprintf(stderr, "-----\nFor-each\n");
+
+    static const hash_flags_t engines[] = { HT_NONE, HT_INCREMENTAL | HT_POW2, HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO };
+    static const char *pnames[] = { "chained", "incremental", "robin hood", "swiss", "cuckoo" };
+    enum { key_count = 200000, thread_count = 4 };
+    main_sum_t sums[thread_count];
+    main_sum_t serial;
+    hash_table_t ht;
+    long long expected = (long long)key_count * (key_count - 1) / 2;
+    size_t engine;
+    int resizing;
+    int key;
+
+    for(engine = 0; engine < sizeof(engines) / sizeof(engines[0]); engine++)
+    {
+        //------------------------------------------------------------------------------------
+        //action 24.1
+        ht_init(&ht, engines[engine], 0.5);
+        ht_set_migrate_budget(&ht, 1);
+        for(key = 0; key < key_count; key++)
+            ht_insert(&ht, &key, sizeof(key), &key, sizeof(key));
+        resizing = (NULL != ht.ppold);
+
+        memset(&serial, 0, sizeof(serial));
+        ht_foreach(&ht, main_sum_visit, &serial);
+        memset(sums, 0, sizeof(sums));
+        ht_foreach_parallel(&ht, thread_count, main_sum_visit, sums, sizeof(sums[0]), main_sum_combine);
+
+        //------------------------------------------------------------------------------------
+        //verif 24.1
+        test(serial.errors == 0 && serial.count == key_count && serial.sum == expected &&
+             sums[0].errors == 0 && sums[0].count == key_count && sums[0].sum == expected &&
+             (resizing || !(engines[engine] & HT_INCREMENTAL)),
+             "%s: %zu pairs on 1 thread, %zu on %d", pnames[engine], serial.count, sums[0].count, thread_count);
+        ht_destroy(&ht);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 24.2
+    ht_init(&ht, HT_NONE, 0.5);
+    for(key = 0; key < 10; key++)
+        ht_insert(&ht, &key, sizeof(key), &key, sizeof(key));
+    memset(sums, 0, sizeof(sums));
+    ht_foreach_parallel(&ht, thread_count, main_sum_visit, sums, sizeof(sums[0]), main_sum_combine);
+
+    //------------------------------------------------------------------------------------
+    //verif 24.2
+    test(sums[0].count == 10 && sums[0].sum == 45 && sums[1].count == 0,
+         "A small table is walked by a single thread (%zu pairs)", sums[0].count);
+    ht_destroy(&ht);
+}
+
+/*! \brief Writes the value main_test25 gives a key: "value " then key % 40 * 4 k's.
+ */
+static void main_snapshot_value(char *pvalue, int key)
+{
+    memcpy(pvalue, "value ", 6);
+    memset(pvalue + 6, 'k', key % 40 * 4);
+    pvalue[6 + key % 40 * 4] = '\0';
+}
+
+/*! \brief Counts the pairs into the size_t pointed to by pstate.
+ */
+static void main_count_visit(void *pstate, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    (void) pkey;
+    (void) key_size;
+    (void) pvalue;
+    (void) value_size;
+    (*(size_t*)pstate)++;
+}
+
+/*! \brief Counts the keys of [0, key_count) missing or with a wrong value.
+ */
+static int main_snapshot_errors_i(hash_table_t *pht, int key_count)
+{
+    char expected[256];
+    size_t value_size;
+    char *pvalue;
+    int errors = 0;
+    int key;
+
+    for(key = 0; key < key_count; key++)
+    {
+        main_snapshot_value(expected, key);
+        pvalue = ht_get_p(pht, &key, sizeof(key), &value_size);
+        errors += (NULL == pvalue || value_size != strlen(expected) + 1 || 0 != strcmp(pvalue, expected));
+    }
+
+    return errors;
+}
+
+/*! \brief Snapshots: a saved table loaded into another engine answers from
+ *         the mapping until its first write, and bad files are refused.
+ */
+void main_test25(void)
+{
+    fprintf(stderr, "-----\nSnapshots\n");
+
+    enum { key_count = 30000 };
+    hash_table_t ht;
+    hash_table_t loaded;
+    char path[64];
+    char value[256];
+    int keys[2] = { 7, key_count + 7 };
+    void *ppkeys[2] = { &keys[0], &keys[1] };
+    size_t key_sizes[2] = { sizeof(int), sizeof(int) };
+    void *ppvalues[2];
+    size_t count = 0;
+    uint8_t byte = 0;
+    int saved;
+    int mapped;
+    int verified;
+    int trusted;
+    int rehashed;
+    int missing;
+    int fd;
+    int key;
+
+    snprintf(path, sizeof(path), "/tmp/hashtable_test_%d.snap", (int)getpid());
+    ht_init(&ht, HT_INLINE | HT_POW2, 0.5);
+    for(key = 0; key < key_count; key++)
+    {
+        main_snapshot_value(value, key);
+        ht_insert(&ht, &key, sizeof(key), value, strlen(value) + 1);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 25.1
+    saved = ht_save_i(&ht, path);
+    ht_init(&loaded, HT_ROBIN_HOOD, 0);
+    mapped = ht_load_i(&loaded, path, 1);
+    ht_get_batch(&loaded, ppkeys, key_sizes, 2, ppvalues, NULL);
+    ht_foreach(&loaded, main_count_visit, &count);
+
+    //------------------------------------------------------------------------------------
+    //verif 25.1
+    key = key_count;
+    test(saved && mapped && NULL != loaded.psnapshot && ht_size_sz(&loaded) == key_count && count == key_count &&
+         0 == main_snapshot_errors_i(&loaded, key_count) && !ht_contains_i(&loaded, &key, sizeof(key)) &&
+         NULL != ppvalues[0] && NULL == ppvalues[1],
+         "Saved then mapped into a Robin Hood table (%zu keys)", ht_size_sz(&loaded));
+
+    //------------------------------------------------------------------------------------
+    //action 25.2
+    ht_insert(&loaded, &key, sizeof(key), "value ", sizeof("value "));
+    key = 0;
+    ht_remove(&loaded, &key, sizeof(key));
+
+    //------------------------------------------------------------------------------------
+    //verif 25.2
+    key = key_count;
+    test(NULL == loaded.psnapshot && ht_size_sz(&loaded) == key_count &&
+         1 == main_snapshot_errors_i(&loaded, key_count) && ht_contains_i(&loaded, &key, sizeof(key)),
+         "The first write turns it into a regular table (%zu keys)", ht_size_sz(&loaded));
+    ht_destroy(&loaded);
+
+    //------------------------------------------------------------------------------------
+    //action 25.3
+    fd = open(path, O_RDWR);
+    if(fd >= 0 && 1 == pread(fd, &byte, 1, 4096)) {
+        byte ^= 1;
+        if(1 != pwrite(fd, &byte, 1, 4096))
+            fd = -1;
+    }
+    if(fd >= 0)
+        close(fd);
+    ht_init(&loaded, HT_NONE, 0.5);
+    verified = ht_load_i(&loaded, path, 1);
+    trusted = ht_load_i(&loaded, path, 0);
+    ht_destroy(&loaded);
+    ht_init(&loaded, HT_HASH64, 0.5);
+    rehashed = ht_load_i(&loaded, path, 0);
+    missing = ht_load_i(&loaded, "/nonexistent/hashtable.snap", 0);
+
+    //------------------------------------------------------------------------------------
+    //verif 25.3
+    test(fd >= 0 && !verified && trusted && !rehashed && !missing && NULL == loaded.psnapshot,
+         "A corrupt body fails the check, another hash or no file fails the load");
+    ht_destroy(&loaded);
+
+    //------------------------------------------------------------------------------------
+    //action 25.4
+    ht_save_i(&ht, path);
+    ht_init(&loaded, HT_KEY_CONST | HT_VALUE_CONST | HT_FASTRANGE, 0.5);
+    mapped = ht_load_i(&loaded, path, 0);
+    key = key_count;
+    ht_insert(&loaded, &key, sizeof(key), "value ", sizeof("value "));
+
+    //------------------------------------------------------------------------------------
+    //verif 25.4
+    test(mapped && 0 == main_snapshot_errors_i(&loaded, key_count) && ht_size_sz(&loaded) == key_count + 1,
+         "Constant keys and values of a thawed snapshot stay mapped");
+    ht_destroy(&loaded);
+
+    //------------------------------------------------------------------------------------
+    //action 25.5
+    // the records take the hashes the tables stored, cuckoo keeps another one without HT_HASH64
+    hash_flags_t engines[] = { HT_SWISS, HT_CUCKOO, HT_CUCKOO | HT_HASH64, HT_ROBIN_HOOD | HT_HASH64 };
+    hash_table_t other;
+    size_t engine;
+    int errors = 0;
+    for(engine = 0; engine < sizeof(engines) / sizeof(engines[0]); engine++)
+    {
+        ht_init(&other, engines[engine], 0.5);
+        for(key = 0; key < key_count / 10; key++)
+        {
+            main_snapshot_value(value, key);
+            ht_insert(&other, &key, sizeof(key), value, strlen(value) + 1);
+        }
+        saved = ht_save_i(&other, path);
+        ht_destroy(&other);
+
+        // a mapped table saves from its records
+        ht_init(&loaded, engines[engine] & HT_HASH64, 0.5);
+        saved = saved && ht_load_i(&loaded, path, 1) && ht_save_i(&loaded, path);
+        ht_destroy(&loaded);
+
+        ht_init(&loaded, engines[engine] & HT_HASH64, 0.5);
+        mapped = ht_load_i(&loaded, path, 1);
+        errors += !saved || !mapped || 0 != main_snapshot_errors_i(&loaded, key_count / 10) ||
+                  ht_size_sz(&loaded) != key_count / 10;
+        ht_destroy(&loaded);
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 25.5
+    test(0 == errors, "Saved from every engine and from a mapped table (%d errors)", errors);
+
+    unlink(path);
+    ht_destroy(&ht);
+}
+
+/*! \brief Reads keys [0, key_count) of a shared table from a process of its
+ *         own, until the key -1 shows up: each must keep the value key * 3.
+ *         Returns the exit status of the process, 0 if every read was right.
+ */
+static int main_shm_reader_i(const char *pname, int key_count)
+{
+    hash_table_shm_t hm;
+    size_t value_size;
+    int stop = -1;
+    int errors = 0;
+    int value;
+    int key;
+
+    if(!hm_open_i(&hm, pname))
+        return 1;
+
+    while(!hm_contains_i(&hm, &stop, sizeof(stop)))
+    {
+        for(key = 0; key < key_count; key++)
+        {
+            value_size = sizeof(value);
+            errors += !hm_get_i(&hm, &key, sizeof(key), &value, &value_size) || value_size != sizeof(value) ||
+                      value != key * 3;
+        }
+    }
+
+    hm_close(&hm);
+    return 0 != errors;
+}
+
+/*! \brief Shared memory table: reader processes see consistent values while
+ *         another writes, a second mapping sees the same table, and a full
+ *         segment refuses inserts.
+ */
+void main_test26(void)
+{
+    fprintf(stderr, "-----\nShared memory table\n");
+
+    enum { key_count = 5000, reader_count = 2 };
+    hash_table_shm_t hm;
+    hash_table_shm_t other;
+    pid_t readers[reader_count];
+    char name[64];
+    char value[128];
+    char copy[128];
+    size_t value_size;
+    size_t used;
+    size_t kept = 0;
+    int statuses = 0;
+    int status;
+    int errors = 0;
+    int created;
+    int opened;
+    int inserted;
+    int round;
+    int index;
+    int key;
+
+    snprintf(name, sizeof(name), "/hashtable_test_%d", (int)getpid());
+    created = hm_create_i(&hm, name, 8 << 20, HT_HASH_MIX);
+    for(key = 0; key < key_count; key++)
+    {
+        index = key * 3;
+        hm_insert_i(&hm, &key, sizeof(key), &index, sizeof(index));
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 26.1
+    for(index = 0; index < reader_count; index++)
+    {
+        readers[index] = fork();
+        if(0 == readers[index])
+            _exit(main_shm_reader_i(name, key_count));
+    }
+
+    /// values growing every round move to bigger blocks, removals free them
+    for(round = 0; round < 20; round++)
+    {
+        for(key = key_count; key < 3 * key_count; key++)
+        {
+            memset(value, 'a' + round, sizeof(value));
+            hm_insert_i(&hm, &key, sizeof(key), value, (size_t)(key % 16 + round * 5));
+            if(key % 3 == round % 3)
+                hm_remove(&hm, &key, sizeof(key));
+        }
+    }
+    key = -1;
+    hm_insert_i(&hm, &key, sizeof(key), &key, sizeof(key));
+
+    for(index = 0; index < reader_count; index++)
+    {
+        statuses += (readers[index] > 0 && readers[index] == waitpid(readers[index], &status, 0) &&
+                     WIFEXITED(status) && 0 == WEXITSTATUS(status));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 26.1
+    for(key = key_count; key < 3 * key_count; key++)
+    {
+        value_size = sizeof(copy);
+        memset(value, 'a' + 19, sizeof(value));
+        if(key % 3 == 19 % 3) {
+            errors += hm_contains_i(&hm, &key, sizeof(key));
+            continue;
+        }
+        kept++;
+        errors += !hm_get_i(&hm, &key, sizeof(key), copy, &value_size) ||
+                  value_size != (size_t)(key % 16 + 19 * 5) || 0 != memcmp(copy, value, value_size);
+    }
+    test(created && reader_count == statuses && 0 == errors && hm_size_sz(&hm) == key_count + 1 + kept,
+         "Reader processes saw every value while a writer changed the table (%zu keys)", hm_size_sz(&hm));
+
+    //------------------------------------------------------------------------------------
+    //action 26.2
+    opened = hm_open_i(&other, name);
+    key = 0;
+    index = 42;
+    if(opened)
+        hm_insert_i(&other, &key, sizeof(key), &index, sizeof(index));
+    value_size = sizeof(index);
+    index = 0;
+    hm_get_i(&hm, &key, sizeof(key), &index, &value_size);
+
+    //------------------------------------------------------------------------------------
+    //verif 26.2
+    test(opened && other.pbase != hm.pbase && 42 == index && hm_size_sz(&other) == hm_size_sz(&hm),
+         "A second mapping, at another address, shares the table");
+    if(opened)
+        hm_close(&other);
+    hm_close(&hm);
+    hm_unlink_i(name);
+
+    //------------------------------------------------------------------------------------
+    //action 26.3
+    created = hm_create_i(&hm, name, 64 << 10, HT_NONE);
+    memset(value, 'v', sizeof(value));
+    for(inserted = 0; hm_insert_i(&hm, &inserted, sizeof(inserted), value, 100); inserted++)
+        ;
+    used = hm_used_sz(&hm);
+    errors = 0;
+    for(key = 0; key < inserted; key++)
+        errors += !hm_contains_i(&hm, &key, sizeof(key));
+    key = 0;
+    hm_remove(&hm, &key, sizeof(key));
+    key = inserted;
+
+    //------------------------------------------------------------------------------------
+    //verif 26.3
+    test(created && inserted > 100 && 0 == errors && hm_size_sz(&hm) == (size_t)inserted - 1 &&
+         hm_insert_i(&hm, &key, sizeof(key), value, 100) && hm_used_sz(&hm) == used &&
+         !hm_create_i(&other, name, 64 << 10, HT_NONE) && !hm_open_i(&other, "/hashtable_test_nonexistent"),
+         "A full segment refuses inserts until a block is freed (%d keys)", inserted);
+    hm_close(&hm);
+    hm_unlink_i(name);
+}
+
+/// What main_match_visit compares a table against.
+typedef struct main_match {
+    hash_table_t *pother;
+    int errors;
+} main_match_t;
+
+/*! \brief Counts in pstate the pairs missing from the other table, or with another value there.
+ */
+static void main_match_visit(void *pstate, void *pkey, size_t key_size, void *pvalue, size_t value_size)
+{
+    main_match_t *pmatch = pstate;
+    size_t other_size;
+    void *pother = ht_get_p(pmatch->pother, pkey, key_size, &other_size);
+
+    pmatch->errors += (NULL == pother || other_size != value_size || 0 != memcmp(pother, pvalue, value_size));
+}
+
+/*! \brief Whether two tables hold the same pairs.
+ */
+static int main_same_pairs_i(hash_table_t *pa, hash_table_t *pb)
+{
+    main_match_t match = { pb, 0 };
+
+    ht_foreach(pa, main_match_visit, &match);
+    return 0 == match.errors && ht_size_sz(pa) == ht_size_sz(pb);
+}
+
+/*! \brief The size of a file, -1 if it can't be opened.
+ */
+static long main_file_size_l(const char *ppath)
+{
+    int fd = open(ppath, O_RDONLY);
+    long size;
+
+    if(fd < 0)
+        return -1;
+    size = (long)lseek(fd, 0, SEEK_END);
+    close(fd);
+    return size;
+}
+
+/*! \brief Write-ahead log: a table is rebuilt from its log, then from a
+ *         checkpoint and the log after it, a torn last record is dropped,
+ *         and what is not a log is refused.
+ */
+void main_test27(void)
+{
+    fprintf(stderr, "-----\nWrite-ahead log\n");
+
+    enum { key_count = 20000, batch_count = 256 };
+    hash_table_t ht;
+    hash_table_t recovered;
+    hash_wal_t wal;
+    char log[64];
+    char snap[64];
+    char value[256];
+    int keys[batch_count];
+    void *ppkeys[batch_count];
+    size_t key_sizes[batch_count];
+    void *ppvalues[batch_count];
+    size_t value_sizes[batch_count];
+    size_t replayed = 0;
+    size_t replayed_torn = 0;
+    long log_size;
+    int opened;
+    int committed;
+    int recovered_ok;
+    int refused;
+    int key;
+
+    snprintf(log, sizeof(log), "/tmp/hashtable_test_%d.wal", (int)getpid());
+    snprintf(snap, sizeof(snap), "/tmp/hashtable_test_%d.snap", (int)getpid());
+    unlink(log);
+    unlink(snap);
+    ht_init(&ht, HT_NONE, 0.5);
+
+    //------------------------------------------------------------------------------------
+    //action 27.1
+    opened = hw_open_i(&wal, &ht, log, HW_SYNC_BATCH);
+    for(key = 0; key < key_count; key++)
+    {
+        main_snapshot_value(value, key);
+        ht_insert(&ht, &key, sizeof(key), value, strlen(value) + 1);
+    }
+    for(key = 0; key < batch_count; key++)
+    {
+        keys[key] = key_count + key;
+        ppkeys[key] = &keys[key];
+        key_sizes[key] = sizeof(int);
+        ppvalues[key] = "batch";
+        value_sizes[key] = sizeof("batch");
+    }
+    ht_insert_batch(&ht, ppkeys, key_sizes, ppvalues, value_sizes, batch_count);
+    for(key = 0; key < key_count; key += 5)
+        ht_insert(&ht, &key, sizeof(key), "replaced", sizeof("replaced"));
+    for(key = 0; key < key_count; key += 7)
+        ht_remove(&ht, &key, sizeof(key));
+    committed = hw_commit_i(&wal);
+    ht_init(&recovered, HT_ROBIN_HOOD, 0);
+    recovered_ok = hw_recover_i(&recovered, snap, log, &replayed);
+
+    //------------------------------------------------------------------------------------
+    //verif 27.1
+    test(opened && committed && recovered_ok && replayed == wal.record_count && main_same_pairs_i(&ht, &recovered),
+         "A Robin Hood table rebuilt from the log (%zu records)", replayed);
+    ht_destroy(&recovered);
+
+    //------------------------------------------------------------------------------------
+    //action 27.2
+    committed = hw_checkpoint_i(&wal, snap);
+    log_size = main_file_size_l(log);
+    for(key = 0; key < 1000; key++)
+        ht_remove(&ht, &key, sizeof(key));
+    for(key = 1; key <= 100; key++)
+        ht_insert(&ht, &key, sizeof(key), "after", sizeof("after"));
+    hw_commit_i(&wal);
+    ht_init(&recovered, HT_NONE, 0.5);
+    recovered_ok = hw_recover_i(&recovered, snap, log, &replayed);
+
+    //------------------------------------------------------------------------------------
+    //verif 27.2
+    test(committed && log_size == sizeof(hash_wal_header_t) && recovered_ok && replayed == 1100 &&
+         main_same_pairs_i(&ht, &recovered),
+         "A checkpoint empties the log, the snapshot and the records after it rebuild the table");
+    ht_destroy(&recovered);
+
+    //------------------------------------------------------------------------------------
+    //action 27.3
+    hw_close(&wal);
+    log_size = main_file_size_l(log);
+    if(0 != truncate(log, log_size - 3))
+        log_size = -1;
+    ht_init(&recovered, HT_NONE, 0.5);
+    recovered_ok = hw_recover_i(&recovered, snap, log, &replayed_torn);
+    opened = hw_open_i(&wal, &recovered, log, HW_SYNC_EACH);
+    key = 100;
+    ht_insert(&recovered, &key, sizeof(key), "after", sizeof("after"));
+    hw_close(&wal);
+    ht_destroy(&recovered);
+    ht_init(&recovered, HT_NONE, 0.5);
+    hw_recover_i(&recovered, snap, log, &replayed);
+
+    //------------------------------------------------------------------------------------
+    //verif 27.3
+    test(log_size > 0 && recovered_ok && replayed_torn == 1099 && opened && replayed == 1100 &&
+         main_same_pairs_i(&ht, &recovered),
+         "A torn last record is dropped, and cut off before the next appends");
+    ht_destroy(&recovered);
+
+    //------------------------------------------------------------------------------------
+    //action 27.4
+    ht_init(&recovered, HT_NONE, 0.5);
+    refused = !hw_recover_i(&recovered, NULL, snap, NULL) && !hw_open_i(&wal, &recovered, snap, HW_SYNC_NONE);
+    unlink(log);
+    recovered_ok = hw_recover_i(&recovered, NULL, log, &replayed);
+    ht_destroy(&recovered);
+    ht_init(&recovered, HT_KEY_CONST, 0.5);
+    refused = refused && !hw_recover_i(&recovered, NULL, log, NULL);
+
+    //------------------------------------------------------------------------------------
+    //verif 27.4
+    test(refused && recovered_ok && 0 == replayed && NULL == recovered.pwal,
+         "A file that is not a log is refused, a missing log replays nothing");
+    ht_destroy(&recovered);
+
+    //------------------------------------------------------------------------------------
+    //action 27.5
+    unlink(log);
+    ht_init(&recovered, HT_NONE, 0.5);
+    opened = hw_open_i(&wal, &recovered, log, HW_SYNC_NONE);
+    for(key = 0; key < 10; key++)
+        ht_insert(&recovered, &key, sizeof(key), "cleared", sizeof("cleared"));
+    ht_clear(&recovered);
+    key = 100;
+    ht_insert(&recovered, &key, sizeof(key), "after", sizeof("after"));
+    refused = !ht_load_i(&recovered, snap, 0) && 1 == ht_size_sz(&recovered);
+    ht_destroy(&recovered);
+    committed = NULL == wal.ptable && NULL == recovered.pwal;
+    hw_close(&wal);
+    ht_init(&recovered, HT_NONE, 0.5);
+    recovered_ok = hw_recover_i(&recovered, NULL, log, &replayed);
+
+    //------------------------------------------------------------------------------------
+    //verif 27.5
+    test(opened && refused && committed && recovered_ok && 12 == replayed && 1 == ht_size_sz(&recovered) &&
+         ht_contains_i(&recovered, &key, sizeof(key)),
+         "A clear is logged and replayed, a destroyed table leaves its log detached");
+    ht_destroy(&recovered);
+
+    unlink(log);
+    unlink(snap);
+    ht_destroy(&ht);
+}
+
+/*! \brief Bulk loading: a delimited file through several parse threads into
+ *         a copying table, then a binary file into a zero-copy one.
+ */
+void main_test28(void)
+{
+    fprintf(stderr, "-----\nBulk loader\n");
+
+    enum { line_count = 200000 };
+    hash_table_t ht;
+    hash_load_t load;
+    char path[64];
+    char key[32];
+    char value[64];
+    uint32_t sizes[2];
+    size_t value_size;
+    size_t array_size;
+    char *pfound;
+    FILE *pfile;
+    int loaded;
+    int missing;
+    int errors = 0;
+    int pointed = 1;
+    int index;
+
+    snprintf(path, sizeof(path), "/tmp/hashtable_test_%d.load", (int)getpid());
+
+    //------------------------------------------------------------------------------------
+    //action 28.1
+    pfile = fopen(path, "w");
+    if(NULL != pfile) {
+        fprintf(pfile, "k5\tfirst\n\nno delimiter here\n");
+        for(index = 0; index < line_count; index++)
+            fprintf(pfile, (index % 3) ? "k%d\tvalue %d\n" : "k%d\tvalue %d\r\n", index, index * 7);
+        fprintf(pfile, "k5\tlast");
+        fclose(pfile);
+    }
+    ht_init(&ht, HT_NONE, 0.5);
+    loaded = hl_load_i(&load, &ht, path, HL_DELIMITED, '\t', 3);
+    array_size = ht.array_size;
+    for(index = 0; index < line_count; index++)
+    {
+        snprintf(key, sizeof(key), "k%d", index);
+        snprintf(value, sizeof(value), "value %d", index * 7);
+        if(5 == index)
+            strcpy(value, "last");
+        pfound = ht_get_p(&ht, key, strlen(key), &value_size);
+        errors += (NULL == pfound || value_size != strlen(value) || 0 != memcmp(pfound, value, value_size));
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 28.1
+    test(loaded && 0 == errors && ht_size_sz(&ht) == line_count && load.record_count == line_count + 2 &&
+         1 == load.skipped && NULL == load.pbase,
+         "Delimited file loaded in order by 3 parse threads (%zu records, %zu buckets)",
+         load.record_count, array_size);
+    ht_destroy(&ht);
+
+    //------------------------------------------------------------------------------------
+    //action 28.2
+    pfile = fopen(path, "wb");
+    if(NULL != pfile) {
+        for(index = 0; index < line_count; index++)
+        {
+            snprintf(value, sizeof(value), "%d", index);
+            sizes[0] = sizeof(index);
+            sizes[1] = (uint32_t)strlen(value);
+            fwrite(sizes, sizeof(sizes), 1, pfile);
+            fwrite(&index, sizeof(index), 1, pfile);
+            fwrite(value, 1, sizes[1], pfile);
+        }
+        sizes[1] = 100;
+        fwrite(sizes, sizeof(sizes), 1, pfile);
+        fwrite(&index, sizeof(index), 1, pfile);
+        fclose(pfile);
+    }
+    ht_init(&ht, HT_KEY_CONST | HT_VALUE_CONST, 0.5);
+    loaded = hl_load_i(&load, &ht, path, HL_BINARY, 0, 0);
+    errors = 0;
+    for(index = 0; index < line_count; index++)
+    {
+        snprintf(value, sizeof(value), "%d", index);
+        pfound = ht_get_p(&ht, &index, sizeof(index), &value_size);
+        errors += (NULL == pfound || value_size != strlen(value) || 0 != memcmp(pfound, value, value_size));
+        pointed = pointed && NULL != pfound && (uint8_t *)pfound > load.pbase &&
+                  (uint8_t *)pfound < load.pbase + load.size;
+    }
+
+    //------------------------------------------------------------------------------------
+    //verif 28.2
+    test(loaded && 0 == errors && pointed && ht_size_sz(&ht) == line_count && load.record_count == line_count &&
+         1 == load.skipped,
+         "Binary file loaded with no copy, the values pointing into the mapping");
+    ht_destroy(&ht);
+    hl_unmap(&load);
+
+    //------------------------------------------------------------------------------------
+    //action 28.3
+    ht_init(&ht, HT_NONE, 0.5);
+    missing = hl_load_i(&load, &ht, "/nonexistent/hashtable.load", HL_BINARY, 0, 0);
+
+    //------------------------------------------------------------------------------------
+    //verif 28.3
+    test(!missing && 0 == ht_size_sz(&ht), "A missing file loads nothing");
+    ht_destroy(&ht);
+
+    unlink(path);
+}
+
+/*! \brief Table statistics: the chain lengths add up to the keys, the bytes
+ *         to what each engine and storage flag holds, and resizes are counted.
+ */
+void main_test29(void)
+{
+    fprintf(stderr, "-----\nTable statistics\n");
+
+    enum { key_count = 20000 };
+    static const hash_flags_t configs[] = { HT_NONE, HT_INLINE, HT_KEY_CONST | HT_VALUE_CONST, HT_INCREMENTAL,
+                                            HT_ROBIN_HOOD, HT_SWISS, HT_CUCKOO };
+    static const char *config_names[] = { "chained", "inline", "const", "incremental",
+                                          "robin hood", "swiss", "cuckoo" };
+    static int keys[key_count];
+    hash_table_t ht;
+    hash_stats_t stats;
+    unsigned int config;
+    size_t buckets;
+    size_t chained;
+    size_t index;
+    int counted;
+    int sized;
+    int timed;
+
+    for(index = 0; index < key_count; index++)
+        keys[index] = (int)index;
+
+    for(config = 0; config < sizeof(configs) / sizeof(configs[0]); config++)
+    {
+        //--------------------------------------------------------------------------------
+        //action 29.1
+        ht_init(&ht, configs[config], 0.5);
+        for(index = 0; index < key_count; index++)
+            ht_insert(&ht, &keys[index], sizeof(keys[index]), &keys[index], sizeof(keys[index]));
+        ht_stats(&ht, &stats);
+
+        buckets = 0;
+        chained = 0;
+        for(index = 0; index < HT_CHAIN_HISTOGRAM_SIZE; index++)
+        {
+            buckets += stats.chain_histogram[index];
+            chained += index * stats.chain_histogram[index];
+        }
+        fprintf(stderr, "%-11s: %zu buckets, chains (max) %zu, probes (hit/miss) %.3f/%.3f, "
+                "bytes (array/nodes/keys/values) %zu/%zu/%zu/%zu, %zu resizes in %.6f s\n",
+                config_names[config], ht.array_size, stats.max_chain, stats.hits.mean_probe, stats.miss_probes,
+                stats.array_bytes, stats.node_bytes, stats.key_bytes, stats.value_bytes,
+                stats.resize_count, stats.resize_seconds);
+
+        //--------------------------------------------------------------------------------
+        //verif 29.1
+        if(configs[config] & HT_CUCKOO) {
+            // the keys in the stash are in no bucket
+            counted = buckets == ht.array_size / CK_BUCKET_SLOTS && chained <= key_count &&
+                      stats.max_chain <= CK_BUCKET_SLOTS && stats.miss_probes >= 2.0;
+        }
+        else {
+            counted = buckets == ht.array_size && stats.max_chain < HT_CHAIN_HISTOGRAM_SIZE &&
+                      chained == key_count && stats.miss_probes >= (double)key_count / ht.array_size;
+        }
+
+        if(configs[config] & HT_INLINE)
+            sized = stats.key_bytes == key_count * 8 && stats.value_bytes == key_count * 8;
+        else if(configs[config] & HT_KEY_CONST)
+            sized = 0 == stats.key_bytes && 0 == stats.value_bytes;
+        else
+            sized = stats.key_bytes == key_count * sizeof(int) && stats.value_bytes == key_count * sizeof(int);
+        if(configs[config] & (HT_ROBIN_HOOD | HT_SWISS))
+            sized = sized && 0 == stats.node_bytes && stats.array_bytes >= ht.array_size * sizeof(hash_slot_t);
+        else
+            sized = sized && stats.node_bytes == key_count * sizeof(hash_entry_t) &&
+                    stats.array_bytes >= ht.array_size * sizeof(hash_entry_t *);
+
+        timed = stats.resize_count > 0 && stats.resize_seconds > 0.0 && stats.hits.mean_probe >= 1.0;
+        test(counted && sized && timed, "Statistics of the %s table", config_names[config]);
+        ht_destroy(&ht);
+    }
+
+    //------------------------------------------------------------------------------------
+    //action 29.2
+    ht_init(&ht, HT_NO_AUTORESIZE, 0.5);
+    for(index = 0; index < key_count; index++)
+        ht_insert(&ht, &keys[index], sizeof(keys[index]), &keys[index], sizeof(keys[index]));
+    ht_stats(&ht, &stats);
+    counted = 0 == stats.resize_count && 0.0 == stats.resize_seconds && stats.max_chain > 1;
+    ht_resize(&ht, key_count);
+    ht_resize(&ht, key_count * 2);
+    ht_stats(&ht, &stats);
+
+    //------------------------------------------------------------------------------------
+    //verif 29.2
+    test(counted && 2 == stats.resize_count && stats.miss_probes < 1.0,
+         "Explicit resizes are the only ones of an HT_NO_AUTORESIZE table (%zu)", stats.resize_count);
+    ht_destroy(&ht);
+}
+
+/*! \brief Arena churn: keys allocated apart from their entry but from the
+ *         same size class, removed and inserted again round after round,
+ *         reuse the freed memory instead of growing the arena.
+ */
+void main_test30(void)
+{
+    fprintf(stderr, "-----\nArena churn\n");
+
+    enum { key_count = 1000, round_count = 200, key_size = 40 };
+    hash_table_t ht;
+    hash_stats_t stats;
+    char key[key_size];
+    size_t reserved = 0;
+    int round;
+    int index;
+
+    ht_init(&ht, HT_ARENA, 0.5);
+
+    //------------------------------------------------------------------------------------
+    //action 30
+    memset(key, 'k', sizeof(key));
+    for(round = 0; round < round_count; round++)
+    {
+        for(index = 0; index < key_count; index++)
+        {
+            memcpy(key, &index, sizeof(index));
+            ht_insert(&ht, key, sizeof(key), &round, sizeof(round));
+        }
+        if(0 == round) {
+            ht_stats(&ht, &stats);
+            reserved = ht.parena->reserved;
+        }
+        for(index = 0; index < key_count; index++)
+        {
+            memcpy(key, &index, sizeof(index));
+            ht_remove(&ht, key, sizeof(key));
+        }
+    }
+    fprintf(stderr, "%d-byte keys: %zu bytes reserved after one round, %zu after %d\n",
+            key_size, reserved, ht.parena->reserved, round_count);
+
+    //------------------------------------------------------------------------------------
+    //verif 30
+    test(ht.parena->reserved == reserved && 0 == ht_size_sz(&ht) && stats.key_bytes == key_count * key_size,
+         "Keys freed apart from their entry are reused by the arena");
+    ht_destroy(&ht);
+}